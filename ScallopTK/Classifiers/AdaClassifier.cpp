@@ -114,51 +114,19 @@ int AdaClassifier::classifyCandidate( cv::Mat image, Candidate* cd )
   if( !cd->isActive )
     return 0;
 
-  // Build input to classifier
-  double input[3900];
-  int pos = 0;
-
-  // Print Size features
-  for( int i=0; i<SIZE_FEATURES; i++ ) {
-    input[pos++] = cd->sizeFeatures[i];
-  }
-
-  // Print color features
-  for( int i=0; i<COLOR_FEATURES; i++ )
-    input[pos++] = cd->colorFeatures[i];
-
-  // Print edge features
-  for( int i=0; i<EDGE_FEATURES; i++ )
-    input[pos++] = cd->edgeFeatures[i];
-
-  // Print HoG1
-  CvMat* mat = cd->hogResults[0];
-  for( int i=0; i<HOG_FEATURES; i++ ) {
-    float value = ((float*)(mat->data.ptr))[i];
-    input[pos++] = value;
-  }
-
-  // Print HoG2
-  mat = cd->hogResults[1];
-  for( int i=0; i<HOG_FEATURES; i++ ) {
-    float value = ((float*)(mat->data.ptr))[i];
-    input[pos++] = value;
-  }
-
-  // Print Gabor features
-  for( int i=0; i<GABOR_FEATURES; i++ )
-    input[pos++] = cd->gaborFeatures[i];
+  // Classifier input is the candidate's row of the feature matrix
+  const float *input = cd->features->row;
 
   // Classify our interest point based on the above features
   int idx = 0;
-  pos = 0;
+  int pos = 0;
   double max = -1.0;
   for( int i = 0; i < mainClassifiers.size(); i++ )
   {
-    cd->classMagnitudes[pos] = mainClassifiers[i].adaTree.Predict( input );
-    if( cd->classMagnitudes[pos] > max )
+    cd->features->classMagnitudes[pos] = mainClassifiers[i].adaTree.Predict( input );
+    if( cd->features->classMagnitudes[pos] > max )
     {
-      max = cd->classMagnitudes[pos];
+      max = cd->features->classMagnitudes[pos];
       idx = pos;
     }
     pos++;
@@ -169,21 +137,21 @@ int AdaClassifier::classifyCandidate( cv::Mat image, Candidate* cd )
 
     for( int i = 0; i < suppressionClassifiers.size(); i++ )
     {
-      cd->classMagnitudes[pos] = suppressionClassifiers[i].adaTree.Predict( input );
+      cd->features->classMagnitudes[pos] = suppressionClassifiers[i].adaTree.Predict( input );
 
-      if( cd->classMagnitudes[pos] > max )
+      if( cd->features->classMagnitudes[pos] > max )
       {
-        max = cd->classMagnitudes[pos];
+        max = cd->features->classMagnitudes[pos];
         idx = pos;
       }
 
       pos++;
     }
-    cd->classification = idx;
+    cd->features->classification = idx;
     return idx+1;
   }
   
-  cd->classification = UNCLASSIFIED;
+  cd->features->classification = UNCLASSIFIED;
   return UNCLASSIFIED;
 }
 
@@ -57,6 +57,9 @@ public:
   // Does this classifier have anything to do with scallop detection?
   bool detectsScallops() { return isScallopDirected; }
 
+  // Prediction only reads from the loaded trees, so this is reentrant
+  bool isThreadSafe() { return true; }
+
   // Extract training samples
   //
   // Image should contain the input image
@@ -20,6 +20,7 @@ CNNClassifier::CNNClassifier()
   suppressionClfr = NULL;
   isScallopDirected = false;
   preClass = NULL;
+  sampleCounter = 0;
 }
 
 CNNClassifier::~CNNClassifier()
@@ -277,7 +278,7 @@ unsigned CNNClassifier::classifyCandidates(
 
         if( chip.rows == 0 || chip.cols == 0 )
         {
-          candidates[entry]->classification = UNCLASSIFIED;
+          candidates[entry]->features->classification = UNCLASSIFIED;
           batchPosition--;
         }
         else
@@ -336,7 +337,7 @@ unsigned CNNClassifier::classifyCandidates(
         for( int j = 0; j < categories; j++ )
         {
           double prop = outputBlob->data_at( i, j, 0, 0 );
-          candidates[cid]->classMagnitudes[j] = ( j == 0 ? -1.0 : prop );
+          candidates[cid]->features->classMagnitudes[j] = ( j == 0 ? -1.0 : prop );
 
           if( prop > maxValue )
           {
@@ -359,12 +360,12 @@ unsigned CNNClassifier::classifyCandidates(
 
         if( criteria1 || criteria2 )
         {
-          candidates[cid]->classification = maxInd;
+          candidates[cid]->features->classification = maxInd;
           positive.push_back( candidates[cid] );
         }
         else
         {
-          candidates[cid]->classification = UNCLASSIFIED;
+          candidates[cid]->features->classification = UNCLASSIFIED;
         }
       }
     }
@@ -520,8 +521,6 @@ void CNNClassifier::extractSamples(
     saveCandidates( &w, groundTruth, "output" + ss.str() + ".png" );
 #endif
 
-  static unsigned sampleCounter = 0;
-
   for( unsigned i = 0; i < totalCandidates; i++ )
   {
     cv::Rect cbox = getCandidateBox( candidatesToUse[i] );
@@ -568,7 +567,7 @@ void CNNClassifier::extractSamples(
 
       if( intersect > topIntersect )
       {
-        topLabel = INT_2_STR( groundTruth[j]->classification ) + "_" + postfix;
+        topLabel = INT_2_STR( groundTruth[j]->features->classification ) + "_" + postfix;
         topIntersect = intersect;
       }
     }
@@ -98,6 +98,7 @@ private:
   // Are we in training mode
   bool isTrainingMode;
   std::string outputFolder;
+  unsigned sampleCounter;
 
   // GPU device settings
   DeviceMode deviceMode;
@@ -13,6 +13,8 @@
 
 //Standard C/C++
 #include <vector>
+#include <algorithm>
+#include <iostream>
 
 //OpenCV
 #include <cv.h>
@@ -70,7 +72,7 @@ bool compareCandidateSize( Candidate* cd1, Candidate* cd2  ) {
 
 // Sorting function 2 - sort based on classification magnitude
 bool sortByMag( Candidate* cd1, Candidate* cd2 ) {
-  if( cd1->classMagnitudes[cd1->classification] > cd2->classMagnitudes[cd2->classification] )
+  if( cd1->features->classMagnitudes[cd1->features->classification] > cd2->features->classMagnitudes[cd2->features->classification] )
     return true;
   return false;
 }
@@ -313,42 +315,39 @@ void takeTopCandidates( CandidatePtrVector& input,
 }
 
 
-void getSortedIDs( vector<int>& indices, vector<double> values )
+// Orders indices by descending value
+struct DescendingValue
 {
-  for( int j = 0; j < values.size(); j++ )
+  const vector<double>& values;
+
+  DescendingValue( const vector<double>& v ) : values( v ) {}
+
+  bool operator()( int a, int b ) const {
+    return values[a] > values[b];
+  }
+};
+
+void getSortedIDs( vector<int>& indices, const vector<double>& values )
+{
+  // Stable so that equal values keep their original relative order
+  indices.resize( values.size() );
+
+  for( unsigned i = 0; i < values.size(); i++ )
   {
-    double max = -10000;
-    int maxind = -1;
-    for( int i = 0; i < values.size(); i++ )
-    {
-      if( values[i] > max )
-      {
-        max = values[i];
-        maxind = i;
-      }
-    }
-    indices.push_back( maxind );
-    values[maxind] = -10000;
+    indices[i] = i;
   }
-}
 
-bool appendInfoToFile( DetectionVector& cds, const string& ListFilename, const string& this_fn ) {
+  stable_sort( indices.begin(), indices.end(), DescendingValue( values ) );
+}
 
-  // Get lock on file
-  getListLock();
+void formatDetections( ostream& out, DetectionVector& cds, const string& this_fn ) {
 
-  // Open file and output
-  ofstream fout( ListFilename.c_str(), ios::app );
-  if( !fout.is_open() ) {
-    cout << "ERROR: Could not open output list for writing!\n";
-    return false;
-  }
+  vector<int> sorted_ind;
 
   // print out all results for every Candidate and every possible classification
   for( unsigned int i=0; i<cds.size(); i++ ) {
 
     // Sort possible classifications in descending value based on classification values
-    vector<int> sorted_ind;
     getSortedIDs( sorted_ind, cds[i].classProbabilities );
 
     // Output all possible classifications if enabled
@@ -359,17 +358,26 @@ bool appendInfoToFile( DetectionVector& cds, const string& ListFilename, const s
       float c = cds[i].c;
       float maj = cds[i].major;
       float minor = cds[i].minor;
-      fout << this_fn << "," << r << "," << c << "," << maj << "," << minor << "," << cds[i].angle << ",";
-      fout << cds[i].classIDs[cind] << "," << cds[i].classProbabilities[cind] << "," << int(j+1) << endl;
+      out << this_fn << "," << r << "," << c << "," << maj << "," << minor << "," << cds[i].angle << ",";
+      out << cds[i].classIDs[cind] << "," << cds[i].classProbabilities[cind] << "," << int(j+1) << "\n";
     }
   }
   // so the full output string is (imagename y x major_axis minor_axis angle class class-confidence rank)
+}
+
+bool appendInfoToFile( DetectionVector& cds, const string& ListFilename, const string& this_fn ) {
+
+  // Open file and output
+  ofstream fout( ListFilename.c_str(), ios::app );
+  if( !fout.is_open() ) {
+    cout << "ERROR: Could not open output list for writing!\n";
+    return false;
+  }
+
+  formatDetections( fout, cds, this_fn );
 
   // Close output file
   fout.close();
-
-  // Remove lock on file
-  unlockList();
   return true;
 }
 
@@ -378,8 +386,8 @@ void cullSimilarObjects( CandidatePtrVector& input, bool clams, bool dollars, bo
   // Suppress clam responses
   if( clams ) {
     for( int ind = input.size()-1; ind >= 0; ind-- ) {
-      double scallopClassMag = input[ind]->classMagnitudes[ input[ind]->classification ];
-      double clamClassMag = input[ind]->classMagnitudes[ CLAM ];
+      double scallopClassMag = input[ind]->features->classMagnitudes[ input[ind]->features->classification ];
+      double clamClassMag = input[ind]->features->classMagnitudes[ CLAM ];
       if( scallopClassMag < clamClassMag ) {
         input.erase( input.begin() + ind );
       }
@@ -389,8 +397,8 @@ void cullSimilarObjects( CandidatePtrVector& input, bool clams, bool dollars, bo
   // Suppress dollar responses
   if( dollars ) {
     for( int ind = input.size()-1; ind >= 0; ind-- ) {
-      double scallopClassMag = input[ind]->classMagnitudes[ input[ind]->classification ];
-      double dollarClassMag = input[ind]->classMagnitudes[ DOLLAR ];
+      double scallopClassMag = input[ind]->features->classMagnitudes[ input[ind]->features->classification ];
+      double dollarClassMag = input[ind]->features->classMagnitudes[ DOLLAR ];
       if( scallopClassMag < dollarClassMag ) {
         input.erase( input.begin() + ind );
       }
@@ -400,8 +408,8 @@ void cullSimilarObjects( CandidatePtrVector& input, bool clams, bool dollars, bo
   // Suppress urchin responses
   if( urchins ) {
     for( int ind = input.size()-1; ind >= 0; ind-- ) {
-      double scallopClassMag = input[ind]->classMagnitudes[ input[ind]->classification ];
-      double urchinClassMag = input[ind]->classMagnitudes[ URCHIN ];
+      double scallopClassMag = input[ind]->features->classMagnitudes[ input[ind]->features->classification ];
+      double urchinClassMag = input[ind]->features->classMagnitudes[ URCHIN ];
       if( scallopClassMag < urchinClassMag ) {
         input.erase( input.begin() + ind );
       }
@@ -411,8 +419,8 @@ void cullSimilarObjects( CandidatePtrVector& input, bool clams, bool dollars, bo
   // Suppress sac responses
   if( sacs ) {
     for( int ind = input.size()-1; ind >= 0; ind-- ) {
-      double scallopClassMag = input[ind]->classMagnitudes[ input[ind]->classification ];
-      double sacClassMag = input[ind]->classMagnitudes[ SAC ];
+      double scallopClassMag = input[ind]->features->classMagnitudes[ input[ind]->features->classification ];
+      double sacClassMag = input[ind]->features->classMagnitudes[ SAC ];
       if( scallopClassMag < sacClassMag ) {
         input.erase( input.begin() + ind );
       }
@@ -422,8 +430,8 @@ void cullSimilarObjects( CandidatePtrVector& input, bool clams, bool dollars, bo
   // Suppress misc other responses
   if( misc ) {
     for( int ind = input.size()-1; ind >= 0; ind-- ) {
-      double scallopClassMag = input[ind]->classMagnitudes[ input[ind]->classification ];
-      double miscClassMag = input[ind]->classMagnitudes[ UNCLASSIFIED ];
+      double scallopClassMag = input[ind]->features->classMagnitudes[ input[ind]->features->classification ];
+      double miscClassMag = input[ind]->features->classMagnitudes[ UNCLASSIFIED ];
       if( scallopClassMag < miscClassMag ) {
         input.erase( input.begin() + ind );
       }
@@ -439,8 +447,8 @@ void sandDollarSuppression( CandidatePtrVector& input, bool& scallopMode ) {
   // perform suppression
   for( unsigned int ind = 0; ind < input.size(); ind++ ) {
 
-    double scallopClassMag = input[ind]->classMagnitudes[ input[ind]->classification ];
-    double dollarClassMag = input[ind]->classMagnitudes[ DOLLAR ];
+    double scallopClassMag = input[ind]->features->classMagnitudes[ input[ind]->features->classification ];
+    double dollarClassMag = input[ind]->features->classMagnitudes[ DOLLAR ];
 
     if( scallopMode ) {
 
@@ -496,7 +504,7 @@ DetectionPtrVector interpolateResults( CandidatePtrVector& input,
     obj->minor = input[i]->minor;
 
     ClassifierIDLabel* labelInfo;
-    int best_class = input[i]->classification;
+    int best_class = input[i]->features->classification;
 
     if( best_class < MainSize )
       labelInfo = Classifiers->getLabel( best_class );
@@ -509,11 +517,11 @@ DetectionPtrVector interpolateResults( CandidatePtrVector& input,
     double best_main_class_val = -10.0;
 
     for( int j = 0; j < MainSize; j++ ) {
-      if( input[i]->classMagnitudes[j] >= 0 ) {
+      if( input[i]->features->classMagnitudes[j] >= 0 ) {
         obj->classIDs.push_back( Classifiers->getLabel( j )->id );
-        obj->classProbabilities.push_back( input[i]->classMagnitudes[j] );
-        if( input[i]->classMagnitudes[j] >= best_main_class_val )
-          best_main_class_val = input[i]->classMagnitudes[j];
+        obj->classProbabilities.push_back( input[i]->features->classMagnitudes[j] );
+        if( input[i]->features->classMagnitudes[j] >= best_main_class_val )
+          best_main_class_val = input[i]->features->classMagnitudes[j];
       }
     }
 
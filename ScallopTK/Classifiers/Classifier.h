@@ -7,6 +7,7 @@
 
 //Standard C/C++
 #include <vector>
+#include <iostream>
 
 //OpenCV
 #include <cv.h>
@@ -76,6 +77,10 @@ public:
   // Does this classifier have anything to do with scallop detection?
   virtual bool detectsScallops() = 0;
 
+  // Can classifyCandidates be called concurrently from multiple threads?
+  // If not, callers sharing this classifier must serialize access to it
+  virtual bool isThreadSafe() { return false; }
+
   // Extract training samples
   //
   // Image should contain the input image
@@ -120,7 +125,13 @@ void deallocateDetections( DetectionPtrVector& vec );
 // Append GT training results to some file
 bool appendInfoToFile( DetectionVector& Detections, const std::string& list_fn );
 
-// Append final Detections to some file
+// Write final Detections for a single image to a stream, one line per
+// detection and class, in the output list format
+void formatDetections( std::ostream& out, DetectionVector& cds,
+  const std::string& this_fn );
+
+// Append final Detections to some file, callers writing to the same file
+// from multiple threads are responsible for serializing calls
 bool appendInfoToFile( DetectionVector& cds, const std::string& ListFilename,
   const std::string& this_fn );
 
@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------
+// Title: DetectionWriter.cpp
+//------------------------------------------------------------------------------
+
+#include "DetectionWriter.h"
+
+#include "ScallopTK/Classifiers/Classifier.h"
+
+#include <sstream>
+#include <algorithm>
+
+#ifdef WIN32
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+namespace ScallopTK
+{
+
+// Force any written data for the given file to disk
+static void syncToDisk( FILE *file )
+{
+#ifdef WIN32
+  _commit( _fileno( file ) );
+#else
+  fsync( fileno( file ) );
+#endif
+}
+
+DetectionWriter::DetectionWriter( const std::string& filename, bool isOrdered,
+  unsigned batchFrames, double batchSeconds, SyncPolicy syncPolicy )
+ : file( NULL ),
+   ordered( isOrdered ),
+   flushFrames( std::max( batchFrames, 1u ) ),
+   flushSeconds( batchSeconds ),
+   sync( syncPolicy ),
+   threaded( false ),
+   failed( false ),
+   nextIndex( 0 ),
+   arrivals( 0 ),
+   stopping( false )
+{
+  file = fopen( filename.c_str(), "w" );
+
+  if( !file || !THREADING_ENABLED )
+  {
+    return;
+  }
+
+  threaded = launchThread( handle, writeLoop, this );
+
+  if( !threaded )
+  {
+    std::cerr << "WARNING: Unable to launch list writer thread" << std::endl;
+  }
+}
+
+DetectionWriter::~DetectionWriter()
+{
+  close();
+}
+
+bool DetectionWriter::parseSyncPolicy( const std::string& name, SyncPolicy& policy )
+{
+  if( name == "never" ) {
+    policy = SYNC_NEVER;
+  } else if( name == "flush" ) {
+    policy = SYNC_ON_FLUSH;
+  } else if( name == "close" ) {
+    policy = SYNC_ON_CLOSE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void DetectionWriter::write( unsigned index, DetectionVector& detections,
+  const std::string& frameName )
+{
+  if( !file )
+  {
+    return;
+  }
+
+  lock.lock();
+
+  PendingFrame& frame = queued[ ordered ? index : arrivals++ ];
+  frame.name = frameName;
+  frame.detections.swap( detections );
+
+  if( threaded )
+  {
+    if( readyCount() >= flushFrames )
+    {
+      frameReady.signal();
+    }
+  }
+  else if( readyCount() >= flushFrames ||
+           sinceFlush.getTimeElapsed() >= flushSeconds * 1000.0 )
+  {
+    // Without a writer thread, write batches on the calling thread
+    std::vector< PendingFrame > frames;
+    takeReady( frames, false );
+    writeFrames( frames );
+  }
+
+  lock.unlock();
+}
+
+void DetectionWriter::close()
+{
+  if( !file )
+  {
+    return;
+  }
+
+  lock.lock();
+  stopping = true;
+  frameReady.signal();
+  lock.unlock();
+
+  if( threaded )
+  {
+    joinThread( handle );
+    threaded = false;
+  }
+  else
+  {
+    std::vector< PendingFrame > frames;
+
+    lock.lock();
+    takeReady( frames, true );
+    writeFrames( frames );
+    lock.unlock();
+  }
+
+  if( sync == SYNC_ON_CLOSE )
+  {
+    syncToDisk( file );
+  }
+
+  fclose( file );
+  file = NULL;
+}
+
+unsigned DetectionWriter::readyCount() const
+{
+  unsigned count = 0;
+
+  std::map< unsigned, PendingFrame >::const_iterator itr = queued.begin();
+
+  while( itr != queued.end() && itr->first == nextIndex + count )
+  {
+    count++;
+    itr++;
+  }
+
+  return count;
+}
+
+void DetectionWriter::takeReady( std::vector< PendingFrame >& output, bool all )
+{
+  output.reserve( output.size() + queued.size() );
+
+  while( !queued.empty() )
+  {
+    std::map< unsigned, PendingFrame >::iterator itr = queued.begin();
+
+    if( !all && itr->first != nextIndex )
+    {
+      break;
+    }
+
+    output.push_back( PendingFrame() );
+    output.back().name.swap( itr->second.name );
+    output.back().detections.swap( itr->second.detections );
+
+    nextIndex = itr->first + 1;
+    queued.erase( itr );
+  }
+
+  sinceFlush.start();
+}
+
+void DetectionWriter::writeFrames( std::vector< PendingFrame >& frames )
+{
+  if( frames.empty() )
+  {
+    return;
+  }
+
+  // Format the whole batch before touching the file
+  std::ostringstream buffer;
+
+  for( unsigned i = 0; i < frames.size(); i++ )
+  {
+    formatDetections( buffer, frames[i].detections, frames[i].name );
+  }
+
+  const std::string text = buffer.str();
+
+  if( fwrite( text.data(), 1, text.size(), file ) != text.size() ||
+      fflush( file ) != 0 )
+  {
+    if( !failed )
+    {
+      std::cerr << "CRITICAL ERROR: Could not write to output list!" << std::endl;
+    }
+
+    failed = true;
+  }
+
+  if( sync == SYNC_ON_FLUSH )
+  {
+    syncToDisk( file );
+  }
+}
+
+void *DetectionWriter::writeLoop( void *arg )
+{
+  DetectionWriter *writer = (DetectionWriter*) arg;
+  std::vector< PendingFrame > frames;
+
+  writer->lock.lock();
+
+  while( true )
+  {
+    // Wait for a full batch, the flush interval to pass, or close
+    while( !writer->stopping && writer->readyCount() < writer->flushFrames )
+    {
+      if( writer->flushSeconds <= 0.0 )
+      {
+        writer->frameReady.wait( writer->lock );
+        continue;
+      }
+
+      double remaining = writer->flushSeconds -
+        writer->sinceFlush.getTimeElapsed() / 1000.0;
+
+      if( remaining <= 0.0 )
+      {
+        if( writer->readyCount() > 0 )
+        {
+          break;
+        }
+
+        // Nothing to write yet, restart the interval
+        writer->sinceFlush.start();
+        remaining = writer->flushSeconds;
+      }
+
+      writer->frameReady.timedWait( writer->lock, remaining );
+    }
+
+    bool finished = writer->stopping;
+
+    writer->takeReady( frames, finished );
+
+    // Format and write without holding the lock
+    writer->lock.unlock();
+    writer->writeFrames( frames );
+    frames.clear();
+    writer->lock.lock();
+
+    if( finished )
+    {
+      break;
+    }
+  }
+
+  writer->lock.unlock();
+  return NULL;
+}
+
+}
@@ -0,0 +1,121 @@
+//------------------------------------------------------------------------------
+// Title: DetectionWriter.h
+// Description: Output sink for the detection list, which formats and writes
+//  detections pushed by worker threads in batches on a dedicated thread
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_DETECTION_WRITER_H_
+#define SCALLOP_TK_DETECTION_WRITER_H_
+
+// C/C++ Includes
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+// Scallop Includes
+#include "ScallopTK/Utilities/Definitions.h"
+#include "ScallopTK/Utilities/Threads.h"
+#include "ScallopTK/Utilities/Benchmarking.h"
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                              Class Definition
+//------------------------------------------------------------------------------
+
+class DetectionWriter
+{
+public:
+
+  // When written data is forced to disk
+  enum SyncPolicy
+  {
+    SYNC_NEVER,    // Leave it to the operating system
+    SYNC_ON_FLUSH, // After every batch written
+    SYNC_ON_CLOSE  // Once, when the writer is closed
+  };
+
+  // Truncate and open the given list file. Frames are written in batches
+  // once flushFrames are ready or flushSeconds have passed since the last
+  // write, whichever comes first. If ordered, frames are written in frame
+  // index order (starting at 0), otherwise in the order they are received.
+  DetectionWriter( const std::string& filename, bool ordered,
+    unsigned flushFrames, double flushSeconds, SyncPolicy sync );
+  ~DetectionWriter();
+
+  // Was the output file opened successfully?
+  bool isOpen() const { return file != NULL; }
+
+  // Queue detections for a frame, taking ownership of their contents. In
+  // ordered mode, every frame index must eventually be written, even if
+  // with no detections, for later frames to be output.
+  void write( unsigned index, DetectionVector& detections,
+    const std::string& frameName );
+
+  // Write all queued frames, stop the writer thread and close the file
+  void close();
+
+  // Convert a policy name (never, flush, close), returns false if invalid
+  static bool parseSyncPolicy( const std::string& name, SyncPolicy& policy );
+
+private:
+
+  // Detections for a single frame waiting to be written
+  struct PendingFrame
+  {
+    std::string name;
+    DetectionVector detections;
+  };
+
+  // Writer thread main loop
+  static void *writeLoop( void *arg );
+
+  // Number of queued frames which can be written now
+  unsigned readyCount() const;
+
+  // Remove frames which can be written now (or all, if requested) from the
+  // queue, must be called with the lock held
+  void takeReady( std::vector< PendingFrame >& output, bool all );
+
+  // Format and write the given frames to file
+  void writeFrames( std::vector< PendingFrame >& frames );
+
+  // Settings
+  FILE *file;
+  bool ordered;
+  unsigned flushFrames;
+  double flushSeconds;
+  SyncPolicy sync;
+
+  // Writer thread
+  ThreadHandle handle;
+  bool threaded;
+
+  // Set once a write has failed, only accessed while writing
+  bool failed;
+
+  // Guards all members below
+  ThreadMutex lock;
+  ThreadCondition frameReady;
+
+  // Queued frames, keyed by frame index if ordered, else arrival order
+  std::map< unsigned, PendingFrame > queued;
+  unsigned nextIndex;
+  unsigned arrivals;
+
+  // Time since frames were last written
+  BenchmarkTimer sinceFlush;
+
+  // Set when the writer thread should write all frames and exit
+  bool stopping;
+
+  DetectionWriter( const DetectionWriter& );
+  DetectionWriter& operator=( const DetectionWriter& );
+};
+
+}
+
+#endif
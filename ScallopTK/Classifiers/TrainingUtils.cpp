@@ -4,61 +4,36 @@
 namespace ScallopTK
 {
 
-void printCandidateInfo( int desig, Candidate *cd ) {
+void printCandidateInfo( TrainingSession& session, int desig, Candidate *cd ) {
 
   // Print desig
-  data_file << desig << " ";
+  session.dataFile << desig << " ";
 
-  // Print Size features
-  for( int i=0; i<SIZE_FEATURES; i++ ) {
-    data_file << cd->sizeFeatures[i] << " ";
-  }
-
-  // Print color features
-  for( int i=0; i<COLOR_FEATURES; i++ )
-    data_file << cd->colorFeatures[i] << " ";
-
-  // Print edge features
-  for( int i=0; i<EDGE_FEATURES; i++ )
-    data_file << cd->edgeFeatures[i] << " ";
-
-  // Print HoG1
-  CvMat* mat = cd->hogResults[0];
-  for( int i=0; i<1764; i++ ) {
-    float value = ((float*)(mat->data.ptr))[i];
-    data_file << value << " " ;
-  }
-
-  // Print HoG2
-  mat = cd->hogResults[1];
-  for( int i=0; i<1764; i++ ) {
-    float value = ((float*)(mat->data.ptr))[i];
-    data_file << value << " " ;
-  }
-
-  // Print Gabor
-  for( int i=0; i<GABOR_FEATURES; i++ )
-    data_file << cd->gaborFeatures[i] << " ";
+  // Print features, in size, color, edge, HoG1, HoG2, gabor order
+  const float *row = cd->features->row;
+  for( int i=0; i<TOTAL_FEATURES; i++ )
+    session.dataFile << row[i] << " ";
 
   // End line
-  data_file << "\n";
+  session.dataFile << "\n";
 }
 
-bool initializeTrainingMode( const std::string& folder, const std::string& file ) {
+bool initializeTrainingMode( TrainingSession& session,
+  const std::string& folder, const std::string& file ) {
 
   std::string data_output_fn = folder + file;
 
 #ifdef SAVE_TRAINING_INSTRUCTIONS
   std::string inst_output_fn = folder + "instructions";
-  instruction_file.open(inst_output_fn);
-  if( !instruction_file.is_open() ) {
+  session.instructionFile.open(inst_output_fn);
+  if( !session.instructionFile.is_open() ) {
     cerr << "WHAT ARE YOU DOING?\n";
     return false;
   }
 #endif
 
-  data_file.open(data_output_fn.c_str());
-  if( !data_file.is_open() ) {
+  session.dataFile.open(data_output_fn.c_str());
+  if( !session.dataFile.is_open() ) {
     cerr << "WHAT ARE YOU DOING?\n";
     return false;
   }
@@ -67,18 +42,19 @@ bool initializeTrainingMode( const std::string& folder, const std::string& file
   return true;
 }
 
-void exitTrainingMode() {
+void exitTrainingMode( TrainingSession& session ) {
   cvDestroyWindow( "output" );
   //cvDestroyWindow( "output2" );
   
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-  instruction_file.close();
+  session.instructionFile.close();
 #endif
 
-  data_file.close();
+  session.dataFile.close();
 }
 
-bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
+bool getDesignationsFromUser( TrainingSession& session,
+  CandidatePtrVector& UnorderedCandidates,
   IplImage *display_img, IplImage *mask, int *Detections, float minRad,
   float maxRad, string img_name ) {
   
@@ -120,7 +96,7 @@ bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
     }
 
     //Show interest point
-    showIPNW( display_img, cd->colorQuadrants, cd );
+    showIPNW( display_img, cd->features->colorQuadrants, cd );
 
     //Get User input
     std::cout << "INFO: " << i << " of " << UnorderedCandidates.size() << " ";
@@ -133,14 +109,14 @@ bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
 
     //Print intruction to file    
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-    instruction_file << input << endl;
+    session.instructionFile << input << endl;
 #endif
 
     //Check instruction for special cases
     if( input == "S" || input == "SKIP" ) 
       break;
     if( input == "EXIT" ) {
-      trainingExitFlag = true;
+      session.exitFlag = true;
       return false;
     }
     if( input == "SKIPSMALL" ) {
@@ -159,8 +135,8 @@ bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
       cin >> highp;
       
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << lowp << endl;
-      instruction_file << highp << endl;
+      session.instructionFile << lowp << endl;
+      session.instructionFile << highp << endl;
 #endif
       skipcustom = true;
       continue;
@@ -173,7 +149,7 @@ bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
       i = i + N;
 
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << N << endl;
+      session.instructionFile << N << endl;
 #endif
       continue;
     }
@@ -185,11 +161,11 @@ bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
 
     int in_num = atoi( input.c_str() );
 #ifdef TRAINING_MODE
-    cd->designation = in_num;
+    cd->features->designation = in_num;
 #endif
 
     //Print features to file
-    printCandidateInfo( in_num, cd );
+    printCandidateInfo( session, in_num, cd );
 
     //Update detect map
     if( in_num == 1 || in_num == 2 || in_num == 4 ) {
@@ -208,12 +184,12 @@ bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
   }
 
 #ifdef SAVE_INTEREST_POINTS
-  ofstream ip_out( ip_file_out.c_str(), ios::app );
+  ofstream ip_out( session.ipFileOut.c_str(), ios::app );
   for( unsigned int i = 0; i < UnorderedCandidates.size(); i++ ) {
     if( !UnorderedCandidates[i]->isActive )
       continue;
     ip_out << img_name << " ";
-    ip_out << UnorderedCandidates[i]->designation << " ";
+    ip_out << UnorderedCandidates[i]->features->designation << " ";
     ip_out << UnorderedCandidates[i]->method << " ";
     ip_out << UnorderedCandidates[i]->magnitude << " ";
     ip_out << UnorderedCandidates[i]->r << " ";
@@ -228,7 +204,8 @@ bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
   return true;
 }
 
-bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
+bool getDesignationsFromUser( TrainingSession& session,
+  CandidateQueue& OrderedCandidates,
   IplImage *display_img, IplImage *mask, int *Detections,
   float minRad, float maxRad, string img_name) {
 
@@ -305,14 +282,14 @@ bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
 
     //Print intruction to file
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-    instruction_file << input << endl;
+    session.instructionFile << input << endl;
 #endif
 
     //Check instruction for special cases
     if( input == "SKIP" ) 
       break;
     if( input == "EXIT" ) {
-      trainingExitFlag = true;
+      session.exitFlag = true;
       return false;
     }
     if( input == "SKIPSMALL" ) {
@@ -330,8 +307,8 @@ bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
       std::cout << " UPPER: ";
       cin >> highp;
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << lowp << endl;
-      instruction_file << highp << endl;
+      session.instructionFile << lowp << endl;
+      session.instructionFile << highp << endl;
 #endif
       skipcustom = true;
       continue;
@@ -346,7 +323,7 @@ bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
         OrderedCandidates.pop();
       i = i + N;
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << N << endl;
+      session.instructionFile << N << endl;
 #endif
       continue;
     }
@@ -362,25 +339,25 @@ bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
       cin >> inrat;
       lr = mask->height * inrat;
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << inrat << endl;
+      session.instructionFile << inrat << endl;
 #endif
       std::cout << " UPPER_R_%: ";
       cin >> inrat;
       ur = mask->height * inrat;
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << inrat << endl;
+      session.instructionFile << inrat << endl;
 #endif
       std::cout << " LOWER_C_%: ";
       cin >> inrat;
       lc = mask->width * inrat;
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << inrat << endl;
+      session.instructionFile << inrat << endl;
 #endif
       std::cout << " UPPER_C_%: ";
       cin >> inrat;
       uc = mask->width * inrat;
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << inrat << endl;
+      session.instructionFile << inrat << endl;
 #endif
       skiparea = true;
       continue;
@@ -390,7 +367,7 @@ bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
       std::cout << " METHOD: ";
       cin >> method;
 #ifdef SAVE_TRAINING_INSTRUCTIONS
-      instruction_file << method << endl;
+      session.instructionFile << method << endl;
 #endif
       skipmethod = true;
       continue;
@@ -404,16 +381,16 @@ bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
     int in_num = atoi( input.c_str() );
 
 #ifdef TRAINING_MODE
-    cd->designation = in_num;
+    cd->features->designation = in_num;
 #endif
 
 #else
     // (If IP read from file enabled, we already have stored desig)
-    int in_num = cd->designation;
+    int in_num = cd->features->designation;
 #endif
 
     //Print features to file
-    printCandidateInfo( in_num, cd );
+    printCandidateInfo( session, in_num, cd );
 
     //Update detect map
     if( in_num == 1 || in_num == 2 || in_num == 11 || in_num == 12 ) {
@@ -430,10 +407,10 @@ bool getDesignationsFromUser(CandidateQueue& OrderedCandidates,
       updateMask( mask, cd->r, cd->c, cd->angle, cd->major, cd->minor, DOLLAR );
     }
 #ifdef SAVE_INTEREST_POINTS
-    ofstream ip_out( ip_file_out.c_str(), ios::app );
+    ofstream ip_out( session.ipFileOut.c_str(), ios::app );
 
     ip_out << img_name << " ";
-    ip_out << cd->designation << " ";
+    ip_out << cd->features->designation << " ";
     ip_out << cd->method << " ";
     ip_out << cd->magnitude << " ";
     ip_out << cd->r << " ";
@@ -456,43 +433,17 @@ void dumpCandidateFeatures( string file_name, CandidatePtrVector& cd )
   
   for( int c = 0; c < cd.size(); c++ ) 
   {
-    // Check to make sure not inactive
-    if( cd[c]->isActive == false )
+    // Check to make sure not inactive, and features were extracted
+    if( cd[c]->isActive == false || !cd[c]->features )
       continue;
     
     // Print desig
-    ip_out << cd[c]->classification << " ";
-  
-    // Print Size features
-    for( int i=0; i<SIZE_FEATURES; i++ ) {
-      ip_out << cd[c]->sizeFeatures[i] << " ";
-    }
-  
-    // Print color features
-    for( int i=0; i<COLOR_FEATURES; i++ )
-      ip_out << cd[c]->colorFeatures[i] << " ";
-  
-    // Print edge features
-    for( int i=0; i<EDGE_FEATURES; i++ )
-      ip_out << cd[c]->edgeFeatures[i] << " ";
-  
-    // Print HoG1
-    CvMat* mat = (cd[c])->hogResults[0];
-    for( int i=0; i<1764; i++ ) {
-      float value = ((float*)(mat->data.ptr))[i];
-      ip_out << value << " " ;
-    }
-  
-    // Print HoG2
-    mat = cd[c]->hogResults[1];
-    for( int i=0; i<1764; i++ ) {
-      float value = ((float*)(mat->data.ptr))[i];
-      ip_out << value << " " ;
-    }
+    ip_out << cd[c]->features->classification << " ";
   
-    // Print Gabor
-    for( int i=0; i<GABOR_FEATURES; i++ )
-      ip_out << cd[c]->gaborFeatures[i] << " ";
+    // Print features, in size, color, edge, HoG1, HoG2, gabor order
+    const float *row = cd[c]->features->row;
+    for( int i=0; i<TOTAL_FEATURES; i++ )
+      ip_out << row[i] << " ";
   
     // End line
     ip_out << "\n";
@@ -28,33 +28,44 @@ namespace ScallopTK
 {
 
 //------------------------------------------------------------------------------
-//                                  Globals
+//                              Training Session
 //------------------------------------------------------------------------------
 
-static ofstream instruction_file;
-static ofstream data_file;
-static std::string ip_file_out;
-static bool trainingExitFlag = false;
+// Output files and state for a single GUI training run
+struct TrainingSession
+{
+  ofstream instructionFile;
+  ofstream dataFile;
+  std::string ipFileOut;
+
+  // Set when the user requests to stop training
+  bool exitFlag;
+
+  TrainingSession() : exitFlag( false ) {}
+};
 
 //------------------------------------------------------------------------------
 //                             Function Prototypes
 //------------------------------------------------------------------------------
 
 // Initialize internal properties needed for GUI trainner
-bool initializeTrainingMode( const std::string& folder, const std::string& file );
+bool initializeTrainingMode( TrainingSession& session,
+  const std::string& folder, const std::string& file );
 
 // Print Candidate features to file for GUI mode
-void printCandidateInfo( int desig, Candidate *cd );
+void printCandidateInfo( TrainingSession& session, int desig, Candidate *cd );
 
 // End GUI training mode
-void exitTrainingMode();
+void exitTrainingMode( TrainingSession& session );
 
 // Get designations from user in GUI mode
-bool getDesignationsFromUser( CandidatePtrVector& UnorderedCandidates,
+bool getDesignationsFromUser( TrainingSession& session,
+  CandidatePtrVector& UnorderedCandidates,
   IplImage *displayImg, IplImage *mask, int *Detections,
   float minRad, float maxRad, string img_name );
 
-bool getDesignationsFromUser( CandidateQueue& OrderedCandidates,
+bool getDesignationsFromUser( TrainingSession& session,
+  CandidateQueue& OrderedCandidates,
   IplImage *displayImg, IplImage *mask, int *Detections,
   float minRad, float maxRad, string img_name );
 
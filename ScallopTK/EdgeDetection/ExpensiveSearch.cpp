@@ -48,8 +48,10 @@ inline float dirActFunc( const float& normalizedDirOffset ) {
     return 0.4f;
 }
 
-void expensiveEdgeSearch( GradientChain& Gradients, hfResults* color,
-  IplImage *ImgLab32f, IplImage *img_rgb_32f, CandidatePtrVector cds ) {
+// Search for edges around candidates [startIdx,endIdx)
+static void expensiveEdgeSearchRange( GradientChain& Gradients, hfResults* color,
+  IplImage *ImgLab32f, IplImage *img_rgb_32f, CandidatePtrVector& cds,
+  unsigned startIdx, unsigned endIdx ) {
 
   assert( color->SaliencyMap->width == ImgLab32f->width );
 
@@ -60,7 +62,7 @@ void expensiveEdgeSearch( GradientChain& Gradients, hfResults* color,
   const float SCAN_DIST = 1.33f;
   int height = lab_mag->height;
   int width = lab_mag->width;
-  for( unsigned int i = 0; i < cds.size(); i++ ) {
+  for( unsigned int i = startIdx; i < endIdx; i++ ) {
 
     Candidate* cd = cds[i];
 
@@ -90,9 +92,9 @@ void expensiveEdgeSearch( GradientChain& Gradients, hfResults* color,
     // Create color cost (simularity to avg color of obj)
     IplImage *color = NULL;
     if( 1 /*cd->classification != SCALLOP_BURIED*/ ) {
-      float avgCh1 = cd->innerColorAvg[0];
-      float avgCh2 = cd->innerColorAvg[1];
-      float avgCh3 = cd->innerColorAvg[2];
+      float avgCh1 = cd->features->innerColorAvg[0];
+      float avgCh2 = cd->features->innerColorAvg[1];
+      float avgCh3 = cd->features->innerColorAvg[2];
       color = cvCreateImage( cvSize( c_range, r_range ), IPL_DEPTH_32F, 1 );
       float *ptr_rgb = ((float*)(img_rgb_32f->imageData + img_rgb_32f->widthStep*lr))+lc*3;
       float *outptr = (float*)color->imageData;
@@ -189,10 +191,6 @@ void expensiveEdgeSearch( GradientChain& Gradients, hfResults* color,
     // Smooth cost func [opt]
     cvSmooth( cost, cost, CV_BLUR, 5, 5 );
 
-#ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times[mark] += getTimeSinceLastCall();
-#endif
-
     // Non-max suppression and selection
     IplImage *bin = cvCreateImage( cvGetSize( cost ), IPL_DEPTH_8U, 1 );
     cvZero( bin );
@@ -500,4 +498,31 @@ void expensiveEdgeSearch( GradientChain& Gradients, hfResults* color,
   }
 }
 
+// Loop body for running the above over chunks of candidates in parallel
+class ExpensiveEdgeSearchBody : public ParallelLoopBody
+{
+public:
+  ExpensiveEdgeSearchBody( GradientChain& g, hfResults* c, IplImage *lab,
+    IplImage *rgb, CandidatePtrVector& cds )
+   : gradients( g ), color( c ), imgLab( lab ), imgRGB( rgb ), candidates( cds ) {}
+
+  void operator()( int begin, int end ) const {
+    expensiveEdgeSearchRange( gradients, color, imgLab, imgRGB, candidates, begin, end );
+  }
+
+private:
+  GradientChain& gradients;
+  hfResults* color;
+  IplImage *imgLab;
+  IplImage *imgRGB;
+  CandidatePtrVector& candidates;
+};
+
+void expensiveEdgeSearch( GradientChain& Gradients, hfResults* color,
+  IplImage *ImgLab32f, IplImage *img_rgb_32f, CandidatePtrVector cds, int threads ) {
+
+  ExpensiveEdgeSearchBody body( Gradients, color, ImgLab32f, img_rgb_32f, cds );
+  parallelFor( cds.size(), body, threads, CANDIDATE_CHUNK_SIZE );
+}
+
 }
@@ -20,6 +20,7 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/Threads.h"
 #include "ScallopTK/EdgeDetection/GaussianEdges.h"
 #include "ScallopTK/ObjectProposals/HistogramFiltering.h"
 
@@ -30,8 +31,10 @@
 namespace ScallopTK
 {
 
+// Candidates are searched independently, in chunks across up to threads threads
 void expensiveEdgeSearch( GradientChain& Gradients, hfResults* color, 
-  IplImage *ImgLab32f, IplImage *img_rgb_32f, CandidatePtrVector cds );
+  IplImage *ImgLab32f, IplImage *img_rgb_32f, CandidatePtrVector cds,
+  int threads = 1 );
 
 }
 
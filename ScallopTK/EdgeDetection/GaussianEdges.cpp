@@ -9,8 +9,8 @@ namespace ScallopTK
 //------------------------------------------------------------------------------
 
 // Takes a verticle gaussian derivative
-IplImage *gaussDerivVerticle( IplImage *input, double sigma ) {
-  IplImage *output = cvCreateImage( cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
+IplImage *gaussDerivVerticle( IplImage *input, double sigma, ImageArena *arena ) {
+  IplImage *output = arenaCreateImage( arena, cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
   int filter_size = sigma * KERNEL_SIZE_PER_SIGMA;
   filter_size = filter_size + (filter_size+1)%2;
   CvMat* M = cvCreateMat(filter_size,1,CV_32FC1);
@@ -28,8 +28,8 @@ IplImage *gaussDerivVerticle( IplImage *input, double sigma ) {
 }
 
 // Takes a horizontal gaussian derivative
-IplImage *gaussDerivHorizontal( IplImage *input, double sigma ) {
-  IplImage *output = cvCreateImage( cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
+IplImage *gaussDerivHorizontal( IplImage *input, double sigma, ImageArena *arena ) {
+  IplImage *output = arenaCreateImage( arena, cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
   int filter_size = sigma * KERNEL_SIZE_PER_SIGMA;
   filter_size = filter_size + (filter_size+1)%2;
   CvMat* M = cvCreateMat(1,filter_size,CV_32FC1);
@@ -48,8 +48,8 @@ IplImage *gaussDerivHorizontal( IplImage *input, double sigma ) {
 
 
 // Takes a verticle box derivative
-IplImage *boxDerivVerticle( IplImage *input ) {
-  IplImage *output = cvCreateImage( cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
+IplImage *boxDerivVerticle( IplImage *input, ImageArena *arena = NULL ) {
+  IplImage *output = arenaCreateImage( arena, cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
   CvMat* M = cvCreateMat(3,3,CV_32FC1);
   cvmSet(M, 0, 0, 1.0f );
   cvmSet(M, 0, 1, 2.0f );
@@ -66,8 +66,8 @@ IplImage *boxDerivVerticle( IplImage *input ) {
 }
 
 // Takes a verticle box derivative
-IplImage *boxDerivHorizontal( IplImage *input ) {
-  IplImage *output = cvCreateImage( cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
+IplImage *boxDerivHorizontal( IplImage *input, ImageArena *arena = NULL ) {
+  IplImage *output = arenaCreateImage( arena, cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
   CvMat* M = cvCreateMat(3,3,CV_32FC1);
   cvmSet(M, 0, 0, 1.0f );
   cvmSet(M, 0, 1, 0.0f );
@@ -173,11 +173,11 @@ IplImage *merge3Chan( IplImage *input ) {
   return output;
 }
 
-IplImage *mergeAbs3Chan( IplImage *input ) {
-  IplImage *output = cvCreateImage( cvGetSize( input ), input->depth, 1 );
-  IplImage* ch1 = cvCreateImage( cvGetSize( input ), input->depth, 1 );
-  IplImage* ch2 = cvCreateImage( cvGetSize( input ), input->depth, 1 );
-  IplImage* ch3 = cvCreateImage( cvGetSize( input ), input->depth, 1 );
+IplImage *mergeAbs3Chan( IplImage *input, ImageArena *arena = NULL ) {
+  IplImage *output = arenaCreateImage( arena, cvGetSize( input ), input->depth, 1 );
+  IplImage* ch1 = arenaCreateImage( arena, cvGetSize( input ), input->depth, 1 );
+  IplImage* ch2 = arenaCreateImage( arena, cvGetSize( input ), input->depth, 1 );
+  IplImage* ch3 = arenaCreateImage( arena, cvGetSize( input ), input->depth, 1 );
   cvSplit( input, ch1, ch2, ch3, NULL );
   cvScale( ch1, ch1, 2.0f);
   cvAbs( ch1, ch1 );
@@ -186,9 +186,9 @@ IplImage *mergeAbs3Chan( IplImage *input ) {
   //showImageRange( ch1 );
   cvAdd( ch1, ch2, output );
   cvAdd( ch3, output, output );
-  cvReleaseImage(&ch1);
-  cvReleaseImage(&ch2);
-  cvReleaseImage(&ch3);
+  arenaReleaseImage( arena, &ch1 );
+  arenaReleaseImage( arena, &ch2 );
+  arenaReleaseImage( arena, &ch3 );
   return output;
 }
 
@@ -259,10 +259,11 @@ IplImage *mergeAbs3Chan( IplImage *input ) {
 // Create a chain of all gradient images we need across all operations
 GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
   IplImage *img_gs_8u, IplImage *img_rgb_8u, hfResults *color,
-  float minRad, float maxRad ) {
+  float minRad, float maxRad, ImageArena *arena ) {
 
   // Create chain
   GradientChain output;
+  output.arena = arena;
 
   // Resize input img if needed
   float maxMinRequired = max( MPFMR_WATERSHED, MPFMR_TEMPLATE );
@@ -271,7 +272,7 @@ GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
   if( resize_factor < RESIZE_FACTOR_REQUIRED ) {
     int nheight = resize_factor * img_lab->height;
     int nwidth = resize_factor * img_lab->width;
-    input = cvCreateImage( cvSize(nwidth, nheight), IPL_DEPTH_32F, img_lab->nChannels );
+    input = arenaCreateImage( arena, cvSize(nwidth, nheight), IPL_DEPTH_32F, img_lab->nChannels );
     cvResize( img_lab, input );
   } else {
     resize_factor = 1.0f;
@@ -287,29 +288,29 @@ GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
 
   // Create Lab derivatives
   float adj_sigma_1 = LAB_GRAD_SIGMA * minRad / MPFMR_TEMPLATE;
-  output.dxColorSig1 = gaussDerivHorizontal( input, adj_sigma_1 );
-  output.dyColorSig1 = gaussDerivVerticle( input, adj_sigma_1 );
-  output.dxMergedSig1 = mergeAbs3Chan( output.dxColorSig1 );
-  output.dyMergedSig1 = mergeAbs3Chan( output.dyColorSig1 );
+  output.dxColorSig1 = gaussDerivHorizontal( input, adj_sigma_1, arena );
+  output.dyColorSig1 = gaussDerivVerticle( input, adj_sigma_1, arena );
+  output.dxMergedSig1 = mergeAbs3Chan( output.dxColorSig1, arena );
+  output.dyMergedSig1 = mergeAbs3Chan( output.dyColorSig1, arena );
   cvScale(output.dxMergedSig1,output.dxMergedSig1,1.0/23.0);
   cvScale(output.dyMergedSig1,output.dyMergedSig1,1.0/23.0);
-  output.dMergedSig1 = cvCreateImage( cvGetSize( output.dxMergedSig1 ), IPL_DEPTH_32F, 1 );
+  output.dMergedSig1 = arenaCreateImage( arena, cvGetSize( output.dxMergedSig1 ), IPL_DEPTH_32F, 1 );
   cvAdd( output.dxMergedSig1, output.dyMergedSig1, output.dMergedSig1 );
 
   // Create color derivative
-  output.dxCCGrad = gaussDerivHorizontal( color->EnvironmentMap, ENV_GRAD_SIGMA );
-  output.dyCCGrad = gaussDerivVerticle( color->EnvironmentMap, ENV_GRAD_SIGMA );
+  output.dxCCGrad = gaussDerivHorizontal( color->EnvironmentMap, ENV_GRAD_SIGMA, arena );
+  output.dyCCGrad = gaussDerivVerticle( color->EnvironmentMap, ENV_GRAD_SIGMA, arena );
   cvAbs( output.dyCCGrad, output.dyCCGrad );
   cvAbs( output.dxCCGrad, output.dxCCGrad );
   cvScale(output.dxCCGrad,output.dxCCGrad,1.0/0.50);
   cvScale(output.dyCCGrad,output.dyCCGrad,1.0/0.50);
-  output.netCCGrad = cvCreateImage( cvGetSize( color->NetScallops ), IPL_DEPTH_32F, 1 );
+  output.netCCGrad = arenaCreateImage( arena, cvGetSize( color->NetScallops ), IPL_DEPTH_32F, 1 );
   cvAdd( output.dxCCGrad, output.dyCCGrad, output.netCCGrad );
 
   // Create grayscale edge map
-  output.gsEdge = cvCreateImage( cvGetSize( img_gs_32f ), IPL_DEPTH_32F, 1 );
-  IplImage *bx = boxDerivHorizontal( img_gs_32f );
-  IplImage *by = boxDerivVerticle( img_gs_32f );
+  output.gsEdge = arenaCreateImage( arena, cvGetSize( img_gs_32f ), IPL_DEPTH_32F, 1 );
+  IplImage *bx = boxDerivHorizontal( img_gs_32f, arena );
+  IplImage *by = boxDerivVerticle( img_gs_32f, arena );
   cvAbs( bx, bx );
   cvAbs( by, by );
   cvScale(by, by, 1.0f/1.70f);
@@ -317,13 +318,13 @@ GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
   cvAdd( bx, by, output.gsEdge );
 
   // Extract canny edges
-  output.cannyEdges = cvCreateImage( cvGetSize(output.dxMergedSig1), IPL_DEPTH_8U, 1 );
+  output.cannyEdges = arenaCreateImage( arena, cvGetSize(output.dxMergedSig1), IPL_DEPTH_8U, 1 );
   cvSmooth( img_gs_8u, img_gs_8u, 2, 7, 7 );
   cvCanny( img_gs_8u, output.cannyEdges, 18, 28, 3 );
 
   // Create net template input
-  output.dx = cvCreateImage( cvGetSize(output.dxMergedSig1), IPL_DEPTH_32F, 1 );
-  output.dy = cvCreateImage( cvGetSize(output.dxMergedSig1), IPL_DEPTH_32F, 1 );
+  output.dx = arenaCreateImage( arena, cvGetSize(output.dxMergedSig1), IPL_DEPTH_32F, 1 );
+  output.dy = arenaCreateImage( arena, cvGetSize(output.dxMergedSig1), IPL_DEPTH_32F, 1 );
   cvAdd( output.dxCCGrad, output.dxMergedSig1, output.dx );
   cvAdd( output.dyCCGrad, output.dyMergedSig1, output.dy );
   cvAdd( output.dx, bx, output.dx );
@@ -333,12 +334,12 @@ GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
   //createWatershedMap( output, img_rgb_8u );
 
   // Take Lab derivative magntitude and direction
-  IplImage *lab_dx = cvCreateImage( cvGetSize( img_lab ), img_lab->depth, 3 );
-  IplImage *lab_dy = cvCreateImage( cvGetSize( img_lab ), img_lab->depth, 3 );
+  IplImage *lab_dx = arenaCreateImage( arena, cvGetSize( img_lab ), img_lab->depth, 3 );
+  IplImage *lab_dy = arenaCreateImage( arena, cvGetSize( img_lab ), img_lab->depth, 3 );
   cvSobel( img_lab, lab_dx, 1, 0, 3 );
   cvSobel( img_lab, lab_dy, 0, 1, 3 );
-  IplImage *lab_mag = cvCreateImage( cvGetSize( img_lab ), img_lab->depth, 1 );
-  IplImage *lab_ori = cvCreateImage( cvGetSize( img_lab ), img_lab->depth, 1 );
+  IplImage *lab_mag = arenaCreateImage( arena, cvGetSize( img_lab ), img_lab->depth, 1 );
+  IplImage *lab_ori = arenaCreateImage( arena, cvGetSize( img_lab ), img_lab->depth, 1 );
 
   // Make a single pass on lab images to calc magnitude and orientation approx
   int lab_entries = lab_dx->width * lab_dy->height;
@@ -372,11 +373,11 @@ GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
     
   // Deallocate extraneous
   if( resize_factor != 1.0f ) 
-    cvReleaseImage(&input);
-  cvReleaseImage(&by);
-  cvReleaseImage(&bx);
-  cvReleaseImage( &lab_dx );
-  cvReleaseImage( &lab_dy );
+    arenaReleaseImage( arena, &input );
+  arenaReleaseImage( arena, &by );
+  arenaReleaseImage( arena, &bx );
+  arenaReleaseImage( arena, &lab_dx );
+  arenaReleaseImage( arena, &lab_dy );
 
   return output;
 }
@@ -384,26 +385,26 @@ GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
 // Deallocate gradient chain
 void deallocateGradientChain( GradientChain& chain ) {
 
-  cvReleaseImage( &chain.dxColorSig1 );
-  cvReleaseImage( &chain.dxMergedSig1 );
-  cvReleaseImage( &chain.dyColorSig1 );
-  cvReleaseImage( &chain.dyMergedSig1 );  
-  cvReleaseImage( &chain.dMergedSig1 );
+  arenaReleaseImage( chain.arena, &chain.dxColorSig1 );
+  arenaReleaseImage( chain.arena, &chain.dxMergedSig1 );
+  arenaReleaseImage( chain.arena, &chain.dyColorSig1 );
+  arenaReleaseImage( chain.arena, &chain.dyMergedSig1 );  
+  arenaReleaseImage( chain.arena, &chain.dMergedSig1 );
 
-  cvReleaseImage( &chain.dLabMag );
-  cvReleaseImage( &chain.dLabOri );
+  arenaReleaseImage( chain.arena, &chain.dLabMag );
+  arenaReleaseImage( chain.arena, &chain.dLabOri );
 
-  cvReleaseImage( &chain.dxCCGrad );
-  cvReleaseImage( &chain.dyCCGrad );
-  cvReleaseImage( &chain.netCCGrad );
+  arenaReleaseImage( chain.arena, &chain.dxCCGrad );
+  arenaReleaseImage( chain.arena, &chain.dyCCGrad );
+  arenaReleaseImage( chain.arena, &chain.netCCGrad );
 
-  cvReleaseImage( &chain.gsEdge );
-  cvReleaseImage( &chain.dx );
-  cvReleaseImage( &chain.dy );
+  arenaReleaseImage( chain.arena, &chain.gsEdge );
+  arenaReleaseImage( chain.arena, &chain.dx );
+  arenaReleaseImage( chain.arena, &chain.dy );
 
-  //cvReleaseImage( &chain.WatershedInput );
+  //arenaReleaseImage( chain.arena, &chain.WatershedInput );
 
-  cvReleaseImage( &chain.cannyEdges );
+  arenaReleaseImage( chain.arena, &chain.cannyEdges );
 }
 
 }
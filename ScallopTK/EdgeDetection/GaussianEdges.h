@@ -19,6 +19,7 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/ImageArena.h"
 #include "ScallopTK/ObjectProposals/HistogramFiltering.h"
 
 //------------------------------------------------------------------------------
@@ -63,6 +64,9 @@ struct GradientChain {
 
   // Watershed inputs
   IplImage *WatershedInput;
+
+  // Arena which the above images were borrowed from, if any
+  ImageArena *arena;
 };
 
 //------------------------------------------------------------------------------
@@ -75,12 +79,16 @@ const float KERNEL_SIZE_PER_SIGMA = 6;
 //                             Function Prototypes
 //------------------------------------------------------------------------------
 
-IplImage *gaussDerivVerticle( IplImage *input, double sigma );
-IplImage *gaussDerivHorizontal( IplImage *input, double sigma );
+IplImage *gaussDerivVerticle( IplImage *input, double sigma,
+  ImageArena *arena = NULL );
+IplImage *gaussDerivHorizontal( IplImage *input, double sigma,
+  ImageArena *arena = NULL );
 
+// Images in the chain are borrowed from the arena if one is given, and are
+// returned to it by deallocateGradientChain
 GradientChain createGradientChain( IplImage *img_lab, IplImage *img_gs_32f,
   IplImage *img_gs_8u, IplImage *img_rgb_8u, hfResults *color,
-  float minRad, float maxRad );
+  float minRad, float maxRad, ImageArena *arena = NULL );
 
 void deallocateGradientChain( GradientChain& chain );
 
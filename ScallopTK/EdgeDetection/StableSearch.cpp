@@ -10,8 +10,6 @@ namespace ScallopTK
 
 #ifdef SS_ENABLE_BENCHMARKINGING
   const string ss_bm_fn = "SSBMResults.dat";
-  vector<double> ss_exe_times;
-  ofstream ss_bm_output;
 #endif
 
 //------------------------------------------------------------------------------
@@ -72,23 +70,24 @@ inline float dirActFunc( const float& normalizedDirOffset ) {
     return 0.4f;
 }
 
-void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f, CandidatePtrVector cds, IplImage *rgb ) {
+// Search for edges around candidates [startIdx,endIdx)
+static void edgeSearchRange( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f,
+  CandidatePtrVector& cds, IplImage *rgb, unsigned startIdx, unsigned endIdx ) {
 
   // Debug Checks
   assert( color->SaliencyMap->width == ImgLab32f->width );
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_bm_output.open( ss_bm_fn.c_str(), fstream::out | fstream::app );
-  ss_exe_times.clear();
-  initializeTimer();
-  startTimer();
+  vector<double> ss_exe_times;
+  ofstream ss_bm_output( ss_bm_fn.c_str(), fstream::out | fstream::app );
+  BenchmarkTimer ss_timer;
 #endif
 
   IplImage *lab_ori = Gradients.dLabOri;
   IplImage *lab_mag = Gradients.dLabMag;
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times.push_back( getTimeSinceLastCall() );
+  ss_exe_times.push_back( ss_timer.getTimeSinceLastCall() );
   int mark = ss_exe_times.size();
   for( int i=0; i<6; i++ )
     ss_exe_times.push_back( 0 );
@@ -98,7 +97,7 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
   const float SCAN_DIST = 1.33f;
   int height = lab_mag->height;
   int width = lab_mag->width;
-  for( unsigned int i = 0; i < cds.size(); i++ ) {
+  for( unsigned int i = startIdx; i < endIdx; i++ ) {
 
     Candidate* cd = cds[i];
 
@@ -158,7 +157,7 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
     //cvSmooth( cost, cost, 2, 3, 3 );
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times[mark] += getTimeSinceLastCall();
+  ss_exe_times[mark] += ss_timer.getTimeSinceLastCall();
 #endif
 
     // Non-max suppression and selection
@@ -286,7 +285,7 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
     }
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times[mark+1] += getTimeSinceLastCall();
+  ss_exe_times[mark+1] += ss_timer.getTimeSinceLastCall();
 #endif
 
     // Link/Select Edges
@@ -366,7 +365,7 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
     }
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times[mark+2] += getTimeSinceLastCall();
+  ss_exe_times[mark+2] += ss_timer.getTimeSinceLastCall();
 #endif
   
     // ~~~~~ Basic Analysis ~~~~~
@@ -477,14 +476,14 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
 
       // Insert into feature vector
       if( MSE > -2.5 && MSE < 2.5 )
-        cd->edgeFeatures[0] = MSE;
+        cd->features->edgeFeatures[0] = MSE;
       else 
-        cd->edgeFeatures[0] = 2.5;
+        cd->features->edgeFeatures[0] = 2.5;
       for( int j=0; j<8; j++ )
         if( regMSE[j] > -2.5 && regMSE[j] < 2.5 )
-          cd->edgeFeatures[j+1] = regMSE[j];
+          cd->features->edgeFeatures[j+1] = regMSE[j];
         else
-          cd->edgeFeatures[j+1] = 2.5;
+          cd->features->edgeFeatures[j+1] = 2.5;
       
       // Calculate features around best 2 edge Contours
 
@@ -585,37 +584,37 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
 
         // Insert into feature vector
         int pos = 9;
-        cd->edgeFeatures[pos++] = (int)cd->hasEdgeFeatures;
+        cd->features->edgeFeatures[pos++] = (int)cd->hasEdgeFeatures;
         for( int j=2; j<=10; j+=2 ) {
-          cd->edgeFeatures[pos++] = avgL[j];
-          cd->edgeFeatures[pos++] = avgA[j];
-          cd->edgeFeatures[pos++] = avgB[j];
+          cd->features->edgeFeatures[pos++] = avgL[j];
+          cd->features->edgeFeatures[pos++] = avgA[j];
+          cd->features->edgeFeatures[pos++] = avgB[j];
         }
-        cd->edgeFeatures[pos++] = (avgL[4]+avgL[6]+avgL[8])/3;
-        cd->edgeFeatures[pos++] = (avgA[4]+avgA[6]+avgA[8])/3;
-        cd->edgeFeatures[pos++] = (avgB[4]+avgB[6]+avgB[8])/3;
+        cd->features->edgeFeatures[pos++] = (avgL[4]+avgL[6]+avgL[8])/3;
+        cd->features->edgeFeatures[pos++] = (avgA[4]+avgA[6]+avgA[8])/3;
+        cd->features->edgeFeatures[pos++] = (avgB[4]+avgB[6]+avgB[8])/3;
         int gradStart = pos;
         for( int j=0; j<12; j++ ) {
-          cd->edgeFeatures[pos++] = avgL[j+1]-avgL[j];
-          cd->edgeFeatures[pos++] = avgA[j+1]-avgA[j];
-          cd->edgeFeatures[pos++] = avgB[j+1]-avgB[j];
+          cd->features->edgeFeatures[pos++] = avgL[j+1]-avgL[j];
+          cd->features->edgeFeatures[pos++] = avgA[j+1]-avgA[j];
+          cd->features->edgeFeatures[pos++] = avgB[j+1]-avgB[j];
         }
-        cd->edgeFeatures[pos++] = avgL[8]-avgL[4];
-        cd->edgeFeatures[pos++] = avgA[8]-avgA[4];
-        cd->edgeFeatures[pos++] = avgB[8]-avgB[4];
+        cd->features->edgeFeatures[pos++] = avgL[8]-avgL[4];
+        cd->features->edgeFeatures[pos++] = avgA[8]-avgA[4];
+        cd->features->edgeFeatures[pos++] = avgB[8]-avgB[4];
         //Avg grad
         float avgGradL = 0.0f;
         float avgGradA = 0.0f;
         float avgGradB = 0.0f;
         for( int j=0; j<12; j++ ) {
           int strt = gradStart+j*3;
-          avgGradL = avgGradL + cd->edgeFeatures[strt+0];
-          avgGradA = avgGradA + cd->edgeFeatures[strt+1];
-          avgGradB = avgGradB + cd->edgeFeatures[strt+2];
+          avgGradL = avgGradL + cd->features->edgeFeatures[strt+0];
+          avgGradA = avgGradA + cd->features->edgeFeatures[strt+1];
+          avgGradB = avgGradB + cd->features->edgeFeatures[strt+2];
         }
-        cd->edgeFeatures[pos++] = avgGradL/12;
-        cd->edgeFeatures[pos++] = avgGradA/12;
-        cd->edgeFeatures[pos++] = avgGradB/12;
+        cd->features->edgeFeatures[pos++] = avgGradL/12;
+        cd->features->edgeFeatures[pos++] = avgGradA/12;
+        cd->features->edgeFeatures[pos++] = avgGradB/12;
         //Avg double deriv
         float avgDDL = 0.0f;
         float avgDDA = 0.0f;
@@ -623,17 +622,17 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
         for( int j=0; j<11; j++ ) {
           int strt = gradStart+j*3;
           int strt2 = strt+3;
-          avgDDL += cd->edgeFeatures[strt2+0]-cd->edgeFeatures[strt+0];
-          avgDDA += cd->edgeFeatures[strt2+1]-cd->edgeFeatures[strt+1];
-          avgDDB += cd->edgeFeatures[strt2+2]-cd->edgeFeatures[strt+2];
+          avgDDL += cd->features->edgeFeatures[strt2+0]-cd->features->edgeFeatures[strt+0];
+          avgDDA += cd->features->edgeFeatures[strt2+1]-cd->features->edgeFeatures[strt+1];
+          avgDDB += cd->features->edgeFeatures[strt2+2]-cd->features->edgeFeatures[strt+2];
         }
-        cd->edgeFeatures[pos++] = avgDDL/11;
-        cd->edgeFeatures[pos++] = avgDDA/11;
-        cd->edgeFeatures[pos++] = avgDDB/11;
+        cd->features->edgeFeatures[pos++] = avgDDL/11;
+        cd->features->edgeFeatures[pos++] = avgDDA/11;
+        cd->features->edgeFeatures[pos++] = avgDDB/11;
 
       } else {
         for( int j=9; j<73; j++ )
-          cd->edgeFeatures[j] = 0;
+          cd->features->edgeFeatures[j] = 0;
       }
 
       // Second best entry
@@ -719,37 +718,37 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
 
         // Insert into feature vector
         int pos = 73;
-        cd->edgeFeatures[pos++] = (int)cd->hasEdgeFeatures;
+        cd->features->edgeFeatures[pos++] = (int)cd->hasEdgeFeatures;
         for( int j=2; j<=10; j+=2 ) {
-          cd->edgeFeatures[pos++] = avgL[j];
-          cd->edgeFeatures[pos++] = avgA[j];
-          cd->edgeFeatures[pos++] = avgB[j];
+          cd->features->edgeFeatures[pos++] = avgL[j];
+          cd->features->edgeFeatures[pos++] = avgA[j];
+          cd->features->edgeFeatures[pos++] = avgB[j];
         }
-        cd->edgeFeatures[pos++] = (avgL[4]+avgL[6]+avgL[8])/3;
-        cd->edgeFeatures[pos++] = (avgA[4]+avgA[6]+avgA[8])/3;
-        cd->edgeFeatures[pos++] = (avgB[4]+avgB[6]+avgB[8])/3;
+        cd->features->edgeFeatures[pos++] = (avgL[4]+avgL[6]+avgL[8])/3;
+        cd->features->edgeFeatures[pos++] = (avgA[4]+avgA[6]+avgA[8])/3;
+        cd->features->edgeFeatures[pos++] = (avgB[4]+avgB[6]+avgB[8])/3;
         int gradStart = pos;
         for( int j=0; j<12; j++ ) {
-          cd->edgeFeatures[pos++] = avgL[j+1]-avgL[j];
-          cd->edgeFeatures[pos++] = avgA[j+1]-avgA[j];
-          cd->edgeFeatures[pos++] = avgB[j+1]-avgB[j];
+          cd->features->edgeFeatures[pos++] = avgL[j+1]-avgL[j];
+          cd->features->edgeFeatures[pos++] = avgA[j+1]-avgA[j];
+          cd->features->edgeFeatures[pos++] = avgB[j+1]-avgB[j];
         }
-        cd->edgeFeatures[pos++] = avgL[8]-avgL[4];
-        cd->edgeFeatures[pos++] = avgA[8]-avgA[4];
-        cd->edgeFeatures[pos++] = avgB[8]-avgB[4];
+        cd->features->edgeFeatures[pos++] = avgL[8]-avgL[4];
+        cd->features->edgeFeatures[pos++] = avgA[8]-avgA[4];
+        cd->features->edgeFeatures[pos++] = avgB[8]-avgB[4];
         //Avg grad
         float avgGradL = 0.0f;
         float avgGradA = 0.0f;
         float avgGradB = 0.0f;
         for( int j=0; j<12; j++ ) {
           int strt = gradStart+j*3;
-          avgGradL = avgGradL + cd->edgeFeatures[strt+0];
-          avgGradA = avgGradA + cd->edgeFeatures[strt+1];
-          avgGradB = avgGradB + cd->edgeFeatures[strt+2];
+          avgGradL = avgGradL + cd->features->edgeFeatures[strt+0];
+          avgGradA = avgGradA + cd->features->edgeFeatures[strt+1];
+          avgGradB = avgGradB + cd->features->edgeFeatures[strt+2];
         }
-        cd->edgeFeatures[pos++] = avgGradL/12;
-        cd->edgeFeatures[pos++] = avgGradA/12;
-        cd->edgeFeatures[pos++] = avgGradB/12;
+        cd->features->edgeFeatures[pos++] = avgGradL/12;
+        cd->features->edgeFeatures[pos++] = avgGradA/12;
+        cd->features->edgeFeatures[pos++] = avgGradB/12;
         //Avg double deriv
         float avgDDL = 0.0f;
         float avgDDA = 0.0f;
@@ -757,17 +756,17 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
         for( int j=0; j<11; j++ ) {
           int strt = gradStart+j*3;
           int strt2 = strt+3;
-          avgDDL += cd->edgeFeatures[strt2+0]-cd->edgeFeatures[strt+0];
-          avgDDA += cd->edgeFeatures[strt2+1]-cd->edgeFeatures[strt+1];
-          avgDDB += cd->edgeFeatures[strt2+2]-cd->edgeFeatures[strt+2];
+          avgDDL += cd->features->edgeFeatures[strt2+0]-cd->features->edgeFeatures[strt+0];
+          avgDDA += cd->features->edgeFeatures[strt2+1]-cd->features->edgeFeatures[strt+1];
+          avgDDB += cd->features->edgeFeatures[strt2+2]-cd->features->edgeFeatures[strt+2];
         }
-        cd->edgeFeatures[pos++] = avgDDL/11;
-        cd->edgeFeatures[pos++] = avgDDA/11;
-        cd->edgeFeatures[pos++] = avgDDB/11;
+        cd->features->edgeFeatures[pos++] = avgDDL/11;
+        cd->features->edgeFeatures[pos++] = avgDDA/11;
+        cd->features->edgeFeatures[pos++] = avgDDB/11;
 
       } else {
         for( int j=73; j<137; j++ )
-          cd->edgeFeatures[j] = 0;
+          cd->features->edgeFeatures[j] = 0;
       }
 
       // Adjust new position for offset
@@ -783,11 +782,11 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
       // Not enough edgel information
       cd->hasEdgeFeatures = false;
       for( int j=0; j<137; j++ )
-        cd->edgeFeatures[j] = 0;
+        cd->features->edgeFeatures[j] = 0;
     }
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times[mark+3] += getTimeSinceLastCall();
+  ss_exe_times[mark+3] += ss_timer.getTimeSinceLastCall();
 #endif
   
     // Deallocations for this cd
@@ -797,13 +796,13 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
     cvReleaseImage( &bin );
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times[mark+4] += getTimeSinceLastCall();
+  ss_exe_times[mark+4] += ss_timer.getTimeSinceLastCall();
 #endif
 
   }  
 
 #ifdef SS_ENABLE_BENCHMARKINGING
-  ss_exe_times.push_back( getTimeSinceLastCall() );  
+  ss_exe_times.push_back( ss_timer.getTimeSinceLastCall() );  
 #endif
 
 #ifdef SS_ENABLE_BENCHMARKINGING
@@ -815,5 +814,32 @@ void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f
   
 }
 
+// Loop body for running the above over chunks of candidates in parallel
+class EdgeSearchBody : public ParallelLoopBody
+{
+public:
+  EdgeSearchBody( GradientChain& g, hfResults* c, IplImage *lab,
+    CandidatePtrVector& cds, IplImage *rgb )
+   : gradients( g ), color( c ), imgLab( lab ), candidates( cds ), imgRGB( rgb ) {}
+
+  void operator()( int begin, int end ) const {
+    edgeSearchRange( gradients, color, imgLab, candidates, imgRGB, begin, end );
+  }
+
+private:
+  GradientChain& gradients;
+  hfResults* color;
+  IplImage *imgLab;
+  CandidatePtrVector& candidates;
+  IplImage *imgRGB;
+};
+
+void edgeSearch( GradientChain& Gradients, hfResults* color, IplImage *ImgLab32f,
+  CandidatePtrVector cds, IplImage *rgb, int threads ) {
+
+  EdgeSearchBody body( Gradients, color, ImgLab32f, cds, rgb );
+  parallelFor( cds.size(), body, threads, CANDIDATE_CHUNK_SIZE );
+}
+
 }
 
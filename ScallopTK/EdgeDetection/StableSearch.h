@@ -20,6 +20,7 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/Threads.h"
 #include "ScallopTK/EdgeDetection/GaussianEdges.h"
 #include "ScallopTK/ObjectProposals/HistogramFiltering.h"
 
@@ -35,11 +36,13 @@
 namespace ScallopTK
 {
 
+// Candidates are searched independently, in chunks across up to threads threads
 void edgeSearch( GradientChain& Gradients,
                  hfResults* color,
                  IplImage *ImgLab32f,
                  CandidatePtrVector cds,
-                 IplImage *rgb );
+                 IplImage *rgb,
+                 int threads = 1 );
 
 }
 
@@ -80,18 +80,20 @@ void createOrientedsummaryImages( IplImage *base, CandidatePtrVector& cds ) {
     cvGetAffineTransform( inputs, outputs, &map_matrix ); 
 
     // Create scaled new iamge
-    cds[i]->summaryImage = cvCreateImage( cvSize( n, n ), base->depth, base->nChannels );    
-    cvWarpAffine( base, cds[i]->summaryImage, &map_matrix, CV_INTER_LINEAR | CV_WARP_FILL_OUTLIERS,  cvScalarAll(0));
+    cds[i]->features->summaryImage = cvCreateImage( cvSize( n, n ), base->depth, base->nChannels );    
+    cvWarpAffine( base, cds[i]->features->summaryImage, &map_matrix, CV_INTER_LINEAR | CV_WARP_FILL_OUTLIERS,  cvScalarAll(0));
   }
 }
 
-void createColorQuadrants( IplImage *base, CandidatePtrVector& cds ) {
+// Create color quadrant masks for candidates [startIdx,endIdx)
+static void createColorQuadrantsRange( IplImage *base, CandidatePtrVector& cds,
+  unsigned startIdx, unsigned endIdx ) {
 
   // Constants
   float R1_RATIO = 0.74f;
   float R2_RATIO = 1.00f;
   float R3_RATIO = 1.36f;
-  for( unsigned int i=0; i < cds.size(); i++ ) {
+  for( unsigned int i=startIdx; i < endIdx; i++ ) {
 
     //BELOW SAME AS WATERSHED, OPTIMIZE LATER
     float in_major = cds[i]->major * R1_RATIO;
@@ -143,17 +145,38 @@ void createColorQuadrants( IplImage *base, CandidatePtrVector& cds ) {
     }
 
     // Create mask
-    cds[i]->colorQR = r_min;
-    cds[i]->colorQC = c_min;
-    cds[i]->colorQuadrants = cvCreateImage( cvSize(c_size, r_size), IPL_DEPTH_8U, 1 );
+    cds[i]->features->colorQR = r_min;
+    cds[i]->features->colorQC = c_min;
+    cds[i]->features->colorQuadrants = cvCreateImage( cvSize(c_size, r_size), IPL_DEPTH_8U, 1 );
     for( unsigned int j=0; j<COLOR_BINS; j++ ) 
-      cds[i]->colorBinCount[j] = 0;
-    drawColorRing( cds[i]->colorQuadrants, cds[i]->r-r_min, cds[i]->c-c_min, cds[i]->angle, 
-      in_major, in_minor, cent_major, out_major, cds[i]->colorBinCount );
+      cds[i]->features->colorBinCount[j] = 0;
+    drawColorRing( cds[i]->features->colorQuadrants, cds[i]->r-r_min, cds[i]->c-c_min, cds[i]->angle, 
+      in_major, in_minor, cent_major, out_major, cds[i]->features->colorBinCount );
 
   }
 }
 
+// Loop body for creating color quadrants over chunks of candidates
+class ColorQuadrantsBody : public ParallelLoopBody
+{
+public:
+  ColorQuadrantsBody( IplImage *img, CandidatePtrVector& cds )
+   : base( img ), candidates( cds ) {}
+
+  void operator()( int begin, int end ) const {
+    createColorQuadrantsRange( base, candidates, begin, end );
+  }
+
+private:
+  IplImage *base;
+  CandidatePtrVector& candidates;
+};
+
+void createColorQuadrants( IplImage *base, CandidatePtrVector& cds, int threads ) {
+  ColorQuadrantsBody body( base, cds );
+  parallelFor( cds.size(), body, threads, CANDIDATE_CHUNK_SIZE );
+}
+
 void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candidate *cd ) {
   if( !cd->isActive )
     return;
@@ -179,15 +202,15 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
   int gcounter5 = 0;
   int gcounter6 = 0;
   for( int i=16; i<32; i++ )
-    entries += cd->colorBinCount[i];
+    entries += cd->features->colorBinCount[i];
 
   //START PASS - Collect all color data from both images in this pass
   //Optimize w/ pointer ops later
   int kindex = 0;
-  IplImage* mask = cd->colorQuadrants;
+  IplImage* mask = cd->features->colorQuadrants;
   IplImage* cc = color_class->NetScallops;
-  int rskip = cd->colorQR;
-  int cskip = cd->colorQC;
+  int rskip = cd->features->colorQR;
+  int cskip = cd->features->colorQC;
   for( int r=0; r<mask->height; r++ ) {
     for( int c=0; c<mask->width; c++ ) {
       int regionID = ((char*)(mask->imageData + mask->widthStep*r))[c];
@@ -218,41 +241,41 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
 
   // Get average value for each region
   for( int i=0; i<COLOR_BINS; i++ ) {
-    if( cd->colorBinCount[i] != 0 ) {
-      class_regions[i] = class_regions[i] / cd->colorBinCount[i];
-      color_regionsCh1[i] = color_regionsCh1[i] / cd->colorBinCount[i];
-      color_regionsCh2[i] = color_regionsCh2[i] / cd->colorBinCount[i];
-      color_regionsCh3[i] = color_regionsCh3[i] / cd->colorBinCount[i];
+    if( cd->features->colorBinCount[i] != 0 ) {
+      class_regions[i] = class_regions[i] / cd->features->colorBinCount[i];
+      color_regionsCh1[i] = color_regionsCh1[i] / cd->features->colorBinCount[i];
+      color_regionsCh2[i] = color_regionsCh2[i] / cd->features->colorBinCount[i];
+      color_regionsCh3[i] = color_regionsCh3[i] / cd->features->colorBinCount[i];
     } else if( i <= 8 && i != 0 ) {
       class_regions[i] = class_regions[i-1];
       color_regionsCh1[i] = color_regionsCh1[i-1];
       color_regionsCh2[i] = color_regionsCh2[i-1];
       color_regionsCh3[i] = color_regionsCh3[i-1];
-      cd->colorBinCount[i] = 1;
+      cd->features->colorBinCount[i] = 1;
     } else if( i <= 15 && i > 8 ) {
       class_regions[i] = class_regions[i-1];
       color_regionsCh1[i] = color_regionsCh1[i-1];
       color_regionsCh2[i] = color_regionsCh2[i-1];
       color_regionsCh3[i] = color_regionsCh3[i-1];
-      cd->colorBinCount[i] = 1;
+      cd->features->colorBinCount[i] = 1;
     } else if( i == 8 ) {
       class_regions[i] = class_regions[0];
       color_regionsCh1[i] = color_regionsCh1[0];
       color_regionsCh2[i] = color_regionsCh2[0];
       color_regionsCh3[i] = color_regionsCh3[0];
-      cd->colorBinCount[i] = 1;
+      cd->features->colorBinCount[i] = 1;
     } else if( i <= 31 && i > 16 ) {
       class_regions[i] = class_regions[i-1];
       color_regionsCh1[i] = color_regionsCh1[i-1];
       color_regionsCh2[i] = color_regionsCh2[i-1];
       color_regionsCh3[i] = color_regionsCh3[i-1];
-      cd->colorBinCount[i] = 1;
+      cd->features->colorBinCount[i] = 1;
     } else if( i == 16 ) {
       class_regions[i] = class_regions[8];
       color_regionsCh1[i] = color_regionsCh1[8];
       color_regionsCh2[i] = color_regionsCh2[8];
       color_regionsCh3[i] = color_regionsCh3[8];
-      cd->colorBinCount[i] = 1;
+      cd->features->colorBinCount[i] = 1;
     } else {
       // probabalistically never reached
       //Heavy environmental lvl
@@ -261,13 +284,13 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
       color_regionsCh1[i] = 0.43;
       color_regionsCh2[i] = 0.47;
       color_regionsCh3[i] = 0.48;
-      cd->colorBinCount[i] = 1;
+      cd->features->colorBinCount[i] = 1;
     }
   }
 
   // Create color feature matrix - part 1 - classifier edge differences u2 - u1
   for( int i=0; i<8; i++ )
-    cd->colorFeatures[i] = class_regions[16+i] - class_regions[8+i];
+    cd->features->colorFeatures[i] = class_regions[16+i] - class_regions[8+i];
 
   // part 2 - net class radial dir - bins 8->15, bins 16->23, bins 24->31
   float inside_class_avg = 0.0f;
@@ -276,9 +299,9 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
 
     // calc slice avg
     float slice_avg;
-    int count_sum = cd->colorBinCount[24+i] + cd->colorBinCount[16+i];
-    slice_avg = class_regions[24+i]*cd->colorBinCount[24+i] + 
-          class_regions[16+i]*cd->colorBinCount[16+i];
+    int count_sum = cd->features->colorBinCount[24+i] + cd->features->colorBinCount[16+i];
+    slice_avg = class_regions[24+i]*cd->features->colorBinCount[24+i] + 
+          class_regions[16+i]*cd->features->colorBinCount[16+i];
     slice_avg = slice_avg / count_sum;
 
     // update total avg
@@ -287,9 +310,9 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
     inside_class_avg = inside_class_avg / inside_class_entries;
 
     // insert feature entries
-    cd->colorFeatures[i+8] = slice_avg - class_regions[8+i];
-    cd->colorFeatures[i+16] = slice_avg;
-    cd->colorFeatures[i+24] = class_regions[8+i];
+    cd->features->colorFeatures[i+8] = slice_avg - class_regions[8+i];
+    cd->features->colorFeatures[i+16] = slice_avg;
+    cd->features->colorFeatures[i+24] = class_regions[8+i];
   }
 
   // part 3 - net class full template - bins 32, 33, 34
@@ -297,25 +320,25 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
   for( int i=0; i<8; i++ )
     outside_class_avg = outside_class_avg + class_regions[8+i];
   outside_class_avg = outside_class_avg / 8;
-  cd->colorFeatures[32] = inside_class_avg - outside_class_avg;
-  cd->colorFeatures[33] = outside_class_avg;
-  cd->colorFeatures[34] = inside_class_avg;
+  cd->features->colorFeatures[32] = inside_class_avg - outside_class_avg;
+  cd->features->colorFeatures[33] = outside_class_avg;
+  cd->features->colorFeatures[34] = inside_class_avg;
 
   // part 4 - color edge differences u2 - u1 - bins 35 - 42, bins 43-50, bins 51-58
   for( int i=0; i<8; i++ ) {
-    cd->colorFeatures[i+35] = color_regionsCh1[16+i] - color_regionsCh1[8+i];
-    cd->colorFeatures[i+43] = color_regionsCh2[16+i] - color_regionsCh2[8+i];
-    cd->colorFeatures[i+51] = color_regionsCh3[16+i] - color_regionsCh3[8+i];
+    cd->features->colorFeatures[i+35] = color_regionsCh1[16+i] - color_regionsCh1[8+i];
+    cd->features->colorFeatures[i+43] = color_regionsCh2[16+i] - color_regionsCh2[8+i];
+    cd->features->colorFeatures[i+51] = color_regionsCh3[16+i] - color_regionsCh3[8+i];
   }
 
   // part 5 - color edge groups - bins 59-106
   for( int i=0; i<8; i++ ) {
-    cd->colorFeatures[i+59] = color_regionsCh1[16+i];
-    cd->colorFeatures[i+67] = color_regionsCh2[16+i];
-    cd->colorFeatures[i+75] = color_regionsCh3[16+i];
-    cd->colorFeatures[i+83] = color_regionsCh1[8+i];
-    cd->colorFeatures[i+91] = color_regionsCh2[8+i];
-    cd->colorFeatures[i+99] = color_regionsCh3[8+i];
+    cd->features->colorFeatures[i+59] = color_regionsCh1[16+i];
+    cd->features->colorFeatures[i+67] = color_regionsCh2[16+i];
+    cd->features->colorFeatures[i+75] = color_regionsCh3[16+i];
+    cd->features->colorFeatures[i+83] = color_regionsCh1[8+i];
+    cd->features->colorFeatures[i+91] = color_regionsCh2[8+i];
+    cd->features->colorFeatures[i+99] = color_regionsCh3[8+i];
   }
 
   // part 6 - total color - bins 107-109, 110-112, 113-115
@@ -338,23 +361,23 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
   avg_inner_color[1] = avg_inner_color[1] / 16;
   avg_inner_color[2] = avg_inner_color[2] / 16;
   for( int i=0; i<3; i++ ) {
-    cd->colorFeatures[i+107] = avg_inner_color[i] - avg_outer_color[i];
-    cd->colorFeatures[i+110] = avg_inner_color[i];
-    cd->colorFeatures[i+113] = avg_outer_color[i];
+    cd->features->colorFeatures[i+107] = avg_inner_color[i] - avg_outer_color[i];
+    cd->features->colorFeatures[i+110] = avg_inner_color[i];
+    cd->features->colorFeatures[i+113] = avg_outer_color[i];
   }  
 
   // part 7 - color trace values
-  cd->colorFeatures[116] = (float)gcounter1 / entries;
-  cd->colorFeatures[117] = (float)gcounter2 / entries;
-  cd->colorFeatures[118] = (float)gcounter3 / entries;
-  cd->colorFeatures[119] = (float)gcounter4 / entries;
-  cd->colorFeatures[120] = (float)gcounter5 / entries;
-  cd->colorFeatures[121] = (float)gcounter6 / entries;
+  cd->features->colorFeatures[116] = (float)gcounter1 / entries;
+  cd->features->colorFeatures[117] = (float)gcounter2 / entries;
+  cd->features->colorFeatures[118] = (float)gcounter3 / entries;
+  cd->features->colorFeatures[119] = (float)gcounter4 / entries;
+  cd->features->colorFeatures[120] = (float)gcounter5 / entries;
+  cd->features->colorFeatures[121] = (float)gcounter6 / entries;
 
   // calculate avg regional colors used for expensive edge selection process
-  cd->innerColorAvg[0] = avg_inner_color[0];
-  cd->innerColorAvg[1] = avg_inner_color[1];
-  cd->innerColorAvg[2] = avg_inner_color[2];
+  cd->features->innerColorAvg[0] = avg_inner_color[0];
+  cd->features->innerColorAvg[1] = avg_inner_color[1];
+  cd->features->innerColorAvg[2] = avg_inner_color[2];
   avg_outer_color[0] = 0.0f;
   avg_outer_color[1] = 0.0f;
   avg_outer_color[2] = 0.0f;
@@ -363,9 +386,34 @@ void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candid
     avg_outer_color[1] = avg_outer_color[1] + color_regionsCh2[i];
     avg_outer_color[2] = avg_outer_color[2] + color_regionsCh3[i];
   }
-  cd->outerColorAvg[0] = avg_outer_color[0] / 16;
-  cd->outerColorAvg[1] = avg_outer_color[1] / 16;
-  cd->outerColorAvg[2] = avg_outer_color[2] / 16;
+  cd->features->outerColorAvg[0] = avg_outer_color[0] / 16;
+  cd->features->outerColorAvg[1] = avg_outer_color[1] / 16;
+  cd->features->outerColorAvg[2] = avg_outer_color[2] / 16;
+}
+
+// Loop body for calculating color features over chunks of candidates
+class ColorFeaturesBody : public ParallelLoopBody
+{
+public:
+  ColorFeaturesBody( IplImage *img, hfResults *cls, CandidatePtrVector& cds )
+   : colorImg( img ), colorClass( cls ), candidates( cds ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int i=begin; i<end; i++ ) {
+      calculateColorFeatures( colorImg, colorClass, candidates[i] );
+    }
+  }
+
+private:
+  IplImage *colorImg;
+  hfResults *colorClass;
+  CandidatePtrVector& candidates;
+};
+
+void calculateColorFeatures( IplImage* color_img, hfResults *color_class,
+  CandidatePtrVector& cds, int threads ) {
+  ColorFeaturesBody body( color_img, color_class, cds );
+  parallelFor( cds.size(), body, threads, CANDIDATE_CHUNK_SIZE );
 }
 
 }
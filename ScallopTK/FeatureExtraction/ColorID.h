@@ -21,6 +21,7 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/Threads.h"
 #include "ScallopTK/ObjectProposals/HistogramFiltering.h"
 
 //------------------------------------------------------------------------------
@@ -32,10 +33,13 @@ namespace ScallopTK
 
 void createOrientedsummaryImages( IplImage *base, CandidatePtrVector& cds );
 
-void createColorQuadrants( IplImage *base, CandidatePtrVector& cds );
+void createColorQuadrants( IplImage *base, CandidatePtrVector& cds, int threads = 1 );
 
 void calculateColorFeatures( IplImage* color_img, hfResults *color_class, Candidate *cd );
 
+void calculateColorFeatures( IplImage* color_img, hfResults *color_class,
+  CandidatePtrVector& cds, int threads = 1 );
+
 }
 
 #endif
@@ -44,7 +44,7 @@ CvMat *createGaborFilter( float sigma, float theta, float lambda, float psi, flo
 
   // Filter 64x64 images
   for( int i=0; i<NUM_FILTERS; i++ )
-    cvFilter2D( cd->summaryImage, results[i], filterBank[i] );
+    cvFilter2D( cd->features->summaryImage, results[i], filterBank[i] );
 
   // Collect results at designated points 
   int index = 0;
@@ -52,11 +52,11 @@ CvMat *createGaborFilter( float sigma, float theta, float lambda, float psi, flo
   float features[entries];
   for( int i=0; i<NUM_FILTERS; i++ ) {
     cvSmooth( results[i], results[i], CV_BLUR, 7, 7 );
-    cd->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[0][0]))[samppos[0][1]];
-    cd->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[1][0]))[samppos[1][1]];
-    cd->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[2][0]))[samppos[2][1]];
-    cd->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[3][0]))[samppos[3][1]];
-    cd->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[4][0]))[samppos[4][1]];
+    cd->features->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[0][0]))[samppos[0][1]];
+    cd->features->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[1][0]))[samppos[1][1]];
+    cd->features->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[2][0]))[samppos[2][1]];
+    cd->features->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[3][0]))[samppos[3][1]];
+    cd->features->gaborFeatures[index++] = ((float*)(results[i]->imageData+results[i]->widthStep*samppos[4][0]))[samppos[4][1]];
   }
 
   //showIP( unused, results[0], cd );
@@ -69,7 +69,27 @@ CvMat *createGaborFilter( float sigma, float theta, float lambda, float psi, flo
   }
 }*/
 
-void calculateGaborFeatures( IplImage *img_gs_32f, CandidatePtrVector& cds ) {
+// Loop body for filtering the input with each filter in a bank in parallel
+class GaborFilterBody : public ParallelLoopBody
+{
+public:
+  GaborFilterBody( IplImage *img, CvMat **bank, IplImage **res )
+   : input( img ), filterBank( bank ), results( res ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int i=begin; i<end; i++ ) {
+      cvFilter2D( input, results[i], filterBank[i] );
+      cvSmooth( results[i], results[i], CV_BLUR, 5 );
+    }
+  }
+
+private:
+  IplImage *input;
+  CvMat **filterBank;
+  IplImage **results;
+};
+
+void calculateGaborFeatures( IplImage *img_gs_32f, CandidatePtrVector& cds, int threads ) {
 
   // Create linear filters
   CvMat *filterBank[NUM_FILTERS];
@@ -86,10 +106,8 @@ void calculateGaborFeatures( IplImage *img_gs_32f, CandidatePtrVector& cds ) {
     results[i] = cvCreateImage( cvGetSize(img_gs_32f), IPL_DEPTH_32F, 1 );
 
   // Filter images
-  for( int i=0; i<NUM_FILTERS; i++ ) {
-    cvFilter2D( img_gs_32f, results[i], filterBank[i] );
-    cvSmooth( results[i], results[i], CV_BLUR, 5 );
-  }
+  GaborFilterBody filterBody( img_gs_32f, filterBank, results );
+  parallelFor( NUM_FILTERS, filterBody, threads );
 
   // Compile vars for scan
   float *img_ptr[NUM_FILTERS];
@@ -115,49 +133,49 @@ void calculateGaborFeatures( IplImage *img_gs_32f, CandidatePtrVector& cds ) {
       int r = cd->r;
       int c = cd->c;
       if( r > 0 && c > 0 && r < imheight && c < imwidth )
-        cd->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
+        cd->features->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
       else 
-        cd->gaborFeatures[index++] = 0.0f;
+        cd->features->gaborFeatures[index++] = 0.0f;
 
       // Samp pos 2
       r = cd->r + cd->major * 0.63;
       c = cd->c;
       if( r > 0 && c > 0 && r < imheight && c < imwidth )
-        cd->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
+        cd->features->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
       else 
-        cd->gaborFeatures[index++] = 0.0f;
+        cd->features->gaborFeatures[index++] = 0.0f;
 
       // Samp pos 3
       r = cd->r;
       c = cd->c + cd->major * 0.63;
       if( r > 0 && c > 0 && r < imheight && c < imwidth )
-        cd->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
+        cd->features->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
       else 
-        cd->gaborFeatures[index++] = 0.0f;
+        cd->features->gaborFeatures[index++] = 0.0f;
 
       // Samp pos 4
       r = cd->r;
       c = cd->c - cd->major * 0.63;
       if( r > 0 && c > 0 && r < imheight && c < imwidth )
-        cd->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
+        cd->features->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
       else 
-        cd->gaborFeatures[index++] = 0.0f;
+        cd->features->gaborFeatures[index++] = 0.0f;
 
       // Samp pos 5
       r = cd->r - cd->major * 0.63;
       c = cd->c;
       if( r > 0 && c > 0 && r < imheight && c < imwidth )
-        cd->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
+        cd->features->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
       else 
-        cd->gaborFeatures[index++] = 0.0f;
+        cd->features->gaborFeatures[index++] = 0.0f;
 
       // Samp pos 6
       r = cd->r + cd->major;
       c = cd->c;
       if( r > 0 && c > 0 && r < imheight && c < imwidth )
-        cd->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
+        cd->features->gaborFeatures[index++] = (img_ptr[j]+fl_step*r)[c];
       else 
-        cd->gaborFeatures[index++] = 0.0f;
+        cd->features->gaborFeatures[index++] = 0.0f;
 
     }
   }
@@ -21,6 +21,7 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/Threads.h"
 
 //------------------------------------------------------------------------------
 //                             Function Prototypes
@@ -30,7 +31,8 @@ namespace ScallopTK
 {
 
 //void performGaborFiltering( Candidate *cd );
-void calculateGaborFeatures( IplImage *img_gs_32f, CandidatePtrVector& cds );
+// The filter bank responses are computed in parallel across up to threads threads
+void calculateGaborFeatures( IplImage *img_gs_32f, CandidatePtrVector& cds, int threads = 1 );
 
 }
 
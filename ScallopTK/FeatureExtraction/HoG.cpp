@@ -10,6 +10,8 @@ namespace ScallopTK
 
 CvMat* calculateHOG_window( IplImage** integrals, CvRect window,
   int normalization, int bins );
+void calculateHOG_window( IplImage** integrals, CvRect window,
+  int normalization, int bins, CvMat* window_feature_vector );
 
 IplImage** calculateIntegralHOG( IplImage* in );
 
@@ -46,12 +48,29 @@ HoGFeatureGenerator::~HoGFeatureGenerator() {
   free(integrals);
 }
 
-void HoGFeatureGenerator::Generate( CandidatePtrVector& cds ) {
-  for( unsigned int i=0; i<cds.size(); i++ ) {
-    if( !GenerateSingle( cds[i] ) ) {
-      cds[i]->isActive = false;
+// Loop body for generating descriptors over chunks of candidates in parallel
+class HoGGenerateBody : public ParallelLoopBody
+{
+public:
+  HoGGenerateBody( HoGFeatureGenerator *gen, CandidatePtrVector& cds )
+   : generator( gen ), candidates( cds ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int i=begin; i<end; i++ ) {
+      if( !generator->GenerateSingle( candidates[i] ) ) {
+        candidates[i]->isActive = false;
+      }
     }
   }
+
+private:
+  HoGFeatureGenerator *generator;
+  CandidatePtrVector& candidates;
+};
+
+void HoGFeatureGenerator::Generate( CandidatePtrVector& cds, int threads ) {
+  HoGGenerateBody body( this, cds );
+  parallelFor( cds.size(), body, threads, CANDIDATE_CHUNK_SIZE );
 }
 
 // Generates a HoG feature vector for the Candidate point
@@ -78,10 +97,18 @@ bool HoGFeatureGenerator::GenerateSingle( Candidate* cd ) {
   //cout << lower_r << " " << upper_r << " " << integrals[0]->height << endl;
   //cout << lower_c << " " << upper_c << " " << integrals[0]->width << endl;
 
-  // Calculate HoG Windows
-  cd->hogResults[output_index] = calculateHOG_window(integrals,
+  // Descriptor must fit in the candidate's feature row
+  if( (bins-1)*(bins-1)*36 != HOG_FEATURES )
+    return false;
+
+  // Calculate HoG Windows directly into the feature row
+  CvMat output;
+  cvInitMatHeader( &output, 1, HOG_FEATURES, CV_32FC1,
+    cd->features->hogFeatures[output_index] );
+
+  calculateHOG_window(integrals,
     cvRect(lower_c, lower_r, window_width, window_height),
-    HOG_NORMALIZATION_METHOD, bins );
+    HOG_NORMALIZATION_METHOD, bins, &output );
 
   return true;
 }
@@ -376,12 +403,21 @@ hog feature vector for the window*/
 
 CvMat* calculateHOG_window(IplImage** integrals,
   CvRect window, int normalization, int bins)
+{
+  CvMat* window_feature_vector = cvCreateMat(1,(bins-1)*(bins-1)*36, CV_32FC1);
+  calculateHOG_window(integrals, window, normalization, bins,
+    window_feature_vector);
+  return (window_feature_vector);
+}
+
+// As above, but writes into an existing 1x((bins-1)^2*36) vector
+void calculateHOG_window(IplImage** integrals,
+  CvRect window, int normalization, int bins,
+  CvMat* window_feature_vector)
 {
   int imHeight = integrals[0]->height;
   int imWidth = integrals[0]->width;
 
-  CvMat* window_feature_vector = cvCreateMat(1,(bins-1)*(bins-1)*36, CV_32FC1);
-
   double cell_height = (double)window.height / bins;
   double cell_width = (double)window.width / bins;
 
@@ -421,7 +457,6 @@ CvMat* calculateHOG_window(IplImage** integrals,
     }
     block_start_y += cell_height;
   }
-  return (window_feature_vector);
 }
 
 #ifdef unused
@@ -21,6 +21,7 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/Threads.h"
 
 namespace ScallopTK
 {
@@ -49,8 +50,8 @@ public:
   // Sets any desired options
   void SetOptions( float add_ratio, float bins_per_dim );
 
-  // Generates descriptors for all Candidates
-  void Generate( CandidatePtrVector& cds );
+  // Generates descriptors for all Candidates, using up to threads threads
+  void Generate( CandidatePtrVector& cds, int threads = 1 );
 
   // Generates descriptors for a single Candidate
   bool GenerateSingle( Candidate *cd );
@@ -123,25 +123,31 @@ void calculateSizeFeatures( Candidate *cd, ImageProperties& ip, float initResize
   float aPS = sizeAdj * ip.getAvgPixelSizeMeters() / initResize;
   majorAxisMeters = cd->major * aPS;
   minor_meters = cd->minor * aPS;
-  cd->majorAxisMeters = majorAxisMeters;
+  cd->features->majorAxisMeters = majorAxisMeters;
   perimeter_m = 2*PI*sqrt( (majorAxisMeters*majorAxisMeters + minor_meters*minor_meters)/2 );
   area_msq = PI * majorAxisMeters * minor_meters;
-  cd->sizeFeatures[0] = area_msq;
-  cd->sizeFeatures[1] = perimeter_m;
-  cd->sizeFeatures[2] = majorAxisMeters;
-  cd->sizeFeatures[3] = minor_meters;
-  cd->sizeFeatures[4] = cd->major;
-  cd->sizeFeatures[5] = cd->minor;
-  cd->sizeFeatures[6] = cd->major / cd->minor;
+  cd->features->sizeFeatures[0] = area_msq;
+  cd->features->sizeFeatures[1] = perimeter_m;
+  cd->features->sizeFeatures[2] = majorAxisMeters;
+  cd->features->sizeFeatures[3] = minor_meters;
+  cd->features->sizeFeatures[4] = cd->major;
+  cd->features->sizeFeatures[5] = cd->minor;
+  cd->features->sizeFeatures[6] = cd->major / cd->minor;
   if( cd->hasEdgeFeatures && cd->nminor != 0 ) {
-    cd->sizeFeatures[7] = cd->nmajor / cd->nminor;
-    cd->sizeFeatures[8] = cd->nmajor / cd->major;
+    cd->features->sizeFeatures[7] = cd->nmajor / cd->nminor;
+    cd->features->sizeFeatures[8] = cd->nmajor / cd->major;
   } else {
-    cd->sizeFeatures[7] = 1;
-    cd->sizeFeatures[8] = 1;
+    cd->features->sizeFeatures[7] = 1;
+    cd->features->sizeFeatures[8] = 1;
   }
 
 }
+
+void calculateSizeFeatures( CandidatePtrVector& cds, ImageProperties& ip, float initResize, float sizeAdj ) {
+  for( unsigned int i=0; i<cds.size(); i++ ) {
+    calculateSizeFeatures( cds[i], ip, initResize, sizeAdj );
+  }
+}
 /*
 inline int determine8quad_sm( int& x, int&y ) {
   if( x <= 0 ) {
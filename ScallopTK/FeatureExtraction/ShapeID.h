@@ -34,6 +34,10 @@ void calculateShapeFeatures( Candidate *cd, IplImage *unused );
 void calculateSizeFeatures( Candidate *cd, ImageProperties& ip,
   float initResize, float sizeAdj = 1.0 );
 
+// Only a few operations per candidate, so this is not worth threading
+void calculateSizeFeatures( CandidatePtrVector& cds, ImageProperties& ip,
+  float initResize, float sizeAdj = 1.0 );
+
 }
 
 #endif
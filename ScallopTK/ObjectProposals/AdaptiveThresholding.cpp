@@ -78,44 +78,18 @@ namespace ScallopTK
 
 void calcFilterStats( IplImage *img, atStats& stats ) {
 
-  // Calculate percentiles
-  float *ptr = (float*) img->imageData;
-  int sze = img->width * img->height;
-  float *endptr = ptr + sze;
-  int skippage = sze / AT_SAMPLES;
-  if( skippage < 1 )
-    skippage = 1;
-  int entries = sze / skippage;
-  vector<float> val_list(entries,0.0f);
-  int counter = 0;
-  while( counter < entries ) {
-    val_list[counter] = *ptr;
-    counter++;
-    ptr = ptr + skippage;
-  }
-  sort( val_list.begin(), val_list.end() );
-  
-  // Determine where 0.0 (start threshold) lies
-  // Binary search would have been more efficient, but irrelevant 
-  // because this takes so short a time...
-  int pivot = val_list.size();
-  for( int i=0; i<val_list.size(); i++ ) {
-    if( val_list[i] > 0.0 ) {
-      pivot = i;
-      break;
-    }
-  }
+  // Histogram all values, with 0.0 (start threshold) as the pivot
+  // between the lower and higher percentiles
+  QuantileHistogram hist( img, 0.0f );
+  int pivot = hist.pivotRank();
+  int total = hist.size();
 
   // Calculate lower %tiles
   if( pivot > 0 ) {
     
-    int ind_list[AT_LOWER_SIZE];
     int range = pivot;
     for( int i=0; i<AT_LOWER_SIZE; i++ ) {
-      ind_list[i] = (int)(AT_LOWER_PER[i]*(float)range);
-      if( ind_list[i] < 0 )
-        ind_list[i] = 0;
-      stats.lower_intvls[i] = val_list[ ind_list[i] ];
+      stats.lower_intvls[i] = hist.valueAtRank( (int)(AT_LOWER_PER[i]*(float)range) );
     }
 
   } else {
@@ -128,15 +102,11 @@ void calcFilterStats( IplImage *img, atStats& stats ) {
   }
 
   // Calculate higher %tiles
-  if( pivot < val_list.size() ) {
+  if( pivot < total ) {
 
-    int ind_list[AT_UPPER_SIZE];
-    int range = val_list.size() - pivot;
+    int range = total - pivot;
     for( int i=0; i<AT_UPPER_SIZE; i++ ) {
-      ind_list[i] = (int)(AT_UPPER_PER[i]*(float)range) + pivot;
-      if( ind_list[i] >= val_list.size() )
-        ind_list[i] = val_list.size() - 1;
-      stats.upper_intvls[i] = val_list[ ind_list[i] ];
+      stats.upper_intvls[i] = hist.valueAtRank( (int)(AT_UPPER_PER[i]*(float)range) + pivot );
     }
 
   } else {
@@ -150,7 +120,7 @@ void calcFilterStats( IplImage *img, atStats& stats ) {
 
 }
 
-int hfBinaryClassify(IplImage *bin, float minRad, float maxRad, CandidatePtrVector& kps ) {
+void hfBinaryClassify(IplImage *bin, float minRad, float maxRad, CandidatePtrVector& kps ) {
 
   // Create OpenCV storage block
   CvMemStorage *mem = cvCreateMemStorage(0);
@@ -161,106 +131,43 @@ int hfBinaryClassify(IplImage *bin, float minRad, float maxRad, CandidatePtrVect
     CV_RETR_CCOMP, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0) );
 
   //Process
-  int highcount = 0;
-  int lowcount = 0;
   for( ptr = Contours; ptr != NULL; ptr = ptr->h_next ) {
-    int ret = findStableMatches( ptr, minRad, maxRad, kps, bin );
-    if( ret == -1 )
-      lowcount++;
-    if( ret == 1 )
-      highcount++;
+    findStableMatches( ptr, minRad, maxRad, kps, bin );
   }
 
-  //Create return
-  int retval = 0x0;
-  if( lowcount > 100000 )
-    retval = retval | AT_LOWER;
-  if( highcount > 0 )
-    retval = retval | AT_RAISE;
-
   //Deallocate
-  if(Contours)
-  {
-    cvReleaseMemStorage( &Contours->storage );
-  }
-  return 0;
-}
-
-int hfLowBinarySearch(hfResults* imgs, atStats* stats, CandidatePtrVector& kps, float minRad, float maxRad, int position ) {
-
-  // Recursive end condition
-  if( position >= AT_LOWER_SIZE )
-    return position;
-
-  // Threshold image
-  IplImage *threshed = cvCreateImage( cvGetSize(imgs->NetScallops), IPL_DEPTH_8U, 1 );
-  cvThreshold(imgs->NetScallops,threshed, stats->lower_intvls[position],1.0f,CV_THRESH_BINARY);  
-
-  // Classify binary groups
-  int option = hfBinaryClassify(threshed, minRad, maxRad, kps );
-
-  // Call recursive search at a different threshold
-  if( option & AT_LOWER ) {
-    hfLowBinarySearch(imgs, stats, kps, minRad, maxRad, 2*position );
-  }
-  if( option & AT_RAISE ) {
-    hfLowBinarySearch(imgs, stats, kps, minRad, maxRad, 2*position+1 );
-  }
-
-  // Deallocate memory
-  cvReleaseImage(&threshed);
-  return position;
+  cvReleaseMemStorage( &mem );
 }
 
-int hfHighBinarySearch(hfResults* imgs, atStats* stats, CandidatePtrVector& kps, float minRad, float maxRad, int position ) {
-
-  // Recursive end condition
-  if( position >= AT_UPPER_SIZE )
-    return position;
+void hfSeedSearch(hfResults* imgs, CandidatePtrVector& kps, float minRad, float maxRad ) {
 
   // Threshold image
   IplImage *threshed = cvCreateImage( cvGetSize(imgs->NetScallops), IPL_DEPTH_8U, 1 );
-  cvThreshold(imgs->NetScallops,threshed,stats->upper_intvls[position],1.0f,CV_THRESH_BINARY);  
+  cvThreshold(imgs->NetScallops,threshed, 0.0f,1.0f,CV_THRESH_BINARY);  
 
   // Classify binary groups
-  int option = hfBinaryClassify(threshed, minRad, maxRad, kps );
-
-  // Call recursive search at a different threshold
-  if( option & AT_LOWER ) {
-    hfHighBinarySearch(imgs, stats, kps, minRad, maxRad, 2*position );
-  }
-  if( option & AT_RAISE ) {
-    hfHighBinarySearch(imgs, stats, kps, minRad, maxRad, 2*position+1 );
-  }
+  hfBinaryClassify(threshed, minRad, maxRad, kps );
 
   // Deallocate memory
   cvReleaseImage(&threshed);
-  return position;
 }
 
-int hfSeedSearch(hfResults* imgs, atStats* stats, CandidatePtrVector& kps, float minRad, float maxRad ) {
-
-  // Threshold image
-  IplImage *threshed = cvCreateImage( cvGetSize(imgs->NetScallops), IPL_DEPTH_8U, 1 );
-  cvThreshold(imgs->NetScallops,threshed, 0.0f,1.0f,CV_THRESH_BINARY);  
+// Candidates from components above the first levels lower and upper
+// percentiles (after the 0th), all found from a single component tree.
+// Components which also exist above 0.0 are left to the seed search.
+void atTreeSearch( IplImage* img, atStats* stats, int levels, CandidatePtrVector& kps, float minRad, float maxRad ) {
 
-  // Classify binary groups
-  int option = hfBinaryClassify(threshed, minRad, maxRad, kps );
+  levels = std::min( levels, std::min( AT_LOWER_SIZE, AT_UPPER_SIZE ) - 1 );
 
-  // Call recursive search at a different threshold
-  if( option & AT_LOWER ) {
-    hfLowBinarySearch(imgs, stats, kps, minRad, maxRad, 1 );
-  }
-  if( option & AT_RAISE ) {
-    hfHighBinarySearch(imgs, stats, kps, minRad, maxRad, 1 );
-  }
+  vector< float > thresholds;
+  thresholds.insert( thresholds.end(), stats->lower_intvls + 1, stats->lower_intvls + 1 + levels );
+  thresholds.insert( thresholds.end(), stats->upper_intvls + 1, stats->upper_intvls + 1 + levels );
 
-  // Deallocate memory
-  cvReleaseImage(&threshed);
-  return option;
+  ComponentTree tree( img );
+  tree.findCandidates( thresholds, minRad, maxRad, kps, vector< float >( 1, 0.0f ) );
 }
 
-void performAdaptiveFiltering( hfResults* color, CandidatePtrVector& cds, float minRad, bool doubleIntrp ) {
+void performAdaptiveFiltering( hfResults* color, CandidatePtrVector& cds, float minRad, bool doubleIntrp, int extraLevels ) {
 
   // Resize and smooth image as desired
   IplImage *img = color->NetScallops;
@@ -274,10 +181,14 @@ void performAdaptiveFiltering( hfResults* color, CandidatePtrVector& cds, float
     resize_factor = 1.0f;
   }
     
-  // Calculate filter stats (percentiles)
-  atStats netStats;
-  calcFilterStats( img, netStats );
-  hfSeedSearch(color,&netStats,cds,color->minRad*resize_factor,color->maxRad*resize_factor);
+  // Threshold at 0.0, and at percentile levels if requested
+  hfSeedSearch(color,cds,color->minRad*resize_factor,color->maxRad*resize_factor);
+
+  if( extraLevels > 0 ) {
+    atStats netStats;
+    calcFilterStats( img, netStats );
+    atTreeSearch(img,&netStats,extraLevels,cds,color->minRad*resize_factor,color->maxRad*resize_factor);
+  }
 
   // Adjust kps for scale  
   float scale = 1 / (resize_factor * color->scale );
@@ -20,6 +20,7 @@
 
 //Scallop Includes
 #include "ScallopTK/ObjectProposals/HistogramFiltering.h"
+#include "ScallopTK/ObjectProposals/ComponentTree.h"
 #include "ScallopTK/EdgeDetection/EdgeLinking.h"
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
@@ -56,19 +57,17 @@ struct atStats {
   float upper_intvls[AT_UPPER_SIZE];
 };
 
-// Return variables for bin search
-const int AT_LOWER = 0x01;
-const int AT_RAISE = 0x02;
-
-// Sampling points for approximating percentiles
-const int AT_SAMPLES = 1200;
-
 //------------------------------------------------------------------------------
 //                                Prototypes
 //------------------------------------------------------------------------------
 
+// Candidates from the environment-corrected classification map thresholded
+// at 0.0. If extraLevels > 0, candidates are added from thresholding the
+// resized map at that many lower and upper percentile levels (in the order
+// listed above, after the 0th) using a component tree, with ellipses fit
+// from component moments. The 0.0 candidates are the same either way.
 void performAdaptiveFiltering( hfResults* color, CandidatePtrVector& cds,
-  float minRad, bool doubleIntrp = false );
+  float minRad, bool doubleIntrp = false, int extraLevels = 0 );
 
 }
 
@@ -0,0 +1,244 @@
+//------------------------------------------------------------------------------
+// Title: ComponentTree.cpp
+//------------------------------------------------------------------------------
+
+#include "ComponentTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                            Helper Definitions
+//------------------------------------------------------------------------------
+
+// Orders pixel indices by decreasing value, then increasing index
+struct DecreasingValue
+{
+  DecreasingValue( const vector< float >& _values ) : values( _values ) {}
+
+  bool operator()( int a, int b ) const {
+    return values[a] > values[b] || ( values[a] == values[b] && a < b );
+  }
+
+  const vector< float >& values;
+};
+
+// Root of a union-find set, halving the path to it
+static int findRoot( vector< int >& zpar, int p )
+{
+  while( zpar[p] != p ) {
+    zpar[p] = zpar[ zpar[p] ];
+    p = zpar[p];
+  }
+  return p;
+}
+
+//------------------------------------------------------------------------------
+//                           ComponentTree Definitions
+//------------------------------------------------------------------------------
+
+ComponentTree::ComponentTree( IplImage *img )
+{
+  assert( img->nChannels == 1 );
+  assert( img->depth == IPL_DEPTH_32F );
+
+  int width = img->width;
+  int height = img->height;
+  int total = width * height;
+
+  if( total == 0 ) {
+    return;
+  }
+
+  vector< float > values( total );
+  for( int r = 0; r < height; r++ ) {
+    const float *row = (const float*)( img->imageData + r * img->widthStep );
+    copy( row, row + width, values.begin() + r * width );
+  }
+
+  vector< int > order( total );
+  for( int i = 0; i < total; i++ ) {
+    order[i] = i;
+  }
+  sort( order.begin(), order.end(), DecreasingValue( values ) );
+
+  // Add pixels from the highest value down, attaching the roots of any
+  // neighbouring components already added beneath the new pixel
+  vector< int > parent( total, -1 );
+  vector< int > zpar( total );
+
+  for( int i = 0; i < total; i++ ) {
+    int p = order[i];
+    int pr = p / width, pc = p % width;
+    parent[p] = p;
+    zpar[p] = p;
+
+    for( int dr = -1; dr <= 1; dr++ ) {
+      for( int dc = -1; dc <= 1; dc++ ) {
+        int nr = pr + dr, nc = pc + dc;
+        if( nr < 0 || nc < 0 || nr >= height || nc >= width ) {
+          continue;
+        }
+        int n = nr * width + nc;
+        if( parent[n] < 0 ) {
+          continue;
+        }
+        int root = findRoot( zpar, n );
+        if( root != p ) {
+          parent[root] = p;
+          zpar[root] = p;
+        }
+      }
+    }
+  }
+
+  // Point every pixel at the first pixel of its component (the canonical
+  // pixel), parents being added after their children
+  int treeRoot = order[ total - 1 ];
+
+  for( int i = total - 1; i >= 0; i-- ) {
+    int p = order[i];
+    int q = parent[p];
+    if( values[ parent[q] ] == values[q] ) {
+      parent[p] = parent[q];
+    }
+  }
+
+  // Number the components, parents first
+  vector< int > nodeIndex( total, -1 );
+
+  for( int i = total - 1; i >= 0; i-- ) {
+    int p = order[i];
+    if( p != treeRoot && values[ parent[p] ] == values[p] ) {
+      continue;
+    }
+
+    Node node;
+    node.level = values[p];
+    node.parent = ( p == treeRoot ? -1 : nodeIndex[ parent[p] ] );
+    node.area = 0;
+    node.minR = height;
+    node.maxR = -1;
+    node.minC = width;
+    node.maxC = -1;
+    node.sumR = node.sumC = node.sumRR = node.sumRC = node.sumCC = 0.0;
+
+    nodeIndex[p] = nodes.size();
+    nodes.push_back( node );
+  }
+
+  // Add each pixel to its own component, then each component to its parent
+  for( int p = 0; p < total; p++ ) {
+    Node& node = nodes[ nodeIndex[p] >= 0 ? nodeIndex[p] : nodeIndex[ parent[p] ] ];
+    int r = p / width, c = p % width;
+    node.area++;
+    node.minR = min( node.minR, r );
+    node.maxR = max( node.maxR, r );
+    node.minC = min( node.minC, c );
+    node.maxC = max( node.maxC, c );
+    node.sumR += r;
+    node.sumC += c;
+    node.sumRR += (double)r * r;
+    node.sumRC += (double)r * c;
+    node.sumCC += (double)c * c;
+  }
+
+  for( int i = nodes.size() - 1; i > 0; i-- ) {
+    const Node& child = nodes[i];
+    Node& node = nodes[ child.parent ];
+    node.area += child.area;
+    node.minR = min( node.minR, child.minR );
+    node.maxR = max( node.maxR, child.maxR );
+    node.minC = min( node.minC, child.minC );
+    node.maxC = max( node.maxC, child.maxC );
+    node.sumR += child.sumR;
+    node.sumC += child.sumC;
+    node.sumRR += child.sumRR;
+    node.sumRC += child.sumRC;
+    node.sumCC += child.sumCC;
+  }
+}
+
+// True if a component with the given level and parent level exists at any
+// of the given sorted levels, parentLevel being NULL for the root
+static bool existsAtAny( const vector< float >& levels, float level,
+  const float *parentLevel ) {
+
+  vector< float >::const_iterator lowest = ( !parentLevel ? levels.begin() :
+    lower_bound( levels.begin(), levels.end(), *parentLevel ) );
+
+  return lowest != levels.end() && *lowest < level;
+}
+
+void ComponentTree::findCandidates( const vector< float >& thresholds,
+  float minRad, float maxRad, CandidatePtrVector& kps,
+  const vector< float >& excluded ) const {
+
+  vector< float > levels( thresholds );
+  sort( levels.begin(), levels.end() );
+
+  vector< float > skipped( excluded );
+  sort( skipped.begin(), skipped.end() );
+
+  if( levels.empty() ) {
+    return;
+  }
+
+  for( unsigned i = 0; i < nodes.size(); i++ ) {
+
+    const Node& node = nodes[i];
+
+    // Skip components not present at any requested level, or present at
+    // an excluded one
+    const float *parentLevel = ( node.parent < 0 ? NULL : &nodes[ node.parent ].level );
+
+    if( !existsAtAny( levels, node.level, parentLevel ) ||
+        existsAtAny( skipped, node.level, parentLevel ) ) {
+      continue;
+    }
+
+    // If bounding box is very small skip
+    int low = min( node.maxR - node.minR, node.maxC - node.minC ) + 1;
+
+    if( low < minRad*2 ) {
+      continue;
+    }
+
+    // Ellipse with the same second order moments
+    double meanR = node.sumR / node.area;
+    double meanC = node.sumC / node.area;
+    double varR = node.sumRR / node.area - meanR * meanR;
+    double varC = node.sumCC / node.area - meanC * meanC;
+    double covRC = node.sumRC / node.area - meanR * meanC;
+
+    double mid = ( varR + varC ) / 2;
+    double diff = sqrt( ( varC - varR ) * ( varC - varR ) / 4 + covRC * covRC );
+    double major = 2 * sqrt( mid + diff );
+    double minor = 2 * sqrt( max( mid - diff, 0.0 ) );
+
+    // Threshold size
+    if( major * minor >= maxRad * maxRad ) {
+      continue;
+    }
+
+    // Angle of the minor axis, the major axis being 90 degrees from it
+    double majorAngle = 0.5 * atan2( 2 * covRC, varC - varR ) * 180 / PI;
+
+    Candidate *kp = new Candidate;
+    kp->angle = majorAngle - 90;
+    kp->r = meanR;
+    kp->c = meanC;
+    kp->minor = minor;
+    kp->major = major;
+    kp->magnitude = 0;
+    kp->method = ADAPTIVE;
+    kps.push_back( kp );
+  }
+}
+
+}
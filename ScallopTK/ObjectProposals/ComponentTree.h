@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+// Title: ComponentTree.h
+// Description: Max-tree of the connected components above every threshold of
+//  a single channel image, built once and then queried for ellipse candidates
+//  at any number of threshold levels
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_COMPONENT_TREE_H_
+#define SCALLOP_TK_COMPONENT_TREE_H_
+
+//------------------------------------------------------------------------------
+//                               Include Files
+//------------------------------------------------------------------------------
+
+//Standard C/C++
+#include <vector>
+
+//Opencv
+#include <cv.h>
+#include <cxcore.h>
+
+//Scallop Includes
+#include "ScallopTK/Utilities/Definitions.h"
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                              Class Definitions
+//------------------------------------------------------------------------------
+
+// Components of pixels with values above a threshold (8-connected) are nested,
+// each component at some threshold being contained in one at any lower
+// threshold. The tree holds each distinct component once, along with the
+// range of thresholds it exists for and its area, bounding box and second
+// order moments, so thresholding the image at many levels costs a single sort
+// and union-find pass over the image.
+class ComponentTree
+{
+public:
+
+  // Build the tree for a single channel 32f image
+  explicit ComponentTree( IplImage *img );
+
+  // Number of distinct components
+  int size() const { return nodes.size(); }
+
+  // Add a candidate for each component found by thresholding the image at
+  // any of the given levels (pixels > level), with bounding box sides of at
+  // least 2*minRad and an ellipse fit with area less than that of a circle
+  // of radius maxRad. Components existing at several of the levels are
+  // only added once, and those also existing at any of the excluded levels
+  // are skipped.
+  void findCandidates( const std::vector< float >& thresholds,
+    float minRad, float maxRad, CandidatePtrVector& kps,
+    const std::vector< float >& excluded = std::vector< float >() ) const;
+
+private:
+
+  struct Node
+  {
+    // Lowest value in the component, it exists for thresholds in
+    // [level of parent, level)
+    float level;
+    int parent;
+
+    // Area, bounding box and moments about the origin
+    int area;
+    int minR, maxR, minC, maxC;
+    double sumR, sumC, sumRR, sumRC, sumCC;
+  };
+
+  // Components, each parent before its children, the first being the
+  // whole image
+  std::vector< Node > nodes;
+};
+
+}
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "DoG.h"
 
+#include "ScallopTK/Utilities/SIMD.h"
+
 namespace ScallopTK
 {
 
@@ -13,22 +15,23 @@ namespace ScallopTK
 //                         Internal Function Prototypes
 //------------------------------------------------------------------------------
 
-//Functions for creating cross-channel trapezoidal DoG structure
-IplImage* formatBase( IplImage* img, float sigma, bool upscale, float maxRad );
-IplImage* downsample( IplImage* img );
-IplImage*** buildGaussTrap( IplImage* base, int octvs, int intvls, double sigma );
-IplImage*** buildDoGTrap( IplImage*** gaussTrap, int octvs, int intvls );
+//Functions for creating cross-channel trapezoidal DoG structure without
+//reusing buffers, superseded by DoGPyramid and kept as its reference
+IplImage* formatBase( IplImage* img, float sigma, bool upscale, float maxRad, ImageArena *arena );
+IplImage* downsample( IplImage* img, ImageArena *arena );
+IplImage*** buildGaussTrap( IplImage* base, int octvs, int intvls, double sigma, ImageArena *arena );
+IplImage*** buildDoGTrap( IplImage*** gaussTrap, int octvs, int intvls, ImageArena *arena );
 IplImage*** mergeDoGChannels( IplImage*** DoGTrap, int octvs, int intvls );
 IplImage*** absDoGChannels( IplImage*** DoGTrap, int octvs, int intvls );
 
 //Candidate selection and filtering
-void detectExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, CandidatePtrVector& kps, float minRad, float maxRad  );
-void detectMinExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, CandidatePtrVector& kps, float minRad, float maxRad  );
-void detectMaxExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, CandidatePtrVector& kps, float minRad, float maxRad  );
+void detectExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, int mode, CandidatePtrVector& kps, float minRad, float maxRad, int threads );
+void detectLevelExtremum( IplImage*** DoGTrap, int octv, int intvl, int intvls, double contr_thr, int mode, CandidatePtrVector& kps );
+void flagRowExtremum( const float* rows[9], int begin, int end, int mode, uchar* flags );
 bool interpExtremum( IplImage*** DoGTrap, int octv, int intvl, int r, int c, int intvls, double contr_thr, DoG_Candidate& point );
 void interpStep( IplImage*** DoGTrap, int octv, int intvl, int r, int c, double* xi, double* xr, double* xc );
-CvMat* deriv3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c );
-CvMat* hessian3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c );
+void deriv3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c, double dI[3] );
+void hessian3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c, double H[3][3] );
 double interpContr( IplImage*** DoGTrap, int octv, int intvl, int r, int c, double xi, double xr, double xc );
 int isTooEdgeLike( IplImage* DoG, int r, int c, int curv_thr );
 void calcFeatureScales( CandidatePtrVector& kps, double sigma, int intvls );
@@ -43,13 +46,21 @@ void addOriToFeature( double* hist, int n, double mag_thr, Candidate* point, Can
 
 //Helper functions
 void adjustForScale( CandidatePtrVector& kps, bool upscale, float maxRad );
-void releaseTrap( IplImage**** pyr, int octvs, int n );
+void releaseTrap( IplImage**** pyr, int octvs, int n, ImageArena *arena = NULL );
 
 //------------------------------------------------------------------------------
 //                       Main DoG Function Definition
 //------------------------------------------------------------------------------
 
-bool findDoGCandidates( IplImage* input, CandidatePtrVector& kps, float minRad, float maxRad, int mode ) {
+#ifdef DOG_BENCHMARKING
+  const string dog_bm_fn = "DoGBMResults.dat";
+
+  void benchmarkPyramid( IplImage* input, float sigma, bool upscale, float maxRad,
+    int octaves, int intervals, ImageArena *arena, DoGPyramid& pyramid, int threads );
+#endif
+
+bool findDoGCandidates( IplImage* input, CandidatePtrVector& kps, float minRad, float maxRad, int mode,
+  ImageArena *arena, DoGPyramid *pyramid, int threads ) {
 
   //Calculate gaussian trapezoid characteristics
   bool upscale = (minRad < DOG_UPSCALE_THRESHOLD ? 1 : 0);
@@ -57,32 +68,26 @@ bool findDoGCandidates( IplImage* input, CandidatePtrVector& kps, float minRad,
   int octaves = (int)(log(maxRad/sigma)/log(2.0f)) + 1;
   int intervals = DOG_INTERVALS_PER_OCT;
 
-  //Format the base of each gaussian trapezoid (1 for each channel)
-  IplImage* init = formatBase( input, sigma, upscale, maxRad );
+  //Build gaussian and DoG trapezoids, in a temporary pyramid if none given
+  DoGPyramid temporary( arena );
+  if( pyramid == NULL )
+    pyramid = &temporary;
+
+#ifdef DOG_BENCHMARKING
+  benchmarkPyramid( input, sigma, upscale, maxRad, octaves, intervals, arena, *pyramid, threads );
+#else
+  pyramid->build( input, sigma, upscale, maxRad, octaves, intervals, threads );
+#endif
 
   //Compensate scanning radii
   minRad = minRad / DOG_COMPENSATION;
 
-  //Build gaussian trapezoid
-  IplImage*** gaussTrap = buildGaussTrap( init, octaves, intervals, sigma );  
-  IplImage*** DoGTrap = buildDoGTrap( gaussTrap, octaves, intervals );
-
   //Find Candidates
-  if( mode == DOG_MIN ) {
-    detectMinExtremum( DoGTrap, octaves, intervals, 0.04f, 10, kps, minRad, maxRad );  
-  } else if( mode == DOG_MAX ) {
-    detectMaxExtremum( DoGTrap, octaves, intervals, 0.04f, 10, kps, minRad, maxRad );  
-  } else {
-    detectExtremum( DoGTrap, octaves, intervals, 0.04f, 10, kps, minRad, maxRad );
-  }
+  detectExtremum( pyramid->dogLevels(), octaves, intervals, 0.04f, 10, mode, kps,
+    minRad, maxRad, threads );
   
   //Adjust Candidates for scale & border
   adjustForScale( kps, upscale, maxRad );
-
-  //Deallocate variables used
-  releaseTrap( &gaussTrap, octaves, intervals + 3 );
-  releaseTrap( &DoGTrap, octaves, intervals + 2 );
-  cvReleaseImage(&init);  
   return true;
 }
 
@@ -91,30 +96,30 @@ bool findDoGCandidates( IplImage* input, CandidatePtrVector& kps, float minRad,
 //------------------------------------------------------------------------------
 
 //Double if necessary and smooth to base of first octave
-IplImage* formatBase( IplImage* img, float sigma, bool upscale, float maxRad )
+IplImage* formatBase( IplImage* img, float sigma, bool upscale, float maxRad, ImageArena *arena )
 {
   // Add border of maxRad size around the image 
   // (to simply extrema searching near image edges)
   CvSize newSize;
   newSize.height = img->height + maxRad;
   newSize.width = img->width + maxRad;
-  IplImage* base = cvCreateImage( newSize, img->depth, img->nChannels );
+  IplImage* base = arenaCreateImage( arena, newSize, img->depth, img->nChannels );
   float sig_diff;
   CvPoint offset;
   offset.x = maxRad / 2;
   offset.y = maxRad / 2;
   CvScalar median;
-  median.val[0] = quickMedian( img, 1000 );
+  median.val[0] = QuantileHistogram( img ).quantile( 0.5f );
   cvCopyMakeBorder( img, base, offset, IPL_BORDER_CONSTANT, median );
 
   // If we need to upscale the image do so
   if( upscale ) {
     sig_diff = (float)sqrt( sigma * sigma - DOG_INIT_SIGMA * DOG_INIT_SIGMA * 4 );
-    IplImage *upped = cvCreateImage( cvSize( img->width*2, img->height*2 ),
+    IplImage *upped = arenaCreateImage( arena, cvSize( img->width*2, img->height*2 ),
       IPL_DEPTH_32F, img->nChannels );
     cvResize( base, upped, CV_INTER_CUBIC );
     cvSmooth( upped, upped, CV_GAUSSIAN, 0, 0, sig_diff, sig_diff );
-    cvReleaseImage( &base );
+    arenaReleaseImage( arena, &base );
     base = upped;
   } else {
     sig_diff = (float)sqrt( sigma * sigma - DOG_INIT_SIGMA * DOG_INIT_SIGMA );
@@ -124,7 +129,7 @@ IplImage* formatBase( IplImage* img, float sigma, bool upscale, float maxRad )
 }
 
 //Builds a gaussian trapezoid so that we can take DoGs
-IplImage*** buildGaussTrap( IplImage* base, int octvs, int intvls, double sigma )
+IplImage*** buildGaussTrap( IplImage* base, int octvs, int intvls, double sigma, ImageArena *arena )
 {
   // Declare required variables
   IplImage*** gaussTrap;
@@ -151,15 +156,15 @@ IplImage*** buildGaussTrap( IplImage* base, int octvs, int intvls, double sigma
     for( i = 0; i < intvls + 3; i++ )
     {
       if( o == 0  &&  i == 0 )
-        gaussTrap[o][i] = cvCloneImage(base);
+        gaussTrap[o][i] = arenaCloneImage( arena, base );
 
       /* base of new octvave is halved image from end of previous octave */
       else if( i == 0 )
-        gaussTrap[o][i] = downsample( gaussTrap[o-1][intvls] );
+        gaussTrap[o][i] = downsample( gaussTrap[o-1][intvls], arena );
 
       /* blur the current octave's last image to create the next one */
       else {
-        gaussTrap[o][i] = cvCreateImage( cvGetSize(gaussTrap[o][i-1]),
+        gaussTrap[o][i] = arenaCreateImage( arena, cvGetSize(gaussTrap[o][i-1]),
           IPL_DEPTH_32F, gaussTrap[o][i-1]->nChannels );
         cvSmooth( gaussTrap[o][i-1], gaussTrap[o][i],
           CV_GAUSSIAN, 0, 0, sig[i], sig[i] );
@@ -170,9 +175,9 @@ IplImage*** buildGaussTrap( IplImage* base, int octvs, int intvls, double sigma
 }
 
 //Downsample an image by half
-IplImage* downsample( IplImage* img )
+IplImage* downsample( IplImage* img, ImageArena *arena )
 {
-  IplImage* smaller = cvCreateImage( cvSize(img->width / 2, img->height / 2),
+  IplImage* smaller = arenaCreateImage( arena, cvSize(img->width / 2, img->height / 2),
     img->depth, img->nChannels );
   cvResize( img, smaller, CV_INTER_NN );
   return smaller;
@@ -180,7 +185,7 @@ IplImage* downsample( IplImage* img )
 
 
 //Takes the DoG from our pre-built gaussian trap
-IplImage*** buildDoGTrap( IplImage*** GaussTrap, int octvs, int intvls )
+IplImage*** buildDoGTrap( IplImage*** GaussTrap, int octvs, int intvls, ImageArena *arena )
 {
   IplImage*** DoGTrap;
 
@@ -190,7 +195,7 @@ IplImage*** buildDoGTrap( IplImage*** GaussTrap, int octvs, int intvls )
 
   for( int o = 0; o < octvs; o++ ) {
     for( int i = 0; i < intvls + 2; i++ ) {
-      DoGTrap[o][i] = cvCreateImage( cvGetSize(GaussTrap[o][i]), IPL_DEPTH_32F, GaussTrap[o][i]->nChannels );
+      DoGTrap[o][i] = arenaCreateImage( arena, cvGetSize(GaussTrap[o][i]), IPL_DEPTH_32F, GaussTrap[o][i]->nChannels );
       cvSub( GaussTrap[o][i+1], GaussTrap[o][i], DoGTrap[o][i], NULL );
       //showImageRange( DoGTrap[o][i] );
     }
@@ -257,118 +262,346 @@ IplImage*** absDoGChannels( IplImage*** DoGTrap, int octvs, int intvls )
 }
 
 //------------------------------------------------------------------------------
-//                    Extrema Localization and Filtering
+//                          DoG Pyramid Definition
 //------------------------------------------------------------------------------
 
-int isMax( IplImage*** DoGTrap, int octv, int intvl, int r, int c )
+//Sets the area of an image outside of the inner rectangle to a value
+static void setBorder( IplImage* img, CvRect inner, float value )
 {
-  float val = getPixel32f( DoGTrap[octv][intvl], r, c );
-  int i, j, k;
+  CvRect strips[4] = {
+    cvRect( 0, 0, img->width, inner.y ),
+    cvRect( 0, inner.y + inner.height, img->width, img->height - inner.y - inner.height ),
+    cvRect( 0, inner.y, inner.x, inner.height ),
+    cvRect( inner.x + inner.width, inner.y, img->width - inner.x - inner.width, inner.height ) };
+
+  for( int i = 0; i < 4; i++ ) {
+    if( strips[i].width > 0 && strips[i].height > 0 ) {
+      cvSetImageROI( img, strips[i] );
+      cvSet( img, cvScalarAll( value ) );
+    }
+  }
+  cvResetImageROI( img );
+}
 
-  /* check for maximum */
-  for( i = -1; i <= 1; i++ )
-    for( j = -1; j <= 1; j++ )
-      for( k = -1; k <= 1; k++ )
-        if( val > getPixel32f( DoGTrap[octv][intvl + i], r + j, c + k ) )
-          return false;
+//Separable gaussian blur, identical to cvSmooth with the same sigma
+static void blurLevel( IplImage* src, IplImage* dst, const cv::Mat& kernel )
+{
+  cv::Mat srcMat = cv::cvarrToMat( src );
+  cv::Mat dstMat = cv::cvarrToMat( dst );
+  cv::sepFilter2D( srcMat, dstMat, CV_32F, kernel, kernel, cv::Point( -1, -1 ), 0,
+    cv::BORDER_REPLICATE );
+}
 
+//Subtracts adjacent gaussian levels of each octave in a range
+class SubtractOctavesBody : public ParallelLoopBody
+{
+public:
 
-  return true;
+  SubtractOctavesBody( IplImage*** _gaussTrap, IplImage*** _dogTrap, int _intvls )
+  : gaussTrap( _gaussTrap ), dogTrap( _dogTrap ), intvls( _intvls ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int o = begin; o < end; o++ )
+      for( int i = 0; i < intvls + 2; i++ )
+        cvSub( gaussTrap[o][i+1], gaussTrap[o][i], dogTrap[o][i], NULL );
+  }
+
+  IplImage*** gaussTrap;
+  IplImage*** dogTrap;
+  int intvls;
+};
+
+DoGPyramid::DoGPyramid( ImageArena *_arena )
+ : arena( _arena ), bordered( NULL ), gaussTrap( NULL ), dogTrap( NULL ),
+   octvs( 0 ), intvls( 0 )
+{
 }
 
-int isMin( IplImage*** DoGTrap, int octv, int intvl, int r, int c )
+DoGPyramid::~DoGPyramid()
 {
-  float val = getPixel32f( DoGTrap[octv][intvl], r, c );
-  int i, j, k;
+  release();
+}
 
-  /* check for maximum */
-  for( i = -1; i <= 1; i++ )
-    for( j = -1; j <= 1; j++ )
-      for( k = -1; k <= 1; k++ )
-        if( val < getPixel32f( DoGTrap[octv][intvl + i], r + j, c + k ) )
-          return false;
+void DoGPyramid::release()
+{
+  releaseTrap( &gaussTrap, octvs, intvls + 3, arena );
+  releaseTrap( &dogTrap, octvs, intvls + 2, arena );
+  arenaReleaseImage( arena, &bordered );
+  octvs = 0;
+  intvls = 0;
+}
 
+void DoGPyramid::allocate( CvSize borderedSize, CvSize baseSize, int octaves, int intervals )
+{
+  bool upscale = ( borderedSize.width != baseSize.width || borderedSize.height != baseSize.height );
+
+  // Keep the current levels if they have the same layout
+  if( gaussTrap && octaves == octvs && intervals == intvls &&
+      gaussTrap[0][0]->width == baseSize.width &&
+      gaussTrap[0][0]->height == baseSize.height &&
+      ( bordered != NULL ) == upscale &&
+      ( !bordered || ( bordered->width == borderedSize.width &&
+                       bordered->height == borderedSize.height ) ) )
+    return;
 
-  return true;
+  release();
+  octvs = octaves;
+  intvls = intervals;
+
+  if( upscale )
+    bordered = arenaCreateImage( arena, borderedSize, IPL_DEPTH_32F, 1 );
+
+  gaussTrap = (IplImage ***) calloc( octvs, sizeof( IplImage** ) );
+  dogTrap = (IplImage ***) calloc( octvs, sizeof( IplImage** ) );
+
+  // Each octave is half the size of the last
+  CvSize size = baseSize;
+  for( int o = 0; o < octvs; o++ ) {
+    if( o > 0 )
+      size = cvSize( size.width / 2, size.height / 2 );
+
+    gaussTrap[o] = (IplImage **)calloc( intvls + 3, sizeof( IplImage* ) );
+    dogTrap[o] = (IplImage **)calloc( intvls + 2, sizeof( IplImage* ) );
+
+    for( int i = 0; i < intvls + 3; i++ )
+      gaussTrap[o][i] = arenaCreateImage( arena, size, IPL_DEPTH_32F, 1 );
+    for( int i = 0; i < intvls + 2; i++ )
+      dogTrap[o][i] = arenaCreateImage( arena, size, IPL_DEPTH_32F, 1 );
+  }
 }
 
-//Detect and Filter Scale Space Extrenum
-void detectMinExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, CandidatePtrVector& kps, float minRad, float maxRad )
+const cv::Mat& DoGPyramid::kernel( double sigma )
 {
-  for( int o = 0; o < octvs; o++ ) {
-    for( int i = 1; i <= intvls; i++ ) {
+  for( unsigned i = 0; i < kernels.size(); i++ )
+    if( kernels[i].first == sigma )
+      return kernels[i].second;
+
+  // Same kernel size as cvSmooth chooses for floating point images
+  int size = cvRound( sigma * 4 * 2 + 1 ) | 1;
+  kernels.push_back( make_pair( sigma, cv::getGaussianKernel( size, sigma, CV_32F ) ) );
+  return kernels.back().second;
+}
 
-      float nextScaleSigma = 2*DOG_SIGMA*pow(2.0f,o+(i+1)/intvls);
-      float prevScaleSigma = 2*DOG_SIGMA*pow(2.0f,o+(i-1)/intvls);
+void DoGPyramid::build( IplImage* input, float sigma, bool upscale, float maxRad,
+  int octaves, int intervals, int threads )
+{
+  assert( input->depth == IPL_DEPTH_32F && input->nChannels == 1 );
+
+  // Border of maxRad in total around the image (as in formatBase)
+  CvSize borderedSize;
+  borderedSize.height = input->height + maxRad;
+  borderedSize.width = input->width + maxRad;
+  CvSize baseSize = ( upscale ? cvSize( input->width*2, input->height*2 ) : borderedSize );
+  allocate( borderedSize, baseSize, octaves, intervals );
+
+  // Copy the input straight into the base, and set only the area around it
+  // to the median, instead of creating a separate bordered copy
+  IplImage* base = ( upscale ? bordered : gaussTrap[0][0] );
+  CvPoint offset;
+  offset.x = maxRad / 2;
+  offset.y = maxRad / 2;
+  CvRect inner = cvRect( offset.x, offset.y, input->width, input->height );
+  setBorder( base, inner, QuantileHistogram( input ).quantile( 0.5f ) );
+  cvSetImageROI( base, inner );
+  cvCopy( input, base );
+  cvResetImageROI( base );
 
-      if( nextScaleSigma <= minRad || prevScaleSigma >= maxRad )
-        continue;
+  // Upscale if required, and smooth to the base of the first octave
+  float sig_diff;
+  if( upscale ) {
+    sig_diff = (float)sqrt( sigma * sigma - DOG_INIT_SIGMA * DOG_INIT_SIGMA * 4 );
+    cvResize( bordered, gaussTrap[0][0], CV_INTER_CUBIC );
+  } else {
+    sig_diff = (float)sqrt( sigma * sigma - DOG_INIT_SIGMA * DOG_INIT_SIGMA );
+  }
+  blurLevel( gaussTrap[0][0], gaussTrap[0][0], kernel( sig_diff ) );
 
-      for( int r = DOG_SCAN_START; r < DoGTrap[o][i]->height-DOG_SCAN_START; r++ ) {
-        for( int c = DOG_SCAN_START; c < DoGTrap[o][i]->width-DOG_SCAN_START; c++ ) {
-          if( isMin( DoGTrap, o, i, r, c ) )  
-          {  
-            DoG_Candidate point;
-            if( interpExtremum(DoGTrap, o, i, r, c, intvls, contr_thr, point) ) 
-            {
-              Candidate* to_add = new Candidate;
-              to_add->r = point.y;
-              to_add->c = point.x;
-              to_add->major = DOG_COMPENSATION*DOG_SIGMA*
-                pow(2.0f,point.octv+(point.intvl+point.subintvl)/intvls);
-              to_add->minor = to_add->major;
-              to_add->angle = 0.0;
-              to_add->method = DOG;
-              to_add->magnitude = getPixel32f( DoGTrap[o][i], r, c );
-              kps.push_back( to_add );
-            }
-          }
-        }
-      }
-    }
+  // Smoothing increments for each interval (as in buildGaussTrap)
+  vector< double > sig( intvls + 3 );
+  sig[0] = sigma;
+  double k = pow( 2.0, 1.0 / intvls );
+  for( int i = 1; i < intvls + 3; i++ )
+  {
+    double sig_prev = pow( k, i - 1 ) * sigma;
+    double sig_total = sig_prev * k;
+    sig[i] = sqrt( sig_total * sig_total - sig_prev * sig_prev );
   }
+
+  // Each octave starts from the previous one, so levels are built in order
+  for( int o = 0; o < octvs; o++ )
+    for( int i = 0; i < intvls + 3; i++ )
+    {
+      if( o == 0  &&  i == 0 )
+        continue;
+      else if( i == 0 )
+        cvResize( gaussTrap[o-1][intvls], gaussTrap[o][i], CV_INTER_NN );
+      else
+        blurLevel( gaussTrap[o][i-1], gaussTrap[o][i], kernel( sig[i] ) );
+    }
+
+  // Octaves are subtracted independently
+  parallelFor( octvs, SubtractOctavesBody( gaussTrap, dogTrap, intvls ), threads );
 }
 
-//Detect and Filter Scale Space Extrenum
-void detectMaxExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, CandidatePtrVector& kps, float minRad, float maxRad )
+#ifdef DOG_BENCHMARKING
+
+//Builds levels with both the reference trapezoid functions and the pyramid,
+//appending the time taken by each and the largest difference between their
+//DoG levels to the results file
+void benchmarkPyramid( IplImage* input, float sigma, bool upscale, float maxRad,
+  int octaves, int intervals, ImageArena *arena, DoGPyramid& pyramid, int threads )
 {
-  for( int o = 0; o < octvs; o++ ) {
-    for( int i = 1; i <= intvls; i++ ) {
+  ofstream dog_bm_output( dog_bm_fn.c_str(), fstream::out | fstream::app );
+  BenchmarkTimer dog_timer;
 
-      float nextScaleSigma = 2*DOG_SIGMA*pow(2.0f,o+(i+1)/intvls);
-      float prevScaleSigma = 2*DOG_SIGMA*pow(2.0f,o+(i-1)/intvls);
+  IplImage* init = formatBase( input, sigma, upscale, maxRad, arena );
+  IplImage*** gaussTrap = buildGaussTrap( init, octaves, intervals, sigma, arena );
+  IplImage*** DoGTrap = buildDoGTrap( gaussTrap, octaves, intervals, arena );
+  releaseTrap( &gaussTrap, octaves, intervals + 3, arena );
+  arenaReleaseImage( arena, &init );
+  double referenceTime = dog_timer.getTimeSinceLastCall();
 
-      if( nextScaleSigma <= minRad || prevScaleSigma >= maxRad )
-        continue;
+  pyramid.build( input, sigma, upscale, maxRad, octaves, intervals, threads );
+  double pyramidTime = dog_timer.getTimeSinceLastCall();
+
+  double maxDifference = 0.0;
+  for( int o = 0; o < octaves; o++ )
+    for( int i = 0; i < intervals + 2; i++ )
+      maxDifference = max( maxDifference,
+        cvNorm( DoGTrap[o][i], pyramid.dogLevels()[o][i], CV_C ) );
+
+  dog_bm_output << referenceTime << " " << pyramidTime << " " << maxDifference << endl;
+  dog_bm_output.close();
+
+  releaseTrap( &DoGTrap, octaves, intervals + 2, arena );
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+//                    Extrema Localization and Filtering
+//------------------------------------------------------------------------------
+
+//Flags each column in [begin,end) of the middle row of a 3x3x3 neighbourhood,
+//given by the 9 surrounding rows of the three adjacent levels, which is no
+//greater than (DOG_MAX) or no less than (DOG_MIN) any of its 26 neighbours.
+//As with the previous per-pixel isMax and isMin tests, DOG_MAX finds minima
+//of the DoG levels (the subtraction is level i+1 minus level i), which are
+//the bright blobs.
+void flagRowExtremum( const float* rows[9], int begin, int end, int mode, uchar* flags )
+{
+  const float* center = rows[4];
+  bool findMin = ( mode != DOG_MIN );
+  bool findMax = ( mode != DOG_MAX );
+  int c = begin;
+
+#ifdef SCALLOP_TK_USE_SSE
+  // Four columns at a time, each compared against the maximum and minimum
+  // of the 27 values around it
+  for( ; c + 4 <= end; c += 4 ) {
+    __m128 hi = _mm_loadu_ps( rows[0] + c - 1 );
+    __m128 lo = hi;
+    for( int j = 0; j < 9; j++ ) {
+      for( int k = -1; k <= 1; k++ ) {
+        __m128 v = _mm_loadu_ps( rows[j] + c + k );
+        hi = _mm_max_ps( hi, v );
+        lo = _mm_min_ps( lo, v );
+      }
+    }
+    __m128 val = _mm_loadu_ps( center + c );
+    int mask = 0;
+    if( findMax )
+      mask |= _mm_movemask_ps( _mm_cmpge_ps( val, hi ) );
+    if( findMin )
+      mask |= _mm_movemask_ps( _mm_cmple_ps( val, lo ) );
+    for( int k = 0; k < 4; k++ )
+      flags[c+k] = ( mask >> k ) & 1;
+  }
+#endif
+
+  for( ; c < end; c++ ) {
+    float hi = rows[0][c-1];
+    float lo = hi;
+    for( int j = 0; j < 9; j++ ) {
+      for( int k = -1; k <= 1; k++ ) {
+        hi = max( hi, rows[j][c+k] );
+        lo = min( lo, rows[j][c+k] );
+      }
+    }
+    flags[c] = ( findMax && center[c] >= hi ) || ( findMin && center[c] <= lo );
+  }
+}
 
-      for( int r = DOG_SCAN_START; r < DoGTrap[o][i]->height-DOG_SCAN_START; r++ ) {
-        for( int c = DOG_SCAN_START; c < DoGTrap[o][i]->width-DOG_SCAN_START; c++ ) {
-          if( isMax( DoGTrap, o, i, r, c ) )  
-          {  
-            DoG_Candidate point;
-            if( interpExtremum(DoGTrap, o, i, r, c, intvls, contr_thr, point) ) 
-            {
-              Candidate* to_add = new Candidate;
-              to_add->r = point.y;
-              to_add->c = point.x;
-              to_add->major = DOG_COMPENSATION*DOG_SIGMA*
-                pow(2.0f,point.octv+(point.intvl+point.subintvl)/intvls);
-              to_add->minor = to_add->major;
-              to_add->angle = 0.0;
-              to_add->method = DOG;
-              to_add->magnitude = getPixel32f( DoGTrap[o][i], r, c );
-              kps.push_back( to_add );
-            }
-          }
+//Detect and Filter Scale Space Extrenum of a single level
+void detectLevelExtremum( IplImage*** DoGTrap, int o, int i, int intvls, double contr_thr, int mode, CandidatePtrVector& kps )
+{
+  IplImage* level = DoGTrap[o][i];
+  int begin = DOG_SCAN_START;
+  int end = level->width - DOG_SCAN_START;
+  vector< uchar > flags( level->width, 0 );
+
+  for( int r = DOG_SCAN_START; r < level->height-DOG_SCAN_START; r++ ) {
+
+    // Rows above, at and below r in the level below, this level and above
+    const float* rows[9];
+    for( int l = 0; l < 3; l++ )
+      for( int j = 0; j < 3; j++ )
+        rows[3*l+j] = (const float*)( DoGTrap[o][i+l-1]->imageData +
+          ( r+j-1 ) * DoGTrap[o][i+l-1]->widthStep );
+
+    flagRowExtremum( rows, begin, end, mode, &flags[0] );
+
+    for( int c = begin; c < end; c++ ) {
+      if( flags[c] )
+      {  
+        DoG_Candidate point;
+        if( interpExtremum(DoGTrap, o, i, r, c, intvls, contr_thr, point) ) 
+        {
+          Candidate* to_add = new Candidate;
+          to_add->r = point.y;
+          to_add->c = point.x;
+          to_add->major = DOG_COMPENSATION*DOG_SIGMA*
+            pow(2.0f,point.octv+(point.intvl+point.subintvl)/intvls);
+          to_add->minor = to_add->major;
+          to_add->angle = 0.0;
+          to_add->method = DOG;
+          to_add->magnitude = rows[4][c];
+          kps.push_back( to_add );
         }
       }
     }
   }
 }
 
-//Detect and Filter Scale Space Extrenum
-void detectExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, CandidatePtrVector& kps, float minRad, float maxRad )
+//Scans a range of levels, each into its own container
+class ScanLevelsBody : public ParallelLoopBody
+{
+public:
+
+  ScanLevelsBody( IplImage*** _DoGTrap, const vector< pair< int, int > >& _levels,
+    int _intvls, double _contr_thr, int _mode, vector< CandidatePtrVector >& _outputs )
+  : DoGTrap( _DoGTrap ), levels( _levels ), intvls( _intvls ),
+    contr_thr( _contr_thr ), mode( _mode ), outputs( _outputs ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int l = begin; l < end; l++ )
+      detectLevelExtremum( DoGTrap, levels[l].first, levels[l].second, intvls,
+        contr_thr, mode, outputs[l] );
+  }
+
+  IplImage*** DoGTrap;
+  const vector< pair< int, int > >& levels;
+  int intvls;
+  double contr_thr;
+  int mode;
+  vector< CandidatePtrVector >& outputs;
+};
+
+//Detect and Filter Scale Space Extrenum of the type given by mode
+void detectExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_thr, int curv_thr, int mode, CandidatePtrVector& kps, float minRad, float maxRad, int threads )
 {
+  // Levels covering the search radii
+  vector< pair< int, int > > levels;
   for( int o = 0; o < octvs; o++ ) {
     for( int i = 1; i <= intvls; i++ ) {
 
@@ -378,29 +611,17 @@ void detectExtremum( IplImage*** DoGTrap, int octvs, int intvls, double contr_th
       if( nextScaleSigma <= minRad || prevScaleSigma >= maxRad )
         continue;
 
-      for( int r = DOG_SCAN_START; r < DoGTrap[o][i]->height-DOG_SCAN_START; r++ ) {
-        for( int c = DOG_SCAN_START; c < DoGTrap[o][i]->width-DOG_SCAN_START; c++ ) {
-          if( isMin( DoGTrap, o, i, r, c ) || isMax( DoGTrap, o, i, r, c ) )  
-          {  
-            DoG_Candidate point;
-            if( interpExtremum(DoGTrap, o, i, r, c, intvls, contr_thr, point) ) 
-            {
-              Candidate* to_add = new Candidate;
-              to_add->r = point.y;
-              to_add->c = point.x;
-              to_add->major = DOG_COMPENSATION*DOG_SIGMA*
-                pow(2.0f,point.octv+(point.intvl+point.subintvl)/intvls);
-              to_add->minor = to_add->major;
-              to_add->angle = 0.0;
-              to_add->method = DOG;
-              to_add->magnitude = getPixel32f( DoGTrap[o][i], r, c );
-              kps.push_back( to_add );
-            }
-          }
-        }
-      }
+      levels.push_back( make_pair( o, i ) );
     }
   }
+
+  // Levels are scanned independently, then their candidates are appended
+  // in the same order as a sequential scan
+  vector< CandidatePtrVector > outputs( levels.size() );
+  parallelFor( levels.size(), ScanLevelsBody( DoGTrap, levels, intvls, contr_thr, mode, outputs ), threads );
+
+  for( unsigned l = 0; l < outputs.size(); l++ )
+    kps.insert( kps.end(), outputs[l].begin(), outputs[l].end() );
 }
 
 bool interpExtremum( IplImage*** DoGTrap, int octv, int intvl, int r, int c, int intvls, double contr_thr, DoG_Candidate& point )
@@ -454,50 +675,63 @@ bool interpExtremum( IplImage*** DoGTrap, int octv, int intvl, int r, int c, int
 void interpStep( IplImage*** DoGTrap, int octv, int intvl, int r, int c,
              double* xi, double* xr, double* xc )
 {
-  CvMat* dD, * H, * H_inv, X;
-  double x[3] = { 0 };
-
-  dD = deriv3D( DoGTrap, octv, intvl, r, c );
-  H = hessian3D( DoGTrap, octv, intvl, r, c );
-  H_inv = cvCreateMat( 3, 3, CV_64FC1 );
-  cvInvert( H, H_inv, CV_SVD );
-  cvInitMatHeader( &X, 3, 1, CV_64FC1, x, CV_AUTOSTEP );
-  cvGEMM( H_inv, dD, -1, NULL, 0, &X, 0 );
-
-  cvReleaseMat( &dD );
-  cvReleaseMat( &H );
-  cvReleaseMat( &H_inv );
+  double dD[3], H[3][3], x[3];
+
+  deriv3D( DoGTrap, octv, intvl, r, c, dD );
+  hessian3D( DoGTrap, octv, intvl, r, c, H );
+
+  // Cofactors of the symmetric hessian, giving its inverse as adj(H) / det(H)
+  double c00 = H[1][1] * H[2][2] - H[1][2] * H[2][1];
+  double c01 = H[1][2] * H[2][0] - H[1][0] * H[2][2];
+  double c02 = H[1][0] * H[2][1] - H[1][1] * H[2][0];
+  double c11 = H[0][0] * H[2][2] - H[0][2] * H[2][0];
+  double c12 = H[0][1] * H[2][0] - H[0][0] * H[2][1];
+  double c22 = H[0][0] * H[1][1] - H[0][1] * H[1][0];
+  double det = H[0][0] * c00 + H[0][1] * c01 + H[0][2] * c02;
+
+  double scale = 0.0;
+  for( int j = 0; j < 3; j++ )
+    for( int k = 0; k < 3; k++ )
+      scale = max( scale, abs( H[j][k] ) );
+
+  if( abs( det ) > DOG_MIN_HESSIAN_DET * scale * scale * scale )
+  {
+    x[0] = -( c00 * dD[0] + c01 * dD[1] + c02 * dD[2] ) / det;
+    x[1] = -( c01 * dD[0] + c11 * dD[1] + c12 * dD[2] ) / det;
+    x[2] = -( c02 * dD[0] + c12 * dD[1] + c22 * dD[2] ) / det;
+  }
+  else
+  {
+    // (Near) singular, use the pseudo-inverse as before, on stack matrices
+    double H_inv[3][3];
+    CvMat Hm, H_invm, dDm, X;
+    cvInitMatHeader( &Hm, 3, 3, CV_64FC1, H, CV_AUTOSTEP );
+    cvInitMatHeader( &H_invm, 3, 3, CV_64FC1, H_inv, CV_AUTOSTEP );
+    cvInitMatHeader( &dDm, 3, 1, CV_64FC1, dD, CV_AUTOSTEP );
+    cvInitMatHeader( &X, 3, 1, CV_64FC1, x, CV_AUTOSTEP );
+    cvInvert( &Hm, &H_invm, CV_SVD );
+    cvGEMM( &H_invm, &dDm, -1, NULL, 0, &X, 0 );
+  }
 
   *xi = x[2];
   *xr = x[1];
   *xc = x[0];
 }
 
-//Creates a derivative OpenCV matrix
-CvMat* deriv3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c )
+//Computes the derivative in x, y and scale
+void deriv3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c, double dI[3] )
 {
-  CvMat* dI;
-  double dx, dy, ds;
-
-  dx = ( getPixel32f( DoGTrap[octv][intvl], r, c+1 ) -
+  dI[0] = ( getPixel32f( DoGTrap[octv][intvl], r, c+1 ) -
     getPixel32f( DoGTrap[octv][intvl], r, c-1 ) ) / 2.0;
-  dy = ( getPixel32f( DoGTrap[octv][intvl], r+1, c ) -
+  dI[1] = ( getPixel32f( DoGTrap[octv][intvl], r+1, c ) -
     getPixel32f( DoGTrap[octv][intvl], r-1, c ) ) / 2.0;
-  ds = ( getPixel32f( DoGTrap[octv][intvl+1], r, c ) -
+  dI[2] = ( getPixel32f( DoGTrap[octv][intvl+1], r, c ) -
     getPixel32f( DoGTrap[octv][intvl-1], r, c ) ) / 2.0;
-
-  dI = cvCreateMat( 3, 1, CV_64FC1 );
-  cvmSet( dI, 0, 0, dx );
-  cvmSet( dI, 1, 0, dy );
-  cvmSet( dI, 2, 0, ds );
-
-  return dI;
 }
 
-//Creates a Hessian OpenCV matrix
-CvMat* hessian3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c )
+//Computes the Hessian in x, y and scale
+void hessian3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c, double H[3][3] )
 {
-  CvMat* H;
   double v, dxx, dyy, dss, dxy, dxs, dys;
 
   v = getPixel32f( DoGTrap[octv][intvl], r, c );
@@ -520,33 +754,25 @@ CvMat* hessian3D( IplImage*** DoGTrap, int octv, int intvl, int r, int c )
       getPixel32f( DoGTrap[octv][intvl-1], r+1, c ) +
       getPixel32f( DoGTrap[octv][intvl-1], r-1, c ) ) / 4.0;
 
-  H = cvCreateMat( 3, 3, CV_64FC1 );
-  cvmSet( H, 0, 0, dxx );
-  cvmSet( H, 0, 1, dxy );
-  cvmSet( H, 0, 2, dxs );
-  cvmSet( H, 1, 0, dxy );
-  cvmSet( H, 1, 1, dyy );
-  cvmSet( H, 1, 2, dys );
-  cvmSet( H, 2, 0, dxs );
-  cvmSet( H, 2, 1, dys );
-  cvmSet( H, 2, 2, dss );
-
-  return H;
+  H[0][0] = dxx;
+  H[0][1] = dxy;
+  H[0][2] = dxs;
+  H[1][0] = dxy;
+  H[1][1] = dyy;
+  H[1][2] = dys;
+  H[2][0] = dxs;
+  H[2][1] = dys;
+  H[2][2] = dss;
 }
 
 double interpContr( IplImage*** DoGTrap, int octv, int intvl, int r,
               int c, double xi, double xr, double xc )
 {
-  CvMat* dD, X, T;
-  double t[1], x[3] = { xc, xr, xi };
-
-  cvInitMatHeader( &X, 3, 1, CV_64FC1, x, CV_AUTOSTEP );
-  cvInitMatHeader( &T, 1, 1, CV_64FC1, t, CV_AUTOSTEP );
-  dD = deriv3D( DoGTrap, octv, intvl, r, c );
-  cvGEMM( dD, &X, 1, NULL, 0, &T,  CV_GEMM_A_T );
-  cvReleaseMat( &dD );
+  double dD[3];
+  deriv3D( DoGTrap, octv, intvl, r, c, dD );
 
-  return getPixel32f( DoGTrap[octv][intvl], r, c ) + t[0] * 0.5;
+  double t = dD[0] * xc + dD[1] * xr + dD[2] * xi;
+  return getPixel32f( DoGTrap[octv][intvl], r, c ) + t * 0.5;
 }
 
 //Use hessian to quell edge responses
@@ -739,7 +965,7 @@ double dominantOrientation( double* hist, int n )
 //------------------------------------------------------------------------------
 
 //Deallocate a trapezoidal structure
-void releaseTrap( IplImage**** pyr, int octvs, int n )
+void releaseTrap( IplImage**** pyr, int octvs, int n, ImageArena *arena )
 {
   if( *pyr == NULL ) 
     return;
@@ -748,7 +974,7 @@ void releaseTrap( IplImage**** pyr, int octvs, int n )
   for( i = 0; i < octvs; i++ )
   {
     for( j = 0; j < n; j++ )
-      cvReleaseImage( &(*pyr)[i][j] );
+      arenaReleaseImage( arena, &(*pyr)[i][j] );
     free( (*pyr)[i] );
   }
   free( *pyr );
@@ -24,12 +24,20 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/ImageArena.h"
+#include "ScallopTK/Utilities/Quantiles.h"
+#include "ScallopTK/Utilities/Threads.h"
 
 //Visual Debugger
 #ifdef ENABLE_VISUAL_DEBUGGER
   #include "ScallopTK/Utilities/VisualDebugger.h"
 #endif
 
+//Benchmarking
+#ifdef DOG_BENCHMARKING
+  #include "ScallopTK/Utilities/Benchmarking.h"
+#endif
+
 //------------------------------------------------------------------------------
 //                               Configurations
 //------------------------------------------------------------------------------
@@ -63,6 +71,10 @@ const int DOG_SCAN_START = 2;
 //Max #steps to infer extrema
 const int DOG_MAX_INTERP_STEPS = 5;
 
+//Hessians with a smaller determinant (relative to their largest entry cubed)
+//are treated as singular when interpolating extrema
+const double DOG_MIN_HESSIAN_DET = 1e-12;
+
 //Scale factor to compensate for size underestimation
 const float DOG_COMPENSATION = 1.55f;
 
@@ -71,12 +83,72 @@ const int DOG_MIN = 0x00;
 const int DOG_MAX = 0x01;
 const int DOG_ALL = 0x02;
 
+//------------------------------------------------------------------------------
+//                              Class Definitions
+//------------------------------------------------------------------------------
+
+// Gaussian and DoG levels of an image. Levels are kept between calls to
+// build, and only reallocated when the image size or number of levels
+// changes, so a pyramid kept for each detector reuses the same buffers for
+// every frame of a survey. Gaussian kernels are computed once per sigma.
+class DoGPyramid {
+public:
+
+  // Levels are borrowed from the arena if given, in which case the pyramid
+  // must be destroyed before the arena
+  explicit DoGPyramid( ImageArena *arena = NULL );
+  ~DoGPyramid();
+
+  // Build all levels for an input image, which is first bordered with its
+  // median by maxRad (in total) and upscaled if requested. Octaves are
+  // subtracted into DoG levels by up to threads threads.
+  void build( IplImage* input, float sigma, bool upscale, float maxRad,
+    int octaves, int intervals, int threads = 1 );
+
+  // Levels from the last build, indexed by [octave][interval]
+  IplImage*** gaussLevels() { return gaussTrap; }
+  IplImage*** dogLevels() { return dogTrap; }
+
+  // Free all levels
+  void release();
+
+private:
+
+  // Allocate levels for the given base size, if not already allocated
+  void allocate( CvSize borderedSize, CvSize baseSize, int octaves, int intervals );
+
+  // Blur kernel for the given sigma, computed on first use
+  const cv::Mat& kernel( double sigma );
+
+  ImageArena *arena;
+
+  // Input bordered with its median, if upscaling (otherwise the first
+  // level is bordered in place)
+  IplImage* bordered;
+
+  // Levels, and the layout they're allocated for
+  IplImage*** gaussTrap;
+  IplImage*** dogTrap;
+  int octvs;
+  int intvls;
+
+  // Gaussian kernels by sigma
+  std::vector< std::pair< double, cv::Mat > > kernels;
+
+  DoGPyramid( const DoGPyramid& );
+  DoGPyramid& operator=( const DoGPyramid& );
+};
+
 //------------------------------------------------------------------------------
 //                             Function Prototypes
 //------------------------------------------------------------------------------
 
+// Levels are built in the given pyramid, reusing its buffers from previous
+// calls. Without one, a temporary pyramid borrows its levels from the arena.
+// Octaves are subtracted and scanned for extrema by up to threads threads.
 bool findDoGCandidates( IplImage* input, CandidatePtrVector& kps,
-  float minRad, float maxRad, int mode = DOG_ALL );
+  float minRad, float maxRad, int mode = DOG_ALL, ImageArena *arena = NULL,
+  DoGPyramid *pyramid = NULL, int threads = 1 );
 
 //------------------------------------------------------------------------------
 //                             Required Structures
@@ -1,13 +1,27 @@
 
 #include "HistogramFiltering.h"
 
+#include "ScallopTK/Utilities/ColorConversion.h"
+
 //------------------------------------------------------------------------------
-//                           Filter Class Definition
+//                               Benchmarking
 //------------------------------------------------------------------------------
 
 namespace ScallopTK
 {
 
+#ifdef SALIENCY_BENCHMARKING
+  const string sal_bm_fn = "SaliencyBMResults.dat";
+
+  // Sampling strides compared against sampling every pixel
+  const int sal_bm_strides[] = { 1, 2, 4, 8, 16 };
+  const int sal_bm_count = 5;
+#endif
+
+//------------------------------------------------------------------------------
+//                           Filter Class Definition
+//------------------------------------------------------------------------------
+
 //Class constructor, loads the desired filter from file
 bool hfFilter::loadFromFile( const string& filter_fn, bool allocSecondary ) {
 
@@ -119,33 +133,16 @@ float hfFilter::classifyPoint3d( float* pt ) {
   return *(filter3d+b1*ch1_scale+b2*ch2_scale+b3);
 }
 
-//FAST FILTER - UNSTABLE IF USED INCORRECTLY
-IplImage *hfFilter::classify3dImage( IplImage *img ) {
+IplImage *hfFilter::classify3dImage( IplImage *img, ImageArena *arena ) {
   assert( img->nChannels == 3 );
   assert( img->depth == IPL_DEPTH_32F );
-  IplImage *output = cvCreateImage( cvGetSize( img ), IPL_DEPTH_32F, 1 );
-  int istep = img->widthStep;
-  int ostep = output->widthStep;
-  int height = output->height;
-  int width = output->width;
-  float *ivalue = (float*)(img->imageData);
-  float *ovalue = (float*)(output->imageData);
-  char *test = output->imageData;
-  for( int i=0; i<height*width; i++ ) {
-    int b1 = (int)((ivalue[0] - startCh1) * bprCh1);
-    int b2 = (int)((ivalue[1] - startCh2) * bprCh2);
-    int b3 = (int)((ivalue[2] - startCh3) * bprCh3);
-
-    if( b1 < 0 || b1 >= histBinsCh1 || 
-      b2 < 0 || b2 >= histBinsCh2 || 
-      b3 < 0 || b3 >= histBinsCh3 ) {
-      *ovalue = 0.0f;
-    } else {    
-      *ovalue = *(filter3d+ch1_scale*b1+ch2_scale*b2+b3);
+  IplImage *output = arenaCreateImage( arena, cvGetSize( img ), IPL_DEPTH_32F, 1 );
+  for( int r=0; r<img->height; r++ ) {
+    const float *ivalue = (const float*)(img->imageData + r*img->widthStep);
+    float *ovalue = (float*)(output->imageData + r*output->widthStep);
+    for( int c=0; c<img->width; c++, ivalue += 3 ) {
+      ovalue[c] = lookup( ivalue );
     }
-
-    ivalue = ivalue + 3;
-    ovalue = ovalue + 1;
   }
   return output;
 }
@@ -182,6 +179,83 @@ int hfFilter::insertInSecondary( float *val ) {
 
 //-------------------------------SECOND------------------------------------
 
+bool hfCompactFilter::build( hfFilter& filter, int valueBits ) {
+
+  if( !filter.isValid() || ( valueBits != 8 && valueBits != 16 && valueBits != 32 ) ) {
+    return false;
+  }
+
+  // Each axis has an extra bin, holding zero, for out of range values
+  int dim1 = filter.histBinsCh1 + 1;
+  int dim2 = filter.histBinsCh2 + 1;
+  int dim3 = filter.histBinsCh3 + 1;
+  int scale1 = dim2 * dim3;
+  int scale2 = dim3;
+
+  // Same scaling as the conversion of 8-bit input to 32f base images
+  const float scale = 1.0f / 255.0f;
+  for( int v = 0; v < 256; v++ ) {
+    float value = v * scale;
+    int b1 = (int)((value - filter.startCh1) * filter.bprCh1);
+    int b2 = (int)((value - filter.startCh2) * filter.bprCh2);
+    int b3 = (int)((value - filter.startCh3) * filter.bprCh3);
+    lutCh1[v] = ( b1 < 0 || b1 >= filter.histBinsCh1 ? filter.histBinsCh1 : b1 ) * scale1;
+    lutCh2[v] = ( b2 < 0 || b2 >= filter.histBinsCh2 ? filter.histBinsCh2 : b2 ) * scale2;
+    lutCh3[v] = ( b3 < 0 || b3 >= filter.histBinsCh3 ? filter.histBinsCh3 : b3 );
+  }
+
+  // Quantize over a range which always includes zero, so that zero (the
+  // most common value) is stored exactly
+  float minValue = 0.0f;
+  maxValue = 0.0f;
+  for( int i = 0; i < filter.size; i++ ) {
+    minValue = min( minValue, filter.filter3d[i] );
+    maxValue = max( maxValue, filter.filter3d[i] );
+  }
+
+  bits = valueBits;
+  int levels = ( bits == 32 ? 0 : ( 1 << bits ) - 1 );
+  step = 1.0f;
+  zero = 0;
+  if( levels > 0 && maxValue > minValue ) {
+    step = ( maxValue - minValue ) / levels;
+    zero = cvRound( -minValue / step );
+  }
+
+  storage.assign( dim1 * dim2 * dim3 * ( bits / 8 ), 0 );
+  maxError = 0.0f;
+
+  for( int i = 0; i < dim1; i++ ) {
+    for( int j = 0; j < dim2; j++ ) {
+      for( int k = 0; k < dim3; k++ ) {
+
+        float value = 0.0f;
+        if( i < filter.histBinsCh1 && j < filter.histBinsCh2 && k < filter.histBinsCh3 ) {
+          value = filter.filter3d[filter.ch1_scale*i+filter.ch2_scale*j+k];
+        }
+
+        int position = scale1*i+scale2*j+k;
+        if( bits == 32 ) {
+          ((float*)&storage[0])[position] = value;
+          continue;
+        }
+
+        int q = cvRound( value / step ) + zero;
+        q = ( q < 0 ? 0 : ( q > levels ? levels : q ) );
+        if( bits == 16 ) {
+          ((unsigned short*)&storage[0])[position] = (unsigned short)q;
+        } else {
+          storage[position] = (unsigned char)q;
+        }
+        maxError = max( maxError, (float)fabs( ( q - zero ) * step - value ) );
+      }
+    }
+  }
+  return true;
+}
+
+//-------------------------------SECOND------------------------------------
+
 void salFilter::allocMap( int binsPerDim ) {
 
   // Initialize Histogram
@@ -191,129 +265,122 @@ void salFilter::allocMap( int binsPerDim ) {
   histBinsCh1 = binsPerDim;
   histBinsCh2 = binsPerDim;
   histBinsCh3 = binsPerDim;
+  delete[] filter3d;
+  delete[] smoothed;
   filter3d = new float[size];
+  smoothed = new float[size];
   flushFilter();
 }
 
 
 void salFilter::flushFilter() {
-  float *ptr = filter3d;
-  for( int i = 0; i < size; i++ ) {
-    *(ptr+i) = 0.0f;
+  memset( filter3d, 0, size * sizeof( float ) );
+}
+
+// Adds a row of bins into another
+static inline void addHistRow( float *output, const float *input, int length ) {
+  for( int k = 0; k < length; k++ ) {
+    output[k] += input[k];
   }
 }
 
-//incomplete
 void salFilter::smoothHist() {
 
-  // Create new filter buffer
-  float *newb = new float[size];
-  for( int i = 0; i < size; i++ ) {
-    newb[i] = 0.0f;
+  // Bins on the border of the histogram don't contribute to the result
+  for( int i = 0; i < histBinsCh1; i++ ) {
+    for( int j = 0; j < histBinsCh2; j++ ) {
+      float *row = filter3d+ch1_scale*i+ch2_scale*j;
+      if( i == 0 || i == histBinsCh1 - 1 || j == 0 || j == histBinsCh2 - 1 ) {
+        memset( row, 0, histBinsCh3 * sizeof( float ) );
+      } else {
+        row[0] = 0.0f;
+        row[histBinsCh3-1] = 0.0f;
+      }
+    }
   }
 
-  // 3d Convolution
-  const float INNER_FACTOR = 1.0f;
-  const float OUTER_FACTOR = 1.0f;
-  for( int i = 1; i < histBinsCh1 - 1; i++ ) {
-    for( int j = 1; j < histBinsCh2 - 1; j++ ) {
-      for( int k = 1; k < histBinsCh3 - 1; k++ ) {
-
-        float val = *(filter3d+ch1_scale*i+ch2_scale*j+k);
-
-        float *center = newb+ch1_scale*i+ch2_scale*j+k;
-        *center = *center + val * INNER_FACTOR;
+  // The 7-point kernel is the sum of a 3-tap box along each axis (less
+  // twice the centre), so each axis is summed in turn, a row at a time
+  for( int i = 0; i < histBinsCh1; i++ ) {
+    for( int j = 0; j < histBinsCh2; j++ ) {
+      const float *input = filter3d+ch1_scale*i+ch2_scale*j;
+      float *output = smoothed+ch1_scale*i+ch2_scale*j;
 
-        float *s1 = center-1;
-        float *s2 = center+1;
-        float *s3 = center-ch1_scale;
-        float *s4 = center+ch1_scale;
-        float *s5 = center-ch2_scale;
-        float *s6 = center+ch2_scale;
-
-        float adj_val = val * OUTER_FACTOR;
-
-        *s1 = *s1 + adj_val;
-        *s2 = *s2 + adj_val;
-        *s3 = *s3 + adj_val;
-        *s4 = *s4 + adj_val;
-        *s5 = *s5 + adj_val;
-        *s6 = *s6 + adj_val;
+      // Channel 3 neighbours (the border bins are zero)
+      output[0] = input[0] + input[1];
+      for( int k = 1; k < histBinsCh3 - 1; k++ ) {
+        output[k] = input[k-1] + input[k] + input[k+1];
       }
+      output[histBinsCh3-1] = input[histBinsCh3-2] + input[histBinsCh3-1];
+
+      // Channel 2 and channel 1 neighbours
+      if( j > 0 )
+        addHistRow( output, input-ch2_scale, histBinsCh3 );
+      if( j < histBinsCh2 - 1 )
+        addHistRow( output, input+ch2_scale, histBinsCh3 );
+      if( i > 0 )
+        addHistRow( output, input-ch1_scale, histBinsCh3 );
+      if( i < histBinsCh1 - 1 )
+        addHistRow( output, input+ch1_scale, histBinsCh3 );
     }
   }
 
-  // Deallocate old filter buffer
-  delete[] filter3d;
-  filter3d = newb;
+  // Swap buffers, the old histogram is reused for the next smoothing
+  swap( filter3d, smoothed );
 }
 
 salFilter::~salFilter() {
   if( filter3d != NULL )
     delete[] filter3d;
+  if( smoothed != NULL )
+    delete[] smoothed;
 }
 
-IplImage *salFilter::classify3dImage( IplImage *img ) {
+IplImage *salFilter::classify3dImage( IplImage *img, ImageArena *arena ) {
   assert( img->nChannels == 3 );
   assert( img->depth == IPL_DEPTH_32F );
-  IplImage *output = cvCreateImage( cvGetSize( img ), IPL_DEPTH_32F, 1 );
-  int istep = img->widthStep;
-  int ostep = output->widthStep;
-  int height = output->height;
-  int width = output->width;
-  float *ivalue = (float*)(img->imageData);
-  float *ovalue = (float*)(output->imageData);
-  char *test = output->imageData;
-
-  for( int i=0; i<height*width; i++ ) {
-    int b1 = (int)((ivalue[0]) * histBinsCh1);
-    int b2 = (int)((ivalue[1]) * histBinsCh2);
-    int b3 = (int)((ivalue[2]) * histBinsCh3);
-
-    if( b1 < 0 || b1 >= histBinsCh1 || 
-      b2 < 0 || b2 >= histBinsCh2 || 
-      b3 < 0 || b3 >= histBinsCh3 ) {
-      *ovalue = 0.0f;
-    } else {    
-      *ovalue = *(filter3d+ch1_scale*b1+ch2_scale*b2+b3);
+  IplImage *output = arenaCreateImage( arena, cvGetSize( img ), IPL_DEPTH_32F, 1 );
+  for( int r=0; r<img->height; r++ ) {
+    const float *ivalue = (const float*)(img->imageData + r*img->widthStep);
+    float *ovalue = (float*)(output->imageData + r*output->widthStep);
+    for( int c=0; c<img->width; c++, ivalue += 3 ) {
+      ovalue[c] = lookup( ivalue );
     }
-    
-    ivalue = ivalue + 3;
-    ovalue = ovalue + 1;
   }
-  
   return output;
 }
 
-void salFilter::buildMap( IplImage *img ) {
+void salFilter::buildMap( IplImage *img, int stride ) {
 
-  int pixels_to_skip = 1;
+  stride = max( stride, 1 );
 
-  float *img_ptr = (float*) img->imageData;
-  float *img_end = ((float*) img->imageData) + img->width * img->height * 3;
+  // Each sample stands in for the pixels skipped around it
+  int samples = ( (img->height + stride - 1) / stride ) * ( (img->width + stride - 1) / stride );
+  float weight = (float)( img->width * img->height ) / samples;
 
-  while( img_ptr < img_end ) {
+  for( int r = 0; r < img->height; r += stride ) {
 
-    int b1 = (int)((img_ptr[0]) * histBinsCh1);
-    int b2 = (int)((img_ptr[1]) * histBinsCh2);
-    int b3 = (int)((img_ptr[2]) * histBinsCh3);
+    const float *img_ptr = (const float*)( img->imageData + r * img->widthStep );
 
-    if( b1 >= 0 && b1 < histBinsCh1 && 
-      b2 >= 0 && b2 < histBinsCh2 && 
-      b3 >= 0 && b3 < histBinsCh3 ) 
-    {
+    for( int c = 0; c < img->width; c += stride, img_ptr += stride*3 ) {
 
-      float *ptr = filter3d+ch1_scale*b1+ch2_scale*b2+b3;
-      *ptr = *ptr - 1.0;
-    }
+      int b1 = (int)((img_ptr[0]) * histBinsCh1);
+      int b2 = (int)((img_ptr[1]) * histBinsCh2);
+      int b3 = (int)((img_ptr[2]) * histBinsCh3);
 
-    img_ptr = img_ptr + pixels_to_skip*3;
+      if( b1 >= 0 && b1 < histBinsCh1 && 
+        b2 >= 0 && b2 < histBinsCh2 && 
+        b3 >= 0 && b3 < histBinsCh3 ) 
+      {
+        float *ptr = filter3d+ch1_scale*b1+ch2_scale*b2+b3;
+        *ptr = *ptr - weight;
+      }
+    }
   }
 
   isValid = true;
 }
 
-
 //-------------------------------SECOND------------------------------------
 
 // Class to construct our filter and perform classifications with it
@@ -340,21 +407,107 @@ bool ColorClassifier::loadFilters( const string& dir, const string& seedname ) {
   }
 
   // Configure filter to load saliency map into
-  SaliencyModel.allocMap( 80 );
+  SaliencyModel.allocMap( SALIENCY_BINS );
 
   filtersLoaded = true;
   return true;
 }
 
-hfResults *ColorClassifier::classifiyImage( IplImage *img ) {
+hfResults *ColorClassifier::classifiyImage( IplImage *img, ImageArena *arena ) {
+  return classifyAllFilters( img, arena, false );
+}
+
+// Classifies an 8-bit image against the compact brown, white, sand dollar
+// and environment filters (in that order) in a single pass
+template< typename T >
+static void classifyCompactPixels( IplImage *img, const hfCompactFilter *filters,
+  IplImage **outputs, IplImage *net ) {
+
+  const T *values[4];
+  float steps[4];
+  float zeros[4];
+  for( int k=0; k<4; k++ ) {
+    values[k] = (const T*)filters[k].values();
+    steps[k] = filters[k].valueStep();
+    zeros[k] = (float)filters[k].valueZero();
+  }
+
+  for( int r=0; r<img->height; r++ ) {
+    const unsigned char *ivalue = (const unsigned char*)(img->imageData + r*img->widthStep);
+    float *rows[4];
+    for( int k=0; k<4; k++ ) {
+      rows[k] = (float*)(outputs[k]->imageData + r*outputs[k]->widthStep);
+    }
+    float *netRow = (float*)(net->imageData + r*net->widthStep);
+
+    for( int c=0; c<img->width; c++, ivalue += 3 ) {
+      float v[4];
+      for( int k=0; k<4; k++ ) {
+        v[k] = ( values[k][filters[k].index( ivalue )] - zeros[k] ) * steps[k];
+        rows[k][c] = v[k];
+      }
+      netRow[c] = ( v[0] > v[1] ? v[0] : v[1] ) - v[3];
+    }
+  }
+}
+
+hfResults *ColorClassifier::classifyAllFilters( IplImage *img, ImageArena *arena,
+  bool withSaliency ) {
+  assert( img->nChannels == 3 );
+  assert( img->depth == IPL_DEPTH_32F || ( img->depth == IPL_DEPTH_8U && compactBits > 0 ) );
+  assert( img->depth == IPL_DEPTH_32F || !withSaliency );
   hfResults * ptr = new hfResults;
-  ptr->BrownScallopClass = BrownScallop.classify3dImage( img );
-  ptr->WhiteScallopClass = WhiteScallop.classify3dImage( img );
-  ptr->SandDollarsClass = SandDollars.classify3dImage( img );
-  ptr->EnvironmentalClass = Environment.classify3dImage( img );
-  ptr->NetScallops = cvCreateImage( cvGetSize(img), IPL_DEPTH_32F, 1 );
-  cvMax( ptr->BrownScallopClass, ptr->WhiteScallopClass, ptr->NetScallops );
-  cvSub( ptr->NetScallops, ptr->EnvironmentalClass, ptr->NetScallops );
+  ptr->arena = arena;
+  ptr->ColorBlobPyramid = &ColorBlobPyramid;
+  ptr->SalientBlobPyramid = &SalientBlobPyramid;
+  ptr->BrownScallopClass = arenaCreateImage( arena, cvGetSize(img), IPL_DEPTH_32F, 1 );
+  ptr->WhiteScallopClass = arenaCreateImage( arena, cvGetSize(img), IPL_DEPTH_32F, 1 );
+  ptr->SandDollarsClass = arenaCreateImage( arena, cvGetSize(img), IPL_DEPTH_32F, 1 );
+  ptr->EnvironmentalClass = arenaCreateImage( arena, cvGetSize(img), IPL_DEPTH_32F, 1 );
+  ptr->NetScallops = arenaCreateImage( arena, cvGetSize(img), IPL_DEPTH_32F, 1 );
+  ptr->SaliencyMap = ( withSaliency ?
+    arenaCreateImage( arena, cvGetSize(img), IPL_DEPTH_32F, 1 ) : NULL );
+  ptr->EnvironmentMap = NULL;
+
+  if( img->depth == IPL_DEPTH_8U ) {
+    IplImage *outputs[4] = { ptr->BrownScallopClass, ptr->WhiteScallopClass,
+      ptr->SandDollarsClass, ptr->EnvironmentalClass };
+    if( compactBits == 8 ) {
+      classifyCompactPixels< unsigned char >( img, Compact, outputs, ptr->NetScallops );
+    } else if( compactBits == 16 ) {
+      classifyCompactPixels< unsigned short >( img, Compact, outputs, ptr->NetScallops );
+    } else {
+      classifyCompactPixels< float >( img, Compact, outputs, ptr->NetScallops );
+    }
+    return ptr;
+  }
+
+  // Each pixel is read once and looked up in every filter, NetScallops is
+  // max(brown,white)-environment as previously computed with cvMax/cvSub
+  for( int r=0; r<img->height; r++ ) {
+    const float *ivalue = (const float*)(img->imageData + r*img->widthStep);
+    float *brown = (float*)(ptr->BrownScallopClass->imageData + r*ptr->BrownScallopClass->widthStep);
+    float *white = (float*)(ptr->WhiteScallopClass->imageData + r*ptr->WhiteScallopClass->widthStep);
+    float *dollars = (float*)(ptr->SandDollarsClass->imageData + r*ptr->SandDollarsClass->widthStep);
+    float *envi = (float*)(ptr->EnvironmentalClass->imageData + r*ptr->EnvironmentalClass->widthStep);
+    float *net = (float*)(ptr->NetScallops->imageData + r*ptr->NetScallops->widthStep);
+    float *sal = ( withSaliency ?
+      (float*)(ptr->SaliencyMap->imageData + r*ptr->SaliencyMap->widthStep) : NULL );
+
+    for( int c=0; c<img->width; c++, ivalue += 3 ) {
+      float b = BrownScallop.lookup( ivalue );
+      float w = WhiteScallop.lookup( ivalue );
+      float e = Environment.lookup( ivalue );
+      brown[c] = b;
+      white[c] = w;
+      envi[c] = e;
+      dollars[c] = SandDollars.lookup( ivalue );
+      net[c] = ( b > w ? b : w ) - e;
+      if( sal ) {
+        sal[c] = SaliencyModel.lookup( ivalue );
+      }
+    }
+  }
   return ptr;
 }
 
@@ -434,84 +587,224 @@ void ColorClassifier::Update( IplImage *img, IplImage *mask, int Detections[] )
   float BROWN_MR = (Detections[SCALLOP_BROWN]+Detections[SCALLOP_BURIED])*0.004f;
   if( Detections[SCALLOP_BROWN] )
     BrownScallop.mergeSecondary( BROWN_MR, 1.0f/envi_count );
+
+  // Compact copies must follow the updated filters
+  if( compactBits > 0 )
+    useCompactFilters( compactBits );
+}
+
+bool ColorClassifier::useCompactFilters( int bits ) {
+
+  compactBits = 0;
+  if( bits == 0 ) {
+    return true;
+  }
+
+  hfFilter *filters[4] = { &BrownScallop, &WhiteScallop, &SandDollars, &Environment };
+
+  for( int k=0; k<4; k++ ) {
+    if( !Compact[k].build( *filters[k], bits ) ) {
+      cerr << "ERROR: Cannot build " << bits << "-bit compact colour filters\n";
+      return false;
+    }
+  }
+  compactBits = bits;
+  return true;
+}
+
+// Largest and mean absolute difference of two single channel 32f images
+static void mapDifference( IplImage *a, IplImage *b, double& maxDiff, double& meanDiff ) {
+  double sum = 0.0;
+  maxDiff = 0.0;
+  for( int r = 0; r < a->height; r++ ) {
+    const float *rowA = (const float*)( a->imageData + r * a->widthStep );
+    const float *rowB = (const float*)( b->imageData + r * b->widthStep );
+    for( int c = 0; c < a->width; c++ ) {
+      double diff = fabs( (double)rowA[c] - rowB[c] );
+      maxDiff = max( maxDiff, diff );
+      sum += diff;
+    }
+  }
+  meanDiff = sum / max( a->width * a->height, 1 );
+}
+
+void ColorClassifier::reportCompactDrift( IplImage* img, bool isRGB, float minRad, float maxRad ) {
+
+  if( compactBits == 0 ) {
+    return;
+  }
+
+  // Base images, converted as for detection
+  IplImage *img32f = cvCreateImage( cvGetSize( img ), IPL_DEPTH_32F, 3 );
+  IplImage *img8u = cvCreateImage( cvGetSize( img ), IPL_DEPTH_8U, 3 );
+  convertBaseImages( img, isRGB, BASE_RGB_32F | BASE_RGB_8U, img32f,
+    NULL, NULL, NULL, img8u );
+
+  // Classify with the float filters, then with the compact tables in use
+  int bits = compactBits;
+  compactBits = 0;
+  hfResults *reference = performColorClassification( img32f, minRad, maxRad );
+  compactBits = bits;
+  hfResults *compact = performColorClassification( img32f, minRad, maxRad, NULL, img8u );
+
+  IplImage *referenceMaps[5] = { reference->BrownScallopClass, reference->WhiteScallopClass,
+    reference->SandDollarsClass, reference->EnvironmentalClass, reference->NetScallops };
+  IplImage *compactMaps[5] = { compact->BrownScallopClass, compact->WhiteScallopClass,
+    compact->SandDollarsClass, compact->EnvironmentalClass, compact->NetScallops };
+  const char *names[5] = { "Brown scallop", "White scallop", "Sand dollar", "Environment",
+    "Net scallops" };
+
+  cout << "Compact colour filters use " << bits << "-bit values, drift from float filters:" << endl;
+  for( int k=0; k<5; k++ ) {
+    double maxDiff, meanDiff;
+    mapDifference( referenceMaps[k], compactMaps[k], maxDiff, meanDiff );
+    cout << "  " << names[k] << ": max difference " << maxDiff
+         << ", mean difference " << meanDiff;
+    if( k < 4 ) {
+      cout << " (table quantization error " << Compact[k].quantizationError() << ")";
+    }
+    cout << endl;
+  }
+
+  hfDeallocResults( reference );
+  hfDeallocResults( compact );
+  cvReleaseImage( &img32f );
+  cvReleaseImage( &img8u );
 }
 
 // Deallocate filter results
 void hfDeallocResults( hfResults* res ) {
   if( res == NULL )
     return;
-  cvReleaseImage( &(res->BrownScallopClass) );
-  cvReleaseImage( &(res->WhiteScallopClass) );
-  cvReleaseImage( &(res->SandDollarsClass) );
-  cvReleaseImage( &(res->EnvironmentalClass) );
-  cvReleaseImage( &(res->NetScallops) );
-  cvReleaseImage( &(res->EnvironmentMap) );
-  cvReleaseImage( &(res->SaliencyMap) );
+  arenaReleaseImage( res->arena, &(res->BrownScallopClass) );
+  arenaReleaseImage( res->arena, &(res->WhiteScallopClass) );
+  arenaReleaseImage( res->arena, &(res->SandDollarsClass) );
+  arenaReleaseImage( res->arena, &(res->EnvironmentalClass) );
+  arenaReleaseImage( res->arena, &(res->NetScallops) );
+  arenaReleaseImage( res->arena, &(res->EnvironmentMap) );
+  arenaReleaseImage( res->arena, &(res->SaliencyMap) );
   delete res;
 }
 
-void quickPercentiles( IplImage* img, float p1, float p2, float &op1, float& op2 ) {
-  float *ptr = (float*) img->imageData;
-  int sze = img->width * img->height;
-  float *endptr = ptr + sze;
-  int skippage = 20;
-  if( sze / 1300 > 20 )
-    skippage = sze / 1300;
-  vector<float> val_list(sze/skippage+1,0.0f);
-  int counter = 0;
-  while( ptr < endptr ) {
-    val_list[counter] = *ptr;
-    counter++;
-    ptr = ptr + skippage;
-  }
-  sort( val_list.begin(), val_list.end() );
-  op1 = val_list[p1*sze/skippage];
-  op2 = val_list[p2*sze/skippage];
+#ifdef SALIENCY_BENCHMARKING
+
+// Correlation coefficient of two single channel 32f images
+static double mapCorrelation( IplImage *a, IplImage *b ) {
+  double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+  int count = a->width * a->height;
+  for( int r = 0; r < a->height; r++ ) {
+    const float *rowA = (const float*)( a->imageData + r * a->widthStep );
+    const float *rowB = (const float*)( b->imageData + r * b->widthStep );
+    for( int c = 0; c < a->width; c++ ) {
+      sumA += rowA[c];
+      sumB += rowB[c];
+      sumAA += rowA[c] * rowA[c];
+      sumBB += rowB[c] * rowB[c];
+      sumAB += rowA[c] * rowB[c];
+    }
+  }
+  double covariance = sumAB - sumA * sumB / count;
+  double varianceA = sumAA - sumA * sumA / count;
+  double varianceB = sumBB - sumB * sumB / count;
+  if( varianceA <= 0 || varianceB <= 0 )
+    return 1.0;
+  return covariance / sqrt( varianceA * varianceB );
 }
 
-hfResults *ColorClassifier::performColorClassification( IplImage* img, float minRad, float maxRad ) {
+// Builds the saliency map of a frame at each benchmarked sampling stride,
+// and appends the time taken by each and the correlation of its map with
+// the map built from every pixel to the results file
+static void benchmarkSaliency( IplImage *img, ImageArena *arena ) {
+  ofstream sal_bm_output( sal_bm_fn.c_str(), fstream::out | fstream::app );
+  salFilter model;
+  model.allocMap( SALIENCY_BINS );
+  IplImage *reference = NULL;
+
+  for( int i = 0; i < sal_bm_count; i++ ) {
+    BenchmarkTimer sal_timer;
+    model.flushFilter();
+    model.buildMap( img, sal_bm_strides[i] );
+    model.smoothHist();
+    IplImage *map = model.classify3dImage( img, arena );
+    cvSmooth( map, map, 2, 3, 3 );
+    double time = sal_timer.getTimeElapsed();
+
+    if( reference == NULL )
+      reference = map;
+
+    sal_bm_output << sal_bm_strides[i] << " " << time << " "
+                  << mapCorrelation( reference, map ) << " ";
+
+    if( map != reference )
+      arenaReleaseImage( arena, &map );
+  }
+
+  sal_bm_output << endl;
+  sal_bm_output.close();
+  arenaReleaseImage( arena, &reference );
+}
+
+#endif
+
+hfResults *ColorClassifier::performColorClassification( IplImage* img, float minRad, float maxRad,
+  ImageArena *arena, IplImage* img8u ) {
 
   // Declare pointer to output
   hfResults *results;
 
+  // Build saliency histogram, the saliency lookup shares the classification
+  // pass when that runs on the same (32f, unresized) image
+  SaliencyModel.flushFilter();
+  SaliencyModel.buildMap( img, saliencyStride );
+  SaliencyModel.smoothHist();
+
+  // Classify 8-bit input with the compact filters if possible
+  IplImage *input = ( compactBits > 0 && img8u != NULL ? img8u : img );
+
   // Perform Class-by-Class Classification
   float resizeFactor = MPFMR_COLOR_CLASS / minRad;
   if( resizeFactor < RESIZE_FACTOR_REQUIRED ) {
-    IplImage *temp = cvCreateImage( cvSize((int)(resizeFactor*img->width),(int)(resizeFactor*img->height)),
-                                        img->depth, img->nChannels );
-    cvResize(img, temp, CV_INTER_LINEAR);
-    results = classifiyImage( temp );
-    cvReleaseImage(&temp);
+    IplImage *temp = arenaCreateImage( arena, cvSize((int)(resizeFactor*input->width),(int)(resizeFactor*input->height)),
+                                        input->depth, input->nChannels );
+    cvResize(input, temp, CV_INTER_LINEAR);
+    results = classifiyImage( temp, arena );
+    arenaReleaseImage( arena, &temp );
     results->minRad = minRad * resizeFactor;
     results->maxRad = maxRad * resizeFactor;
     results->scale = resizeFactor;
   } else {
-    results = classifiyImage( img );
+    results = classifyAllFilters( input, arena, input == img );
     results->minRad = minRad;
     results->maxRad = maxRad;
     results->scale = 1.0f;
   }
 
+  // Saliency is computed at full resolution, so may need its own pass
+  if( results->SaliencyMap == NULL ) {
+    results->SaliencyMap = SaliencyModel.classify3dImage( img, arena );
+  }
+
   // Create environment map
-  float p1, p2;
-  quickPercentiles( results->EnvironmentalClass, 0.04, 0.40, p1, p2 ); 
-  results->EnvironmentMap = cvCreateImage( cvGetSize( results->EnvironmentalClass ), IPL_DEPTH_32F, 1 );
+  QuantileHistogram envHist( results->EnvironmentalClass );
+  float p1 = envHist.quantile( 0.04f );
+  float p2 = envHist.quantile( 0.40f );
+  results->EnvironmentMap = arenaCreateImage( arena, cvGetSize( results->EnvironmentalClass ), IPL_DEPTH_32F, 1 );
   cvScale( results->EnvironmentalClass, results->EnvironmentMap, -1.0f/(p2-p1), p2/(p2-p1) );
   cvThreshold( results->EnvironmentMap, results->EnvironmentMap, 0.0, 0.0, CV_THRESH_TOZERO );
   cvSmooth( results->EnvironmentMap, results->EnvironmentMap, CV_BLUR, 5, 5 );
 
-  // Create saliency map
-  SaliencyModel.flushFilter();
-  SaliencyModel.buildMap( img );
-  SaliencyModel.smoothHist();
-  results->SaliencyMap = SaliencyModel.classify3dImage( img );
+  // Smooth saliency map
   cvSmooth( results->SaliencyMap, results->SaliencyMap, 2, 3, 3 );
 
+#ifdef SALIENCY_BENCHMARKING
+  benchmarkSaliency( img, arena );
+#endif
+
   // Return results
   return results;
 }
 
-void detectColoredBlobs( hfResults* color, CandidatePtrVector& cds ) {
+void detectColoredBlobs( hfResults* color, CandidatePtrVector& cds, int threads ) {
   
   // Add border unto classification results and resize if needed
   float resize_factor = MPFMR_COLOR_DOG/color->minRad;
@@ -521,12 +814,12 @@ void detectColoredBlobs( hfResults* color, CandidatePtrVector& cds ) {
   if( resize_factor < RESIZE_FACTOR_REQUIRED ) {
     int nwidth = (int)(resize_factor * color->NetScallops->width);
     int nheight = (int)(resize_factor * color->NetScallops->height);
-    input = cvCreateImage( cvSize(nwidth,nheight), IPL_DEPTH_32F, 1 );
+    input = arenaCreateImage( color->arena, cvSize(nwidth,nheight), IPL_DEPTH_32F, 1 );
     cvResize(color->NetScallops, input, CV_INTER_LINEAR);
     minRad = color->minRad * resize_factor;
     maxRad = color->maxRad * resize_factor;
   } else {
-    input = cvCloneImage(color->NetScallops);
+    input = arenaCloneImage( color->arena, color->NetScallops );
     resize_factor = 1.0f;
   }
 
@@ -534,7 +827,8 @@ void detectColoredBlobs( hfResults* color, CandidatePtrVector& cds ) {
   cvSmooth( input, input, 2, 3, 3 );
 
   // Find DoG Candidates in image
-  findDoGCandidates( input, cds, minRad, maxRad, DOG_MAX );
+  findDoGCandidates( input, cds, minRad, maxRad, DOG_MAX, color->arena,
+    color->ColorBlobPyramid, threads );
 
   // Adjust cds for scaling factor
   float scaleFactor = 1.0 / (color->scale * resize_factor);
@@ -543,10 +837,10 @@ void detectColoredBlobs( hfResults* color, CandidatePtrVector& cds ) {
   }
 
   // Dealloc
-  cvReleaseImage( &input );
+  arenaReleaseImage( color->arena, &input );
 }
 
-void detectSalientBlobs( hfResults* color, CandidatePtrVector& cds ) {
+void detectSalientBlobs( hfResults* color, CandidatePtrVector& cds, int threads ) {
   
   // Add border unto classification results and resize if needed
   float resize_factor = MPFMR_COLOR_DOG/color->minRad;
@@ -556,12 +850,12 @@ void detectSalientBlobs( hfResults* color, CandidatePtrVector& cds ) {
   if( resize_factor < RESIZE_FACTOR_REQUIRED ) {
     int nwidth = (int)(resize_factor * color->SaliencyMap->width);
     int nheight = (int)(resize_factor * color->SaliencyMap->height);
-    input = cvCreateImage( cvSize(nwidth,nheight), IPL_DEPTH_32F, 1 );
+    input = arenaCreateImage( color->arena, cvSize(nwidth,nheight), IPL_DEPTH_32F, 1 );
     cvResize(color->SaliencyMap, input, CV_INTER_LINEAR);
     minRad = color->minRad * resize_factor;
     maxRad = color->maxRad * resize_factor;
   } else {
-    input = cvCloneImage(color->SaliencyMap);
+    input = arenaCloneImage( color->arena, color->SaliencyMap );
     resize_factor = 1.0f;
   }
 
@@ -569,7 +863,8 @@ void detectSalientBlobs( hfResults* color, CandidatePtrVector& cds ) {
   cvSmooth( input, input, 2, 3, 3 );
 
   // Find DoG Candidates in image
-  findDoGCandidates( input, cds, minRad, maxRad, DOG_ALL );
+  findDoGCandidates( input, cds, minRad, maxRad, DOG_ALL, color->arena,
+    color->SalientBlobPyramid, threads );
 
   // Adjust cds for scaling factor
   float scaleFactor = 1 / (color->scale * resize_factor);
@@ -578,7 +873,7 @@ void detectSalientBlobs( hfResults* color, CandidatePtrVector& cds ) {
   }
 
   // Dealloc
-  cvReleaseImage( &input );
+  arenaReleaseImage( color->arena, &input );
 }
 
 }
@@ -8,6 +8,7 @@
 //Standard C/C++
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <string>
 #include <map>
@@ -21,8 +22,15 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/ImageArena.h"
+#include "ScallopTK/Utilities/Quantiles.h"
 #include "ScallopTK/ObjectProposals/DoG.h"
 
+//Benchmarking
+#ifdef SALIENCY_BENCHMARKING
+  #include "ScallopTK/Utilities/Benchmarking.h"
+#endif
+
 namespace ScallopTK
 {
 
@@ -36,6 +44,9 @@ const int CHECKSUM = 999999;
 //Header size devoted in each filter matlab filter file
 const int HEADER_BYTES = 48;
 
+//Bins per channel of the saliency model
+const int SALIENCY_BINS = 80;
+
 //------------------------------------------------------------------------------
 //  Struct to contain a particular color classification result for some image
 //------------------------------------------------------------------------------
@@ -51,6 +62,9 @@ struct hfResults {
   IplImage *NetScallops;
   IplImage *SaliencyMap;
   IplImage *EnvironmentMap;
+  ImageArena *arena;
+  DoGPyramid *ColorBlobPyramid;
+  DoGPyramid *SalientBlobPyramid;
 };
 
 //------------------------------------------------------------------------------
@@ -77,7 +91,21 @@ public:
   float classifyPoint3d( float* pt );
 
   // Classifies an entire 3-chan image
-  IplImage *classify3dImage( IplImage *img );
+  IplImage *classify3dImage( IplImage *img, ImageArena *arena = NULL );
+
+  // Classifies a single pixel of a 3-chan 32f image, used by the above
+  float lookup( const float* pt ) const {
+    int b1 = (int)((pt[0] - startCh1) * bprCh1);
+    int b2 = (int)((pt[1] - startCh2) * bprCh2);
+    int b3 = (int)((pt[2] - startCh3) * bprCh3);
+
+    if( b1 < 0 || b1 >= histBinsCh1 ||
+      b2 < 0 || b2 >= histBinsCh2 ||
+      b3 < 0 || b3 >= histBinsCh3 ) {
+      return 0.0f;
+    }
+    return filter3d[ch1_scale*b1+ch2_scale*b2+b3];
+  }
 
   // Sets the secondary buffer to 0
   void flushSecondary();
@@ -90,6 +118,9 @@ public:
 
 private:
 
+  // Compact filters are built from the loaded histogram
+  friend class hfCompactFilter;
+
   // Buffer to hold color filter
   float *filter3d;
 
@@ -132,6 +163,64 @@ private:
   int size;
 };
 
+//------------------------------------------------------------------------------
+//                      Compact Filter Class Prototype
+//------------------------------------------------------------------------------
+
+// Copy of a hfFilter which classifies 8-bit BGR input directly. Each channel
+// value is mapped to its (pre-scaled) bin offset by a 256-entry table, built
+// with the same arithmetic as the float path so that pixels fall in the same
+// bins as their [0,1] scaled values. Values outside the histogram's range map
+// to an extra zero bin on each axis, so no range checks are needed. Histogram
+// values may be quantized to 8 or 16 bits to reduce the table size (a 64^3
+// histogram is 1MB as floats, 256KB as 8-bit values).
+class hfCompactFilter {
+public:
+  // Declares an empty filter
+  hfCompactFilter() { bits = 0; step = 1.0f; zero = 0; maxError = 0.0f; maxValue = 0.0f; }
+
+  // Builds the compact filter from a loaded filter, storing histogram
+  // values as 8 or 16-bit quantized values, or 32-bit floats. Returns
+  // false for other bit counts or if the filter isn't loaded.
+  bool build( hfFilter& filter, int valueBits );
+
+  // Bits per stored histogram value, 0 if not built
+  int valueBits() const { return bits; }
+
+  // Largest difference between a stored value and the float histogram
+  float quantizationError() const { return maxError; }
+
+  // Index into the stored values for a single 8-bit BGR pixel
+  int index( const unsigned char* pt ) const {
+    return lutCh1[pt[0]] + lutCh2[pt[1]] + lutCh3[pt[2]];
+  }
+
+  // Stored values, of type unsigned char, unsigned short or float depending
+  // on valueBits, which are converted back by (value - zero) * step
+  const void* values() const { return &storage[0]; }
+  float valueStep() const { return step; }
+  int valueZero() const { return zero; }
+
+private:
+
+  // Bin offsets for each 8-bit channel value
+  int lutCh1[256];
+  int lutCh2[256];
+  int lutCh3[256];
+
+  // Stored histogram values, including the zero bins
+  std::vector< unsigned char > storage;
+
+  // Bits per value, and quantization parameters
+  int bits;
+  float step;
+  int zero;
+
+  // Drift of the stored values from the float histogram
+  float maxError;
+  float maxValue;
+};
+
 //------------------------------------------------------------------------------
 //                      Saliency Filter Class Prototype
 //------------------------------------------------------------------------------
@@ -141,27 +230,46 @@ private:
 class salFilter {
 public:
   // Declares a new filter
-  salFilter() { isValid = false; size = 0; filter3d = NULL; }
+  salFilter() { isValid = false; size = 0; filter3d = NULL; smoothed = NULL; }
   ~salFilter();
 
   // Classifies an entire image
-  IplImage *classify3dImage( IplImage *img );
+  IplImage *classify3dImage( IplImage *img, ImageArena *arena = NULL );
+
+  // Classifies a single pixel, used by the above
+  float lookup( const float* pt ) const {
+    int b1 = (int)(pt[0] * histBinsCh1);
+    int b2 = (int)(pt[1] * histBinsCh2);
+    int b3 = (int)(pt[2] * histBinsCh3);
+
+    if( b1 < 0 || b1 >= histBinsCh1 ||
+      b2 < 0 || b2 >= histBinsCh2 ||
+      b3 < 0 || b3 >= histBinsCh3 ) {
+      return 0.0f;
+    }
+    return filter3d[ch1_scale*b1+ch2_scale*b2+b3];
+  }
 
   // Reset the histogram
   void flushFilter();
 
-  // Smooth the histogram
+  // Smooth the histogram, adding the six face neighbours of each bin to it
   void smoothHist();
 
-  // Builds the saliency map
+  // Builds the saliency map, from every stride'th pixel of every stride'th
+  // row (each weighted to give the same total as sampling every pixel)
   void allocMap( int binsPerDim );
-  void buildMap( IplImage *img );
+  void buildMap( IplImage *img, int stride = 1 );
 
 private:
 
   // Buffer to hold color filter
   float *filter3d;
 
+  // Buffer smoothHist writes into, swapped with the above afterwards so
+  // that nothing is allocated per frame
+  float *smoothed;
+
   // Is the map valid
   bool isValid;
 
@@ -188,7 +296,7 @@ class ColorClassifier {
 public:
 
   // Class Constructor
-  ColorClassifier() { filtersLoaded=false; }
+  ColorClassifier() { filtersLoaded=false; compactBits=0; saliencyStride=1; }
 
   // Class Destructr
   ~ColorClassifier() {}
@@ -199,17 +307,40 @@ public:
   // Returns true if valid filters have been loaded
   bool isValid() { return filtersLoaded; }
 
-  // Performs all required histogram-based filtering of image
-  hfResults *classifiyImage( IplImage *img );
+  // Classify 8-bit input using compact copies of each filter, with values
+  // stored using the given number of bits (8, 16 or 32), or 0 to use the
+  // float filters. Returns false for unsupported bit counts.
+  bool useCompactFilters( int bits );
+
+  // Prints the drift of the compact filters from the float filters, by
+  // classifying an 8-bit input image both ways and comparing the max and mean
+  // difference of each class map and of NetScallops
+  void reportCompactDrift( IplImage* img, bool isRGB, float minRad, float maxRad );
+
+  // Sample every stride'th pixel and row when building the saliency model
+  void setSaliencyStride( int stride ) { saliencyStride = max( stride, 1 ); }
 
-  // Calls classifyImage after resizing/smoothing image
-  hfResults *performColorClassification( IplImage* img, float minRad, float maxRad );
+  // Performs all required histogram-based filtering of image (32f, or 8u if
+  // compact filters are in use), output images are borrowed from the arena
+  // if one is given
+  hfResults *classifiyImage( IplImage *img, ImageArena *arena = NULL );
+
+  // Calls classifyImage after resizing/smoothing image. If compact filters
+  // are in use and an 8-bit copy of the image is given, it's classified
+  // instead of the 32f image (the saliency map always uses the 32f image).
+  hfResults *performColorClassification( IplImage* img, float minRad, float maxRad,
+    ImageArena *arena = NULL, IplImage* img8u = NULL );
 
   // Updates all of the filters after interest points have been classified
   void Update( IplImage *img, IplImage *mask, int Detections[] );
   
 private:
 
+  // Allocates results and classifies every pixel against all filters in a
+  // single pass over the image, also looking up the saliency map if it was
+  // built from this image
+  hfResults *classifyAllFilters( IplImage *img, ImageArena *arena, bool withSaliency );
+
   // Last classifier results for last image (managed externally)
   IplImage *img;
   hfResults *res;
@@ -217,6 +348,12 @@ private:
   // True if filters successfully loaded
   bool filtersLoaded;
 
+  // Bits per value of the compact filters, 0 if not in use
+  int compactBits;
+
+  // Sampling stride for building the saliency model
+  int saliencyStride;
+
   // Classifiers for each type
   hfFilter WhiteScallop;
   hfFilter BrownScallop;
@@ -224,6 +361,13 @@ private:
   hfFilter Environment;
   hfFilter SandDollars;
   salFilter SaliencyModel;
+
+  // Compact copies of the brown, white, sand dollar and environment filters
+  hfCompactFilter Compact[4];
+
+  // DoG levels for blob detection on results, reused for every image
+  DoGPyramid ColorBlobPyramid;
+  DoGPyramid SalientBlobPyramid;
 };
 
 //------------------------------------------------------------------------------
@@ -233,12 +377,10 @@ private:
 // Deallocates a results struct
 void hfDeallocResults( hfResults* res );
 
-// Detects blobs in our color-classification results
-void detectColoredBlobs( hfResults* color, CandidatePtrVector& cds );
-void detectSalientBlobs( hfResults* color, CandidatePtrVector& cds );
-
-// Quickly approximates the percentiles p1 and p2 in the single chan 32f image img
-void quickPercentiles( IplImage* img, float p1, float p2, float &op1, float& op2 );
+// Detects blobs in our color-classification results, using up to threads
+// threads to build and scan DoG levels
+void detectColoredBlobs( hfResults* color, CandidatePtrVector& cds, int threads = 1 );
+void detectSalientBlobs( hfResults* color, CandidatePtrVector& cds, int threads = 1 );
 
 }
 
@@ -5,6 +5,8 @@
 
 #include "TemplateApproximator.h"
 
+#include "ScallopTK/Utilities/SIMD.h"
+
 //------------------------------------------------------------------------------
 //                              Misc Definitions
 //------------------------------------------------------------------------------
@@ -25,6 +27,7 @@ const int END3 = START3 + INTERVALS_SCALE3;
 const int TOTAL_SCALES = END3 + 1;
 const float BASE_SIGMA = 1.2f;
 const int MAX_T4_IP = INT_MAX;
+const int T4_BINS = 20;
 
 // Structs
 struct t4cand {
@@ -51,10 +54,9 @@ struct SSInfo {
 //                            Function Prototypes
 //------------------------------------------------------------------------------
 
-IplImage *gaussDerivVerticle( IplImage *input, double sigma );
-IplImage *gaussDerivHorizontal( IplImage *input, double sigma );
 IplImage *createT4Scale( IplImage *dx, IplImage *dy, float radius, float offset );
-IplImage *createT4ScaleC( IplImage *dx, IplImage *dy, float radius, int offset );
+void createT4Scales( IplImage *dx, IplImage *dy, const float *radii, int offset, int count,
+      IplImage **output, ImageArena *arena = NULL, int threads = 1, bool benchmark = true );
 void detectT4Extremum( IplImage** ss, Candidates& cds, SSInfo& ssinfo );
 void interpolateIP( IplImage **ss, Candidates& cds, CandidatePtrVector& kps, float resize_factor,
       float minRad, float maxRad, int height, int width, ImageProperties& imgProp, SSInfo& ssinfo );
@@ -65,8 +67,7 @@ void interpolateIP( IplImage **ss, Candidates& cds, CandidatePtrVector& kps, flo
 
 #ifdef TEMPLATE_BENCHMARKING
   const string temp_bm_fn = "TemplateBMResults.dat";
-  vector<double> tp_exe_times;
-  ofstream tp_bm_output;
+  const string temp_radius_bm_fn = "TemplateRadiusBMResults.dat";
 #endif
 
 //------------------------------------------------------------------------------
@@ -80,26 +81,9 @@ void showChain( IplImage **ss ) {
   }
 }
 
-float quickMedianTemp( IplImage* img ) {
-  float *ptr = (float*) img->imageData;
-  int sze = img->width * img->height;
-  float *endptr = ptr + sze;
-  int skippage = 20;
-  if( sze / 1000 > 20 )
-    skippage = sze / 1000;
-  vector<float> val_list(sze/skippage+1,0.0f);
-  int counter = 0;
-  while( ptr < endptr ) {
-    val_list[counter] = *ptr;
-    counter++;
-    ptr = ptr + skippage;
-  }
-  sort( val_list.begin(), val_list.end() );
-  return val_list[0.5f*sze/skippage];
-}
-
 // Create tapprox hough ss
-IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float maxRad, SSInfo& ssinfo, IplImage *mask ) {
+IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float maxRad, SSInfo& ssinfo, IplImage *mask,
+  ImageArena *arena = NULL, int threads = 1 ) {
 
   // Initialize array
   int total_scales = INTERVALS_SCALE1 + INTERVALS_SCALE2 + INTERVALS_SCALE3 + 6;
@@ -132,27 +116,30 @@ IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float max
   CvSize newSize;
   newSize.height = dx->height + 2*maxRad;
   newSize.width = dx->width + 2*maxRad;
-  IplImage* dxBase = cvCreateImage( newSize, dx->depth, dx->nChannels );
-  IplImage* dyBase = cvCreateImage( newSize, dy->depth, dy->nChannels );
+  IplImage* dxBase = arenaCreateImage( arena, newSize, dx->depth, dx->nChannels );
+  IplImage* dyBase = arenaCreateImage( arena, newSize, dy->depth, dy->nChannels );
   CvPoint offset;
   offset.x = maxRad;
   offset.y = maxRad;
   CvScalar scala;
-  scala.val[0] = quickMedianTemp( dx );
+  scala.val[0] = QuantileHistogram( dx ).quantile( 0.5f );
   cvCopyMakeBorder( dx, dxBase, offset, IPL_BORDER_CONSTANT, scala );
   cvCopyMakeBorder( dy, dyBase, offset, IPL_BORDER_CONSTANT, scala );
   cvSmooth( dxBase, dxBase, 2, 3, 3 );
   cvSmooth( dyBase, dyBase, 2, 3, 3 );
 
   // Create SS#1
+  float radii[TOTAL_SCALES];
   float currad = s1 - intvl1;
   for( int i=START1-1; i<END1+1; i++ ) {
     ssinfo.RELATIVE_SCALE[i] = 1.0f;
     ssinfo.SCALE_OFFSET[i] = maxRad;
     ssinfo.SCALE_RADII[i] = currad;
-    ss[i] = createT4ScaleC( dxBase, dyBase, currad, maxRad );
+    radii[i] = currad;
     currad = currad + intvl1;
   }
+  createT4Scales( dxBase, dyBase, radii+START1-1, maxRad, END1-START1+2, ss+START1-1,
+    arena, threads );
 
   // Resize base to remaining 2 scales
   float resize_factor2 = 0.5f;
@@ -161,8 +148,8 @@ IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float max
   if( resize_factor2 < 1.0f ) {
     int nheight = resize_factor2 * dxBase->height;
     int nwidth = resize_factor2 * dxBase->width;
-    dxLvl2 = cvCreateImage( cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
-    dyLvl2 = cvCreateImage( cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
+    dxLvl2 = arenaCreateImage( arena, cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
+    dyLvl2 = arenaCreateImage( arena, cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
     int sf = (int)(1.0 / resize_factor2);
     if( sf > 1 ) {
       cvSmooth(dxBase,dxBase,CV_BLUR,1+sf,1+sf);
@@ -181,9 +168,11 @@ IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float max
     ssinfo.TOP_OFFSET[i] = maxRad;
     ssinfo.SCALE_OFFSET[i] = maxRad * resize_factor2;
     ssinfo.SCALE_RADII[i] = currad;
-    ss[i] = createT4ScaleC( dxLvl2, dyLvl2, currad*resize_factor2, ssinfo.SCALE_OFFSET[i] );
+    radii[i] = currad*resize_factor2;
     currad = currad + intvl2;
   }
+  createT4Scales( dxLvl2, dyLvl2, radii+START2-1, maxRad*resize_factor2, END2-START2+2,
+    ss+START2-1, arena, threads );
 
   // Resize base to remaining 2 scales
   float resize_factor3 = 0.5f;
@@ -192,8 +181,8 @@ IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float max
   if( resize_factor3 < 1.0f ) {
     int nheight = resize_factor3 * dxLvl2->height;
     int nwidth = resize_factor3 * dxLvl2->width;
-    dxLvl3 = cvCreateImage( cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
-    dyLvl3 = cvCreateImage( cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
+    dxLvl3 = arenaCreateImage( arena, cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
+    dyLvl3 = arenaCreateImage( arena, cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
     int sf = (int)(1.0 / resize_factor3);
     if( sf > 1 ) {
       cvSmooth(dxLvl2,dxLvl2,CV_BLUR,1+sf,1+sf);
@@ -212,20 +201,22 @@ IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float max
     ssinfo.RELATIVE_SCALE[i] = resize_factor2 * resize_factor3;
     ssinfo.TOP_OFFSET[i] = maxRad;
     ssinfo.SCALE_OFFSET[i] = maxRad / 4.0f;
-    ss[i] = createT4ScaleC( dxLvl3, dyLvl3, currad*resize_factor2*resize_factor3, maxRad / 4.0f );
+    radii[i] = currad*resize_factor2*resize_factor3;
     currad = currad + intvl3;
   }
+  createT4Scales( dxLvl3, dyLvl3, radii+START3-1, maxRad / 4.0f, END3-START3+2,
+    ss+START3-1, arena, threads );
 
   // Deallocations
-  cvReleaseImage( &dxBase );
-  cvReleaseImage( &dyBase );
+  arenaReleaseImage( arena, &dxBase );
+  arenaReleaseImage( arena, &dyBase );
   if( resize_factor2 < 1.0f ) {
-    cvReleaseImage( &dxLvl2 );
-    cvReleaseImage( &dyLvl2 );
+    arenaReleaseImage( arena, &dxLvl2 );
+    arenaReleaseImage( arena, &dyLvl2 );
   }
   if( resize_factor3 < 1.0f ) {
-    cvReleaseImage( &dxLvl3 );
-    cvReleaseImage( &dyLvl3 );
+    arenaReleaseImage( arena, &dxLvl3 );
+    arenaReleaseImage( arena, &dyLvl3 );
   }
 
   return ss;
@@ -241,10 +232,10 @@ IplImage **createScaleSpace( IplImage* dx, IplImage *dy, float minRad, float max
 }
 
 // Dealloc t4 ss
-void deallocateScaleSpace( IplImage** ss ) {
+void deallocateScaleSpace( IplImage** ss, ImageArena *arena = NULL ) {
   int total = INTERVALS_SCALE1 + INTERVALS_SCALE2 + INTERVALS_SCALE3 + 6;
   for( int j=0; j<total; j++ ) {
-    cvReleaseImage(&ss[j]);
+    arenaReleaseImage( arena, &ss[j] );
   }
   free(ss);
 }
@@ -303,80 +294,147 @@ inline float calcSimularityFactor( float *input, float& sum ) {
   return max;
 }
 
-// Option 1: don't use shifted temp buffers and use mag shifting
-IplImage *createT4ScaleC( IplImage *dx, IplImage *dy, float radius, int offset ) {
+// Ring sample positions for a template radius, the first and third quarters
+// of the ring are sampled from dy and the others from dx
+void calcT4Ring( float radius, int rpos[T4_BINS], int cpos[T4_BINS] ) {
+  for( int i = 0; i<T4_BINS; i++ ) {
+    float angle = 2*PI*i/T4_BINS - 0.7*PI;
+    rpos[i] = radius * sin( angle );
+    cpos[i] = radius * cos( angle );
+  }
+}
+
+// Sum the ring samples around each pixel of rows [begin,end) of a scale,
+// eight columns at a time when SSE is available. Samples are added in ring
+// order for every column, so all paths give identical sums.
+void sumT4Rows( IplImage *dx, IplImage *dy, const int rpos[T4_BINS], const int cpos[T4_BINS],
+  int offset, IplImage *scale, int begin, int end ) {
+
+  int first = offset+1;
+  int count = scale->width-offset-1 - first;
+
+  for( int r = begin; r < end; r++ ) {
+
+    const float *in[T4_BINS];
+    for( int j = 0; j < T4_BINS; j++ ) {
+      IplImage *src = ( ( j / 5 ) % 2 == 0 ? dy : dx );
+      in[j] = ((float*)(src->imageData + src->widthStep*(r+rpos[j]))) + first + cpos[j];
+    }
+    float *out = ((float*)(scale->imageData + scale->widthStep*r)) + first;
+
+    int c = 0;
+
+#if defined( SCALLOP_TK_USE_SSE ) && !defined( TEMPLATE_SIMILARITY_WEIGHTING )
+    for( ; c + 8 <= count; c += 8 ) {
+      __m128 lo = _mm_loadu_ps( in[0] + c );
+      __m128 hi = _mm_loadu_ps( in[0] + c + 4 );
+      for( int j = 1; j < T4_BINS; j++ ) {
+        lo = _mm_add_ps( lo, _mm_loadu_ps( in[j] + c ) );
+        hi = _mm_add_ps( hi, _mm_loadu_ps( in[j] + c + 4 ) );
+      }
+      _mm_storeu_ps( out + c, lo );
+      _mm_storeu_ps( out + c + 4, hi );
+    }
+#endif
+
+    for( ; c < count; c++ ) {
+      float sum = in[0][c];
+      for( int j = 1; j < T4_BINS; j++ )
+        sum = sum + in[j][c];
+
+#ifdef TEMPLATE_SIMILARITY_WEIGHTING
+      float magnitudes[T4_BINS];
+      for( int j = 0; j < T4_BINS; j++ )
+        magnitudes[j] = in[j][c];
+      sum = sum * calcSimularityFactor( magnitudes, sum );
+#endif
+
+      out[c] = sum;
+    }
+  }
+}
+
+// Sums rings for a band of rows of one scale, for each (scale, band) task
+class T4SumBody : public ParallelLoopBody
+{
+public:
+
+  T4SumBody( IplImage *_dx, IplImage *_dy, const float *_radii, int _offset,
+    IplImage **_output, int _bands )
+  : dx( _dx ), dy( _dy ), radii( _radii ), offset( _offset ),
+    output( _output ), bands( _bands ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int t = begin; t < end; t++ ) {
+      int i = t / bands;
+      int band = t % bands;
+
+      int rpos[T4_BINS], cpos[T4_BINS];
+      calcT4Ring( radii[i], rpos, cpos );
+
+      int first = offset+1;
+      int rows = output[i]->height-offset-1 - first;
+      int bandBegin = first + ( rows * band ) / bands;
+      int bandEnd = first + ( rows * ( band + 1 ) ) / bands;
+      sumT4Rows( dx, dy, rpos, cpos, offset, output[i], bandBegin, bandEnd );
+    }
+  }
+
+  IplImage *dx;
+  IplImage *dy;
+  const float *radii;
+  int offset;
+  IplImage **output;
+  int bands;
+};
+
+// Smooths each scale
+class T4SmoothBody : public ParallelLoopBody
+{
+public:
+
+  T4SmoothBody( IplImage **_output ) : output( _output ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int i = begin; i < end; i++ )
+      cvSmooth( output[i], output[i], 2, 9, 9 );
+  }
+
+  IplImage **output;
+};
+
+#ifdef TEMPLATE_BENCHMARKING
+
+// Previous single scale implementation, gathering the ring for each pixel
+IplImage *createT4ScaleReference( IplImage *dx, IplImage *dy, float radius, int offset,
+  ImageArena *arena ) {
 
   int bpfloat = (IPL_DEPTH_32F/8);
   int wstep = dx->widthStep / bpfloat;
-  const int BINS = 20;
-  int rpos[BINS];
-  int cpos[BINS];
-  int pos_offset[BINS];
-  float magnitudes[BINS];
+  int rpos[T4_BINS];
+  int cpos[T4_BINS];
+  int pos_offset[T4_BINS];
+  float magnitudes[T4_BINS];
 
-  for( int i = 0; i<BINS; i++ ) {
-    float angle = 2*PI*i/BINS - 0.7*PI;
-    rpos[i] = radius * sin( angle );
-    cpos[i] = radius * cos( angle );
+  calcT4Ring( radius, rpos, cpos );
+  for( int i = 0; i<T4_BINS; i++ )
     pos_offset[i] = rpos[i]*wstep + cpos[i];
-  }
 
-  IplImage *scale = cvCreateImage( cvGetSize( dx ), IPL_DEPTH_32F, 1 );
+  IplImage *scale = arenaCreateImage( arena, cvGetSize( dx ), IPL_DEPTH_32F, 1 );
   cvZero(scale);
-  int step = dx->widthStep;
   float *outptr = ((float*)(scale->imageData + scale->widthStep*(offset+1)))+(offset+1);
   float *dxin = ((float*)(dx->imageData + dx->widthStep*(offset+1)))+(offset+1);
   float *dyin = ((float*)(dy->imageData + dy->widthStep*(offset+1)))+(offset+1);
   int rstep = wstep-(scale->width-offset-1-(offset+1));
   for( int r=offset+1; r < scale->height-offset-1; r++ ) {
     for( int c=offset+1; c < scale->width-offset-1; c++ ) {
-      // Because who needs for loops anyways
-      /*magnitudes[0] = ((float*)(dy->imageData + step*(r+rpos[0])))[c+cpos[0]];
-      magnitudes[1] = ((float*)(dy->imageData + step*(r+rpos[1])))[c+cpos[1]];
-      magnitudes[2] = ((float*)(dy->imageData + step*(r+rpos[2])))[c+cpos[2]];
-      magnitudes[3] = ((float*)(dy->imageData + step*(r+rpos[3])))[c+cpos[3]];
-      magnitudes[4] = ((float*)(dy->imageData + step*(r+rpos[4])))[c+cpos[4]];
-      magnitudes[5] = ((float*)(dx->imageData + step*(r+rpos[5])))[c+cpos[5]];
-      magnitudes[6] = ((float*)(dx->imageData + step*(r+rpos[6])))[c+cpos[6]];
-      magnitudes[7] = ((float*)(dx->imageData + step*(r+rpos[7])))[c+cpos[7]];
-      magnitudes[8] = ((float*)(dx->imageData + step*(r+rpos[8])))[c+cpos[8]];
-      magnitudes[9] = ((float*)(dx->imageData + step*(r+rpos[9])))[c+cpos[9]];
-      magnitudes[10] = ((float*)(dy->imageData + step*(r+rpos[10])))[c+cpos[10]];
-      magnitudes[11] = ((float*)(dy->imageData + step*(r+rpos[11])))[c+cpos[11]];
-      magnitudes[12] = ((float*)(dy->imageData + step*(r+rpos[12])))[c+cpos[12]];
-      magnitudes[13] = ((float*)(dy->imageData + step*(r+rpos[13])))[c+cpos[13]];
-      magnitudes[14] = ((float*)(dy->imageData + step*(r+rpos[14])))[c+cpos[14]];
-      magnitudes[15] = ((float*)(dx->imageData + step*(r+rpos[15])))[c+cpos[15]];
-      magnitudes[16] = ((float*)(dx->imageData + step*(r+rpos[16])))[c+cpos[16]];
-      magnitudes[17] = ((float*)(dx->imageData + step*(r+rpos[17])))[c+cpos[17]];
-      magnitudes[18] = ((float*)(dx->imageData + step*(r+rpos[18])))[c+cpos[18]];
-      magnitudes[19] = ((float*)(dx->imageData + step*(r+rpos[19])))[c+cpos[19]];*/
-      magnitudes[0] = *(dyin+pos_offset[0]);
-      magnitudes[1] = *(dyin+pos_offset[1]);
-      magnitudes[2] = *(dyin+pos_offset[2]);
-      magnitudes[3] = *(dyin+pos_offset[3]);
-      magnitudes[4] = *(dyin+pos_offset[4]);
-      magnitudes[5] = *(dxin+pos_offset[5]);
-      magnitudes[6] = *(dxin+pos_offset[6]);
-      magnitudes[7] = *(dxin+pos_offset[7]);
-      magnitudes[8] = *(dxin+pos_offset[8]);
-      magnitudes[9] = *(dxin+pos_offset[9]);
-      magnitudes[10] = *(dyin+pos_offset[10]);
-      magnitudes[11] = *(dyin+pos_offset[11]);
-      magnitudes[12] = *(dyin+pos_offset[12]);
-      magnitudes[13] = *(dyin+pos_offset[13]);
-      magnitudes[14] = *(dyin+pos_offset[14]);
-      magnitudes[15] = *(dxin+pos_offset[15]);
-      magnitudes[16] = *(dxin+pos_offset[16]);
-      magnitudes[17] = *(dxin+pos_offset[17]);
-      magnitudes[18] = *(dxin+pos_offset[18]);
-      magnitudes[19] = *(dxin+pos_offset[19]);
+      for( int j=0; j<T4_BINS; j++ )
+        magnitudes[j] = *(( ( j / 5 ) % 2 == 0 ? dyin : dxin )+pos_offset[j]);
 
       // Calculate sum
-      float sum = magnitudes[0] + magnitudes[1] + magnitudes[2] + magnitudes[3] + magnitudes[4] +
-        magnitudes[5] + magnitudes[6] + magnitudes[7] + magnitudes[8] + magnitudes[9] +
-        magnitudes[10] + magnitudes[11] + magnitudes[12] + magnitudes[13] + magnitudes[14] +
-        magnitudes[15] + magnitudes[16] + magnitudes[17] + magnitudes[18] + magnitudes[19];
+      float sum = magnitudes[0];
+      for( int j=1; j<T4_BINS; j++ )
+        sum = sum + magnitudes[j];
 
       // Calculate simularity scaling factor
       float sim = calcSimularityFactor( magnitudes, sum );
@@ -392,10 +450,59 @@ IplImage *createT4ScaleC( IplImage *dx, IplImage *dy, float radius, int offset )
     dxin+=rstep;
   }
   cvSmooth(scale, scale, 2, 9, 9 );
-  //showImageRange(scale);
   return scale;
 }
 
+// Appends the radius, the time taken by the reference and current
+// implementations to build its scale, and the largest difference between
+// them to the per-radius results file
+void benchmarkT4Scale( IplImage *dx, IplImage *dy, float radius, int offset,
+  ImageArena *arena, int threads ) {
+
+  ofstream radius_bm_output( temp_radius_bm_fn.c_str(), fstream::out | fstream::app );
+  BenchmarkTimer radius_timer;
+
+  IplImage *reference = createT4ScaleReference( dx, dy, radius, offset, arena );
+  double referenceTime = radius_timer.getTimeSinceLastCall();
+
+  IplImage *current = NULL;
+  createT4Scales( dx, dy, &radius, offset, 1, &current, arena, threads, false );
+  double currentTime = radius_timer.getTimeSinceLastCall();
+
+  radius_bm_output << radius << " " << referenceTime << " " << currentTime << " ";
+  radius_bm_output << cvNorm( reference, current, CV_C ) << endl;
+  radius_bm_output.close();
+
+  arenaReleaseImage( arena, &reference );
+  arenaReleaseImage( arena, &current );
+}
+
+#endif
+
+// Create the template scales for count radii on a single level, with rows
+// and scales spread across up to threads threads
+void createT4Scales( IplImage *dx, IplImage *dy, const float *radii, int offset, int count,
+  IplImage **output, ImageArena *arena, int threads, bool benchmark ) {
+
+#ifdef TEMPLATE_BENCHMARKING
+  if( benchmark ) {
+    for( int i = 0; i < count; i++ ) {
+      benchmarkT4Scale( dx, dy, radii[i], offset, arena, threads );
+    }
+  }
+#endif
+
+  for( int i = 0; i < count; i++ ) {
+    output[i] = arenaCreateImage( arena, cvGetSize( dx ), IPL_DEPTH_32F, 1 );
+    cvZero( output[i] );
+  }
+
+  // Enough bands for every thread to have work even with few scales
+  int bands = std::max( ( threads + count - 1 ) / count, 1 );
+  parallelFor( count * bands, T4SumBody( dx, dy, radii, offset, output, bands ), threads );
+  parallelFor( count, T4SmoothBody( output ), threads );
+}
+
 //Is this position higher than its 26 surrounding bins?
 int isT4Extremum( IplImage** imgChain, int intvl, int r, int c )
 {
@@ -630,7 +737,7 @@ void interpolateIP( IplImage **ss, Candidates& cds, CandidatePtrVector& kps, flo
 
 //Find Double-Donut Candidate
 void findTemplateCandidates( GradientChain& grad, CandidatePtrVector& kps,
-  ImageProperties& imgProp, IplImage* mask ) {
+  ImageProperties& imgProp, IplImage* mask, int threads ) {
 
   // Normalize image scale
   float resize_factor = MPFMR_TEMPLATE / grad.minRad;
@@ -639,8 +746,8 @@ void findTemplateCandidates( GradientChain& grad, CandidatePtrVector& kps,
   if( resize_factor < RESIZE_FACTOR_REQUIRED ) {
     int nheight = resize_factor * grad.dx->height;
     int nwidth = resize_factor * grad.dx->width;
-    dx = cvCreateImage( cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
-    dy = cvCreateImage( cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
+    dx = arenaCreateImage( grad.arena, cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
+    dy = arenaCreateImage( grad.arena, cvSize(nwidth, nheight), IPL_DEPTH_32F, 1 );
     cvResize( grad.dx, dx );
     cvResize( grad.dy, dy );
   } else {
@@ -650,18 +757,17 @@ void findTemplateCandidates( GradientChain& grad, CandidatePtrVector& kps,
   float maxRad = grad.maxRad * resize_factor;
 
 #ifdef TEMPLATE_BENCHMARKING
-  tp_bm_output.open( temp_bm_fn.c_str(), fstream::out | fstream::app );
-  tp_exe_times.clear();
-  initializeTimer();
-  startTimer();
+  vector<double> tp_exe_times;
+  ofstream tp_bm_output( temp_bm_fn.c_str(), fstream::out | fstream::app );
+  BenchmarkTimer tp_timer;
 #endif
   
   // Create Scale Space
   SSInfo scaleSpaceInfo;
-  IplImage **ss = createScaleSpace( dx, dy, minRad, maxRad, scaleSpaceInfo, mask );
+  IplImage **ss = createScaleSpace( dx, dy, minRad, maxRad, scaleSpaceInfo, mask, grad.arena, threads );
 
 #ifdef TEMPLATE_BENCHMARKING
-  tp_exe_times.push_back( getTimeSinceLastCall() );  
+  tp_exe_times.push_back( tp_timer.getTimeSinceLastCall() );  
 #endif
 
   // Identify extrema in scale space (ordered by magnitude)
@@ -669,7 +775,7 @@ void findTemplateCandidates( GradientChain& grad, CandidatePtrVector& kps,
   detectT4Extremum( ss, cds, scaleSpaceInfo );
 
 #ifdef TEMPLATE_BENCHMARKING
-  tp_exe_times.push_back( getTimeSinceLastCall() );  
+  tp_exe_times.push_back( tp_timer.getTimeSinceLastCall() );  
 #endif
 
   // Interpolate and adjust Candidates
@@ -677,14 +783,14 @@ void findTemplateCandidates( GradientChain& grad, CandidatePtrVector& kps,
     grad.dx->height/grad.scale, grad.dx->width/grad.scale, imgProp, scaleSpaceInfo );
 
 #ifdef TEMPLATE_BENCHMARKING
-  tp_exe_times.push_back( getTimeSinceLastCall() );  
+  tp_exe_times.push_back( tp_timer.getTimeSinceLastCall() );  
 #endif
 
   // Deallocate memory
-  deallocateScaleSpace( ss );
+  deallocateScaleSpace( ss, grad.arena );
   if( resize_factor < RESIZE_FACTOR_REQUIRED ) {
-    cvReleaseImage(&dx);
-    cvReleaseImage(&dy);
+    arenaReleaseImage( grad.arena, &dx );
+    arenaReleaseImage( grad.arena, &dy );
   }
 
 #ifdef TEMPLATE_BENCHMARKING
@@ -28,6 +28,8 @@
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/Quantiles.h"
+#include "ScallopTK/Utilities/Threads.h"
 #include "ScallopTK/ScaleDetection/ImageProperties.h"
 #include "ScallopTK/EdgeDetection/GaussianEdges.h"
 
@@ -43,8 +45,11 @@
 namespace ScallopTK
 {
 
+// Template scales are built with up to threads threads. Defining
+// TEMPLATE_SIMILARITY_WEIGHTING scales each ring sum by its ratio to the
+// largest sample, which is otherwise skipped.
 void findTemplateCandidates( GradientChain& grad, CandidatePtrVector& cds,
-  ImageProperties& imgProp, IplImage* mask = NULL );
+  ImageProperties& imgProp, IplImage* mask = NULL, int threads = 1 );
 
 }
 
@@ -10,6 +10,9 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
 #include <fstream>
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,7 +27,13 @@
 #include "ScallopTK/Utilities/ConfigParsing.h"
 #include "ScallopTK/Utilities/Display.h"
 #include "ScallopTK/Utilities/Benchmarking.h"
+#include "ScallopTK/Utilities/CandidatePool.h"
+#include "ScallopTK/Utilities/ColorConversion.h"
 #include "ScallopTK/Utilities/Threads.h"
+#include "ScallopTK/Utilities/ImageArena.h"
+#include "ScallopTK/Utilities/ImagePrefetcher.h"
+#include "ScallopTK/Utilities/ImageDecoding.h"
+#include "ScallopTK/ScaleDetection/MetadataIndex.h"
 #include "ScallopTK/Utilities/Filesystem.h"
 
 #include "ScallopTK/ScaleDetection/ImageProperties.h"
@@ -48,18 +57,14 @@
 
 #include "ScallopTK/Classifiers/TrainingUtils.h"
 #include "ScallopTK/Classifiers/Classifier.h"
+#include "ScallopTK/Classifiers/DetectionWriter.h"
 
 namespace ScallopTK
 {
 
-// Number of worker threads
-int THREADS;
-
-// Variables for benchmarking tests
+// Output file for benchmarking tests
 #ifdef ENABLE_BENCHMARKING
   const string BenchmarkingFilename = "BenchmarkingResults.dat";
-  vector<double> executionTimes;
-  ofstream benchmarkingOutput;
 #endif
 
 // Struct to hold inputs to the single image algorithm (1 per thread is created)
@@ -71,15 +76,26 @@ struct AlgorithmArgs {
   // Input image
   cv::Mat InputImage;
 
+  // Full resolution of the input image file, if InputImage was decoded at a
+  // reduced scale, else empty
+  cv::Size InputFullSize;
+
+  // Metadata parsed from the input image file when it was read, if any
+  ImageMetadata InputMetadata;
+
+  // Input image is one view of a stereo pair given as separate images,
+  // rather than a side-by-side pair
+  bool IsStereoView;
+
+  // Input image channel order is RGB, instead of BGR as loaded from file
+  bool InputIsRGB;
+
   // Input filename for input image, full path, if available
   string InputFilename;
 
   // Input filename for image, without directory
   string InputFilenameNoDir;
 
-  // Output filename for Scallop List or Extracted Training Data
-  string ListFilename;
-
   // Output filename for image result if enabled
   string OutputFilename;
 
@@ -91,7 +107,6 @@ struct AlgorithmArgs {
 
   // Output options
   bool EnableOutputDisplay;
-  bool EnableListOutput;
   bool OutputDuplicateClass;
   bool OutputProposalImages;
   bool OutputDetectionImages;
@@ -112,12 +127,29 @@ struct AlgorithmArgs {
   // Container for color filters
   ColorClassifier *CC;
 
+  // Split frames into overlapping tiles of this size if larger, 0 disables
+  int TileSize;
+
+  // Print the drift of the compact colour filters on the next frame
+  bool ReportCompactDrift;
+
+  // Additional color filters, one per extra tile processed at once (color
+  // filters hold per-image state, so can't be shared between tiles)
+  vector< ColorClassifier* > TileCC;
+
+  // Pool of intermediate images reused across frames, NULL if disabled
+  ImageArena *Arena;
+
   // Container for external statistics collected so far (densities, etc)
   ThreadStatistics *Stats;
 
   // Container for loaded classifier system to use on this image
   Classifier *Model;
 
+  // Lock to hold while classifying if the above model is shared between
+  // threads and is not thread safe, NULL if not required
+  ThreadMutex *ModelLock;
+
   // Did we last see a scallop or sand dollar cluster?
   bool ScallopMode;
 
@@ -133,129 +165,273 @@ struct AlgorithmArgs {
   // Process border interest points
   bool ProcessBorderPoints;
 
+  // Run the object proposal detectors for this image in parallel
+  bool ParallelProposals;
+
+  // Number of threads to use for per-candidate feature extraction
+  int FeatureThreads;
+
+  // Number of percentile levels adaptive filtering thresholds at per side,
+  // in addition to 0.0
+  int AdaptiveThresholdLevels;
+
   // Pointer to GT input data if in training mode
   GTEntryList *GTData;
 
+  // Output files for GUI training mode, if enabled
+  TrainingSession *Training;
+
   // Output final detections
   DetectionVector FinalDetections;
 
+#ifdef ENABLE_BENCHMARKING
+  // Per-stage timings for the last processed image
+  vector<double> ExecutionTimes;
+#endif
+
   AlgorithmArgs()
-  : Model( NULL ),
-    GTData( NULL )
+  : IsStereoView( false ),
+    InputIsRGB( false ),
+    TileSize( 0 ),
+    ReportCompactDrift( false ),
+    Arena( NULL ),
+    Model( NULL ),
+    ModelLock( NULL ),
+    ParallelProposals( false ),
+    FeatureThreads( 1 ),
+    AdaptiveThresholdLevels( 0 ),
+    GTData( NULL ),
+    Training( NULL )
   {}
 };
 
-// Our Core Detection Algorithm - performs classification for a single image
-//   inputs - shown above
-//   outputs - returns NULL
-void *processImage( void *InputArgs ) {
+// The individual object proposal methods run on each image
+enum ProposalMethod
+{
+  PROPOSAL_COLOR_BLOB = 0,
+  PROPOSAL_ADAPTIVE_FILT,
+  PROPOSAL_TEMPLATE_APRX,
+  PROPOSAL_CANNY_EDGE,
+  PROPOSAL_METHOD_COUNT
+};
 
-//--------------------Get Pointers to Main Inputs---------------------
+// Inputs and outputs for a single object proposal method
+struct ProposalTask {
 
-  // Read input arguments (pthread requires void* as argument type)
-  AlgorithmArgs *Options = (AlgorithmArgs*) InputArgs;
-  ColorClassifier *CC = Options->CC;
-  ThreadStatistics *Stats = Options->Stats;
+  ProposalMethod Method;
+
+  // Shared read-only inputs
+  hfResults *Color;
+  GradientChain *Gradients;
+  ImageProperties *Properties;
+  IplImage *Mask;
+  float MinRadPixels;
+  float MaxRadPixels;
+  int Threads;
+  int AdaptiveLevels;
+
+  // Filtered candidates output by this method
+  CandidatePtrVector Output;
+};
+
+// Run a single object proposal method, followed by candidate filtering
+void runProposalTask( ProposalTask *Task ) {
+
+  switch( Task->Method )
+  {
+    case PROPOSAL_COLOR_BLOB:
+      // Perform Difference of Gaussian blob detection on our color classifications
+      detectSalientBlobs( Task->Color, Task->Output, Task->Threads ); //<-- Better for small # of images
+      break;
+
+    case PROPOSAL_ADAPTIVE_FILT:
+      // Perform Adaptive Filtering
+      performAdaptiveFiltering( Task->Color, Task->Output, Task->MinRadPixels, false,
+        Task->AdaptiveLevels );
+      break;
+
+    case PROPOSAL_TEMPLATE_APRX:
+      // Template Approx Candidate Detection
+      findTemplateCandidates( *Task->Gradients, Task->Output, *Task->Properties, Task->Mask,
+        Task->Threads );
+      break;
+
+    case PROPOSAL_CANNY_EDGE:
+      // Stable Canny Edge Candidates
+      findCannyCandidates( *Task->Gradients, Task->Output );
+      break;
+
+    default:
+      break;
+  }
+
+  filterCandidates( Task->Output, Task->MinRadPixels, Task->MaxRadPixels, true );
+}
+
+// Runs a range of proposal tasks, so they can be shared over threads
+class ProposalTasksBody : public ParallelLoopBody
+{
+public:
+  ProposalTasksBody( ProposalTask *t ) : tasks( t ) {}
+
+  void operator()( int begin, int end ) const {
+    for( int i=begin; i<end; i++ ) {
+      runProposalTask( &tasks[i] );
+    }
+  }
+
+private:
+  ProposalTask *tasks;
+};
+
+// Candidates detected within a single region of a frame, which is either the
+// full frame or one tile of it
+struct RegionResults {
+
+  // All candidates detected in the region, owned by this struct
+  CandidatePtrVector Candidates;
+
+  // Subset of the above with positive classifications
+  CandidatePtrVector Positives;
+
+  // Features of the above candidates, referenced by each candidate
+  FeatureMatrix Features;
+
+  // Float RGB copy of the region, only retained for full frames
+  IplImage *ImageRGB32f;
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.clear();
-  startTimer();
+  // Per-stage timings for the region
+  vector<double> ExecutionTimes;
 #endif
 
-  // Declare input image in assorted formats for later operations
-  cv::Mat inputImgMat = Options->InputImage;
+  RegionResults() : ImageRGB32f( NULL ) {}
+};
 
-  if( inputImgMat.cols == 0 || inputImgMat.rows == 0 )
+// A single tile of a frame processed in tiled mode
+struct FrameTile {
+
+  // Extent of the tile within the frame
+  cv::Rect Region;
+
+  // Area of the tile, in tile coordinates, which candidate centers must lie
+  // within to be kept. The kept areas of adjacent tiles meet halfway across
+  // their overlap.
+  cv::Rect Keep;
+};
+
+// Split [0,length) into spans no longer than size, overlapping by at least
+// overlap, and the range of positions owned by each span
+void splitTileAxis( int length, int size, int overlap, int border,
+  vector<int>& starts, vector<int>& sizes, vector<int>& keepBegins,
+  vector<int>& keepEnds )
+{
+  int count = 1;
+
+  if( length > size )
   {
-    throw std::runtime_error( "Invalid input image" );
+    int step = size - overlap;
+    count = 1 + ( length - size + step - 1 ) / step;
   }
 
-  if( Options->ProcessLeftHalfOnly )
+  for( int i = 0; i < count; i++ )
   {
-    inputImgMat = inputImgMat(
-      cv::Rect( 0, 0, inputImgMat.cols/2, inputImgMat.rows ) );
+    // Spread spans evenly so that the last ends at the frame edge
+    starts.push_back( count > 1 ? ( i * ( length - size ) ) / ( count - 1 ) : 0 );
+    sizes.push_back( std::min( size, length ) );
   }
 
-//----------------------Calculate Object Size-------------------------
+  for( int i = 0; i < count; i++ )
+  {
+    int begin = ( i == 0 ? border :
+      ( starts[i-1] + sizes[i-1] + starts[i] ) / 2 );
+    int end = ( i == count - 1 ? length - border :
+      ( starts[i] + sizes[i] + starts[i+1] ) / 2 );
 
-  // Declare Image Properties reader (for metadata read, size calc, etc)
-  ImageProperties inputProp;
+    keepBegins.push_back( begin - starts[i] );
+    keepEnds.push_back( end - starts[i] );
+  }
+}
 
-  if( Options->UseMetadata )
+// Split a frame into overlapping tiles no larger than tileSize
+void computeFrameTiles( int width, int height, int tileSize, int overlap,
+  bool processBorder, vector< FrameTile >& tiles )
+{
+  tiles.clear();
+
+  // Tiles must be large enough for their kept areas to be non-empty
+  tileSize = std::max( tileSize, 2 * overlap );
+
+  // Matches the border used by removeBorderCandidates
+  int border = ( processBorder ? 0 : 10 );
+
+  vector<int> rowStarts, rowSizes, rowBegins, rowEnds;
+  vector<int> colStarts, colSizes, colBegins, colEnds;
+
+  splitTileAxis( height, tileSize, overlap, border,
+    rowStarts, rowSizes, rowBegins, rowEnds );
+  splitTileAxis( width, tileSize, overlap, border,
+    colStarts, colSizes, colBegins, colEnds );
+
+  for( unsigned r = 0; r < rowStarts.size(); r++ )
   {
-    // Automatically loads metadata from input file if necessary
-    if( !Options->MetadataProvided )
+    for( unsigned c = 0; c < colStarts.size(); c++ )
     {
-      inputProp.calculateImageProperties( Options->InputFilename, inputImgMat.cols,
-        inputImgMat.rows, Options->FocalLength );
+      FrameTile tile;
+      tile.Region = cv::Rect( colStarts[c], rowStarts[r], colSizes[c], rowSizes[r] );
+      tile.Keep = cv::Rect( colBegins[c], rowBegins[r],
+        colEnds[c] - colBegins[c], rowEnds[r] - rowBegins[r] );
+      tiles.push_back( tile );
     }
-    else
+  }
+}
+
+// Deallocate candidates whose centers lie outside of the given area
+void removeCandidatesOutside( CandidatePtrVector& cds, const cv::Rect& keep )
+{
+  CandidatePtrVector kept;
+
+  for( unsigned i = 0; i < cds.size(); i++ )
+  {
+    if( cds[i]->r >= keep.y && cds[i]->r < keep.y + keep.height &&
+        cds[i]->c >= keep.x && cds[i]->c < keep.x + keep.width )
     {
-      inputProp.calculateImageProperties( inputImgMat.cols, inputImgMat.rows,
-         Options->Altitude, Options->Pitch, Options->Roll, Options->FocalLength );
+      kept.push_back( cds[i] );
     }
-
-    if( !inputProp.hasMetadata() )
+    else
     {
-      cerr << "ERROR: Failure to read image metadata for file ";
-      cerr << Options->InputFilenameNoDir << endl;
-      threadExit();
-      return NULL;
+      deallocateCandidate( cds[i] );
     }
   }
-  else
-  {
-    inputProp.calculateImageProperties( inputImgMat.cols, inputImgMat.rows);
-  }
 
-  // Get the min and max Scallop size from combined image properties and input parameters
-  float minRadPixels = ( Options->UseMetadata ? Options->MinSearchRadiusMeters
-    : Options->MinSearchRadiusPixels ) / inputProp.getAvgPixelSizeMeters();
-  float maxRadPixels = ( Options->UseMetadata ? Options->MaxSearchRadiusMeters
-    : Options->MaxSearchRadiusPixels ) / inputProp.getAvgPixelSizeMeters();
+  cds.swap( kept );
+}
 
-  // Threshold size scanning range
-  if( maxRadPixels < 1.0 )
-  {
-    cerr << "WARN: Scallop scanning size range is less than 1 pixel for image ";
-    cerr << Options->InputFilenameNoDir << ", skipping." << endl;
-    threadExit();
-    return NULL;
-  }
+// Detect and classify candidates within a single region of a frame
+//   inputs - algorithm options, the region's image (8-bit), its properties,
+//            and if processing in tiles, the tile being processed
+//   outputs - detected candidates in frame coordinates
+void processRegion( AlgorithmArgs *Options, ColorClassifier *CC,
+  IplImage *inputImg, ImageProperties& inputProp, float minRadPixels,
+  float maxRadPixels, float resizeFactor, const FrameTile *tile,
+  int featureThreads, RegionResults& output ) {
+
+  ThreadStatistics *Stats = Options->Stats;
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
+  vector<double>& executionTimes = output.ExecutionTimes;
+  executionTimes.clear();
+  BenchmarkTimer timer;
 #endif
 
-//-------------------------Format Base Images--------------------------
-
-  // Resize image to maximum size required for all operations
-  //  Stats->getMaxMinRequiredRad returns the maximum required image size
-  //  in terms of how many pixels the min scallop radius should be. We only
-  //  resize the image if this results in a downscale.
-  float resizeFactor = MAX_PIXELS_FOR_MIN_RAD / minRadPixels;
-
-  if( resizeFactor < RESIZE_FACTOR_REQUIRED ) {
-    cv::Mat resizedImgMat;
-
-    cv::resize( inputImgMat, resizedImgMat,
-      cv::Size( (int)( resizeFactor*inputImgMat.cols ),
-                (int)( resizeFactor*inputImgMat.rows ) ) );
-
-    inputImgMat = resizedImgMat;
-    minRadPixels = minRadPixels * resizeFactor;
-    maxRadPixels = maxRadPixels * resizeFactor;
-
-  } else {
-    resizeFactor = 1.0f;
-  }
-
-  // The remaining code uses legacy OpenCV API (IplImage)
-  IplImage inputImgIplWrapper = inputImgMat;
-  IplImage *inputImg = &inputImgIplWrapper;
+  // Images borrowed below are returned when this function exits, including
+  // if it throws
+  ImageArena *arena = Options->Arena;
+  ArenaImageGuard borrowed( arena );
 
   // Create processed mask - records which pixels belong to what
-  IplImage *mask = cvCreateImage( cvGetSize( inputImg ), IPL_DEPTH_8U, 1 );
+  IplImage *mask = arenaCreateImage( arena, cvGetSize( inputImg ), IPL_DEPTH_8U, 1 );
+  borrowed.add( &mask );
   cvSet( mask, cvScalar( 255 ) );
 
   // Records how many detections of each classification category we have
@@ -266,103 +442,112 @@ void *processImage( void *InputArgs ) {
     detections[i] = 0;
   }
 
-#ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
-#endif
-
   // Convert input image to other formats required for later operations
   //  - 32f = Std Floating Point, Range [0,1]
   //  - 8u = unsigned bytes, Range [0,255]
   //  - lab = CIELab color space
   //  - gs = Grayscale
   //  - rgb = sRGB (although beware OpenCV may load this as BGR in mem)
-  IplImage *imgRGB32f = cvCreateImage( cvGetSize(inputImg), IPL_DEPTH_32F, inputImg->nChannels );
-  IplImage *imgLab32f = cvCreateImage( cvGetSize(inputImg), IPL_DEPTH_32F, inputImg->nChannels );
-  IplImage *imgGrey32f = cvCreateImage( cvGetSize(inputImg), IPL_DEPTH_32F, 1 );
-  IplImage *imgGrey8u = cvCreateImage( cvGetSize(inputImg), IPL_DEPTH_8U, 1 );
-  IplImage *imgRGB8u = cvCreateImage( cvGetSize(inputImg), IPL_DEPTH_8U, 3 );
-
-  float scalingFactor = 1 / ( pow( 2.0f, inputImg->depth ) - 1 );
-  cvConvertScale( inputImg, imgRGB32f, scalingFactor );
-  cvCvtColor( imgRGB32f, imgLab32f, CV_RGB2Lab );
-  cvCvtColor( imgRGB32f, imgGrey32f, CV_RGB2GRAY );
-  cvScale( imgGrey32f, imgGrey8u, 255. );
-  cvScale( imgRGB32f, imgRGB8u, 255. );
+  IplImage *imgRGB32f = arenaCreateImage( arena, cvGetSize(inputImg), IPL_DEPTH_32F, inputImg->nChannels );
+  IplImage *imgLab32f = arenaCreateImage( arena, cvGetSize(inputImg), IPL_DEPTH_32F, inputImg->nChannels );
+  IplImage *imgGrey32f = arenaCreateImage( arena, cvGetSize(inputImg), IPL_DEPTH_32F, 1 );
+  IplImage *imgGrey8u = arenaCreateImage( arena, cvGetSize(inputImg), IPL_DEPTH_8U, 1 );
+  IplImage *imgRGB8u = arenaCreateImage( arena, cvGetSize(inputImg), IPL_DEPTH_8U, 3 );
+  borrowed.add( &imgRGB32f );
+  borrowed.add( &imgLab32f );
+  borrowed.add( &imgGrey32f );
+  borrowed.add( &imgGrey8u );
+  borrowed.add( &imgRGB8u );
+
+  // All of the above are required by the gradient chain and classifiers
+  convertBaseImages( inputImg, Options->InputIsRGB, BASE_ALL, imgRGB32f,
+    imgLab32f, imgGrey32f, imgGrey8u, imgRGB8u, featureThreads );
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
+  executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
   // Perform color classifications on base image
   //   Puts results in hfResults struct
   //   Contains classification results for different organisms, and sal maps
   hfResults *color = CC->performColorClassification( imgRGB32f,
-    minRadPixels, maxRadPixels );
+    minRadPixels, maxRadPixels, arena, imgRGB8u );
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
+  executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
   // Calculate all required image gradients for later operations
   GradientChain gradients = createGradientChain( imgLab32f, imgGrey32f,
-    imgGrey8u, imgRGB8u, color, minRadPixels, maxRadPixels );
+    imgGrey8u, imgRGB8u, color, minRadPixels, maxRadPixels, arena );
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
+  executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
 //-----------------------Detect ROIs-----------------------------
 
-  // Containers for initial interest points
-  CandidatePtrVector cdsColorBlob;
-  CandidatePtrVector cdsAdaptiveFilt;
-  CandidatePtrVector cdsTemplateAprx;
-  CandidatePtrVector cdsCannyEdge;
+  // Proposal methods only read from the color and gradient results, and
+  // each writes to its own container, so they may be run concurrently.
+  // When they are, each gets an even share of the thread budget for its own
+  // parallel loops, so the total stays near featureThreads.
+  ProposalTask proposals[PROPOSAL_METHOD_COUNT];
+
+  int proposalThreads = featureThreads;
 
-  // Perform Difference of Gaussian blob detection on our color classifications
-  if( 1 || Stats->processed < 5 || !Options->Model->detectsScallops() )
+  if( Options->ParallelProposals && THREADING_ENABLED )
   {
-    detectSalientBlobs( color, cdsColorBlob ); //<-- Better for small # of images
+    proposalThreads = std::max( featureThreads / PROPOSAL_METHOD_COUNT, 1 );
   }
-  else
+
+  for( int i=0; i<PROPOSAL_METHOD_COUNT; i++ )
   {
-    detectColoredBlobs( color, cdsColorBlob ); //<-- Better for large # of images
+    proposals[i].Method = (ProposalMethod)i;
+    proposals[i].Color = color;
+    proposals[i].Gradients = &gradients;
+    proposals[i].Properties = &inputProp;
+    proposals[i].Mask = mask;
+    proposals[i].MinRadPixels = minRadPixels;
+    proposals[i].MaxRadPixels = maxRadPixels;
+    proposals[i].Threads = proposalThreads;
+    proposals[i].AdaptiveLevels = Options->AdaptiveThresholdLevels;
   }
 
-  filterCandidates( cdsColorBlob, minRadPixels, maxRadPixels, true );
-
-#ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
-#endif
-
-  // Perform Adaptive Filtering
-  performAdaptiveFiltering( color, cdsAdaptiveFilt, minRadPixels, false );
-  filterCandidates( cdsAdaptiveFilt, minRadPixels, maxRadPixels, true );
+  if( Options->ParallelProposals && THREADING_ENABLED )
+  {
+    // One method per thread, on the shared helper pool
+    parallelFor( PROPOSAL_METHOD_COUNT, ProposalTasksBody( proposals ),
+      PROPOSAL_METHOD_COUNT );
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
+    // All proposal time is attributed to the first method in this mode
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
+    for( int i=1; i<PROPOSAL_METHOD_COUNT; i++ )
+      executionTimes.push_back( 0.0 );
 #endif
-
-  // Template Approx Candidate Detection
-  findTemplateCandidates( gradients, cdsTemplateAprx, inputProp, mask );
-  filterCandidates( cdsTemplateAprx, minRadPixels, maxRadPixels, true );
+  }
+  else
+  {
+    for( int i=0; i<PROPOSAL_METHOD_COUNT; i++ )
+    {
+      runProposalTask( &proposals[i] );
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
+      executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
+    }
+  }
 
-  // Stable Canny Edge Candidates
-  findCannyCandidates( gradients, cdsCannyEdge );
-  filterCandidates( cdsCannyEdge, minRadPixels, maxRadPixels, true );
-
-#ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
-#endif
+  // Containers for initial interest points
+  CandidatePtrVector& cdsColorBlob = proposals[PROPOSAL_COLOR_BLOB].Output;
+  CandidatePtrVector& cdsAdaptiveFilt = proposals[PROPOSAL_ADAPTIVE_FILT].Output;
+  CandidatePtrVector& cdsTemplateAprx = proposals[PROPOSAL_TEMPLATE_APRX].Output;
+  CandidatePtrVector& cdsCannyEdge = proposals[PROPOSAL_CANNY_EDGE].Output;
 
 //---------------------Consolidate ROIs--------------------------
 
   // Containers for sorted IPs
-  CandidatePtrVector cdsAllUnordered;
+  CandidatePtrVector& cdsAllUnordered = output.Candidates;
   CandidateQueue cdsAllOrdered;
 
   // Consolidate interest points
@@ -370,7 +555,7 @@ void *processImage( void *InputArgs ) {
     cdsCannyEdge, cdsAllUnordered, cdsAllOrdered, Stats );
 
 #ifdef ENABLE_BENCHMARKING
-  executionTimes.push_back( getTimeSinceLastCall() );
+  executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
 //------------------GT Merging Procedure------------------------
@@ -391,17 +576,25 @@ void *processImage( void *InputArgs ) {
     }
   }
 
-  if( !Options->ProcessBorderPoints )
+  if( tile )
+  {
+    // Leave candidates near the tile's edges to its neighbours
+    removeCandidatesOutside( cdsAllUnordered, tile->Keep );
+  }
+  else if( !Options->ProcessBorderPoints )
   {
     removeBorderCandidates( cdsAllUnordered, imgRGB32f );
   }
 
-  if( Options->EnableOutputDisplay )
+  // Proposal outputs are only generated for full frames
+  if( Options->EnableOutputDisplay && !tile )
   {
+    getDisplayLock();
     displayInterestPointImage( imgRGB32f, cdsAllUnordered );
+    unlockDisplay();
   }
 
-  if( Options->OutputProposalImages )
+  if( Options->OutputProposalImages && !tile )
   {
     saveCandidates( imgRGB32f, cdsAllUnordered,
       Options->OutputFilename + ".proposals.png" );
@@ -412,33 +605,35 @@ void *processImage( void *InputArgs ) {
   if( Options->Model->requiresFeatures() )
   {
     // Initializes Candidate stats used for classification
-    initalizeCandidateStats( cdsAllUnordered, inputImg->height, inputImg->width );
+    initalizeCandidateStats( cdsAllUnordered, output.Features,
+      inputImg->height, inputImg->width );
 
 #ifdef ENABLE_BENCHMARKING
-    executionTimes.push_back( getTimeSinceLastCall() );
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
     // Identifies edges around each IP
-    edgeSearch( gradients, color, imgLab32f, cdsAllUnordered, imgRGB32f );
+    edgeSearch( gradients, color, imgLab32f, cdsAllUnordered, imgRGB32f,
+      featureThreads );
 
 #ifdef ENABLE_BENCHMARKING
-    executionTimes.push_back( getTimeSinceLastCall() );
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
     // Creates an unoriented gs HoG descriptor around each IP
     HoGFeatureGenerator gsHoG( imgGrey32f, minRadPixels, maxRadPixels, 0 );
-    gsHoG.Generate( cdsAllUnordered );
+    gsHoG.Generate( cdsAllUnordered, featureThreads );
 
 #ifdef ENABLE_BENCHMARKING
-    executionTimes.push_back( getTimeSinceLastCall() );
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
     // Creates an unoriented sal HoG descriptor around each IP
     HoGFeatureGenerator salHoG( color->SaliencyMap, minRadPixels, maxRadPixels, 1 );
-    salHoG.Generate( cdsAllUnordered );
+    salHoG.Generate( cdsAllUnordered, featureThreads );
 
 #ifdef ENABLE_BENCHMARKING
-    executionTimes.push_back( getTimeSinceLastCall() );
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
     // Calculates size based features around each IP
@@ -446,172 +641,725 @@ void *processImage( void *InputArgs ) {
       // Above is a hack to make size features more comparable when we have/don't
       // have input metadata used to compute size info
 
-    for( int i=0; i<cdsAllUnordered.size(); i++ ) {
-      calculateSizeFeatures( cdsAllUnordered[i], inputProp, resizeFactor, sizeAdj );
-    }
+    calculateSizeFeatures( cdsAllUnordered, inputProp, resizeFactor, sizeAdj );
 
 #ifdef ENABLE_BENCHMARKING
-    executionTimes.push_back( getTimeSinceLastCall() );
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
     // Calculates color based features around each IP
-    createColorQuadrants( imgGrey32f, cdsAllUnordered );
-    for( int i=0; i<cdsAllUnordered.size(); i++ ) {
-      calculateColorFeatures( imgRGB32f, color, cdsAllUnordered[i] );
-    }
+    createColorQuadrants( imgGrey32f, cdsAllUnordered, featureThreads );
+    calculateColorFeatures( imgRGB32f, color, cdsAllUnordered, featureThreads );
 
 #ifdef ENABLE_BENCHMARKING
-    executionTimes.push_back( getTimeSinceLastCall() );
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
 
     // Calculates gabor based features around each IP
-    calculateGaborFeatures( imgGrey32f, cdsAllUnordered );
+    calculateGaborFeatures( imgGrey32f, cdsAllUnordered, featureThreads );
 
 #ifdef ENABLE_BENCHMARKING
-    executionTimes.push_back( getTimeSinceLastCall() );
+    executionTimes.push_back( timer.getTimeSinceLastCall() );
 #endif
   }
+  else
+  {
+    // Classification results are still stored with each candidate's features
+    allocateCandidateFeatures( cdsAllUnordered );
+  }
 
 //----------------------Classify ROIs----------------------------
 
-  CandidatePtrVector interestingCds;
-  CandidatePtrVector likelyObjects;
-  DetectionPtrVector objects;
+  CandidatePtrVector& interestingCds = output.Positives;
 
   if( Options->IsTrainingMode && !Options->UseGTData )
   {
     // If in training mode, have user enter Candidate classifications
-    if( !getDesignationsFromUser( cdsAllOrdered, imgRGB32f, mask, detections,
-           minRadPixels, maxRadPixels, Options->InputFilenameNoDir ) )
+    if( !getDesignationsFromUser( *Options->Training, cdsAllOrdered, imgRGB32f,
+           mask, detections, minRadPixels, maxRadPixels, Options->InputFilenameNoDir ) )
     {
-      trainingExitFlag = true;
+      Options->Training->exitFlag = true;
     }
   }
   else if( Options->IsTrainingMode )
   {
+    // Sample extraction appends to the model's training data
+    ScopedLock modelLock( Options->ModelLock );
     Options->Model->extractSamples( imgRGB8u, cdsAllUnordered, GTDetections );
   }
   else
   {
     // Classify candidates, returning ones with positive classifications
-    Options->Model->classifyCandidates( imgRGB8u, cdsAllUnordered, interestingCds );
+    {
+      ScopedLock modelLock( Options->ModelLock );
+      Options->Model->classifyCandidates( imgRGB8u, cdsAllUnordered, interestingCds );
+    }
 
     // Calculate expensive edges around each interesting candidate point
     if( Options->Model->requiresFeatures() )
     {
-      expensiveEdgeSearch( gradients, color, imgLab32f, imgRGB32f, interestingCds );
-    }
-
-    // Perform cleanup by removing interest points which are part of another interest point
-    removeInsidePoints( interestingCds, likelyObjects );
-
-    // Interpolate correct object categories
-    objects = interpolateResults( likelyObjects, Options->Model, Options->InputFilename );
-
-    // Display Detections
-    if( Options->EnableOutputDisplay ) {
-      getDisplayLock();
-      displayResultsImage( imgRGB32f, objects, Options->InputFilenameNoDir );
-      unlockDisplay();
+      expensiveEdgeSearch( gradients, color, imgLab32f, imgRGB32f, interestingCds,
+        featureThreads );
     }
   }
 
-//-----------------------Update Stats----------------------------
-
-  // Update Detection variables and mask
-  /*if( !Options->IsTrainingMode )
+  // Move candidates into frame coordinates
+  if( tile )
   {
-    for( unsigned int i=0; i<objects.size(); i++ ) {
-      Detection *cur = objects[i];
-      if( cur->isBrownScallop ) {
-        detections[SCALLOP_BROWN]++;
-        updateMask( mask, cur->r, cur->c, cur->angle, cur->major, cur->minor, SCALLOP_BROWN );
-      } else if( cur->isWhiteScallop ) {
-        detections[SCALLOP_WHITE]++;
-        updateMask( mask, cur->r, cur->c, cur->angle, cur->major, cur->minor, SCALLOP_WHITE );
-      } else if( cur->isBuriedScallop ) {
-        detections[SCALLOP_BURIED]++;
-        updateMaskRing( mask, cur->r, cur->c, cur->angle,
-          cur->major*0.8, cur->minor*0.8, cur->major, SCALLOP_BROWN );
-      }
+    for( unsigned i = 0; i < cdsAllUnordered.size(); i++ )
+    {
+      cdsAllUnordered[i]->r += tile->Region.y;
+      cdsAllUnordered[i]->c += tile->Region.x;
     }
   }
-  else
-  {
-    // Quick hack: If we're not trying to detect scallops, reuse scallop histogram for better ip detections
-    for( unsigned int i=0; i<objects.size(); i++ ) {
-      Detection *cur = objects[i];
-      updateMask( mask, cur->r, cur->c, cur->angle, cur->major, cur->minor, SCALLOP_BROWN );
-    }
-  }*/
 
-  // Update color classifiers from mask and detections matrix
-  //CC->Update( imgRGB32f, mask, detections );
+//-------------------------Clean Up------------------------------
 
-  // Update statistics
-  //Stats->Update( detections, inputProp.getImgHeightMeters() * inputProp.getImgWidthMeters() );
+  // Deallocate memory used by region
+  deallocateGradientChain( gradients );
+  hfDeallocResults( color );
 
-  // Output results to image files
-  if( Options->OutputDetectionImages )
+  // Full frames hand the float image on to the caller, the rest are
+  // returned to the arena by the guard
+  if( !tile )
   {
-    saveScallops( imgRGB32f, objects, Options->OutputFilename + ".detections.png" );
+    output.ImageRGB32f = imgRGB32f;
+    imgRGB32f = NULL;
   }
+}
 
-  // Resize results to input resolution, and output to text file
-  DetectionVector resizedObjects = convertVector( objects );
+// Processes a range of tiles of a frame, each with a colour classifier taken
+// from a shared pool (colour classifiers keep per-image state)
+class TileLoopBody : public ParallelLoopBody
+{
+public:
+  TileLoopBody( AlgorithmArgs *options, const cv::Mat& image,
+    ImageProperties& properties, float minRad, float maxRad, float resize,
+    int featureThreads, const vector< FrameTile >& tiles,
+    vector< RegionResults >& results, vector< ColorClassifier* >& pool,
+    ThreadMutex& poolLock )
+   : options( options ), image( image ), properties( properties ),
+     minRad( minRad ), maxRad( maxRad ), resize( resize ),
+     featureThreads( featureThreads ), tiles( tiles ), results( results ),
+     pool( pool ), poolLock( poolLock ) {}
 
-  if( resizeFactor != 1.0f && resizeFactor != 0.0f )
-  {
-    resizeDetections( resizedObjects, 1.0f / resizeFactor );
-  }
+  void operator()( int begin, int end ) const {
 
-  if( Options->EnableListOutput && !Options->IsTrainingMode )
-  {
-    if( !appendInfoToFile( resizedObjects, Options->ListFilename,
-      Options->InputFilenameNoDir ) )
-    {
-      cerr << "CRITICAL ERROR: Could not write to output list!" << endl;
-    }
-  }
+    poolLock.lock();
+    ColorClassifier *CC = pool.back();
+    pool.pop_back();
+    poolLock.unlock();
 
-  // Copy final detections to class output
-  Options->FinalDetections = resizedObjects;
+    for( int i=begin; i<end; i++ ) {
 
-//-------------------------Clean Up------------------------------
+      const FrameTile& tile = tiles[i];
 
-  // Deallocate memory used by thread
-  deallocateCandidates( cdsAllUnordered );
-  deallocateDetections( objects );
-  deallocateGradientChain( gradients );
-  hfDeallocResults( color );
+      // Tiles share the frame's pixel data, only headers are created
+      cv::Mat tileMat = image( tile.Region );
+      IplImage tileIpl = tileMat;
 
-  cvReleaseImage( &imgRGB32f );
-  cvReleaseImage( &imgRGB8u );
-  cvReleaseImage( &imgGrey32f );
-  cvReleaseImage( &imgLab32f );
-  cvReleaseImage( &imgGrey8u );
-  cvReleaseImage( &mask );
+      ImageProperties tileProp = properties.getRegionProperties(
+        tile.Region.height / (float)image.rows,
+        tile.Region.width / (float)image.cols );
 
-  // Update thread status
-  markThreadAsFinished( Options->ThreadID );
-  threadExit();
-  return NULL;
-}
+      processRegion( options, CC, &tileIpl, tileProp, minRad, maxRad,
+        resize, &tile, featureThreads, results[i] );
+    }
 
-//--------------File system manager / algorithm caller------------------
+    poolLock.lock();
+    pool.push_back( CC );
+    poolLock.unlock();
+  }
 
-int runCoreDetector( const SystemParameters& settings )
+private:
+  AlgorithmArgs *options;
+  const cv::Mat& image;
+  ImageProperties& properties;
+  float minRad;
+  float maxRad;
+  float resize;
+  int featureThreads;
+  const vector< FrameTile >& tiles;
+  vector< RegionResults >& results;
+  vector< ColorClassifier* >& pool;
+  ThreadMutex& poolLock;
+};
+
+// Metadata for a frame, from an external list if provided, else as parsed
+// from its file when read (which may not be valid)
+ImageMetadata getFrameMetadata( const AlgorithmArgs *Options,
+  const ImageMetadata& fileMetadata, float altitude, float pitch, float roll )
 {
-  // Retrieve some contents from input
-  string inputDir = settings.InputDirectory;
-  string inputFile = settings.InputFilename;
-  string outputDir = settings.OutputDirectory;
-  string outputFile = settings.OutputFilename;
+  if( !Options->MetadataProvided )
+  {
+    return fileMetadata;
+  }
 
-  // Compile a vector of all files to process with related info
-  vector<string> inputFilenames; // filenames (full or relative path)
-  vector<string> inputClassifiers; // corresponding classifier keys
-  vector<float> inputPitch; // input pitches, if used
+  ImageMetadata output;
+  output.valid = true;
+  output.altitude = altitude;
+  output.pitch = pitch;
+  output.roll = roll;
+  return output;
+}
+
+// Estimates image properties and the object search radii, in pixels, for a
+// frame with the given resolution
+//   inputs - algorithm settings, frame metadata and full frame size
+//   outputs - returns false if metadata is required but couldn't be read
+bool calculateSearchRadii( const AlgorithmArgs *Options, const string& filename,
+  const ImageMetadata& metadata, int cols, int rows, ImageProperties& inputProp,
+  float& minRadPixels, float& maxRadPixels )
+{
+  if( Options->UseMetadata )
+  {
+    // Automatically loads metadata from input file if not already known
+    if( !metadata.valid )
+    {
+      inputProp.calculateImageProperties( filename, cols, rows, Options->FocalLength );
+    }
+    else
+    {
+      inputProp.calculateImageProperties( cols, rows, metadata.altitude,
+         metadata.pitch, metadata.roll, Options->FocalLength, metadata.heading );
+    }
+
+    if( !inputProp.hasMetadata() )
+    {
+      return false;
+    }
+  }
+  else
+  {
+    inputProp.calculateImageProperties( cols, rows );
+  }
+
+  // Get the min and max Scallop size from combined image properties and input parameters
+  minRadPixels = ( Options->UseMetadata ? Options->MinSearchRadiusMeters
+    : Options->MinSearchRadiusPixels ) / inputProp.getAvgPixelSizeMeters();
+  maxRadPixels = ( Options->UseMetadata ? Options->MaxSearchRadiusMeters
+    : Options->MaxSearchRadiusPixels ) / inputProp.getAvgPixelSizeMeters();
+  return true;
+}
+
+// Our Core Detection Algorithm - performs classification for a single image
+//   inputs - shown above
+//   outputs - returns NULL
+void *processImage( void *InputArgs ) {
+
+//--------------------Get Pointers to Main Inputs---------------------
+
+  // Read input arguments (pthread requires void* as argument type)
+  AlgorithmArgs *Options = (AlgorithmArgs*) InputArgs;
+
+#ifdef ENABLE_BENCHMARKING
+  vector<double>& executionTimes = Options->ExecutionTimes;
+  executionTimes.clear();
+  BenchmarkTimer timer;
+#endif
+
+  // Declare input image in assorted formats for later operations
+  cv::Mat inputImgMat = Options->InputImage;
+
+  if( inputImgMat.cols == 0 || inputImgMat.rows == 0 )
+  {
+    throw std::runtime_error( "Invalid input image" );
+  }
+
+  // Sizes are calculated at full resolution, even if decoded at a reduced scale
+  cv::Size fullSize = Options->InputFullSize;
+
+  if( fullSize.width == 0 || fullSize.height == 0 )
+  {
+    fullSize = inputImgMat.size();
+  }
+
+  // Side-by-side stereo input, only needed if not given as separate images
+  if( Options->ProcessLeftHalfOnly && !Options->IsStereoView )
+  {
+    inputImgMat = inputImgMat(
+      cv::Rect( 0, 0, inputImgMat.cols/2, inputImgMat.rows ) );
+    fullSize.width = fullSize.width / 2;
+  }
+
+//----------------------Calculate Object Size-------------------------
+
+  // Declare Image Properties reader (for metadata read, size calc, etc)
+  ImageProperties inputProp;
+  float minRadPixels, maxRadPixels;
+
+  ImageMetadata metadata = getFrameMetadata( Options, Options->InputMetadata,
+    Options->Altitude, Options->Pitch, Options->Roll );
+
+  if( !calculateSearchRadii( Options, Options->InputFilename, metadata,
+    fullSize.width, fullSize.height, inputProp, minRadPixels, maxRadPixels ) )
+  {
+    cerr << "ERROR: Failure to read image metadata for file ";
+    cerr << Options->InputFilenameNoDir << endl;
+    return NULL;
+  }
+
+  // Threshold size scanning range
+  if( maxRadPixels < 1.0 )
+  {
+    cerr << "WARN: Scallop scanning size range is less than 1 pixel for image ";
+    cerr << Options->InputFilenameNoDir << ", skipping." << endl;
+    return NULL;
+  }
+
+#ifdef ENABLE_BENCHMARKING
+  executionTimes.push_back( timer.getTimeSinceLastCall() );
+#endif
+
+//-------------------------Format Base Images--------------------------
+
+  // Resize image to maximum size required for all operations
+  //  Stats->getMaxMinRequiredRad returns the maximum required image size
+  //  in terms of how many pixels the min scallop radius should be. We only
+  //  resize the image if this results in a downscale. If the image was
+  //  decoded at a reduced scale, only a small residual resize remains.
+  float resizeFactor = MAX_PIXELS_FOR_MIN_RAD / minRadPixels;
+
+  if( resizeFactor < RESIZE_FACTOR_REQUIRED ) {
+    cv::Size resizedSize( (int)( resizeFactor*fullSize.width ),
+                          (int)( resizeFactor*fullSize.height ) );
+
+    if( resizedSize != inputImgMat.size() ) {
+      cv::Mat resizedImgMat;
+      cv::resize( inputImgMat, resizedImgMat, resizedSize );
+      inputImgMat = resizedImgMat;
+    }
+
+  } else if( inputImgMat.cols != fullSize.width ) {
+    resizeFactor = (float)inputImgMat.cols / fullSize.width;
+  } else {
+    resizeFactor = 1.0f;
+  }
+
+  if( resizeFactor != 1.0f ) {
+    minRadPixels = minRadPixels * resizeFactor;
+    maxRadPixels = maxRadPixels * resizeFactor;
+  }
+
+  // The remaining code uses legacy OpenCV API (IplImage)
+  IplImage inputImgIplWrapper = inputImgMat;
+  IplImage *inputImg = &inputImgIplWrapper;
+
+  if( Options->ReportCompactDrift )
+  {
+    Options->CC->reportCompactDrift( inputImg, Options->InputIsRGB,
+      minRadPixels, maxRadPixels );
+    Options->ReportCompactDrift = false;
+  }
+
+#ifdef ENABLE_BENCHMARKING
+  executionTimes.push_back( timer.getTimeSinceLastCall() );
+#endif
+
+//-------------------Detect Candidates in Regions-----------------------
+
+  // Split large frames into overlapping tiles, wide enough that any object
+  // lies fully within the kept area of at least one tile
+  vector< FrameTile > tiles;
+
+  if( Options->TileSize > 0 && !Options->IsTrainingMode )
+  {
+    computeFrameTiles( inputImg->width, inputImg->height, Options->TileSize,
+      (int)ceil( TILE_OVERLAP_RADII * maxRadPixels ),
+      Options->ProcessBorderPoints, tiles );
+  }
+
+  vector< RegionResults > regions( std::max( tiles.size(), (size_t)1 ) );
+
+  if( tiles.size() > 1 )
+  {
+    // Processed tiles share the intra-frame thread budget
+    vector< ColorClassifier* > pool( 1, Options->CC );
+    pool.insert( pool.end(), Options->TileCC.begin(), Options->TileCC.end() );
+
+    int tileThreads = std::min( (int)pool.size(), (int)tiles.size() );
+    int featureThreads = std::max( Options->FeatureThreads / tileThreads, 1 );
+
+    ThreadMutex poolLock;
+    TileLoopBody body( Options, inputImgMat, inputProp, minRadPixels,
+      maxRadPixels, resizeFactor, featureThreads, tiles, regions, pool, poolLock );
+
+    parallelFor( tiles.size(), body, tileThreads );
+  }
+  else
+  {
+    processRegion( Options, Options->CC, inputImg, inputProp, minRadPixels,
+      maxRadPixels, resizeFactor, NULL, Options->FeatureThreads, regions[0] );
+  }
+
+#ifdef ENABLE_BENCHMARKING
+  // Stage timings are summed across all tiles
+  for( unsigned i = 0; i < regions.size(); i++ )
+  {
+    vector<double>& times = regions[i].ExecutionTimes;
+
+    for( unsigned j = 0; j < times.size(); j++ )
+    {
+      if( executionTimes.size() <= j + 2 )
+      {
+        executionTimes.push_back( 0.0 );
+      }
+
+      executionTimes[j+2] += times[j];
+    }
+  }
+#endif
+
+//----------------------Merge Regions----------------------------
+
+  CandidatePtrVector interestingCds;
+  CandidatePtrVector likelyObjects;
+  DetectionPtrVector objects;
+
+  for( unsigned i = 0; i < regions.size(); i++ )
+  {
+    interestingCds.insert( interestingCds.end(),
+      regions[i].Positives.begin(), regions[i].Positives.end() );
+  }
+
+  // Tiles don't retain their float images, so make one for output if needed
+  IplImage *imgRGB32f = regions[0].ImageRGB32f;
+
+  if( !imgRGB32f && ( Options->EnableOutputDisplay || Options->OutputDetectionImages ) )
+  {
+    imgRGB32f = arenaCreateImage( Options->Arena, cvGetSize(inputImg), IPL_DEPTH_32F, inputImg->nChannels );
+    convertBaseImages( inputImg, Options->InputIsRGB, BASE_RGB_32F, imgRGB32f,
+      NULL, NULL, NULL, NULL, Options->FeatureThreads );
+  }
+
+  if( !Options->IsTrainingMode )
+  {
+    // Perform cleanup by removing interest points which are part of another
+    // interest point, including duplicates found on both sides of tile seams
+    removeInsidePoints( interestingCds, likelyObjects );
+
+    // Interpolate correct object categories
+    objects = interpolateResults( likelyObjects, Options->Model, Options->InputFilename );
+
+    // Display Detections
+    if( Options->EnableOutputDisplay ) {
+      getDisplayLock();
+      displayResultsImage( imgRGB32f, objects, Options->InputFilenameNoDir );
+      unlockDisplay();
+    }
+  }
+
+//-----------------------Update Stats----------------------------
+
+  // Update Detection variables and mask
+  /*if( !Options->IsTrainingMode )
+  {
+    for( unsigned int i=0; i<objects.size(); i++ ) {
+      Detection *cur = objects[i];
+      if( cur->isBrownScallop ) {
+        detections[SCALLOP_BROWN]++;
+        updateMask( mask, cur->r, cur->c, cur->angle, cur->major, cur->minor, SCALLOP_BROWN );
+      } else if( cur->isWhiteScallop ) {
+        detections[SCALLOP_WHITE]++;
+        updateMask( mask, cur->r, cur->c, cur->angle, cur->major, cur->minor, SCALLOP_WHITE );
+      } else if( cur->isBuriedScallop ) {
+        detections[SCALLOP_BURIED]++;
+        updateMaskRing( mask, cur->r, cur->c, cur->angle,
+          cur->major*0.8, cur->minor*0.8, cur->major, SCALLOP_BROWN );
+      }
+    }
+  }
+  else
+  {
+    // Quick hack: If we're not trying to detect scallops, reuse scallop histogram for better ip detections
+    for( unsigned int i=0; i<objects.size(); i++ ) {
+      Detection *cur = objects[i];
+      updateMask( mask, cur->r, cur->c, cur->angle, cur->major, cur->minor, SCALLOP_BROWN );
+    }
+  }*/
+
+  // Update color classifiers from mask and detections matrix
+  //CC->Update( imgRGB32f, mask, detections );
+
+  // Update statistics
+  //Stats->Update( detections, inputProp.getImgHeightMeters() * inputProp.getImgWidthMeters() );
+
+  // Output results to image files
+  if( Options->OutputDetectionImages )
+  {
+    saveScallops( imgRGB32f, objects, Options->OutputFilename + ".detections.png" );
+  }
+
+  // Resize results to input resolution, the caller writes them to the
+  // output list
+  DetectionVector resizedObjects = convertVector( objects );
+
+  if( resizeFactor != 1.0f && resizeFactor != 0.0f )
+  {
+    resizeDetections( resizedObjects, 1.0f / resizeFactor );
+  }
+
+  // Copy final detections to class output
+  Options->FinalDetections = resizedObjects;
+
+//-------------------------Clean Up------------------------------
+
+  // Deallocate memory used by thread
+  for( unsigned i = 0; i < regions.size(); i++ )
+  {
+    deallocateCandidates( regions[i].Candidates );
+  }
+
+  deallocateDetections( objects );
+
+  if( imgRGB32f )
+  {
+    arenaReleaseImage( Options->Arena, &imgRGB32f );
+  }
+
+  // Drop pooled images for sizes this frame didn't use
+  if( Options->Arena )
+  {
+    Options->Arena->nextFrame();
+  }
+  return NULL;
+}
+
+//----------------------Frame-level worker pool--------------------------
+
+// Everything required to process a single frame from an input list
+struct FrameJob {
+
+  // Input and output filenames
+  string InputFilename;
+  string InputFilenameNoDir;
+  string OutputFilename;
+
+  // Classifier to use on this frame, and lock if it must be serialized
+  Classifier *Model;
+  ThreadMutex *ModelLock;
+
+  // Externally provided metadata, if any
+  float Altitude;
+  float Pitch;
+  float Roll;
+
+  // Metadata and resolution from the metadata index, if indexed
+  MetadataIndexEntry Indexed;
+
+  FrameJob()
+  : Model( NULL ),
+    ModelLock( NULL ),
+    Altitude( 0.0f ),
+    Pitch( 0.0f ),
+    Roll( 0.0f )
+  {}
+};
+
+// Queue of frames shared between all workers in runCoreDetector
+//
+// Workers claim frames in input order, but may finish them out of order,
+// the list writer puts detections back into input order.
+struct FrameQueue {
+
+  // Guards all members below
+  ThreadMutex Lock;
+
+  // All frames to process
+  vector< FrameJob > Jobs;
+
+  // Source of decoded input images for each frame
+  ImagePrefetcher *Images;
+
+  // Next frame to hand out to a worker
+  unsigned NextJob;
+
+  // Output list writer, NULL if list output is disabled
+  DetectionWriter *ListWriter;
+
+  // Set when no further frames should be handed out (training exit)
+  bool Stop;
+
+#ifdef ENABLE_BENCHMARKING
+  // Output file for per-frame timings
+  ofstream *BenchmarkingOutput;
+#endif
+
+  FrameQueue()
+  : Images( NULL ),
+    NextJob( 0 ),
+    ListWriter( NULL ),
+    Stop( false )
+  {}
+};
+
+// Inputs to a single worker thread
+struct WorkerArgs {
+  AlgorithmArgs *Args;
+  FrameQueue *Queue;
+};
+
+// Metadata read from a frame's file, or from the metadata index instead if the
+// frame is indexed with the same resolution as read
+ImageMetadata getIndexedMetadata( const FrameJob& Job, const cv::Size& fullSize,
+  const ImageMetadata& fileMetadata )
+{
+  const MetadataIndexEntry& entry = Job.Indexed;
+
+  if( !entry.metadata.valid ||
+      entry.cols != fullSize.width || entry.rows != fullSize.height )
+  {
+    return fileMetadata;
+  }
+
+  return entry.metadata;
+}
+
+// Chooses the scale frames in the queue are decoded at, from the same search
+// radii later calculated by processImage
+class FrameScaleSelector : public DecodeScaleSelector
+{
+public:
+
+  FrameScaleSelector( const AlgorithmArgs *settings, const vector< FrameJob >& jobs )
+   : Settings( settings ), Jobs( jobs ) {}
+
+  float getDecodeScale( unsigned index, const cv::Size& fullSize,
+    const ImageMetadata& fileMetadata )
+  {
+    const FrameJob& Job = Jobs[index];
+    ImageProperties inputProp;
+    float minRadPixels, maxRadPixels;
+
+    int cols = ( Settings->ProcessLeftHalfOnly ? fullSize.width / 2 : fullSize.width );
+
+    ImageMetadata metadata = getFrameMetadata( Settings,
+      getIndexedMetadata( Job, fullSize, fileMetadata ),
+      Job.Altitude, Job.Pitch, Job.Roll );
+
+    if( !calculateSearchRadii( Settings, Job.InputFilename, metadata,
+      cols, fullSize.height, inputProp, minRadPixels, maxRadPixels ) ||
+      maxRadPixels < 1.0 )
+    {
+      return 1.0f;
+    }
+
+    return std::min( MAX_PIXELS_FOR_MIN_RAD / minRadPixels, 1.0f );
+  }
+
+private:
+
+  // Only settings which are the same for every frame are used
+  const AlgorithmArgs *Settings;
+  const vector< FrameJob >& Jobs;
+};
+
+// Worker thread main loop, processes frames from the queue until empty
+//   inputs - a WorkerArgs struct
+//   outputs - returns NULL
+void *processFrameQueue( void *InputArgs )
+{
+  WorkerArgs *Worker = (WorkerArgs*) InputArgs;
+  AlgorithmArgs *Options = Worker->Args;
+  FrameQueue *Queue = Worker->Queue;
+
+  while( true )
+  {
+    // Claim the next frame
+    Queue->Lock.lock();
+
+    if( Queue->Stop || Queue->NextJob >= Queue->Jobs.size() )
+    {
+      Queue->Lock.unlock();
+      break;
+    }
+
+    unsigned id = Queue->NextJob++;
+    const FrameJob& Job = Queue->Jobs[id];
+    cout << Job.InputFilenameNoDir << "..." << endl;
+
+    Queue->Lock.unlock();
+
+    // Set per-frame arguments
+    Options->Model = Job.Model;
+    Options->ModelLock = Job.ModelLock;
+    Options->InputFilename = Job.InputFilename;
+    Options->InputFilenameNoDir = Job.InputFilenameNoDir;
+    Options->OutputFilename = Job.OutputFilename;
+    Options->Altitude = Job.Altitude;
+    Options->Pitch = Job.Pitch;
+    Options->Roll = Job.Roll;
+    Options->FinalDetections.clear();
+
+    // Load image from file, or retrieve it from the prefetch queue
+    {
+      DecodedFrame frame = Queue->Images->getImage( id );
+      Options->InputImage = frame.image;
+      Options->InputFullSize = frame.fullSize;
+      Options->InputMetadata = getIndexedMetadata( Job, frame.fullSize, frame.metadata );
+
+      if( Job.Indexed.metadata.valid && !frame.image.empty() &&
+          ( Job.Indexed.cols != frame.fullSize.width ||
+            Job.Indexed.rows != frame.fullSize.height ) )
+      {
+        cerr << "WARNING: Metadata index entry for " << Job.InputFilenameNoDir;
+        cerr << " doesn't match the image, ignoring it" << endl;
+      }
+    }
+
+    // Execute processing
+    try
+    {
+      processImage( Options );
+    }
+    catch( const std::exception& e )
+    {
+      cerr << "ERROR: " << e.what() << " for file " << Job.InputFilenameNoDir << endl;
+    }
+
+    Options->InputImage.release();
+
+    // Hand detections to the list writer
+    if( Queue->ListWriter )
+    {
+      Queue->ListWriter->write( id, Options->FinalDetections, Job.InputFilenameNoDir );
+    }
+
+    Queue->Lock.lock();
+
+#ifdef ENABLE_BENCHMARKING
+    // Output benchmarking results to file
+    for( unsigned int i=0; i<Options->ExecutionTimes.size(); i++ )
+      *Queue->BenchmarkingOutput << Options->ExecutionTimes[i] << " ";
+    *Queue->BenchmarkingOutput << endl;
+#endif
+
+    // Checks if user entered EXIT command in training mode
+    if( Options->Training && Options->Training->exitFlag )
+    {
+      Queue->Stop = true;
+    }
+
+    Queue->Lock.unlock();
+  }
+
+  return NULL;
+}
+
+//--------------File system manager / algorithm caller------------------
+
+int runCoreDetector( const SystemParameters& settings )
+{
+  // Retrieve some contents from input
+  string inputDir = settings.InputDirectory;
+  string inputFile = settings.InputFilename;
+  string outputDir = settings.OutputDirectory;
+  string outputFile = settings.OutputFilename;
+
+  // Compile a vector of all files to process with related info
+  vector<string> inputFilenames; // filenames (full or relative path)
+  vector<string> inputClassifiers; // corresponding classifier keys
+  vector<float> inputPitch; // input pitches, if used
   vector<float> inputAltitudes; // input altitudes, if used
   vector<float> inputRoll; // input rolls, if used
   vector<string> subdirsToCreate; // subdirs we may be going to create
@@ -772,8 +1520,8 @@ int runCoreDetector( const SystemParameters& settings )
   // Format the output name vector for each input image
   formatOutputNames( inputFilenames, outputFilenames, inputDir, outputDir );
 
-  // Set global thread count
-  THREADS = settings.NumThreads;
+  // Set thread count
+  const int threadCount = std::max( settings.NumThreads, 1 );
 
   // Create output list filename
   string listFilename = outputDir + outputFile;
@@ -788,10 +1536,16 @@ int runCoreDetector( const SystemParameters& settings )
     fout.close();
   }
 
+  DetectionWriter::SyncPolicy listSync;
+
+  if( !DetectionWriter::parseSyncPolicy( settings.ListSyncPolicy, listSync ) ) {
+    cout << "ERROR: Invalid list sync policy " << settings.ListSyncPolicy << std::endl;
+    return false;
+  }
+
 #ifdef ENABLE_BENCHMARKING
   // Initialize Timing Statistics
-  initializeTimer();
-  benchmarkingOutput.open( BenchmarkingFilename.c_str() );
+  ofstream benchmarkingOutput( BenchmarkingFilename.c_str() );
 
   if( !benchmarkingOutput.is_open() ) {
     cout << "ERROR: Could not write to benchmarking file!" << std::endl;
@@ -802,6 +1556,9 @@ int runCoreDetector( const SystemParameters& settings )
   // Storage map for loaded classifier styles
   map< string, Classifier* > classifiers;
 
+  // Locks for classifiers which cannot be shared between threads
+  map< string, ThreadMutex* > classifierLocks;
+
   // Preload all required classifiers just in case there's a mistake
   // in a config file (so it doesn't die midstream)
   cout << "Loading Classifier Systems... ";
@@ -827,27 +1584,56 @@ int runCoreDetector( const SystemParameters& settings )
       }
 
       classifiers[ inputClassifiers[i] ] = LoadedSystem;
+      classifierLocks[ inputClassifiers[i] ] =
+        ( LoadedSystem->isThreadSafe() ? NULL : new ThreadMutex );
     }
   }
   cout << "FINISHED" << endl;
 
+  // Extra color filters are required to process multiple tiles at once
+  int tileThreads = 1;
+
+  if( settings.TileSize > 0 && !settings.IsTrainingMode && THREADING_ENABLED )
+  {
+    tileThreads = std::min( std::max( settings.TileThreads, 1 ), MAX_THREADS );
+  }
+
   // Load Statistics/Color filters
   cout << "Loading Colour Filters... ";
-  AlgorithmArgs *inputArgs = new AlgorithmArgs[THREADS];
+  AlgorithmArgs *inputArgs = new AlgorithmArgs[threadCount];
 
-  for( int i=0; i < THREADS; i++ )
+  for( int i=0; i < threadCount; i++ )
   {
     inputArgs[i].CC = new ColorClassifier;
     inputArgs[i].Stats = new ThreadStatistics;
-    if( !inputArgs[i].CC->loadFilters( settings.RootColorDIR, DEFAULT_COLORBANK_EXT ) ) {
+    if( !inputArgs[i].CC->loadFilters( settings.RootColorDIR, DEFAULT_COLORBANK_EXT ) ||
+        !inputArgs[i].CC->useCompactFilters( settings.CompactColorFilters ) ) {
       cerr << "ERROR: Could not load colour filters!" << std::endl;
       return 0;
     }
+    for( int j=1; j < tileThreads; j++ ) {
+      inputArgs[i].TileCC.push_back( new ColorClassifier );
+      if( !inputArgs[i].TileCC.back()->loadFilters( settings.RootColorDIR, DEFAULT_COLORBANK_EXT ) ||
+          !inputArgs[i].TileCC.back()->useCompactFilters( settings.CompactColorFilters ) ) {
+        cerr << "ERROR: Could not load colour filters!" << std::endl;
+        return 0;
+      }
+    }
   }
+  for( int i=0; i < threadCount; i++ ) {
+    inputArgs[i].CC->setSaliencyStride( settings.SaliencySampleStride );
+    for( unsigned j=0; j < inputArgs[i].TileCC.size(); j++ ) {
+      inputArgs[i].TileCC[j]->setSaliencyStride( settings.SaliencySampleStride );
+    }
+  }
+
   cout << "FINISHED" << std::endl;
 
+  // Drift of the compact filters is reported from the first frame
+  inputArgs[0].ReportCompactDrift = ( settings.CompactColorFilters > 0 );
+
   // Configure algorithm input based on settings
-  for( int i=0; i<THREADS; i++ )
+  for( int i=0; i<threadCount; i++ )
   {
     // Set thread output options
     inputArgs[i].IsTrainingMode = settings.IsTrainingMode;
@@ -855,20 +1641,24 @@ int runCoreDetector( const SystemParameters& settings )
     inputArgs[i].TrainingPercentKeep = settings.TrainingPercentKeep;
     inputArgs[i].ProcessBorderPoints = settings.LookAtBorderPoints;
     inputArgs[i].GTData = GTs;
-    inputArgs[i].EnableListOutput = settings.OutputList;
     inputArgs[i].OutputDuplicateClass = settings.OutputDuplicateClass;
     inputArgs[i].OutputProposalImages = settings.OutputProposalImages;
     inputArgs[i].OutputDetectionImages = settings.OutputDetectionImages;
     inputArgs[i].EnableOutputDisplay = settings.EnableOutputDisplay;
     inputArgs[i].ScallopMode = true;
     inputArgs[i].MetadataProvided = !settings.IsMetadataInImage && !settings.IsInputDirectory;
-    inputArgs[i].ListFilename = listFilename;
+    inputArgs[i].FocalLength = settings.FocalLength;
     inputArgs[i].MinSearchRadiusMeters = settings.MinSearchRadiusMeters;
     inputArgs[i].MaxSearchRadiusMeters = settings.MaxSearchRadiusMeters;
     inputArgs[i].MinSearchRadiusPixels = settings.MinSearchRadiusPixels;
     inputArgs[i].MaxSearchRadiusPixels = settings.MaxSearchRadiusPixels;
     inputArgs[i].UseMetadata = settings.UseMetadata;
     inputArgs[i].ProcessLeftHalfOnly = settings.ProcessLeftHalfOnly;
+    inputArgs[i].ParallelProposals = settings.IntraFrameThreading;
+    inputArgs[i].FeatureThreads = ( settings.IntraFrameThreading ? threadCount : 1 );
+    inputArgs[i].AdaptiveThresholdLevels = settings.AdaptiveThresholdLevels;
+    inputArgs[i].TileSize = settings.TileSize;
+    inputArgs[i].Arena = ( settings.UseImageArena ? new ImageArena : NULL );
   }
 
   // Initiate display window for output
@@ -878,8 +1668,13 @@ int runCoreDetector( const SystemParameters& settings )
   }
 
   // Initialize training mode if in gui mode
+  TrainingSession training;
+
   if( settings.IsTrainingMode && !settings.UseFileForTraining ) {
-    if( !initializeTrainingMode( outputDir, outputFile ) ) {
+    for( int i=0; i<threadCount; i++ ) {
+      inputArgs[i].Training = &training;
+    }
+    if( !initializeTrainingMode( training, outputDir, outputFile ) ) {
       cerr << "ERROR: Could not initiate training mode!" << std::endl;
     }
   }
@@ -888,59 +1683,169 @@ int runCoreDetector( const SystemParameters& settings )
   cout << endl << "Processing Files: " << endl << endl;
   cout << "Directory: " << inputDir << endl << endl;
 
-  // For every file...
-  for( unsigned int i=0; i<inputFilenames.size(); i++ ) {
+  // Build the frame queue shared by all workers
+  FrameQueue queue;
+  queue.Jobs.resize( inputFilenames.size() );
+
+  if( settings.OutputList && !settings.IsTrainingMode )
+  {
+    queue.ListWriter = new DetectionWriter( listFilename, settings.OrderedListOutput,
+      std::max( settings.ListFlushFrames, 1 ), settings.ListFlushSeconds, listSync );
+  }
+#ifdef ENABLE_BENCHMARKING
+  queue.BenchmarkingOutput = &benchmarkingOutput;
+#endif
+
+  // Metadata stored in images is read from a sidecar index instead, if one
+  // has been built for the input directory
+  bool metadataInImages = settings.UseMetadata && !inputArgs[0].MetadataProvided;
+  MetadataIndex metadataIndex;
+  unsigned indexedCount = 0;
 
-    // Always set the focal length
-    inputArgs[0].FocalLength = settings.FocalLength;
+  if( metadataInImages )
+  {
+    string indexFilename = settings.MetadataIndexFile;
+
+    if( indexFilename.empty() )
+    {
+      indexFilename = settings.InputDirectory + DEFAULT_METADATA_INDEX;
+    }
+
+    if( metadataIndex.load( indexFilename ) )
+    {
+      cout << "Metadata Index: " << indexFilename << endl << endl;
+    }
+    else if( !settings.MetadataIndexFile.empty() )
+    {
+      cerr << "WARNING: Unable to load metadata index " << indexFilename << endl;
+    }
+  }
+
+  for( unsigned int i=0; i<inputFilenames.size(); i++ )
+  {
+    FrameJob& job = queue.Jobs[i];
 
     // Set classifier related settings
-    inputArgs[0].Model = classifiers[ inputClassifiers[i] ];
-    inputArgs[0].TrainingPercentKeep = settings.TrainingPercentKeep;
-    inputArgs[0].ProcessBorderPoints = settings.LookAtBorderPoints;
+    job.Model = classifiers[ inputClassifiers[i] ];
+    job.ModelLock = classifierLocks[ inputClassifiers[i] ];
 
     // Set file/dir arguments
-    string Dir, filenameNoDir;
-    splitPathAndFile( inputFilenames[i], Dir, filenameNoDir );
-    cout << filenameNoDir << "..." << endl;
-    inputArgs[0].InputFilename = inputFilenames[i];
-    inputArgs[0].OutputFilename = outputFilenames[i];
-    inputArgs[0].InputFilenameNoDir = filenameNoDir;
+    string Dir;
+    splitPathAndFile( inputFilenames[i], Dir, job.InputFilenameNoDir );
+    job.InputFilename = inputFilenames[i];
+    job.OutputFilename = outputFilenames[i];
 
     // Set metadata if required
     if( !settings.IsMetadataInImage && !settings.IsInputDirectory && !settings.IsTrainingMode )
     {
-      inputArgs[0].Altitude = inputAltitudes[i];
-      inputArgs[0].Pitch = inputPitch[i];
-      inputArgs[0].Roll = inputRoll[i];
+      job.Altitude = inputAltitudes[i];
+      job.Pitch = inputPitch[i];
+      job.Roll = inputRoll[i];
     }
 
-    // Load image from file
-    cv::Mat image;
-    image = imread( inputFilenames[i], CV_LOAD_IMAGE_COLOR );
-    inputArgs[0].InputImage = image;
+    // Use indexed metadata if available
+    const MetadataIndexEntry *entry = metadataIndex.find( inputFilenames[i] );
 
-    // Execute processing
-    processImage( inputArgs );
+    if( metadataInImages && entry && entry->metadata.valid )
+    {
+      job.Indexed = *entry;
+      indexedCount++;
+    }
+  }
 
-#ifdef ENABLE_BENCHMARKING
-    // Output benchmarking results to file
-    for( unsigned int i=0; i<executionTimes.size(); i++ )
-      benchmarkingOutput << executionTimes[i] << " ";
-    benchmarkingOutput << endl;
-#endif
+  // Start reading and decoding images ahead of the workers, at the reduced
+  // scale they will be processed at if possible. Metadata stored in images
+  // is parsed from the same file read, unless all frames are indexed.
+  FrameScaleSelector scaleSelector( &inputArgs[0], queue.Jobs );
 
-    // Checks if user entered EXIT command in training mode
-    if( settings.IsTrainingMode && trainingExitFlag )
+  ImagePrefetcher prefetcher( inputFilenames,
+    std::max( settings.PrefetchDepth, 0 ),
+    std::max( settings.PrefetchThreads, 0 ),
+    settings.ScaledDecoding ? &scaleSelector : NULL,
+    metadataInImages && indexedCount < queue.Jobs.size() );
+
+  queue.Images = &prefetcher;
+
+  // Launch one worker per thread, each with its own algorithm inputs.
+  // If threading is disabled, each launch runs to completion in turn, so
+  // the first worker processes every frame. In intra-frame mode, a single
+  // worker processes frames in turn and parallelizes within each one.
+  // Training shares one session (and its user prompts and sample output)
+  // across all frames, so frames are always processed in turn.
+  int workerCount = std::min( threadCount, (int)inputFilenames.size() );
+
+  if( settings.IntraFrameThreading || settings.IsTrainingMode )
+  {
+    workerCount = 1;
+  }
+
+  vector< WorkerArgs > workers( workerCount );
+  vector< ThreadHandle > handles( workerCount );
+  int launched = 0;
+
+  for( int i=0; i<workerCount; i++ )
+  {
+    inputArgs[i].ThreadID = i;
+    workers[i].Args = &inputArgs[i];
+    workers[i].Queue = &queue;
+
+    if( !launchThread( handles[i], processFrameQueue, &workers[i] ) )
     {
+      cerr << "WARNING: Unable to launch worker thread " << i << endl;
       break;
     }
+
+    launched++;
+  }
+
+  if( launched == 0 )
+  {
+    processFrameQueue( &workers[0] );
   }
 
+  for( int i=0; i<launched; i++ )
+  {
+    joinThread( handles[i] );
+  }
+
+  prefetcher.stop();
+
+  // Write any remaining detections
+  if( queue.ListWriter )
+  {
+    queue.ListWriter->close();
+    delete queue.ListWriter;
+  }
+
+#ifdef ENABLE_BENCHMARKING
+  if( settings.PrefetchDepth > 0 )
+  {
+    cout << endl;
+    prefetcher.printStats( cout );
+  }
+
+  if( settings.UseImageArena )
+  {
+    ImageArenaStats arenaStats;
+
+    for( int i=0; i < threadCount; i++ ) {
+      arenaStats.add( inputArgs[i].Arena->getStats() );
+    }
+
+    arenaStats.print( cout );
+  }
+
+  printCandidatePoolStats( cout );
+#endif
+
   // Deallocate algorithm inputs
-  for( int i=0; i < THREADS; i++ ) {
+  for( int i=0; i < threadCount; i++ ) {
     delete inputArgs[i].Stats;
     delete inputArgs[i].CC;
+    for( unsigned j=0; j < inputArgs[i].TileCC.size(); j++ ) {
+      delete inputArgs[i].TileCC[j];
+    }
+    delete inputArgs[i].Arena;
   }
   delete[] inputArgs;
 
@@ -952,6 +1857,13 @@ int runCoreDetector( const SystemParameters& settings )
     p++;
   }
 
+  map< string, ThreadMutex* >::iterator l = classifierLocks.begin();
+  while( l != classifierLocks.end() )
+  {
+    delete l->second;
+    l++;
+  }
+
   // Remove output display window
   if( settings.EnableOutputDisplay )
   {
@@ -966,7 +1878,7 @@ int runCoreDetector( const SystemParameters& settings )
   // Close gui-training mode
   if( settings.IsTrainingMode && !settings.UseFileForTraining )
   {
-    exitTrainingMode();
+    exitTrainingMode( training );
   }
 
   // Deallocate GT info if in training mode
@@ -986,22 +1898,147 @@ public:
   explicit Priv( const SystemParameters& sets );
   ~Priv();
 
+  // Behaviour of submit when the submission queue is full
+  enum QueuePolicy
+  {
+    QUEUE_BLOCK,
+    QUEUE_DROP_OLDEST,
+    QUEUE_REJECT
+  };
+
+  // A submitted frame waiting to be processed
+  struct SubmittedFrame
+  {
+    FrameTicket ticket;
+    cv::Mat image;
+    FrameMetadata meta;
+    unsigned index;
+    std::string id;
+  };
+
+  // Outcome of a submitted frame, until collected
+  struct TicketState
+  {
+    TicketStatus status;
+    std::vector< Detection > detections;
+    std::string error;
+  };
+
+  // A batch of frames being processed by one processFrames call, shared by
+  // the threads working on it. Each call has its own, so several batches may
+  // be in flight at once.
+  struct BatchContext
+  {
+    Priv *owner;
+    const std::vector< cv::Mat > *frames;
+    const std::vector< FrameMetadata > *metadata;
+    std::vector< std::string > ids;
+    std::vector< unsigned > indices;
+
+    // Guards the entries below
+    ThreadMutex lock;
+    std::vector< std::vector< Detection > > results;
+    std::vector< std::string > errors;
+    unsigned next;
+  };
+
+  // Reserve a free set of algorithm arguments, blocking until one is
+  // available, and return it to the pool afterwards
+  int acquireSlot();
+  void releaseSlot( int slot );
+
+  // Run the detector on a single frame using the given slot, returns false
+  // and sets error on failure. Stereo views are never cropped to their left
+  // half, unlike side-by-side input.
+  bool processSlot( int slot, const cv::Mat& image, bool stereoView,
+    const FrameMetadata& meta, const std::string& id,
+    std::vector< Detection >& output, std::string& error );
+
+  // Generate the next streaming frame ID, and its index in the output list
+  std::string nextFrameID( unsigned& index );
+
+  // Queue a copy of the detections for a frame for the output list, if
+  // enabled. Every frame index must be written, even if with no detections.
+  void writeList( unsigned index, const std::vector< Detection >& detections,
+    const std::string& id );
+
+  // Process frames from the given batch until none remain
+  void processBatch( BatchContext& batch );
+
+  // Process frames from the submission queue until stopped
+  void processSubmissions();
+
+  // Worker thread entry points for the above, taking a BatchContext and
+  // a Priv respectively
+  static void *processBatchThread( void *arg );
+  static void *processSubmissionsThread( void *arg );
+
   Classifier* classifier;
+  ThreadMutex classifierLock;
   AlgorithmArgs *inputArgs;
   SystemParameters settings;
+  string listFilename;
+  DetectionWriter *listWriter;
+  int threadCount;
+
+  // Guards the frame counter and the benchmarking output file
+  ThreadMutex outputLock;
   unsigned counter;
+#ifdef ENABLE_BENCHMARKING
+  ofstream benchmarkingOutput;
+#endif
+
+  // Unused algorithm argument slots
+  ThreadMutex slotLock;
+  ThreadCondition slotReady;
+  std::vector< int > freeSlots;
+
+  // Submission queue and uncollected tickets, guarded by queueLock
+  ThreadMutex queueLock;
+  ThreadCondition queueSpace;
+  ThreadCondition queueWork;
+  ThreadCondition ticketDone;
+  std::deque< SubmittedFrame > submitQueue;
+  std::map< FrameTicket, TicketState > tickets;
+  FrameTicket nextTicket;
+  unsigned queueDepth;
+  QueuePolicy queuePolicy;
+  bool stopping;
+  std::vector< ThreadHandle > submitWorkers;
 };
 
 CoreDetector::Priv::Priv( const SystemParameters& sets )
 {
   counter = 0;
+  nextTicket = 0;
+  stopping = false;
+  listWriter = NULL;
 
   // Retrieve some contents from input
   settings = sets;
   string outputDir = settings.OutputDirectory;
   string outputFile = settings.OutputFilename;
-  string listFilename = outputDir + outputFile;
-  THREADS = settings.NumThreads;
+  listFilename = outputDir + outputFile;
+  threadCount = std::max( settings.NumThreads, 1 );
+
+  // Configure submission queue
+  queueDepth = std::max( settings.SubmitQueueDepth, 1 );
+
+  if( settings.SubmitQueuePolicy == "block" ) {
+    queuePolicy = QUEUE_BLOCK;
+  } else if( settings.SubmitQueuePolicy == "drop_oldest" ) {
+    queuePolicy = QUEUE_DROP_OLDEST;
+  } else if( settings.SubmitQueuePolicy == "reject" ) {
+    queuePolicy = QUEUE_REJECT;
+  } else {
+    throw std::runtime_error( "Invalid submit queue policy " + settings.SubmitQueuePolicy );
+  }
+
+  DetectionWriter::SyncPolicy listSync;
+
+  if( !DetectionWriter::parseSyncPolicy( settings.ListSyncPolicy, listSync ) ) {
+    throw std::runtime_error( "Invalid list sync policy " + settings.ListSyncPolicy );
+  }
 
   // Check to make sure we can open the output file (and flush contents)
   if( settings.OutputList && !listFilename.empty() ) {
@@ -1014,7 +2051,6 @@ CoreDetector::Priv::Priv( const SystemParameters& sets )
 
 #ifdef ENABLE_BENCHMARKING
   // Initialize Timing Statistics
-  initializeTimer();
   benchmarkingOutput.open( BenchmarkingFilename.c_str() );
 
   if( !benchmarkingOutput.is_open() ) {
@@ -1038,40 +2074,67 @@ CoreDetector::Priv::Priv( const SystemParameters& sets )
     throw std::runtime_error( "Unabled to load classifier " + settings.ClassifierToUse );
   }
 
+  // Extra color filters are required to process multiple tiles at once
+  int tileThreads = 1;
+
+  if( settings.TileSize > 0 && !settings.IsTrainingMode && THREADING_ENABLED )
+  {
+    tileThreads = std::min( std::max( settings.TileThreads, 1 ), MAX_THREADS );
+  }
+
   // Load Statistics/Color filters
   cout << "Loading Colour Filters... ";
-  inputArgs = new AlgorithmArgs[THREADS];
+  inputArgs = new AlgorithmArgs[threadCount];
 
-  for( int i=0; i < THREADS; i++ )
+  for( int i=0; i < threadCount; i++ )
   {
     inputArgs[i].CC = new ColorClassifier;
     inputArgs[i].Stats = new ThreadStatistics;
 
-    if( !inputArgs[i].CC->loadFilters( settings.RootColorDIR, DEFAULT_COLORBANK_EXT ) ) {
+    if( !inputArgs[i].CC->loadFilters( settings.RootColorDIR, DEFAULT_COLORBANK_EXT ) ||
+        !inputArgs[i].CC->useCompactFilters( settings.CompactColorFilters ) ) {
       throw std::runtime_error( "Could not load colour filters" );
     }
+
+    for( int j=1; j < tileThreads; j++ ) {
+      inputArgs[i].TileCC.push_back( new ColorClassifier );
+
+      if( !inputArgs[i].TileCC.back()->loadFilters( settings.RootColorDIR, DEFAULT_COLORBANK_EXT ) ||
+          !inputArgs[i].TileCC.back()->useCompactFilters( settings.CompactColorFilters ) ) {
+        throw std::runtime_error( "Could not load colour filters" );
+      }
+    }
+  }
+
+  for( int i=0; i < threadCount; i++ ) {
+    inputArgs[i].CC->setSaliencyStride( settings.SaliencySampleStride );
+    for( unsigned j=0; j < inputArgs[i].TileCC.size(); j++ ) {
+      inputArgs[i].TileCC[j]->setSaliencyStride( settings.SaliencySampleStride );
+    }
   }
 
   cout << "FINISHED" << std::endl;
 
+  // Drift of the compact filters is reported from the first frame
+  inputArgs[0].ReportCompactDrift = ( settings.CompactColorFilters > 0 );
+
   // Configure algorithm input based on settings
-  for( int i=0; i<THREADS; i++ )
+  for( int i=0; i<threadCount; i++ )
   {
     // Set thread output options
     inputArgs[i].IsTrainingMode = settings.IsTrainingMode;
     inputArgs[i].Model = classifier;
+    inputArgs[i].ModelLock = ( classifier->isThreadSafe() ? NULL : &classifierLock );
     inputArgs[i].UseGTData = settings.UseFileForTraining;
     inputArgs[i].TrainingPercentKeep = settings.TrainingPercentKeep;
     inputArgs[i].ProcessBorderPoints = settings.LookAtBorderPoints;
     inputArgs[i].GTData = NULL;
-    inputArgs[i].EnableListOutput = settings.OutputList;
     inputArgs[i].OutputDuplicateClass = settings.OutputDuplicateClass;
     inputArgs[i].OutputProposalImages = settings.OutputProposalImages;
     inputArgs[i].OutputDetectionImages = settings.OutputDetectionImages;
     inputArgs[i].EnableOutputDisplay = settings.EnableOutputDisplay;
     inputArgs[i].ScallopMode = true;
     inputArgs[i].MetadataProvided = !settings.IsMetadataInImage && !settings.IsInputDirectory;
-    inputArgs[i].ListFilename = listFilename;
     inputArgs[i].FocalLength = settings.FocalLength;
     inputArgs[i].MinSearchRadiusMeters = settings.MinSearchRadiusMeters;
     inputArgs[i].MaxSearchRadiusMeters = settings.MaxSearchRadiusMeters;
@@ -1079,6 +2142,13 @@ CoreDetector::Priv::Priv( const SystemParameters& sets )
     inputArgs[i].MaxSearchRadiusPixels = settings.MaxSearchRadiusPixels;
     inputArgs[i].UseMetadata = settings.UseMetadata;
     inputArgs[i].ProcessLeftHalfOnly = settings.ProcessLeftHalfOnly;
+    inputArgs[i].ParallelProposals = settings.IntraFrameThreading;
+    inputArgs[i].FeatureThreads = ( settings.IntraFrameThreading ? threadCount : 1 );
+    inputArgs[i].AdaptiveThresholdLevels = settings.AdaptiveThresholdLevels;
+    inputArgs[i].TileSize = settings.TileSize;
+    inputArgs[i].Arena = ( settings.UseImageArena ? new ImageArena : NULL );
+
+    freeSlots.push_back( i );
   }
 
   // Initiate display window for output
@@ -1087,16 +2157,54 @@ CoreDetector::Priv::Priv( const SystemParameters& sets )
     initOutputDisplay();
   }
 
+  // Start output list writer
+  if( settings.OutputList && !listFilename.empty() )
+  {
+    listWriter = new DetectionWriter( listFilename, settings.OrderedListOutput,
+      std::max( settings.ListFlushFrames, 1 ), settings.ListFlushSeconds, listSync );
+  }
+
   // Cycle through all input files
   cout << endl << "Ready to Process Files" << endl;
 }
 
 CoreDetector::Priv::~Priv()
 {
+  // Stop submission workers, frames not yet started are dropped
+  queueLock.lock();
+  stopping = true;
+
+  while( !submitQueue.empty() )
+  {
+    tickets[ submitQueue.front().ticket ].status = TICKET_DROPPED;
+    submitQueue.pop_front();
+  }
+
+  queueWork.broadcast();
+  queueSpace.broadcast();
+  ticketDone.broadcast();
+  queueLock.unlock();
+
+  for( unsigned i=0; i < submitWorkers.size(); i++ )
+  {
+    joinThread( submitWorkers[i] );
+  }
+
+  // Write any remaining detections
+  if( listWriter )
+  {
+    listWriter->close();
+    delete listWriter;
+  }
+
   // Deallocate algorithm inputs
-  for( int i=0; i < THREADS; i++ ) {
+  for( int i=0; i < threadCount; i++ ) {
     delete inputArgs[i].Stats;
     delete inputArgs[i].CC;
+    for( unsigned j=0; j < inputArgs[i].TileCC.size(); j++ ) {
+      delete inputArgs[i].TileCC[j];
+    }
+    delete inputArgs[i].Arena;
   }
 
   delete[] inputArgs;
@@ -1144,61 +2252,511 @@ CoreDetector::~CoreDetector()
   }
 }
 
-std::vector< Detection >
-CoreDetector::processFrame( const cv::Mat& image,
- float pitch, float roll, float altitude )
+int CoreDetector::Priv::acquireSlot()
 {
-  data->counter++;
-  std::string frameID = "streaming_frame_" + INT_2_STR( data->counter );
+  slotLock.lock();
+
+  while( freeSlots.empty() )
+  {
+    slotReady.wait( slotLock );
+  }
 
-  cv::Mat corrected;
-  cv::cvtColor( image, corrected, cv::COLOR_RGB2BGR );
+  int slot = freeSlots.back();
+  freeSlots.pop_back();
+
+  slotLock.unlock();
+  return slot;
+}
+
+void CoreDetector::Priv::releaseSlot( int slot )
+{
+  slotLock.lock();
+  freeSlots.push_back( slot );
+  slotReady.signal();
+  slotLock.unlock();
+}
 
-  data->inputArgs[0].InputImage = corrected;
-  data->inputArgs[0].InputFilename = frameID;
-  data->inputArgs[0].OutputFilename = frameID;
-  data->inputArgs[0].InputFilenameNoDir = frameID;
+std::string CoreDetector::Priv::nextFrameID( unsigned& index )
+{
+  outputLock.lock();
+  index = counter++;
+  outputLock.unlock();
+  return "streaming_frame_" + INT_2_STR( index + 1 );
+}
 
-  if( pitch != 0.0f || roll != 0.0f || altitude != 0.0f )
+void CoreDetector::Priv::writeList( unsigned index,
+  const std::vector< Detection >& detections, const std::string& id )
+{
+  if( listWriter )
   {
-    data->inputArgs[0].MetadataProvided = true;
-    data->inputArgs[0].Pitch = pitch;
-    data->inputArgs[0].Roll = roll;
-    data->inputArgs[0].Altitude = altitude;
+    std::vector< Detection > copy( detections );
+    listWriter->write( index, copy, id );
   }
-  else
+}
+
+bool CoreDetector::Priv::processSlot( int slot, const cv::Mat& image,
+  bool stereoView, const FrameMetadata& meta, const std::string& id,
+  std::vector< Detection >& output, std::string& error )
+{
+  AlgorithmArgs& args = inputArgs[slot];
+
+  try
+  {
+    // Images are shared, not copied, RGB input is swapped to BGR during
+    // conversion to floating point instead
+    args.InputImage = image;
+    args.InputFullSize = cv::Size();
+    args.InputMetadata = ImageMetadata();
+    args.IsStereoView = stereoView;
+    args.InputIsRGB = true;
+    args.InputFilename = id;
+    args.OutputFilename = id;
+    args.InputFilenameNoDir = id;
+
+    if( meta.pitch != 0.0f || meta.roll != 0.0f || meta.altitude != 0.0f )
+    {
+      args.MetadataProvided = true;
+      args.Pitch = meta.pitch;
+      args.Roll = meta.roll;
+      args.Altitude = meta.altitude;
+    }
+    else
+    {
+      args.MetadataProvided = false;
+    }
+
+    // Execute processing
+    args.FinalDetections.clear();
+    processImage( &args );
+  }
+  catch( const std::exception& e )
   {
-    data->inputArgs[0].MetadataProvided = false;
+    args.InputImage.release();
+    error = e.what();
+    return false;
   }
 
-  // Execute processing
-  processImage( data->inputArgs );
+  args.InputImage.release();
+
+  // Get output from input args
+  output.swap( args.FinalDetections );
 
 #ifdef ENABLE_BENCHMARKING
   // Output benchmarking results to file
-  for( unsigned int i=0; i<executionTimes.size(); i++ )
-    benchmarkingOutput << executionTimes[i] << " ";
+  outputLock.lock();
+  for( unsigned int i=0; i<args.ExecutionTimes.size(); i++ )
+    benchmarkingOutput << args.ExecutionTimes[i] << " ";
   benchmarkingOutput << endl;
+  outputLock.unlock();
 #endif
 
-   // Get output from input args
-  return data->inputArgs->FinalDetections;
+  return true;
+}
+
+void CoreDetector::Priv::processBatch( BatchContext& batch )
+{
+  int slot = acquireSlot();
+
+  while( true )
+  {
+    // Claim the next frame
+    batch.lock.lock();
+
+    if( batch.next >= batch.frames->size() )
+    {
+      batch.lock.unlock();
+      break;
+    }
+
+    unsigned id = batch.next++;
+
+    batch.lock.unlock();
+
+    FrameMetadata meta;
+
+    if( !batch.metadata->empty() )
+    {
+      meta = (*batch.metadata)[id];
+    }
+
+    std::vector< Detection > output;
+    std::string error;
+
+    bool success = processSlot( slot, (*batch.frames)[id], false, meta,
+      batch.ids[id], output, error );
+
+    batch.lock.lock();
+
+    if( success )
+    {
+      batch.results[id].swap( output );
+    }
+    else
+    {
+      batch.errors[id] = ( error.empty() ? "Unknown error" : error );
+    }
+
+    batch.lock.unlock();
+  }
+
+  releaseSlot( slot );
+}
+
+void CoreDetector::Priv::processSubmissions()
+{
+  queueLock.lock();
+
+  while( true )
+  {
+    // Wait for the next submitted frame
+    while( submitQueue.empty() && !stopping )
+    {
+      queueWork.wait( queueLock );
+    }
+
+    if( stopping )
+    {
+      break;
+    }
+
+    SubmittedFrame frame = submitQueue.front();
+    submitQueue.pop_front();
+    queueSpace.signal();
+
+    queueLock.unlock();
+
+    // Process frame without holding the queue lock
+    int slot = acquireSlot();
+
+    std::vector< Detection > output;
+    std::string error;
+
+    bool success = processSlot( slot, frame.image, false, frame.meta,
+      frame.id, output, error );
+
+    releaseSlot( slot );
+    frame.image.release();
+
+    writeList( frame.index, output, frame.id );
+
+    queueLock.lock();
+
+    TicketState& state = tickets[frame.ticket];
+    state.status = ( success ? TICKET_DONE : TICKET_FAILED );
+    state.detections.swap( output );
+    state.error = error;
+
+    ticketDone.broadcast();
+  }
+
+  queueLock.unlock();
+}
+
+void *CoreDetector::Priv::processBatchThread( void *arg )
+{
+  BatchContext *batch = (BatchContext*) arg;
+  batch->owner->processBatch( *batch );
+  return NULL;
+}
+
+void *CoreDetector::Priv::processSubmissionsThread( void *arg )
+{
+  ((Priv*) arg)->processSubmissions();
+  return NULL;
+}
+
+std::vector< std::vector< Detection > >
+CoreDetector::processFrames( const std::vector< cv::Mat >& images,
+  const std::vector< FrameMetadata >& metadata,
+  std::vector< std::string >* errors )
+{
+  if( !metadata.empty() && metadata.size() != images.size() )
+  {
+    throw std::runtime_error( "Metadata count does not match frame count" );
+  }
+
+  // Assign frame IDs in input order
+  Priv::BatchContext batch;
+  batch.owner = data;
+  batch.frames = &images;
+  batch.metadata = &metadata;
+  batch.ids.resize( images.size() );
+  batch.indices.resize( images.size() );
+  batch.results.resize( images.size() );
+  batch.errors.resize( images.size() );
+  batch.next = 0;
+
+  for( unsigned i=0; i<images.size(); i++ )
+  {
+    batch.ids[i] = data->nextFrameID( batch.indices[i] );
+  }
+
+  // Spread frames across worker slots, the calling thread takes one.
+  // In intra-frame mode frames are processed one at a time instead.
+  int workerCount = std::min( data->threadCount, (int)images.size() );
+
+  if( data->settings.IntraFrameThreading || !THREADING_ENABLED )
+  {
+    workerCount = 1;
+  }
+
+  vector< ThreadHandle > handles( std::max( workerCount, 1 ) );
+  int launched = 0;
+
+  for( int i=1; i<workerCount; i++ )
+  {
+    if( !launchThread( handles[i], Priv::processBatchThread, &batch ) )
+    {
+      break;
+    }
+
+    launched++;
+  }
+
+  data->processBatch( batch );
+
+  for( int i=1; i<=launched; i++ )
+  {
+    joinThread( handles[i] );
+  }
+
+  // Write detections to output list, including any failed frames
+  for( unsigned i=0; i<images.size(); i++ )
+  {
+    data->writeList( batch.indices[i], batch.results[i], batch.ids[i] );
+  }
+
+  // Report failed frames, which are left without detections
+  if( errors )
+  {
+    errors->swap( batch.errors );
+  }
+  else
+  {
+    for( unsigned i=0; i<images.size(); i++ )
+    {
+      if( !batch.errors[i].empty() )
+      {
+        cerr << "ERROR: Unable to process " << batch.ids[i] << ": "
+             << batch.errors[i] << endl;
+      }
+    }
+  }
+
+  std::vector< std::vector< Detection > > output;
+  output.swap( batch.results );
+  return output;
+}
+
+std::vector< Detection >
+CoreDetector::processFrame( const cv::Mat& image,
+ float pitch, float roll, float altitude )
+{
+  std::vector< cv::Mat > images( 1, image );
+  std::vector< FrameMetadata > metadata( 1, FrameMetadata( pitch, roll, altitude ) );
+  std::vector< std::string > errors;
+
+  std::vector< std::vector< Detection > > output =
+    processFrames( images, metadata, &errors );
+
+  if( !errors[0].empty() )
+  {
+    throw std::runtime_error( errors[0] );
+  }
+
+  return output[0];
+}
+
+FrameTicket
+CoreDetector::submit( const cv::Mat& image,
+  float pitch, float roll, float altitude )
+{
+  Priv::SubmittedFrame frame;
+  frame.image = image;
+  frame.meta = FrameMetadata( pitch, roll, altitude );
+
+  // Without threading support, process the frame immediately
+  if( !THREADING_ENABLED )
+  {
+    frame.ticket = data->nextTicket++;
+    frame.id = data->nextFrameID( frame.index );
+
+    Priv::TicketState& state = data->tickets[frame.ticket];
+
+    int slot = data->acquireSlot();
+
+    bool success = data->processSlot( slot, frame.image, false, frame.meta,
+      frame.id, state.detections, state.error );
+
+    data->releaseSlot( slot );
+    data->writeList( frame.index, state.detections, frame.id );
+
+    state.status = ( success ? TICKET_DONE : TICKET_FAILED );
+    return frame.ticket;
+  }
+
+  data->queueLock.lock();
+
+  // Launch workers on first use, one per algorithm slot
+  if( data->submitWorkers.empty() )
+  {
+    int workerCount = ( data->settings.IntraFrameThreading ? 1 : data->threadCount );
+
+    for( int i=0; i<workerCount; i++ )
+    {
+      ThreadHandle handle;
+
+      if( !launchThread( handle, Priv::processSubmissionsThread, data ) )
+      {
+        break;
+      }
+
+      data->submitWorkers.push_back( handle );
+    }
+
+    if( data->submitWorkers.empty() )
+    {
+      data->queueLock.unlock();
+      throw std::runtime_error( "Unable to launch submission threads" );
+    }
+  }
+
+  frame.ticket = data->nextTicket++;
+
+  // Apply full queue policy
+  if( data->submitQueue.size() >= data->queueDepth )
+  {
+    if( data->queuePolicy == Priv::QUEUE_REJECT )
+    {
+      data->tickets[frame.ticket].status = TICKET_REJECTED;
+      data->queueLock.unlock();
+      return frame.ticket;
+    }
+    else if( data->queuePolicy == Priv::QUEUE_DROP_OLDEST )
+    {
+      while( data->submitQueue.size() >= data->queueDepth )
+      {
+        Priv::SubmittedFrame& oldest = data->submitQueue.front();
+        data->tickets[ oldest.ticket ].status = TICKET_DROPPED;
+        data->writeList( oldest.index, std::vector< Detection >(), oldest.id );
+        data->submitQueue.pop_front();
+      }
+
+      data->ticketDone.broadcast();
+    }
+    else
+    {
+      while( data->submitQueue.size() >= data->queueDepth && !data->stopping )
+      {
+        data->queueSpace.wait( data->queueLock );
+      }
+    }
+  }
+
+  frame.id = data->nextFrameID( frame.index );
+  data->tickets[frame.ticket].status = TICKET_PENDING;
+  data->submitQueue.push_back( frame );
+  data->queueWork.signal();
+
+  data->queueLock.unlock();
+  return frame.ticket;
+}
+
+TicketStatus
+CoreDetector::collect( FrameTicket ticket,
+  std::vector< Detection >& detections, bool wait )
+{
+  data->queueLock.lock();
+
+  std::map< FrameTicket, Priv::TicketState >::iterator itr =
+    data->tickets.find( ticket );
+
+  while( wait && itr != data->tickets.end() &&
+         itr->second.status == TICKET_PENDING )
+  {
+    data->ticketDone.wait( data->queueLock );
+    itr = data->tickets.find( ticket );
+  }
+
+  if( itr == data->tickets.end() )
+  {
+    data->queueLock.unlock();
+    return TICKET_UNKNOWN;
+  }
+
+  TicketStatus status = itr->second.status;
+  std::string error = itr->second.error;
+
+  // Release finished tickets once collected
+  if( status != TICKET_PENDING )
+  {
+    detections.swap( itr->second.detections );
+    data->tickets.erase( itr );
+  }
+
+  data->queueLock.unlock();
+
+  if( status == TICKET_FAILED )
+  {
+    throw std::runtime_error( error );
+  }
+
+  return status;
 }
 
 std::vector< Detection >
 CoreDetector::processFrame( const cv::Mat& leftImage,
   const cv::Mat& rightImage, float pitch, float roll, float altitude )
 {
-  cv::Size leftSize = leftImage.size();
-  cv::Size rightSize = rightImage.size();
+  if( leftImage.empty() || rightImage.empty() )
+  {
+    throw std::runtime_error( "Invalid stereo image pair" );
+  }
+
+  // Both images are processed as views without being merged. Unless only
+  // the left half is wanted, detections from the right view are appended
+  // with columns offset by the left width, as for side-by-side input.
+  unsigned index;
+  std::string id = data->nextFrameID( index );
+  FrameMetadata meta( pitch, roll, altitude );
+  std::vector< Detection > output;
+  std::string error;
 
-  Mat merged( leftSize.height, leftSize.width + rightSize.width, leftImage.depth() );
-  Mat left( merged, cv::Rect( 0, 0, leftSize.width, leftSize.height ) );
-  leftImage.copyTo( left );
-  Mat right( merged, cv::Rect( leftSize.width, 0, rightSize.width, rightSize.height ) );
-  rightImage.copyTo( right );
+  int slot = data->acquireSlot();
+
+  bool success = data->processSlot( slot, leftImage, true, meta, id,
+    output, error );
+
+  if( success && !data->settings.ProcessLeftHalfOnly )
+  {
+    std::vector< Detection > rightOutput;
+
+    success = data->processSlot( slot, rightImage, true, meta,
+      id + "_right", rightOutput, error );
+
+    for( unsigned i=0; i<rightOutput.size(); i++ )
+    {
+      Detection& det = rightOutput[i];
+      det.c += leftImage.cols;
+
+      for( unsigned j=0; j<det.cntr.pts.size(); j++ )
+      {
+        det.cntr.pts[j].c += leftImage.cols;
+      }
+
+      output.push_back( det );
+    }
+  }
+
+  data->releaseSlot( slot );
+  data->writeList( index, output, id );
+
+  if( !success )
+  {
+    throw std::runtime_error( error );
+  }
 
-  return processFrame( merged, pitch, roll, altitude );
+  return output;
 }
 
 std::vector< Detection >
@@ -25,6 +25,32 @@ namespace ScallopTK
 // also contains the main model training subroutine option.
 int runCoreDetector( const SystemParameters& settings );
 
+// Optional platform metadata for a single frame, leave all values as
+// the defaults if it is not known
+struct FrameMetadata
+{
+  float pitch;
+  float roll;
+  float altitude;
+
+  FrameMetadata( float p = 0.0f, float r = 0.0f, float a = 0.0f )
+   : pitch( p ), roll( r ), altitude( a ) {}
+};
+
+// Identifier for a frame given to CoreDetector::submit
+typedef unsigned FrameTicket;
+
+// State of a submitted frame
+enum TicketStatus
+{
+  TICKET_PENDING,  // Queued or being processed
+  TICKET_DONE,     // Processed, detections available
+  TICKET_DROPPED,  // Removed from a full queue before processing
+  TICKET_REJECTED, // Not accepted because the queue was full
+  TICKET_FAILED,   // Processing failed
+  TICKET_UNKNOWN   // Invalid or already collected ticket
+};
+
 // Streaming class definition, for use by external programs
 //
 // This function should be called if an external library wants
@@ -61,8 +87,46 @@ public:
   std::vector< Detection > processFrame( std::string filename,
     float pitch = 0.0f, float roll = 0.0f, float altitude = 0.0f  );
 
+  // Process a batch of frames, spreading them across the detector's
+  // worker threads, and return their detections in input order. Metadata
+  // should either be empty or contain one entry per frame. A frame which
+  // fails is returned without detections and doesn't affect the others;
+  // if errors is given it receives one message per frame (empty for those
+  // which succeeded), otherwise failures are printed to stderr. Batches may
+  // be processed from several threads at once.
+  //
+  // Throws runtime_error exception on invalid metadata
+  std::vector< std::vector< Detection > > processFrames(
+    const std::vector< cv::Mat >& images,
+    const std::vector< FrameMetadata >& metadata =
+      std::vector< FrameMetadata >(),
+    std::vector< std::string >* errors = NULL );
+
+  // Queue a frame for processing on background threads and return
+  // immediately with a ticket for collecting its results. The image data is
+  // shared rather than copied, so it must not be modified until the ticket
+  // completes. When submit_queue_depth frames are already waiting, the
+  // submit_queue_policy setting decides whether to block, drop the oldest
+  // waiting frame, or reject this one.
+  //
+  // Throws runtime_error exception if worker threads can't be launched
+  FrameTicket submit( const cv::Mat& image,
+    float pitch = 0.0f, float roll = 0.0f, float altitude = 0.0f );
+
+  // Retrieve the status of a submitted frame, optionally waiting for it to
+  // finish. Once finished, detections are returned (if any) and the ticket
+  // is released, so later calls for it will return TICKET_UNKNOWN.
+  //
+  // Throws runtime_error exception if processing of the frame failed
+  TicketStatus collect( FrameTicket ticket,
+    std::vector< Detection >& detections, bool wait = true );
+
   // Process a new stereo frame given an image and platform metadata
-  // if it is known (otherwise leave it all values as the defaults)
+  // if it is known (otherwise leave it all values as the defaults).
+  // Neither image is copied. If process_left_half_only is set only the left
+  // image is processed, otherwise both are and the right image's detections
+  // follow the left's, with columns offset by the left image width as if
+  // the pair were side-by-side.
   //
   // Throws runtime_error exception on critical failure
   std::vector< Detection > processFrame( const cv::Mat& leftImage,
@@ -2,8 +2,11 @@
 #include "ImageProperties.h"
 
 #include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/ImageDecoding.h"
 #include "ScallopTK/TPL/Homography/ScottCamera.h"
 
+#include <algorithm>
+
 using namespace std;
 
 //------------------------------------------------------------------------------
@@ -13,6 +16,107 @@ using namespace std;
 namespace ScallopTK
 {
 
+// Number of bytes at the end of TIFF files searched for metadata
+const int TIFF_META_SEARCH_BYTES = 4408;
+
+// Parse metadata from the text of a single JPEG header segment
+static bool parseJpegMetadataText( const string& text, ImageMetadata& output ) {
+
+  istringstream stream( text );
+
+  // Read until we hit 'IMTAKE'
+  string word;
+  int type = 0;
+  while( stream >> word ) {
+    if( word == "IMTAKE" ) {
+      type = 1;
+      break;
+    } else if( word == "alt," ) {
+      type = 2;
+      break;
+    }
+  }
+
+  // Read in required variables
+  if( type == 1 ) {
+    stream >> word; //Date (unused)
+    stream >> word; //Time (unused)
+    stream >> word; //Filename (unused)
+    stream >> output.altitude; //Altitude
+    stream >> output.depth; //Depth
+    stream >> output.heading; //Head
+    stream >> output.pitch; //Pitch
+    stream >> output.roll; //Roll
+    return !stream.fail();
+  } else if ( type == 2 ) {
+    stream >> word;
+    word = word.substr( 0, word.length()-1 );
+    output.altitude = (float) atof( word.c_str() ); //Altitude
+    stream >> word >> word;
+    word = word.substr( 0, word.length()-1 );
+    output.depth = (float) atof( word.c_str() );
+    stream >> word >> word;
+    word = word.substr( 0, word.length()-1 );
+    output.heading = (float) atof( word.c_str() );
+    stream >> word >> word;
+    word = word.substr( 0, word.length()-1 );
+    output.pitch = (float) atof( word.c_str() );
+    stream >> word >> word;
+    word = word.substr( 0, word.length()-1 );
+    output.roll = (float) atof( word.c_str() );
+    return true;
+  }
+  return false;
+}
+
+// Parse metadata from the application and comment segments of a JPEG, which
+// precede the image data, searching at most MAX_META_SEARCH_BYTES
+static bool parseJpegMetadata( const unsigned char *data, size_t size,
+  ImageMetadata& output ) {
+
+  vector< JpegSegment > segments;
+  readJpegSegments( data, std::min( size, (size_t)MAX_META_SEARCH_BYTES ), segments );
+
+  for( unsigned i = 0; i < segments.size(); i++ ) {
+    const JpegSegment& segment = segments[i];
+
+    if( ( segment.marker >= 0xE0 && segment.marker <= 0xEF ) || segment.marker == 0xFE ) {
+      string text( (const char*)segment.data, segment.length );
+
+      if( parseJpegMetadataText( text, output ) )
+        return true;
+    }
+  }
+  return false;
+}
+
+// Parse metadata from the trailer of a TIFF file
+static bool parseTiffMetadata( const unsigned char *data, size_t size,
+  ImageMetadata& output ) {
+
+  istringstream stream( string( (const char*)data, size ) );
+
+  //Scan for start of header data
+  string word, first;
+  while( getline(stream,word,' ') ) {
+    stringstream ss(word);
+    getline(ss,first,'&');
+    if( first == "alt" )
+      ss >> output.altitude;
+    else if( first == "depth" )
+      ss >> output.depth;
+    else if( first == "head" )
+      ss >> output.heading;
+    else if( first == "pitch" )
+      ss >> output.pitch;
+    else if( first == "roll" ) {
+      ss >> output.roll;
+      return true;
+    }
+  }
+  return false;
+}
+
 // Loads metadata from file fn
 void ImageProperties::calculateImageProperties( const std::string& fn,
   const int& cols, const int& rows, const float& focalLength ) {
@@ -66,20 +170,23 @@ void ImageProperties::calculateImageProperties( const int& cols, const int& rows
   pixelWidth = avgPixelSize;
 }
 
-//Returns the type of the image (only identified via extension, not contents)
+// Scales dimensions for a sub-region of the image
+ImageProperties ImageProperties::getRegionProperties( float rowFraction,
+  float colFraction ) const {
+
+  ImageProperties output = *this;
+
+  output.imgRows = (int)( imgRows * rowFraction + 0.5f );
+  output.imgCols = (int)( imgCols * colFraction + 0.5f );
+  output.avgHeight = avgHeight * rowFraction;
+  output.avgWidth = avgWidth * colFraction;
+  output.estArea = estArea * rowFraction * colFraction;
+  return output;
+}
+
+//Returns the type of the image
 int ImageProperties::getImageType() { 
-  string ext = filename.substr(filename.find_last_of(".") + 1);
-  if( ext == "jpg" || ext == "JPG" )
-    return JPEG;
-  else if( ext == "tif" || ext == "TIF" )
-    return RAW_TIF;
-  else if( ext == "tiff" || ext == "TIFF" )
-    return RAW_TIFF;
-  else if( ext == "bmp" || ext == "BMP" )
-    return BMP;
-  else if( ext == "png" || ext == "PNG" )
-    return PNG;
-  return UNKNOWN;
+  return ScallopTK::getImageType( filename );
 }
 
 // Process metadata
@@ -100,7 +207,7 @@ void ImageProperties::calculateProperties() {
 bool ImageProperties::loadMetadata( const float& focal ) {
 
   // Open filestream
-  ifstream inFile( filename.c_str() );
+  ifstream inFile( filename.c_str(), ios::binary );
 
   // Check to make sure file opened
   if( !inFile.is_open() ) {
@@ -111,95 +218,49 @@ bool ImageProperties::loadMetadata( const float& focal ) {
   // Set focal length (is not hardcoded in file)
   focalLength = focal;
 
+  // Only read the portion of the file which is searched
+  inFile.seekg( 0, ios::end );
+  long fileSize = (long)inFile.tellg();
+  long start = 0, count = 0;
+
   if( imageType == JPEG ) {
+    count = std::min( fileSize, (long)MAX_META_SEARCH_BYTES );
+  } else if( imageType == RAW_TIF || imageType == RAW_TIFF ) {
+    start = std::max( fileSize - (long)TIFF_META_SEARCH_BYTES, 0L );
+    count = fileSize - start;
+  } else {
+    cerr << "ERROR: Metadata read fail\n";
+    return false;
+  }
 
-    // Read until we hit 'IMTAKE' 
-    string word;
-    int type = 0;
-    int counter = 0;
-    while(!inFile.eof()) {
-      inFile >> word;
-      counter++;
-      if( word == "IMTAKE" ) {
-        type = 1;
-        break;
-      } else if( word == "alt," ) {
-        type = 2;
-        break;
-      } else if( counter >= MAX_META_SEARCH_DEPTH ) {
-        return false;
-      }
-    }
+  if( count <= 0 ) {
+    return false;
+  }
 
-    // Read in required variables
-    if( type == 1 ) {
-      inFile >> word; //Date (unused)
-      inFile >> word; //Time (unused)
-      inFile >> word; //Filename (unused)
-      inFile >> altitude; //Altitude
-      inFile >> depth; //Depth
-      inFile >> heading; //Head
-      inFile >> pitch; //Pitch
-      inFile >> roll; //Roll
-    } else if ( type == 2 ) {
-      inFile >> word;
-      word = word.substr( 0, word.length()-1 );
-      altitude = (float) atof( word.c_str() ); //Altitude
-      inFile >> word >> word;
-      word = word.substr( 0, word.length()-1 );
-      depth = (float) atof( word.c_str() );
-      inFile >> word >> word;
-      word = word.substr( 0, word.length()-1 );
-      heading = (float) atof( word.c_str() );
-      inFile >> word >> word;
-      word = word.substr( 0, word.length()-1 );
-      pitch = (float) atof( word.c_str() );
-      inFile >> word >> word;
-      word = word.substr( 0, word.length()-1 );
-      roll = (float) atof( word.c_str() );
-    } else {
-      return false;
-    }
+  vector< unsigned char > contents( count );
+  inFile.seekg( start, ios::beg );
+  inFile.read( (char*)&contents[0], count );
+  inFile.close();
 
-  } else if( imageType == RAW_TIF || imageType == RAW_TIFF ) {
+  ImageMetadata metadata;
 
-    //Initial seek location from end of file
-    const int MAX_SEEK = 4408;
-    inFile.seekg(-MAX_SEEK, ios::end);
-
-    //Scan for start of header data
-    string word, first;
-    bool md_found = false;
-    while(!inFile.eof() && !md_found) {
-      getline(inFile,word,' ');
-      stringstream ss(word);
-      getline(ss,first,'&');
-      if( first == "alt" ) 
-        ss >> altitude;
-      else if( first == "depth" )
-        ss >> depth;
-      else if( first == "head" )
-        ss >> heading;
-      else if( first == "pitch" )
-        ss >> pitch;
-      else if( first == "roll" ) {
-        ss >> roll;
-        md_found = true;
-        break;
-      }
-    }
-    if( !md_found ) {
-      cerr << "ERROR: Metadata read fail\n";
-      return false;
-    }
+  if( imageType == JPEG ) {
+    metadata.valid = parseJpegMetadata( &contents[0], contents.size(), metadata );
   } else {
-    cerr << "ERROR: Metadata read fail\n";
-    inFile.close();
+    metadata.valid = parseTiffMetadata( &contents[0], contents.size(), metadata );
+  }
+
+  if( !metadata.valid ) {
+    if( imageType != JPEG )
+      cerr << "ERROR: Metadata read fail\n";
     return false;
   }
 
-  // Close filestream
-  inFile.close();
+  altitude = metadata.altitude;
+  depth = metadata.depth;
+  heading = metadata.heading;
+  pitch = metadata.pitch;
+  roll = metadata.roll;
 
   //Adjust for special circumstances (unreported data)
   if( heading == -999.99f )
@@ -212,4 +273,26 @@ bool ImageProperties::loadMetadata( const float& focal ) {
   return true;
 }
 
+bool parseImageMetadata( const std::string& filename,
+  const std::vector< unsigned char >& contents, ImageMetadata& output ) {
+
+  output = ImageMetadata();
+
+  if( contents.empty() ) {
+    return false;
+  }
+
+  int type = getImageType( filename );
+
+  if( type == JPEG ) {
+    output.valid = parseJpegMetadata( &contents[0], contents.size(), output );
+  } else if( type == RAW_TIF || type == RAW_TIFF ) {
+    size_t start = ( contents.size() > (size_t)TIFF_META_SEARCH_BYTES ?
+      contents.size() - TIFF_META_SEARCH_BYTES : 0 );
+    output.valid = parseTiffMetadata( &contents[start], contents.size() - start, output );
+  }
+
+  return output.valid;
+}
+
 }
@@ -11,6 +11,7 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 //Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
@@ -22,6 +23,25 @@
 namespace ScallopTK
 {
 
+// Camera pose stored within an image file
+struct ImageMetadata {
+
+  bool valid;
+  float altitude;
+  float depth;
+  float heading;
+  float pitch;
+  float roll;
+
+  ImageMetadata() : valid( false ), altitude( 0.0f ), depth( 0.0f ),
+    heading( 0.0f ), pitch( 0.0f ), roll( 0.0f ) {}
+};
+
+// Parse metadata from the contents of an image file already read into memory,
+// only the header segments of JPEGs and the trailer of TIFFs are searched
+bool parseImageMetadata( const std::string& filename,
+  const std::vector< unsigned char >& contents, ImageMetadata& output );
+
 // Estimates various image properties (GSD, i.e. Scale) from metadata.
 class ImageProperties {
 
@@ -45,6 +65,10 @@ public:
   // Destructor
   ~ImageProperties() {}
 
+  // Properties of a sub-region of the image covering the given fraction of
+  // its rows and columns, assuming the same average pixel size
+  ImageProperties getRegionProperties( float rowFraction, float colFraction ) const;
+
   // Accessors
   bool hasMetadata() { return isValid; }
   float getImgHeightMeters() { return avgHeight; }
@@ -0,0 +1,177 @@
+#include "MetadataIndex.h"
+
+#include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/ImageDecoding.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+//                            Function Definitions
+//------------------------------------------------------------------------------
+
+namespace ScallopTK
+{
+
+// File identifier and format version, entries are stored in native byte order
+const char INDEX_MAGIC[8] = { 'S', 'T', 'K', 'M', 'E', 'T', 'A', '\0' };
+const unsigned int INDEX_VERSION = 1;
+
+// Longest filename accepted when reading an index
+const unsigned int INDEX_MAX_NAME_LENGTH = 4096;
+
+// Index key for an image, its filename without directory
+static string indexKey( const string& filename ) {
+  return filename.substr( filename.find_last_of( "/\\" ) + 1 );
+}
+
+// Read or write a single value, returns false on failure
+template< typename T >
+static bool readValue( FILE *file, T& value ) {
+  return fread( &value, sizeof( T ), 1, file ) == 1;
+}
+
+template< typename T >
+static bool writeValue( FILE *file, const T& value ) {
+  return fwrite( &value, sizeof( T ), 1, file ) == 1;
+}
+
+bool MetadataIndex::load( const std::string& filename ) {
+
+  entries.clear();
+
+  FILE *file = fopen( filename.c_str(), "rb" );
+
+  if( !file ) {
+    return false;
+  }
+
+  char magic[8];
+  unsigned int version = 0, count = 0;
+
+  bool success = fread( magic, 1, 8, file ) == 8 &&
+    equal( magic, magic + 8, INDEX_MAGIC ) &&
+    readValue( file, version ) && version == INDEX_VERSION &&
+    readValue( file, count );
+
+  for( unsigned int i = 0; success && i < count; i++ ) {
+
+    unsigned int length = 0;
+    unsigned char valid = 0;
+    MetadataIndexEntry entry;
+
+    success = readValue( file, length ) && length > 0 &&
+      length <= INDEX_MAX_NAME_LENGTH;
+
+    if( !success ) {
+      break;
+    }
+
+    string name( length, ' ' );
+
+    success = fread( &name[0], 1, length, file ) == length &&
+      readValue( file, entry.cols ) &&
+      readValue( file, entry.rows ) &&
+      readValue( file, valid ) &&
+      readValue( file, entry.metadata.altitude ) &&
+      readValue( file, entry.metadata.depth ) &&
+      readValue( file, entry.metadata.heading ) &&
+      readValue( file, entry.metadata.pitch ) &&
+      readValue( file, entry.metadata.roll );
+
+    entry.metadata.valid = ( valid != 0 );
+    entries[ name ] = entry;
+  }
+
+  fclose( file );
+
+  if( !success ) {
+    cerr << "ERROR: Invalid metadata index " << filename << endl;
+    entries.clear();
+  }
+
+  return success;
+}
+
+bool MetadataIndex::save( const std::string& filename ) const {
+
+  FILE *file = fopen( filename.c_str(), "wb" );
+
+  if( !file ) {
+    return false;
+  }
+
+  bool success = fwrite( INDEX_MAGIC, 1, 8, file ) == 8 &&
+    writeValue( file, INDEX_VERSION ) &&
+    writeValue( file, (unsigned int)entries.size() );
+
+  for( map< string, MetadataIndexEntry >::const_iterator itr = entries.begin();
+       success && itr != entries.end(); itr++ ) {
+
+    const MetadataIndexEntry& entry = itr->second;
+
+    success = writeValue( file, (unsigned int)itr->first.size() ) &&
+      fwrite( itr->first.data(), 1, itr->first.size(), file ) == itr->first.size() &&
+      writeValue( file, entry.cols ) &&
+      writeValue( file, entry.rows ) &&
+      writeValue( file, (unsigned char)( entry.metadata.valid ? 1 : 0 ) ) &&
+      writeValue( file, entry.metadata.altitude ) &&
+      writeValue( file, entry.metadata.depth ) &&
+      writeValue( file, entry.metadata.heading ) &&
+      writeValue( file, entry.metadata.pitch ) &&
+      writeValue( file, entry.metadata.roll );
+  }
+
+  if( fclose( file ) != 0 ) {
+    success = false;
+  }
+
+  return success;
+}
+
+void MetadataIndex::insert( const std::string& imageFilename,
+  const MetadataIndexEntry& entry ) {
+  entries[ indexKey( imageFilename ) ] = entry;
+}
+
+const MetadataIndexEntry* MetadataIndex::find( const std::string& imageFilename ) const {
+
+  map< string, MetadataIndexEntry >::const_iterator itr =
+    entries.find( indexKey( imageFilename ) );
+
+  return ( itr != entries.end() ? &itr->second : NULL );
+}
+
+bool readIndexEntry( const std::string& imageFilename, MetadataIndexEntry& entry ) {
+
+  entry = MetadataIndexEntry();
+
+  vector< unsigned char > contents;
+  cv::Size size;
+
+  // JPEG metadata and frame headers are both near the start of the file
+  if( getImageType( imageFilename ) == JPEG &&
+      readFileContents( imageFilename, contents, MAX_META_SEARCH_BYTES ) &&
+      readImageSize( contents, size ) ) {
+
+    parseImageMetadata( imageFilename, contents, entry.metadata );
+  }
+  else {
+
+    // Other formats are read in full and decoded for their size
+    if( !readFileContents( imageFilename, contents ) ) {
+      return false;
+    }
+
+    parseImageMetadata( imageFilename, contents, entry.metadata );
+    size = decodeImage( contents ).size();
+  }
+
+  entry.cols = size.width;
+  entry.rows = size.height;
+  return entry.cols > 0 && entry.rows > 0;
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef SCALLOP_TK_METADATA_INDEX_H_
+#define SCALLOP_TK_METADATA_INDEX_H_
+
+//------------------------------------------------------------------------------
+//                               Include Files
+//------------------------------------------------------------------------------
+
+//Standard C/C++
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+//Scallop Includes
+#include "ScallopTK/Utilities/Definitions.h"
+#include "ScallopTK/ScaleDetection/ImageProperties.h"
+
+//------------------------------------------------------------------------------
+//                             Class Declaration
+//------------------------------------------------------------------------------
+
+namespace ScallopTK
+{
+
+// Metadata and full resolution of a single image in an index
+struct MetadataIndexEntry {
+
+  ImageMetadata metadata;
+  int cols;
+  int rows;
+
+  MetadataIndexEntry() : cols( 0 ), rows( 0 ) {}
+};
+
+// Sidecar index of metadata for a survey directory, built once by the
+// metadata indexer tool so that reprocessing a survey doesn't need to parse
+// metadata from every image again. Images are keyed by filename without
+// directory, so the index remains valid if the survey is moved.
+class MetadataIndex {
+
+public:
+
+  MetadataIndex() {}
+  ~MetadataIndex() {}
+
+  // Read or write an index file, returns false on failure
+  bool load( const std::string& filename );
+  bool save( const std::string& filename ) const;
+
+  // Add an entry for the given image, replacing any existing one
+  void insert( const std::string& imageFilename, const MetadataIndexEntry& entry );
+
+  // Find the entry for the given image, returns NULL if not indexed
+  const MetadataIndexEntry* find( const std::string& imageFilename ) const;
+
+  // Number of indexed images
+  unsigned size() const { return entries.size(); }
+
+private:
+
+  std::map< std::string, MetadataIndexEntry > entries;
+};
+
+// Read the metadata and full resolution of an image from its file, reading
+// only the file header for JPEGs
+bool readIndexEntry( const std::string& imageFilename, MetadataIndexEntry& entry );
+
+}
+
+#endif
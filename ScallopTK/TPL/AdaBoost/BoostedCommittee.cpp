@@ -70,6 +70,26 @@ double CBoostedCommittee::Predict(double * in_Sample)
 
 
 
+double CBoostedCommittee::Predict(const float * in_Sample)
+
+{
+
+  double final_prediction = 0;
+
+  for (int i = 0; i < m_vWeights.size(); i++)
+
+  {
+
+    final_prediction += m_vWeights[i] * m_vHypotheses[i].Predict(in_Sample);
+
+  }
+
+  return final_prediction;
+
+}
+
+
+
 bool CBoostedCommittee::LoadFromFile(FILE* in_File)
 
 {
@@ -158,4 +178,4 @@ bool CBoostedCommittee::LoadFromString(const char* Data)
 
   return true;
 
-}
+}
@@ -44,6 +44,12 @@ public:
 
 
 
+  // Single precision samples, as stored in a feature matrix row
+
+  double Predict(const float * in_Sample);
+
+
+
   bool LoadFromFile(FILE* in_File);
 
 
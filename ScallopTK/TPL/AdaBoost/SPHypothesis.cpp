@@ -72,6 +72,26 @@ double CSPHypothesis::Predict(double * in_Sample)
 
 
 
+double CSPHypothesis::Predict(const float * in_Sample)
+
+{
+
+  for (int i = 0; i < m_vDims.size(); i++)
+
+  {
+
+    if(!(m_vSignums[i] * in_Sample[m_vDims[i]] > m_vSignums[i] * m_vThresholds[i]))
+
+      return 0;
+
+  }
+
+  return 1;
+
+}
+
+
+
 
 
 void CSPHypothesis::PredictVector(double **in_vSamples, int in_iTotalSamples, double *out_vPredictions)
@@ -188,4 +208,4 @@ bool CSPHypothesis::LoadFromString(const char* Data)
 
   return true;
 
-}
+}
@@ -46,6 +46,12 @@ public:
 
 
 
+  // Single precision samples, as stored in a feature matrix row
+
+  double Predict(const float * in_Sample);
+
+
+
   void   PredictVector(double **in_vSamples, int in_iTotalSamples, double *out_vPredictions);
 
 
@@ -1,4 +1,3 @@
-
 #ifndef SCALLOP_TK_BENCHMARKING_H_
 #define SCALLOP_TK_BENCHMARKING_H_
 
@@ -8,74 +7,75 @@
 #include <vector>
 #include <fstream>
 
-namespace ScallopTK
-{
-
 // For Windows
-#ifdef WIN32 
-
-#include <windows.h>
-#include <stdio.h>
-
-static LARGE_INTEGER frequency;
-static LARGE_INTEGER t1, t2;
-static double LAST_TIME;
-
-
-inline void initializeTimer() {
-  QueryPerformanceFrequency(&frequency);  
-}
-
-inline double getTimeElapsed() {
-  QueryPerformanceCounter(&t2);
-  return (t2.QuadPart - t1.QuadPart) * 1000.0 / frequency.QuadPart;
-}
-
-inline void startTimer() {
-  QueryPerformanceCounter(&t1);
-  LAST_TIME = getTimeElapsed();
-}
-
-inline double getTimeSinceLastCall() {
-  double newTime = getTimeElapsed();
-  double passedSinceLastCall = newTime - LAST_TIME;
-  LAST_TIME = newTime;
-  return passedSinceLastCall;
-}
-
+#ifdef WIN32
+  #include <windows.h>
+  #include <stdio.h>
 // For Unix
-#else 
-
-#include <sys/time.h>
-using namespace std;
-
-static timeval t1, t2;
-static double LAST_TIME;
-
-inline void initializeTimer() {
-    
-}
+#else
+  #include <sys/time.h>
+#endif
 
-inline double getTimeElapsed() {
-  gettimeofday(&t2, NULL);
-  double elapsedTime = (t2.tv_sec - t1.tv_sec) * 1000.0;
-  elapsedTime += (t2.tv_usec - t1.tv_usec) / 1000.0;
-  return elapsedTime;
-}
+namespace ScallopTK
+{
 
-inline void startTimer() {
-  gettimeofday(&t1, NULL);
-  LAST_TIME = getTimeElapsed();
-}
+using namespace std;
 
-inline double getTimeSinceLastCall() {
-  double newTime = getTimeElapsed();
-  double passedSinceLastCall = newTime - LAST_TIME;
-  LAST_TIME = newTime;
-  return passedSinceLastCall;
-}
+// Simple millisecond timer, one should be created per thread of execution
+class BenchmarkTimer
+{
+public:
 
+  BenchmarkTimer() : lastTime( 0.0 ) {
+#ifdef WIN32
+    QueryPerformanceFrequency(&frequency);
+#endif
+    start();
+  }
+
+  // Reset the timer origin to the current time
+  void start() {
+#ifdef WIN32
+    QueryPerformanceCounter(&t1);
+#else
+    gettimeofday(&t1, NULL);
+#endif
+    lastTime = getTimeElapsed();
+  }
+
+  // Milliseconds passed since start was last called
+  double getTimeElapsed() {
+#ifdef WIN32
+    LARGE_INTEGER t2;
+    QueryPerformanceCounter(&t2);
+    return (t2.QuadPart - t1.QuadPart) * 1000.0 / frequency.QuadPart;
+#else
+    timeval t2;
+    gettimeofday(&t2, NULL);
+    double elapsedTime = (t2.tv_sec - t1.tv_sec) * 1000.0;
+    elapsedTime += (t2.tv_usec - t1.tv_usec) / 1000.0;
+    return elapsedTime;
+#endif
+  }
+
+  // Milliseconds passed since this function or start was last called
+  double getTimeSinceLastCall() {
+    double newTime = getTimeElapsed();
+    double passedSinceLastCall = newTime - lastTime;
+    lastTime = newTime;
+    return passedSinceLastCall;
+  }
+
+private:
+
+#ifdef WIN32
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER t1;
+#else
+  timeval t1;
 #endif
+  double lastTime;
+};
 
 }
 
@@ -0,0 +1,312 @@
+//------------------------------------------------------------------------------
+// Title: CandidatePool.cpp
+//------------------------------------------------------------------------------
+
+#include "CandidatePool.h"
+
+#include "ScallopTK/Utilities/Definitions.h"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+
+namespace ScallopTK
+{
+
+CandidatePool::CandidatePool( size_t size, unsigned perSlab )
+ : blockSize( std::max( size, sizeof( FreeBlock ) ) ),
+   blocksPerSlab( std::max( perSlab, 1u ) ),
+   emptySlabs( 0 ),
+   retainedSlabs( std::numeric_limits< unsigned >::max() ),
+   intervalPeakSlabs( 0 ),
+   intervalFills( 0 ),
+   peakSlabs( 0 ),
+   releasedSlabs( 0 )
+{
+  // Keep every block aligned for any member type
+  const size_t alignment = sizeof( double ) * 2;
+  blockSize = ( blockSize + alignment - 1 ) / alignment * alignment;
+
+#ifdef USE_PTHREADS
+  pthread_key_create( &cacheKey, releaseCache );
+#else
+  cache = NULL;
+#endif
+}
+
+CandidatePool::~CandidatePool()
+{
+#ifdef USE_PTHREADS
+  pthread_key_delete( cacheKey );
+#else
+  delete cache;
+#endif
+
+  // Only destroyed at exit, any blocks still cached by threads go with it
+  for( std::map< char*, Slab >::iterator itr = slabs.begin();
+       itr != slabs.end(); itr++ )
+  {
+    ::operator delete( itr->first );
+  }
+}
+
+void *CandidatePool::allocate()
+{
+  ThreadCache *cache = getCache();
+
+  if( !cache->freeList )
+  {
+    lock.lock();
+    fillCache( cache );
+    lock.unlock();
+  }
+
+  FreeBlock *block = cache->freeList;
+  cache->freeList = block->next;
+  cache->count--;
+  return block;
+}
+
+void CandidatePool::deallocate( void *ptr )
+{
+  if( !ptr )
+  {
+    return;
+  }
+
+  ThreadCache *cache = getCache();
+
+  FreeBlock *block = static_cast< FreeBlock* >( ptr );
+  block->next = cache->freeList;
+  cache->freeList = block;
+  cache->count++;
+
+  // Keep a batch on hand for reuse, hand back the rest
+  if( cache->count >= 2 * CANDIDATE_CACHE_BATCH )
+  {
+    lock.lock();
+    drainCache( cache, CANDIDATE_CACHE_BATCH );
+    lock.unlock();
+  }
+}
+
+void CandidatePool::printStats( std::ostream& out, const std::string& name )
+{
+  lock.lock();
+  out << name << ": " << peakSlabs * blocksPerSlab << " peak allocated, ";
+  out << slabs.size() * blocksPerSlab << " allocated, ";
+  out << releasedSlabs << " slabs released" << std::endl;
+  lock.unlock();
+}
+
+CandidatePool::ThreadCache *CandidatePool::getCache()
+{
+#ifdef USE_PTHREADS
+  ThreadCache *cache = static_cast< ThreadCache* >( pthread_getspecific( cacheKey ) );
+#endif
+
+  if( !cache )
+  {
+    cache = new ThreadCache;
+    cache->pool = this;
+    cache->freeList = NULL;
+    cache->count = 0;
+
+#ifdef USE_PTHREADS
+    pthread_setspecific( cacheKey, cache );
+#endif
+  }
+
+  return cache;
+}
+
+void CandidatePool::releaseCache( void *ptr )
+{
+  ThreadCache *cache = static_cast< ThreadCache* >( ptr );
+  CandidatePool *pool = cache->pool;
+
+  pool->lock.lock();
+  pool->drainCache( cache, cache->count );
+  pool->lock.unlock();
+
+  delete cache;
+}
+
+void CandidatePool::fillCache( ThreadCache *cache )
+{
+  // Take from the fullest slab with free blocks, so emptier ones may drain
+  std::map< char*, Slab >::iterator best = slabs.end();
+
+  for( std::map< char*, Slab >::iterator itr = slabs.begin();
+       itr != slabs.end(); itr++ )
+  {
+    if( itr->second.freeCount > 0 &&
+        ( best == slabs.end() || itr->second.freeCount < best->second.freeCount ) )
+    {
+      best = itr;
+    }
+  }
+
+  if( best == slabs.end() )
+  {
+    char *start = static_cast< char* >( ::operator new( blockSize * blocksPerSlab ) );
+
+    Slab& slab = slabs[ start ];
+    slab.freeList = NULL;
+    slab.freeCount = blocksPerSlab;
+
+    // Chain new blocks in address order, so they are handed out sequentially
+    for( int i = blocksPerSlab - 1; i >= 0; i-- )
+    {
+      FreeBlock *block = reinterpret_cast< FreeBlock* >( start + i * blockSize );
+      block->next = slab.freeList;
+      slab.freeList = block;
+    }
+
+    emptySlabs++;
+    peakSlabs = std::max( peakSlabs, (unsigned)slabs.size() );
+    best = slabs.find( start );
+  }
+
+  Slab& slab = best->second;
+
+  if( slab.freeCount == blocksPerSlab )
+  {
+    emptySlabs--;
+  }
+
+  for( unsigned i = 0; i < CANDIDATE_CACHE_BATCH && slab.freeList; i++ )
+  {
+    FreeBlock *block = slab.freeList;
+    slab.freeList = block->next;
+    slab.freeCount--;
+
+    block->next = cache->freeList;
+    cache->freeList = block;
+    cache->count++;
+  }
+
+  // Slabs are kept until a full interval has shown how many are needed
+  intervalPeakSlabs = std::max( intervalPeakSlabs,
+    (unsigned)slabs.size() - emptySlabs );
+
+  if( ++intervalFills >= CANDIDATE_TRIM_INTERVAL )
+  {
+    retainedSlabs = intervalPeakSlabs + 1;
+    intervalPeakSlabs = slabs.size() - emptySlabs;
+    intervalFills = 0;
+    trimSlabs();
+  }
+}
+
+void CandidatePool::drainCache( ThreadCache *cache, unsigned count )
+{
+  for( unsigned i = 0; i < count && cache->freeList; i++ )
+  {
+    FreeBlock *block = cache->freeList;
+    cache->freeList = block->next;
+    cache->count--;
+
+    // Find the slab containing this block, the last starting at or before it
+    char *address = reinterpret_cast< char* >( block );
+    std::map< char*, Slab >::iterator itr = slabs.upper_bound( address );
+    itr--;
+
+    Slab& slab = itr->second;
+    block->next = slab.freeList;
+    slab.freeList = block;
+    slab.freeCount++;
+
+    if( slab.freeCount < blocksPerSlab )
+    {
+      continue;
+    }
+
+    if( slabs.size() > retainedSlabs )
+    {
+      ::operator delete( itr->first );
+      slabs.erase( itr );
+      releasedSlabs++;
+    }
+    else
+    {
+      emptySlabs++;
+    }
+  }
+}
+
+void CandidatePool::trimSlabs()
+{
+  std::map< char*, Slab >::iterator itr = slabs.begin();
+
+  while( itr != slabs.end() && slabs.size() > retainedSlabs && emptySlabs > 0 )
+  {
+    if( itr->second.freeCount < blocksPerSlab )
+    {
+      itr++;
+      continue;
+    }
+
+    ::operator delete( itr->first );
+    slabs.erase( itr++ );
+    emptySlabs--;
+    releasedSlabs++;
+  }
+}
+
+//------------------------------------------------------------------------------
+//                       Candidate Allocation Functions
+//------------------------------------------------------------------------------
+
+static CandidatePool candidatePool( sizeof( Candidate ), CANDIDATE_SLAB_SIZE );
+static CandidatePool featurePool( sizeof( CandidateFeatures ), CANDIDATE_SLAB_SIZE / 4 );
+
+void *Candidate::operator new( size_t size )
+{
+  if( size != sizeof( Candidate ) )
+  {
+    return ::operator new( size );
+  }
+
+  return candidatePool.allocate();
+}
+
+void Candidate::operator delete( void *ptr, size_t size )
+{
+  if( size != sizeof( Candidate ) )
+  {
+    ::operator delete( ptr );
+    return;
+  }
+
+  candidatePool.deallocate( ptr );
+}
+
+void *CandidateFeatures::operator new( size_t size )
+{
+  if( size != sizeof( CandidateFeatures ) )
+  {
+    return ::operator new( size );
+  }
+
+  return featurePool.allocate();
+}
+
+void CandidateFeatures::operator delete( void *ptr, size_t size )
+{
+  if( size != sizeof( CandidateFeatures ) )
+  {
+    ::operator delete( ptr );
+    return;
+  }
+
+  featurePool.deallocate( ptr );
+}
+
+void printCandidatePoolStats( std::ostream& out )
+{
+  candidatePool.printStats( out, "Candidate Pool" );
+  featurePool.printStats( out, "Candidate Feature Pool" );
+}
+
+}
@@ -0,0 +1,143 @@
+//------------------------------------------------------------------------------
+// Title: CandidatePool.h
+// Description: Fixed size block allocator used for candidates and their
+//  features, which are created and destroyed in large numbers every frame
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_CANDIDATE_POOL_H_
+#define SCALLOP_TK_CANDIDATE_POOL_H_
+
+// C/C++ Includes
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+// Scallop Includes
+#include "ScallopTK/Utilities/Threads.h"
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                                 Constants
+//------------------------------------------------------------------------------
+
+// Number of blocks allocated from the heap at once when a pool is empty
+const unsigned CANDIDATE_SLAB_SIZE = 512;
+
+// Number of blocks moved between a thread's cache and the shared pool at once
+const unsigned CANDIDATE_CACHE_BATCH = 64;
+
+// Number of batches taken from the shared pool between updates of the number
+// of slabs it keeps around while unused
+const unsigned CANDIDATE_TRIM_INTERVAL = 1024;
+
+//------------------------------------------------------------------------------
+//                              Class Definition
+//------------------------------------------------------------------------------
+
+// Blocks are carved from large slabs and recycled instead of being returned
+// to the heap, so the same memory is reused from frame to frame. Each thread
+// keeps a small cache of free blocks and only takes the pool lock to move a
+// batch of them to or from the shared slabs, so workers allocating in
+// parallel rarely contend. Caches are flushed when their thread exits. Slabs
+// whose blocks are all free are kept while the pool recently needed them,
+// and otherwise returned to the heap, so memory follows the candidate count
+// of recent frames rather than the largest ever seen.
+class CandidatePool
+{
+public:
+
+  CandidatePool( size_t blockSize, unsigned blocksPerSlab );
+  ~CandidatePool();
+
+  // Get a block of at least blockSize bytes
+  void *allocate();
+
+  // Return a block given out by allocate, from any thread
+  void deallocate( void *block );
+
+  // Print the number of blocks allocated from the heap in a single line
+  void printStats( std::ostream& out, const std::string& name );
+
+private:
+
+  // Unused blocks are chained through their first bytes
+  struct FreeBlock
+  {
+    FreeBlock *next;
+  };
+
+  // Free blocks within a single slab
+  struct Slab
+  {
+    FreeBlock *freeList;
+    unsigned freeCount;
+  };
+
+  // Free blocks held by a single thread
+  struct ThreadCache
+  {
+    CandidatePool *pool;
+    FreeBlock *freeList;
+    unsigned count;
+  };
+
+  // Retrieve the calling thread's cache, creating it on first use
+  ThreadCache *getCache();
+
+  // Return all blocks in a cache to the pool and delete it, run on exit of
+  // the thread owning it
+  static void releaseCache( void *cache );
+
+  // Move a batch of free blocks from the slabs into a cache, allocating a
+  // new slab if none are free. Must be called with the lock held.
+  void fillCache( ThreadCache *cache );
+
+  // Move up to count blocks from a cache back to their slabs, releasing
+  // slabs left entirely free if not needed. Must be called with the lock held.
+  void drainCache( ThreadCache *cache, unsigned count );
+
+  // Release entirely free slabs beyond those retained. Must be called with
+  // the lock held.
+  void trimSlabs();
+
+  ThreadMutex lock;
+
+  size_t blockSize;
+  unsigned blocksPerSlab;
+
+  // Slabs by start address, and how many are entirely free
+  std::map< char*, Slab > slabs;
+  unsigned emptySlabs;
+
+  // Number of slabs kept even if free, the most in use during the previous
+  // trim interval plus a spare, and the most in use in the current one
+  unsigned retainedSlabs;
+  unsigned intervalPeakSlabs;
+  unsigned intervalFills;
+
+  unsigned peakSlabs;
+  unsigned releasedSlabs;
+
+#ifdef USE_PTHREADS
+  pthread_key_t cacheKey;
+#else
+  ThreadCache *cache;
+#endif
+
+  CandidatePool( const CandidatePool& );
+  CandidatePool& operator=( const CandidatePool& );
+};
+
+//------------------------------------------------------------------------------
+//                             Function Prototypes
+//------------------------------------------------------------------------------
+
+// Print usage of the pools backing Candidate and CandidateFeatures
+void printCandidatePoolStats( std::ostream& out );
+
+}
+
+#endif
@@ -0,0 +1,335 @@
+//------------------------------------------------------------------------------
+// Title: ColorConversion.cpp
+//------------------------------------------------------------------------------
+
+#include "ColorConversion.h"
+
+#include "ScallopTK/Utilities/Threads.h"
+#include "ScallopTK/Utilities/SIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ScallopTK
+{
+
+#ifdef SCALLOP_TK_USE_SSE
+// Split 4 interleaved 3 channel pixels, held in a, b and c, into one
+// register per channel
+static inline void deinterleave3( __m128 a, __m128 b, __m128 c,
+  __m128& ch0, __m128& ch1, __m128& ch2 )
+{
+  ch0 = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 3, 0 ) ),
+    _mm_shuffle_ps( b, c, _MM_SHUFFLE( 0, 1, 0, 2 ) ), _MM_SHUFFLE( 2, 0, 1, 0 ) );
+  ch1 = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 0, 1 ) ),
+    _mm_shuffle_ps( b, c, _MM_SHUFFLE( 0, 2, 0, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  ch2 = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 1, 0, 2 ) ),
+    _mm_shuffle_ps( c, c, _MM_SHUFFLE( 0, 3, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+}
+
+// Inverse of deinterleave3
+static inline void interleave3( __m128 ch0, __m128 ch1, __m128 ch2,
+  __m128& a, __m128& b, __m128& c )
+{
+  __m128 lo01 = _mm_unpacklo_ps( ch0, ch1 );
+  __m128 hi01 = _mm_unpackhi_ps( ch0, ch1 );
+
+  a = _mm_shuffle_ps( lo01, _mm_shuffle_ps( ch2, ch0, _MM_SHUFFLE( 1, 1, 0, 0 ) ),
+    _MM_SHUFFLE( 2, 0, 1, 0 ) );
+  b = _mm_shuffle_ps( _mm_shuffle_ps( ch1, ch2, _MM_SHUFFLE( 1, 1, 1, 1 ) ), hi01,
+    _MM_SHUFFLE( 1, 0, 2, 0 ) );
+  c = _mm_shuffle_ps( _mm_shuffle_ps( ch2, ch0, _MM_SHUFFLE( 3, 3, 2, 2 ) ),
+    _mm_shuffle_ps( ch1, ch2, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+}
+#endif
+
+// Converts blocks of rows, each a contiguous range of rows
+class ConvertBlocksBody : public ParallelLoopBody
+{
+public:
+
+  ConvertBlocksBody( IplImage *_input, bool _isRGB, int _outputs,
+    IplImage *_rgb32f, IplImage *_lab32f, IplImage *_grey32f,
+    IplImage *_grey8u, IplImage *_rgb8u, int _blockRows )
+  : input( _input ), isRGB( _isRGB ), outputs( _outputs ),
+    rgb32f( _rgb32f ), lab32f( _lab32f ), grey32f( _grey32f ),
+    grey8u( _grey8u ), rgb8u( _rgb8u ), blockRows( _blockRows )
+  {
+    scale = 1 / ( pow( 2.0f, input->depth ) - 1 );
+  }
+
+  void operator()( int begin, int end ) const
+  {
+    for( int b = begin; b < end; b++ )
+    {
+      int firstRow = b * blockRows;
+      int lastRow = std::min( firstRow + blockRows, input->height );
+      convertBlock( firstRow, lastRow );
+    }
+  }
+
+private:
+
+  void convertBlock( int firstRow, int lastRow ) const
+  {
+    const int width = input->width;
+
+    // Lab needs a float RGB block to convert from, use a temporary one if
+    // the float RGB image itself isn't requested
+    const bool needRGB32f = ( outputs & ( BASE_RGB_32F | BASE_LAB_32F ) ) != 0;
+    CvMat *tempRGB32f = NULL;
+
+    if( needRGB32f && !( outputs & BASE_RGB_32F ) )
+    {
+      tempRGB32f = cvCreateMat( lastRow - firstRow, width, CV_32FC3 );
+    }
+
+    // Channel index of the first and third output channels in the input
+    const int first = ( isRGB ? 2 : 0 );
+    const int third = ( isRGB ? 0 : 2 );
+
+    for( int r = firstRow; r < lastRow; r++ )
+    {
+      const unsigned char *in =
+        (const unsigned char*)( input->imageData + input->widthStep * r );
+
+      float *outRGB32f = NULL;
+
+      if( tempRGB32f )
+      {
+        outRGB32f = (float*)( tempRGB32f->data.ptr + tempRGB32f->step * ( r - firstRow ) );
+      }
+      else if( needRGB32f )
+      {
+        outRGB32f = (float*)( rgb32f->imageData + rgb32f->widthStep * r );
+      }
+
+      unsigned char *outRGB8u = ( outputs & BASE_RGB_8U ?
+        (unsigned char*)( rgb8u->imageData + rgb8u->widthStep * r ) : NULL );
+      float *outGrey32f = ( outputs & BASE_GREY_32F ?
+        (float*)( grey32f->imageData + grey32f->widthStep * r ) : NULL );
+      unsigned char *outGrey8u = ( outputs & BASE_GREY_8U ?
+        (unsigned char*)( grey8u->imageData + grey8u->widthStep * r ) : NULL );
+      const bool needGrey = ( outGrey32f || outGrey8u );
+
+      int c = 0;
+
+#ifdef SCALLOP_TK_USE_SSE
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 scales = _mm_set1_ps( scale );
+      const __m128 weight0 = _mm_set1_ps( 0.299f );
+      const __m128 weight1 = _mm_set1_ps( 0.587f );
+      const __m128 weight2 = _mm_set1_ps( 0.114f );
+      const __m128 max8u = _mm_set1_ps( 255.0f );
+
+      // Each step loads 16 bytes for 4 pixels, so stop while that stays
+      // inside the row
+      for( ; c + 6 <= width; c += 4 )
+      {
+        __m128i bytes = _mm_loadu_si128( (const __m128i*)( in + 3*c ) );
+        __m128i words0 = _mm_unpacklo_epi8( bytes, zero );
+        __m128i words1 = _mm_unpackhi_epi8( bytes, zero );
+
+        __m128 ch0, ch1, ch2;
+        deinterleave3(
+          _mm_cvtepi32_ps( _mm_unpacklo_epi16( words0, zero ) ),
+          _mm_cvtepi32_ps( _mm_unpackhi_epi16( words0, zero ) ),
+          _mm_cvtepi32_ps( _mm_unpacklo_epi16( words1, zero ) ),
+          ch0, ch1, ch2 );
+
+        const __m128 in0 = ( isRGB ? ch2 : ch0 );
+        const __m128 in2 = ( isRGB ? ch0 : ch2 );
+
+        const __m128 out0 = _mm_mul_ps( in0, scales );
+        const __m128 out1 = _mm_mul_ps( ch1, scales );
+        const __m128 out2 = _mm_mul_ps( in2, scales );
+
+        if( outRGB32f )
+        {
+          __m128 a, b, d;
+          interleave3( out0, out1, out2, a, b, d );
+          _mm_storeu_ps( outRGB32f + 3*c, a );
+          _mm_storeu_ps( outRGB32f + 3*c + 4, b );
+          _mm_storeu_ps( outRGB32f + 3*c + 8, d );
+        }
+
+        if( outRGB8u )
+        {
+          __m128 a, b, d;
+          interleave3( in0, ch1, in2, a, b, d );
+          __m128i packed = _mm_packus_epi16(
+            _mm_packs_epi32( _mm_cvtps_epi32( a ), _mm_cvtps_epi32( b ) ),
+            _mm_packs_epi32( _mm_cvtps_epi32( d ), zero ) );
+          _mm_storel_epi64( (__m128i*)( outRGB8u + 3*c ), packed );
+          int last = _mm_cvtsi128_si32( _mm_srli_si128( packed, 8 ) );
+          memcpy( outRGB8u + 3*c + 8, &last, 4 );
+        }
+
+        if( needGrey )
+        {
+          __m128 value = _mm_add_ps( _mm_add_ps(
+            _mm_mul_ps( out0, weight0 ), _mm_mul_ps( out1, weight1 ) ),
+            _mm_mul_ps( out2, weight2 ) );
+
+          if( outGrey32f )
+          {
+            _mm_storeu_ps( outGrey32f + c, value );
+          }
+          if( outGrey8u )
+          {
+            // Rounds to nearest even, as cvRound does
+            __m128i rounded = _mm_cvtps_epi32( _mm_mul_ps( value, max8u ) );
+            rounded = _mm_packs_epi32( rounded, rounded );
+            int packed = _mm_cvtsi128_si32( _mm_packus_epi16( rounded, rounded ) );
+            memcpy( outGrey8u + c, &packed, 4 );
+          }
+        }
+      }
+#endif
+
+      for( ; c < width; c++ )
+      {
+        if( outRGB32f )
+        {
+          outRGB32f[3*c+0] = in[3*c+first] * scale;
+          outRGB32f[3*c+1] = in[3*c+1] * scale;
+          outRGB32f[3*c+2] = in[3*c+third] * scale;
+        }
+
+        // Scaling to [0,1] and back rounds to the input value
+        if( outRGB8u )
+        {
+          outRGB8u[3*c+0] = in[3*c+first];
+          outRGB8u[3*c+1] = in[3*c+1];
+          outRGB8u[3*c+2] = in[3*c+third];
+        }
+
+        // Same weights and operation order as CV_RGB2GRAY on float input
+        if( needGrey )
+        {
+          float value = ( in[3*c+first] * scale ) * 0.299f +
+                        ( in[3*c+1] * scale ) * 0.587f +
+                        ( in[3*c+third] * scale ) * 0.114f;
+
+          if( outGrey32f )
+          {
+            outGrey32f[c] = value;
+          }
+          if( outGrey8u )
+          {
+            int rounded = cvRound( value * 255.0f );
+            outGrey8u[c] = (unsigned char)( rounded < 0 ? 0 : ( rounded > 255 ? 255 : rounded ) );
+          }
+        }
+      }
+    }
+
+    if( outputs & BASE_LAB_32F )
+    {
+      // Headers onto this block only, so blocks can convert concurrently
+      CvRect rows = cvRect( 0, firstRow, width, lastRow - firstRow );
+      CvMat blockRGB, blockLab;
+
+      if( tempRGB32f )
+      {
+        cvGetSubRect( tempRGB32f, &blockRGB, cvRect( 0, 0, width, rows.height ) );
+      }
+      else
+      {
+        cvGetSubRect( rgb32f, &blockRGB, rows );
+      }
+
+      cvGetSubRect( lab32f, &blockLab, rows );
+      cvCvtColor( &blockRGB, &blockLab, CV_RGB2Lab );
+    }
+
+    if( tempRGB32f )
+    {
+      cvReleaseMat( &tempRGB32f );
+    }
+  }
+
+  IplImage *input;
+  bool isRGB;
+  int outputs;
+  IplImage *rgb32f;
+  IplImage *lab32f;
+  IplImage *grey32f;
+  IplImage *grey8u;
+  IplImage *rgb8u;
+  int blockRows;
+  float scale;
+};
+
+// Separate OpenCV conversions, for inputs the fused kernel doesn't handle
+static void convertBaseImagesSeparately( IplImage *input, bool isRGB, int outputs,
+  IplImage *rgb32f, IplImage *lab32f, IplImage *grey32f,
+  IplImage *grey8u, IplImage *rgb8u )
+{
+  IplImage *base = rgb32f;
+
+  if( !base )
+  {
+    base = cvCreateImage( cvGetSize( input ), IPL_DEPTH_32F, input->nChannels );
+  }
+
+  float scalingFactor = 1 / ( pow( 2.0f, input->depth ) - 1 );
+  cvConvertScale( input, base, scalingFactor );
+
+  if( isRGB )
+  {
+    cvCvtColor( base, base, CV_RGB2BGR );
+  }
+
+  IplImage *grey = grey32f;
+
+  if( !grey && ( outputs & BASE_GREY_8U ) )
+  {
+    grey = cvCreateImage( cvGetSize( input ), IPL_DEPTH_32F, 1 );
+  }
+
+  if( outputs & BASE_LAB_32F )
+    cvCvtColor( base, lab32f, CV_RGB2Lab );
+  if( grey )
+    cvCvtColor( base, grey, CV_RGB2GRAY );
+  if( outputs & BASE_GREY_8U )
+    cvScale( grey, grey8u, 255. );
+  if( outputs & BASE_RGB_8U )
+    cvScale( base, rgb8u, 255. );
+
+  if( base != rgb32f )
+    cvReleaseImage( &base );
+  if( grey != grey32f )
+    cvReleaseImage( &grey );
+}
+
+void convertBaseImages( IplImage *input, bool isRGB, int outputs,
+  IplImage *rgb32f, IplImage *lab32f, IplImage *grey32f,
+  IplImage *grey8u, IplImage *rgb8u, int threads )
+{
+  if( input->depth != IPL_DEPTH_8U || input->nChannels != 3 )
+  {
+    convertBaseImagesSeparately( input, isRGB, outputs, rgb32f, lab32f,
+      grey32f, grey8u, rgb8u );
+    return;
+  }
+
+  // Bytes per pixel read and written by a block
+  int pixelBytes = 3;
+  if( outputs & ( BASE_RGB_32F | BASE_LAB_32F ) ) pixelBytes += 12;
+  if( outputs & BASE_LAB_32F ) pixelBytes += 12;
+  if( outputs & BASE_GREY_32F ) pixelBytes += 4;
+  if( outputs & BASE_GREY_8U ) pixelBytes += 1;
+  if( outputs & BASE_RGB_8U ) pixelBytes += 3;
+
+  int blockRows = std::max( CONVERSION_BLOCK_BYTES / ( pixelBytes * std::max( input->width, 1 ) ), 1 );
+  int blocks = ( input->height + blockRows - 1 ) / blockRows;
+
+  ConvertBlocksBody body( input, isRGB, outputs, rgb32f, lab32f, grey32f,
+    grey8u, rgb8u, blockRows );
+
+  parallelFor( blocks, body, threads );
+}
+
+}
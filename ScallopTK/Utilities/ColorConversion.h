@@ -0,0 +1,55 @@
+//------------------------------------------------------------------------------
+// Title: ColorConversion.h
+// Description: Single pass conversion of an 8-bit input image into the set of
+//  base images (float RGB, Lab, greyscale, and 8-bit copies) used throughout
+//  detection
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_COLOR_CONVERSION_H_
+#define SCALLOP_TK_COLOR_CONVERSION_H_
+
+// OpenCV Includes
+#include <cv.h>
+#include <cxcore.h>
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                                 Constants
+//------------------------------------------------------------------------------
+
+// Base images which can be produced, combine to select several
+const int BASE_RGB_32F  = 0x01;
+const int BASE_LAB_32F  = 0x02;
+const int BASE_GREY_32F = 0x04;
+const int BASE_GREY_8U  = 0x08;
+const int BASE_RGB_8U   = 0x10;
+const int BASE_ALL      = 0x1F;
+
+// Approximate bytes of input and output touched per block of rows, chosen so
+// that a block stays in cache while all of its outputs are produced
+const int CONVERSION_BLOCK_BYTES = 256 * 1024;
+
+//------------------------------------------------------------------------------
+//                             Function Prototypes
+//------------------------------------------------------------------------------
+
+// Convert an 8-bit, 3 channel input into the selected base images, visiting
+// the input once. Outputs must be the size of the input, and any which are
+// not selected may be NULL. Results are identical to the separate OpenCV
+// conversions used previously:
+//   rgb32f  - input scaled to [0,1], channels swapped first if isRGB (so the
+//             channel order is BGR, as loaded from file)
+//   lab32f  - CV_RGB2Lab of rgb32f
+//   grey32f - CV_RGB2GRAY of rgb32f
+//   grey8u  - grey32f scaled by 255
+//   rgb8u   - rgb32f scaled by 255
+// Blocks of rows are processed by up to threads threads.
+void convertBaseImages( IplImage *input, bool isRGB, int outputs,
+  IplImage *rgb32f, IplImage *lab32f, IplImage *grey32f,
+  IplImage *grey8u, IplImage *rgb8u, int threads = 1 );
+
+}
+
+#endif
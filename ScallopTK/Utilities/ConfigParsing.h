@@ -203,7 +203,14 @@ inline bool parseModeConfig( string key, SystemParameters& params )
       params.OutputList = !strcmp( rdr.GetValue( "options", "output_list", NULL ), "true" );
       params.OutputDuplicateClass = !strcmp( rdr.GetValue( "options", "output_duplicate_class", NULL ), "true" );
       params.OutputDetectionImages = !strcmp( rdr.GetValue( "options", "output_detection_images", NULL ), "true" );
-      params.NumThreads = atoi( rdr.GetValue( "options", "num_threads", "1" ) );
+
+      // Only override the system-wide thread count if specified
+      const char* threads = rdr.GetValue( "options", "num_threads", NULL );
+
+      if( threads )
+      {
+        params.NumThreads = atoi( threads );
+      }
     }
   }
   catch( ... )
@@ -259,7 +266,24 @@ inline bool parseSystemConfig( SystemParameters& params, std::string location =
     params.OutputProposalImages = !strcmp( rdr.GetValue( "options", "output_proposal_images", NULL ), "true" );
     params.OutputDetectionImages = !strcmp( rdr.GetValue( "options", "output_detection_images", NULL ), "true" );
     params.NumThreads = atoi( rdr.GetValue( "options", "num_threads", "1" ) );
+    params.IntraFrameThreading = !strcmp( rdr.GetValue( "options", "intra_frame_threading", "false" ), "true" );
+    params.PrefetchDepth = atoi( rdr.GetValue( "options", "prefetch_depth", "2" ) );
+    params.PrefetchThreads = atoi( rdr.GetValue( "options", "prefetch_threads", "1" ) );
+    params.ScaledDecoding = !strcmp( rdr.GetValue( "options", "scaled_decoding", "true" ), "true" );
+    params.CompactColorFilters = atoi( rdr.GetValue( "options", "compact_color_filters", "0" ) );
+    params.SaliencySampleStride = atoi( rdr.GetValue( "options", "saliency_sample_stride", "1" ) );
+    params.AdaptiveThresholdLevels = atoi( rdr.GetValue( "options", "adaptive_threshold_levels", "0" ) );
+    params.SubmitQueueDepth = atoi( rdr.GetValue( "options", "submit_queue_depth", "2" ) );
+    params.SubmitQueuePolicy = rdr.GetValue( "options", "submit_queue_policy", "block" );
+    params.OrderedListOutput = !strcmp( rdr.GetValue( "options", "ordered_list_output", "true" ), "true" );
+    params.ListFlushFrames = atoi( rdr.GetValue( "options", "list_flush_frames", "16" ) );
+    params.ListFlushSeconds = atof( rdr.GetValue( "options", "list_flush_seconds", "2.0" ) );
+    params.ListSyncPolicy = rdr.GetValue( "options", "list_sync_policy", "close" );
+    params.TileSize = atoi( rdr.GetValue( "options", "tile_size", "0" ) );
+    params.TileThreads = atoi( rdr.GetValue( "options", "tile_threads", "1" ) );
+    params.UseImageArena = !strcmp( rdr.GetValue( "options", "use_image_arena", "true" ), "true" );
     params.FocalLength = atof( rdr.GetValue( "options", "focal_length", NULL ) );
+    params.MetadataIndexFile = rdr.GetValue( "options", "metadata_index", "" );
     params.RootConfigDIR = configDir;
     params.RootClassifierDIR = rdr.GetValue( "options", "root_classifier_dir", NULL );
     params.RootColorDIR = rdr.GetValue( "options", "root_color_dir", NULL );
@@ -449,6 +473,23 @@ inline void initializeDefault( SystemParameters& settings )
   settings.OutputDuplicateClass = true;
   settings.OutputDetectionImages = false;
   settings.NumThreads = 1;
+  settings.IntraFrameThreading = false;
+  settings.PrefetchDepth = 2;
+  settings.PrefetchThreads = 1;
+  settings.ScaledDecoding = true;
+  settings.CompactColorFilters = 0;
+  settings.SaliencySampleStride = 1;
+  settings.AdaptiveThresholdLevels = 0;
+  settings.MetadataIndexFile = "";
+  settings.SubmitQueueDepth = 2;
+  settings.SubmitQueuePolicy = "block";
+  settings.OrderedListOutput = true;
+  settings.ListFlushFrames = 16;
+  settings.ListFlushSeconds = 2.0f;
+  settings.ListSyncPolicy = "close";
+  settings.TileSize = 0;
+  settings.TileThreads = 1;
+  settings.UseImageArena = true;
 }
 
 }
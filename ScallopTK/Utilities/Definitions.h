@@ -36,10 +36,11 @@ const std::string CONFIG_SEARCH_DIR2 = "/scallop_tk_models/";
 const std::string DEFAULT_COLORBANK_DIR = "ColorFilterBanks/";
 const std::string DEFAULT_CLASSIFIER_DIR = "Classifiers/";
 const std::string DEFAULT_CONFIG_FILE = "SYSTEM_SETTINGS";
+const std::string DEFAULT_METADATA_INDEX = "METADATA_INDEX";
 const std::string DEFAULT_COLORBANK_EXT = "_32f_rgb_v1.cfilt";
 
-// Max search depth for reading metadata contained within JPEG files
-const int MAX_META_SEARCH_DEPTH = 10000;
+// Max number of bytes at the start of JPEG files searched for metadata
+const int MAX_META_SEARCH_BYTES = 262144;
 
 // Input image type definitions
 const int UNKNOWN  = 0x00;   //.???
@@ -63,6 +64,12 @@ const float MAX_PIXELS_FOR_MIN_RAD = 10.0;
 // 1 for some problems.
 const float RESIZE_FACTOR_REQUIRED = 0.975f;
 
+// Overlap between adjacent tiles when processing large frames in tiles, in
+// units of the maximum object search radius. Must be greater than 2 so that
+// objects lie fully within the kept area of some tile, with some margin for
+// features computed around each object.
+const float TILE_OVERLAP_RADII = 3.0f;
+
 // Default image scale factors for assorted operations, this is applied
 // on top of any initial image filtering resize optimizations. Units are
 // relative measure as to the number of pixels minimum object search
@@ -149,6 +156,15 @@ const unsigned int EDGE_FEATURES  = 137;
 const unsigned int HOG_FEATURES   = 1764;
 const unsigned int NUM_HOG        = 2;
 
+// Start columns of each feature type within a row of the feature matrix, in
+// the order expected by trained classifiers
+const unsigned int SIZE_FEATURE_START  = 0;
+const unsigned int COLOR_FEATURE_START = SIZE_FEATURE_START + SIZE_FEATURES;
+const unsigned int EDGE_FEATURE_START  = COLOR_FEATURE_START + COLOR_FEATURES;
+const unsigned int HOG_FEATURE_START   = EDGE_FEATURE_START + EDGE_FEATURES;
+const unsigned int GABOR_FEATURE_START = HOG_FEATURE_START + NUM_HOG * HOG_FEATURES;
+const unsigned int TOTAL_FEATURES      = GABOR_FEATURE_START + GABOR_FEATURES;
+
 // Amount to expand bounding box around candidate by when
 // computing image chips to feed into a CNN classifier.
 const float CNN_EXPANSION_RATIO = 1.45f;
@@ -195,6 +211,10 @@ struct SystemParameters
   // Is metadata stored in the image or the file list?
   bool IsMetadataInImage;
 
+  // Sidecar metadata index used instead of reading metadata from images, if
+  // empty, an index named DEFAULT_METADATA_INDEX in the input dir is used
+  std::string MetadataIndexFile;
+
   // Only process the left half of the input image
   bool ProcessLeftHalfOnly;
 
@@ -247,6 +267,58 @@ struct SystemParameters
 
   // Number of worker threads to allocate for processing images
   int NumThreads;
+
+  // If set, parallelize work within each frame (lower latency) instead of
+  // processing multiple frames at once (higher throughput)
+  bool IntraFrameThreading;
+
+  // Number of input images to read and decode ahead of processing (0 = off)
+  int PrefetchDepth;
+
+  // Number of threads used for reading and decoding images ahead of time
+  int PrefetchThreads;
+
+  // Decode JPEGs directly at the reduced resolution they are processed at
+  bool ScaledDecoding;
+
+  // Bits per value of compact colour filters used on 8-bit input (8, 16 or
+  // 32), or 0 to classify with the float filters
+  int CompactColorFilters;
+
+  // Build the saliency model from every n-th pixel of every n-th row
+  int SaliencySampleStride;
+
+  // Number of percentile levels below and above 0.0 (0 to 3) that adaptive
+  // thresholding also thresholds at, 0 thresholds at 0.0 only
+  int AdaptiveThresholdLevels;
+
+  // Maximum number of frames waiting in the CoreDetector submission queue
+  int SubmitQueueDepth;
+
+  // What to do when the submission queue is full: block, drop_oldest,
+  // or reject
+  std::string SubmitQueuePolicy;
+
+  // Write the output list in input frame order
+  bool OrderedListOutput;
+
+  // Write the output list after this many frames are ready, or this many
+  // seconds have passed, whichever comes first
+  int ListFlushFrames;
+  float ListFlushSeconds;
+
+  // When to force the output list to disk: never, flush, or close
+  std::string ListSyncPolicy;
+
+  // Process frames larger than this (in pixels, after any initial downscale)
+  // as overlapping tiles of this size, 0 to disable
+  int TileSize;
+
+  // Maximum number of tiles of a single frame to process at once
+  int TileThreads;
+
+  // Reuse intermediate images across frames instead of reallocating them
+  bool UseImageArena;
 };
 
 
@@ -330,11 +402,79 @@ struct Contour
 //                         Interest Point Definition
 //------------------------------------------------------------------------------
 
+// Features extracted around a candidate, and its classification results
+//
+// These are only allocated (by initalizeCandidateStats, or by
+// allocateCandidateFeatures for models which don't use extracted features)
+// for candidates which survive consolidation and reach classification, and
+// are freed along with their candidate. Feature values are stored in a row of
+// the frame's FeatureMatrix, which must outlive the candidate's use of them,
+// and row is NULL if features were not extracted.
+struct CandidateFeatures
+{
+  // Full row of features for classification, and each feature type within it
+  float *row;
+  float *sizeFeatures;
+  float *colorFeatures;
+  float *edgeFeatures;
+  float *hogFeatures[NUM_HOG];
+  float *gaborFeatures;
+  double majorAxisMeters;
+
+  // Used for color detectors
+  IplImage *summaryImage;
+  IplImage *colorQuadrants;
+  int colorQR, colorQC;
+  int colorBinCount[COLOR_BINS];
+
+  // Expensive edge search results
+  float innerColorAvg[3];
+  float outerColorAvg[3];
+
+  // User entered designation, if in training mode
+  int designation;
+
+  // Stats for final classification
+  unsigned int classification;
+  double classMagnitudes[MAX_CLASSIFIERS];
+
+  // Default constructor
+  CandidateFeatures()
+  : row( NULL ),
+    summaryImage( NULL ),
+    colorQuadrants( NULL )
+  {
+    for( unsigned i = 0; i < MAX_CLASSIFIERS; i++ )
+    {
+      classMagnitudes[i] = -std::numeric_limits<double>::max();
+    }
+  }
+
+  // Releases any images held
+  ~CandidateFeatures()
+  {
+    if( summaryImage )
+      cvReleaseImage( &summaryImage );
+    if( colorQuadrants )
+      cvReleaseImage( &colorQuadrants );
+  }
+
+  // Allocated from a shared pool, see CandidatePool.h
+  static void *operator new( size_t size );
+  static void operator delete( void *ptr, size_t size );
+
+private:
+
+  CandidateFeatures( const CandidateFeatures& );
+  CandidateFeatures& operator=( const CandidateFeatures& );
+};
+
 // Candidate Point (Object Proposal) and associated information
 //
-// This object stores location, stats for classification, features extracted
-// around the candidate location, and preliminary classification results for
-// the candidate.
+// This object stores the location of the candidate and how it was proposed.
+// Thousands are created for each image by the proposal detectors, so features
+// and classification results are kept separately and only allocated for
+// candidates which reach classification.
 struct Candidate
 {
 
@@ -363,55 +503,34 @@ struct Candidate
   bool isCorner; //is the Candidate on an image boundary
   bool isSideBorder[8]; // which octants are outside the image
 
-  // Features for classification
+  // Is the Candidate still being considered, and does it have edge features
   bool isActive;
-  double colorFeatures[COLOR_FEATURES];
-  double gaborFeatures[GABOR_FEATURES];
-  double sizeFeatures[SIZE_FEATURES];
-  CvMat *hogResults[NUM_HOG];
-  double majorAxisMeters;
-
-  // Used for color detectors
-  IplImage *summaryImage;
-  IplImage *colorQuadrants;
-  int colorQR, colorQC;
-  int colorBinCount[COLOR_BINS];
-
-  // Edge Based Features
   bool hasEdgeFeatures;
-  double edgeFeatures[EDGE_FEATURES];
 
-  // Expensive edge search results
-  float innerColorAvg[3];
-  float outerColorAvg[3];
-  Contour *bestContour;
-  Contour *fullContour;
-
-  // User entered designation, Candidate filename if in training mode
-  int designation;
-  std::string filename;
-
-  // Stats for final classification
-  unsigned int classification;
-  double classMagnitudes[MAX_CLASSIFIERS];
+  // Extracted features and classification results, NULL until the
+  // candidate reaches classification
+  CandidateFeatures *features;
 
   // Default constructor
   Candidate()
-  : summaryImage( NULL ),
-    colorQuadrants( NULL ),
-    bestContour( NULL ),
-    fullContour( NULL )
+  : features( NULL )
   {
-    for( unsigned i = 0; i < NUM_HOG; i++ )
-    {
-      hogResults[i] = NULL;
-    }
+  }
 
-    for( unsigned i = 0; i < MAX_CLASSIFIERS; i++ )
-    {
-      classMagnitudes[i] = -std::numeric_limits<double>::max();
-    }
+  // Frees extracted features, if any
+  ~Candidate()
+  {
+    delete features;
   }
+
+  // Allocated from a shared pool, see CandidatePool.h
+  static void *operator new( size_t size );
+  static void operator delete( void *ptr, size_t size );
+
+private:
+
+  Candidate( const Candidate& );
+  Candidate& operator=( const Candidate& );
 };
 
 // An actual Detection according to our algorithm, used for output and
@@ -445,7 +564,6 @@ struct Detection
 typedef std::vector<Candidate*> CandidatePtrVector;
 typedef std::vector<Detection*> DetectionPtrVector;
 
-typedef std::vector<Candidate> CandidateVector;
 typedef std::vector<Detection> DetectionVector;
 
 }
@@ -5,9 +5,21 @@
 
 #include "Display.h"
 
+#include "ScallopTK/Utilities/Threads.h"
+
 namespace ScallopTK
 {
 
+ThreadMutex displayLock;
+
+void getDisplayLock() {
+  displayLock.lock();
+}
+
+void unlockDisplay() {
+  displayLock.unlock();
+}
+
 void initOutputDisplay() {
   cvNamedWindow( DISPLAY_WINDOW_NAME.c_str(), CV_WINDOW_AUTOSIZE );
 }
@@ -72,11 +84,11 @@ void displayResultsImage( IplImage* img, CandidatePtrVector& cds ) {
   IplImage* local = cvCloneImage( img );
   for( unsigned int i=0; i<cds.size(); i++ ) {  
     CvScalar color;
-    if( cds[i]->classification == SCALLOP_BROWN )
+    if( cds[i]->features->classification == SCALLOP_BROWN )
       color = cvScalar(0,1,0); 
-    else if( cds[i]->classification == SCALLOP_WHITE )
+    else if( cds[i]->features->classification == SCALLOP_WHITE )
       color = cvScalar(1,1,1); 
-    else if( cds[i]->classification == SCALLOP_BURIED )
+    else if( cds[i]->features->classification == SCALLOP_BURIED )
       color = cvScalar(1,0,0); 
     else 
       continue;
@@ -44,6 +44,11 @@ void displayInterestPointImage( IplImage* img, CandidatePtrVector& cds );
 void displayResultsImage( IplImage* img, CandidatePtrVector& Scallops );
 void displayResultsImage( IplImage* img, DetectionPtrVector& cds, string Filename );
 
+// The output display window is shared by the whole process, hold this lock
+// while drawing to it from any detector thread
+void getDisplayLock();
+void unlockDisplay();
+
 }
 
 #endif
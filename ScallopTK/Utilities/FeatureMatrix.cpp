@@ -0,0 +1,34 @@
+//------------------------------------------------------------------------------
+// Title: FeatureMatrix.cpp
+//------------------------------------------------------------------------------
+
+#include "FeatureMatrix.h"
+
+namespace ScallopTK
+{
+
+void FeatureMatrix::reset( unsigned rows )
+{
+  rowCount = rows;
+
+  data.clear();
+  data.resize( rows * TOTAL_FEATURES, 0.0f );
+}
+
+void FeatureMatrix::bindRow( unsigned index, CandidateFeatures *features )
+{
+  float *start = row( index );
+
+  features->row = start;
+  features->sizeFeatures = start + SIZE_FEATURE_START;
+  features->colorFeatures = start + COLOR_FEATURE_START;
+  features->edgeFeatures = start + EDGE_FEATURE_START;
+  features->gaborFeatures = start + GABOR_FEATURE_START;
+
+  for( unsigned i = 0; i < NUM_HOG; i++ )
+  {
+    features->hogFeatures[i] = start + HOG_FEATURE_START + i * HOG_FEATURES;
+  }
+}
+
+}
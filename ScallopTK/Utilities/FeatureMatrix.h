@@ -0,0 +1,53 @@
+//------------------------------------------------------------------------------
+// Title: FeatureMatrix.h
+// Description: Contiguous row-major storage of the features of every
+//  candidate in an image, one row per candidate
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_FEATURE_MATRIX_H_
+#define SCALLOP_TK_FEATURE_MATRIX_H_
+
+// C/C++ Includes
+#include <vector>
+
+// Scallop Includes
+#include "ScallopTK/Utilities/Definitions.h"
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                              Class Definition
+//------------------------------------------------------------------------------
+
+// Each row holds TOTAL_FEATURES floats, laid out according to the
+// *_FEATURE_START columns in Definitions.h. Feature extractors write into
+// rows through the pointers in CandidateFeatures, and classifiers read rows
+// directly.
+class FeatureMatrix
+{
+public:
+
+  FeatureMatrix() : rowCount( 0 ) {}
+
+  // Resize to the given number of rows with all features zeroed, which
+  // invalidates any previously bound rows
+  void reset( unsigned rows );
+
+  // Point the feature ranges of the given features at a row
+  void bindRow( unsigned index, CandidateFeatures *features );
+
+  unsigned rows() const { return rowCount; }
+
+  float *row( unsigned index ) { return &data[ index * TOTAL_FEATURES ]; }
+  const float *row( unsigned index ) const { return &data[ index * TOTAL_FEATURES ]; }
+
+private:
+
+  std::vector< float > data;
+  unsigned rowCount;
+};
+
+}
+
+#endif
@@ -440,21 +440,9 @@ void drawColorRing( IplImage *input, float r, float c, float angle, float major1
   }
 }
 
-//Deallocates Candidate vector
+//Deallocates Candidate vector (features are released with the candidate)
 void deallocateCandidate( Candidate* cd ) {
-
-  if( cd != NULL ) {
-    
-    if( cd->summaryImage != NULL )
-      cvReleaseImage( &cd->summaryImage );
-    if( cd->colorQuadrants != NULL )
-      cvReleaseImage( &cd->colorQuadrants );
-    for( unsigned int j=0; j<NUM_HOG; j++ )
-      if( cd->hogResults[j] != NULL )
-        cvReleaseMat( &cd->hogResults[j] );
-
-    delete cd;
-  }
+  delete cd;
 }
 
 void deallocateCandidates( CandidatePtrVector &kps ) {
@@ -467,13 +455,13 @@ void showScallopsNW( IplImage *img, CandidatePtrVector& kps ) {
   IplImage* local = cvCloneImage( img );
   for( unsigned int i=0; i<kps.size(); i++ ) {  
     CvScalar color;
-    if( kps[i]->classification == 1 )
+    if( kps[i]->features->classification == 1 )
       color = cvScalar(0,1,0); 
-    else if( kps[i]->classification == 2 )
+    else if( kps[i]->features->classification == 2 )
       color = cvScalar(1,1,1); 
-    else if( kps[i]->classification == 3 )
+    else if( kps[i]->features->classification == 3 )
       color = cvScalar(1,0,0); 
-    else if( kps[i]->classification == 4 )
+    else if( kps[i]->features->classification == 4 )
       color = cvScalar(1,1,0); 
     else 
       continue;
@@ -490,13 +478,13 @@ void showScallops( IplImage *img, CandidatePtrVector& kps ) {
   IplImage* local = cvCloneImage( img );
   for( unsigned int i=0; i<kps.size(); i++ ) {  
     CvScalar color;
-    if( kps[i]->classification == 1 )
+    if( kps[i]->features->classification == 1 )
       color = cvScalar(0,1,0); 
-    else if( kps[i]->classification == 2 )
+    else if( kps[i]->features->classification == 2 )
       color = cvScalar(1,1,1); 
-    else if( kps[i]->classification == 3 )
+    else if( kps[i]->features->classification == 3 )
       color = cvScalar(1,0,0); 
-    else if( kps[i]->classification == 4 )
+    else if( kps[i]->features->classification == 4 )
       color = cvScalar(1,1,0); 
     else 
       continue;
@@ -574,24 +562,6 @@ void saveCandidates( IplImage *img, CandidatePtrVector& cds, const string& fn )
   cvReleaseImage( &local );
 }
 
-float quickMedian( IplImage* img, int max_to_sample ) {
-  float *ptr = (float*) img->imageData;
-  int sze = img->width * img->height;
-  float *endptr = ptr + sze;
-  int skippage = 20;
-  if( sze / max_to_sample > 20 )
-    skippage = sze / max_to_sample;
-  vector<float> val_list(sze/skippage+1,0.0f);
-  int counter = 0;
-  while( ptr < endptr ) {
-    val_list[counter] = *ptr;
-    counter++;
-    ptr = ptr + skippage;
-  }
-  sort( val_list.begin(), val_list.end() );
-  return val_list[0.5f*sze/skippage];
-}
-
 void showIPNW( IplImage* img, IplImage *img2, Candidate *ip ) {
 
   //Copy Image
@@ -633,17 +603,23 @@ void showIPNW( IplImage* img, Candidate *ip ) {
   cvReleaseImage( &copy );
 }
 
-void initalizeCandidateStats( CandidatePtrVector cds, int imheight, int imwidth ) {
+void initalizeCandidateStats( CandidatePtrVector cds, FeatureMatrix& features,
+  int imheight, int imwidth ) {
+
+  // One row of features per candidate
+  features.reset( cds.size() );
+
   for( int i=0; i<cds.size(); i++ ) {
 
     // Initialize Candidate Variables
     cds[i]->isActive = true;
-    cds[i]->summaryImage = NULL;
-    cds[i]->colorQuadrants = NULL;
     cds[i]->hasEdgeFeatures = false;
     cds[i]->isCorner = false;
-    for( unsigned int j=0; j<NUM_HOG; j++ )
-      cds[i]->hogResults[j] = NULL;
+
+    // Allocate feature storage, only done for candidates reaching this point
+    delete cds[i]->features;
+    cds[i]->features = new CandidateFeatures;
+    features.bindRow( i, cds[i]->features );
 
     // Determine if Candidate is on image border
     const double ICS_MAJOR_INC_FACTOR = 1.33;
@@ -684,6 +660,15 @@ void initalizeCandidateStats( CandidatePtrVector cds, int imheight, int imwidth
   }
 }
 
+void allocateCandidateFeatures( CandidatePtrVector& cds ) {
+
+  // Storage for classification results only, feature rows stay NULL
+  for( int i=0; i<cds.size(); i++ ) {
+    if( !cds[i]->features )
+      cds[i]->features = new CandidateFeatures;
+  }
+}
+
 void removeBorderCandidates( CandidatePtrVector& cds, IplImage *img )
 {
   // Top down greedy search - very slow but who cares its for training only
@@ -749,11 +734,11 @@ void resetClassificationValues( CandidatePtrVector& cds )
 {
   for( unsigned i = 0; i < cds.size(); i++ )
   {
-    cds[i]->classification = 0;
+    cds[i]->features->classification = 0;
 
     for( unsigned j = 0; j < MAX_CLASSIFIERS; j++ )
     {
-       cds[i]->classMagnitudes[j] = -std::numeric_limits<double>::max();
+       cds[i]->features->classMagnitudes[j] = -std::numeric_limits<double>::max();
     }
   }
 }
@@ -765,7 +750,7 @@ void thresholdClassificationMag( CandidatePtrVector& input,
   {
     for( unsigned j = 0; j < MAX_CLASSIFIERS; j++ )
     {
-       if( input[i]->classMagnitudes[j] > thresh )
+       if( input[i]->features->classMagnitudes[j] > thresh )
        {
          output.push_back( input[i] );
          break;
@@ -22,6 +22,7 @@
 
 // Scallop Includes
 #include "ScallopTK/Utilities/Definitions.h"
+#include "ScallopTK/Utilities/FeatureMatrix.h"
 
 // Namespaces
 using namespace std;
@@ -82,9 +83,9 @@ inline void rgb2gray( IplImage *src, IplImage *dst );
 void printMat( CvMat *A );
 void showImageRange( IplImage* img );
 void calcMinMax( IplImage *img );
-void initalizeCandidateStats( CandidatePtrVector cds,
+void initalizeCandidateStats( CandidatePtrVector cds, FeatureMatrix& features,
   int imheight, int imwidth );
-float quickMedian( IplImage* img, int max_to_sample );
+void allocateCandidateFeatures( CandidatePtrVector& cds );
 void removeBorderCandidates( CandidatePtrVector& cds, IplImage *img );
 void cullNonImages( vector<string>& fn_list );
 vector<string> tokenizeString( std::string s );
@@ -243,8 +244,9 @@ inline Candidate* convertGTToCandidate( GTEntry& Pt, float DownsizeFactor, bool
   output->minor = RAND_MINOR * AXIS / 2.0;
   output->angle = RAND_ANGLE;
 
-  // Set classification value
-  output->classification = Pt.ID;
+  // Set classification value, held with the (empty) features
+  output->features = new CandidateFeatures;
+  output->features->classification = Pt.ID;
 
   return output;
 }
@@ -281,7 +283,7 @@ inline void removeOverlapAndMerge( CandidatePtrVector& Base,
     }
     else
     {
-      Base[j]->classification = 0;
+      Base[j]->features->classification = 0;
     }
   }
 
@@ -0,0 +1,273 @@
+//------------------------------------------------------------------------------
+// Title: ImageArena.cpp
+//------------------------------------------------------------------------------
+
+#include "ImageArena.h"
+
+#include <algorithm>
+
+namespace ScallopTK
+{
+
+ImageArenaStats::ImageArenaStats()
+ : requests( 0 ),
+   hits( 0 ),
+   heldBytes( 0 ),
+   peakHeldBytes( 0 ),
+   peakBorrowedBytes( 0 ),
+   evictions( 0 ),
+   arenas( 0 )
+{
+}
+
+void ImageArenaStats::add( const ImageArenaStats& other )
+{
+  requests += other.requests;
+  hits += other.hits;
+  heldBytes += other.heldBytes;
+  peakHeldBytes += other.peakHeldBytes;
+  peakBorrowedBytes += other.peakBorrowedBytes;
+  evictions += other.evictions;
+  arenas += other.arenas;
+}
+
+void ImageArenaStats::print( std::ostream& out ) const
+{
+  const double megabyte = 1024.0 * 1024.0;
+
+  out << "Image Arena: " << hits << " of " << requests << " images reused";
+
+  if( requests > 0 )
+  {
+    out << " (" << 100.0 * hits / requests << "%)";
+  }
+
+  out << ", " << peakHeldBytes / megabyte << " MB peak held, ";
+  out << peakBorrowedBytes / megabyte << " MB peak in use";
+
+  if( arenas > 1 )
+  {
+    out << " (sums of " << arenas << " per-worker peaks)";
+  }
+
+  out << ", " << evictions << " evicted" << std::endl;
+}
+
+bool ImageArena::ImageKey::operator<( const ImageKey& other ) const
+{
+  if( width != other.width )
+    return width < other.width;
+  if( height != other.height )
+    return height < other.height;
+  if( depth != other.depth )
+    return depth < other.depth;
+  return channels < other.channels;
+}
+
+ImageArena::ImageKey ImageArena::keyOf( CvSize size, int depth, int channels )
+{
+  ImageKey key;
+  key.width = size.width;
+  key.height = size.height;
+  key.depth = depth;
+  key.channels = channels;
+  return key;
+}
+
+size_t ImageArena::bytesOf( IplImage *image )
+{
+  return image->imageSize;
+}
+
+ImageArena::ImageArena()
+ : borrowedBytes( 0 )
+{
+}
+
+ImageArena::~ImageArena()
+{
+  clear();
+
+  // Borrowed images are owned by whoever has them
+  for( std::set< IplImage* >::iterator itr = borrowed.begin();
+       itr != borrowed.end(); itr++ )
+  {
+    IplImage *image = *itr;
+    cvReleaseImage( &image );
+  }
+}
+
+IplImage *ImageArena::acquire( CvSize size, int depth, int channels )
+{
+  IplImage *image = NULL;
+
+  lock.lock();
+
+  stats.requests++;
+
+  ImageKey key = keyOf( size, depth, channels );
+  used.insert( key );
+
+  std::map< ImageKey, std::vector< IplImage* > >::iterator itr =
+    pooled.find( key );
+
+  if( itr != pooled.end() && !itr->second.empty() )
+  {
+    image = itr->second.back();
+    itr->second.pop_back();
+    stats.hits++;
+  }
+  else
+  {
+    // Allocate outside of the lock on a miss
+    lock.unlock();
+    image = cvCreateImage( size, depth, channels );
+    lock.lock();
+
+    stats.heldBytes += bytesOf( image );
+    stats.peakHeldBytes = std::max( stats.peakHeldBytes, stats.heldBytes );
+  }
+
+  borrowed.insert( image );
+  borrowedBytes += bytesOf( image );
+  stats.peakBorrowedBytes = std::max( stats.peakBorrowedBytes, borrowedBytes );
+
+  lock.unlock();
+  return image;
+}
+
+void ImageArena::release( IplImage *image )
+{
+  if( !image )
+  {
+    return;
+  }
+
+  cvResetImageROI( image );
+
+  lock.lock();
+
+  if( borrowed.erase( image ) > 0 )
+  {
+    borrowedBytes -= bytesOf( image );
+  }
+  else
+  {
+    // Adopt an image allocated elsewhere
+    stats.heldBytes += bytesOf( image );
+    stats.peakHeldBytes = std::max( stats.peakHeldBytes, stats.heldBytes );
+  }
+
+  ImageKey key = keyOf( cvGetSize( image ), image->depth, image->nChannels );
+  used.insert( key );
+  pooled[ key ].push_back( image );
+
+  lock.unlock();
+}
+
+void ImageArena::clear()
+{
+  lock.lock();
+
+  for( std::map< ImageKey, std::vector< IplImage* > >::iterator itr = pooled.begin();
+       itr != pooled.end(); itr++ )
+  {
+    for( unsigned i = 0; i < itr->second.size(); i++ )
+    {
+      stats.heldBytes -= bytesOf( itr->second[i] );
+      cvReleaseImage( &itr->second[i] );
+    }
+  }
+
+  pooled.clear();
+
+  lock.unlock();
+}
+
+void ImageArena::nextFrame()
+{
+  lock.lock();
+
+  std::map< ImageKey, std::vector< IplImage* > >::iterator itr = pooled.begin();
+
+  while( itr != pooled.end() )
+  {
+    if( used.count( itr->first ) > 0 )
+    {
+      itr++;
+      continue;
+    }
+
+    for( unsigned i = 0; i < itr->second.size(); i++ )
+    {
+      stats.heldBytes -= bytesOf( itr->second[i] );
+      stats.evictions++;
+      cvReleaseImage( &itr->second[i] );
+    }
+
+    pooled.erase( itr++ );
+  }
+
+  used.clear();
+
+  lock.unlock();
+}
+
+ImageArenaStats ImageArena::getStats()
+{
+  lock.lock();
+  ImageArenaStats output = stats;
+  lock.unlock();
+  output.arenas = 1;
+  return output;
+}
+
+ArenaImageGuard::~ArenaImageGuard()
+{
+  for( unsigned i = 0; i < images.size(); i++ )
+  {
+    arenaReleaseImage( arena, images[i] );
+  }
+}
+
+IplImage *arenaCreateImage( ImageArena *arena, CvSize size, int depth, int channels )
+{
+  if( arena )
+  {
+    return arena->acquire( size, depth, channels );
+  }
+
+  return cvCreateImage( size, depth, channels );
+}
+
+IplImage *arenaCloneImage( ImageArena *arena, IplImage *image )
+{
+  if( !arena )
+  {
+    return cvCloneImage( image );
+  }
+
+  IplImage *output = arena->acquire( cvGetSize( image ), image->depth, image->nChannels );
+  cvCopy( image, output );
+  return output;
+}
+
+void arenaReleaseImage( ImageArena *arena, IplImage **image )
+{
+  if( !*image )
+  {
+    return;
+  }
+
+  if( arena )
+  {
+    arena->release( *image );
+    *image = NULL;
+  }
+  else
+  {
+    cvReleaseImage( image );
+  }
+}
+
+}
@@ -0,0 +1,154 @@
+//------------------------------------------------------------------------------
+// Title: ImageArena.h
+// Description: Pool of images, keyed by size and type, which processing
+//  stages borrow from and return to instead of allocating for every frame
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_IMAGE_ARENA_H_
+#define SCALLOP_TK_IMAGE_ARENA_H_
+
+// C/C++ Includes
+#include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+
+// OpenCV Includes
+#include <cv.h>
+#include <cxcore.h>
+
+// Scallop Includes
+#include "ScallopTK/Utilities/Threads.h"
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                              Class Definitions
+//------------------------------------------------------------------------------
+
+// Usage statistics for one or more arenas
+struct ImageArenaStats
+{
+  // Number of images requested, and how many were reused from the pool
+  unsigned long requests;
+  unsigned long hits;
+
+  // Current and peak bytes of image data owned by the arena (both pooled
+  // and borrowed), and peak bytes borrowed at once
+  size_t heldBytes;
+  size_t peakHeldBytes;
+  size_t peakBorrowedBytes;
+
+  // Number of pooled images freed at the end of a frame as unused
+  unsigned long evictions;
+
+  // Number of arenas these statistics were collected from
+  unsigned arenas;
+
+  ImageArenaStats();
+
+  // Combine with statistics from another arena. Peaks are summed, as arenas
+  // don't record when theirs occurred, so combined peaks are an upper bound
+  // on the peak of all arenas at once.
+  void add( const ImageArenaStats& other );
+
+  // Print statistics in a single line
+  void print( std::ostream& out ) const;
+};
+
+class ImageArena
+{
+public:
+
+  ImageArena();
+  ~ImageArena();
+
+  // Borrow an image of the given size and type, contents are undefined
+  IplImage *acquire( CvSize size, int depth, int channels );
+
+  // Return an image for later reuse. Images created by cvCreateImage outside
+  // of the arena may also be returned, the arena then takes ownership.
+  void release( IplImage *image );
+
+  // Free all pooled images which are not currently borrowed
+  void clear();
+
+  // Mark the end of a frame, freeing pooled images of any size and type
+  // which was neither acquired nor released during it. Sizes change with
+  // input resolution and tiling, so without this images for sizes no
+  // longer in use would be held until the arena is destroyed.
+  void nextFrame();
+
+  // Retrieve usage statistics collected so far
+  ImageArenaStats getStats();
+
+private:
+
+  // Pool key
+  struct ImageKey
+  {
+    int width;
+    int height;
+    int depth;
+    int channels;
+
+    bool operator<( const ImageKey& other ) const;
+  };
+
+  static ImageKey keyOf( CvSize size, int depth, int channels );
+  static size_t bytesOf( IplImage *image );
+
+  // Guards all members below, stages may share an arena across threads
+  ThreadMutex lock;
+
+  // Images available for reuse
+  std::map< ImageKey, std::vector< IplImage* > > pooled;
+
+  // Keys acquired or released since the last call to nextFrame
+  std::set< ImageKey > used;
+
+  // Images currently borrowed
+  std::set< IplImage* > borrowed;
+  size_t borrowedBytes;
+
+  ImageArenaStats stats;
+
+  ImageArena( const ImageArena& );
+  ImageArena& operator=( const ImageArena& );
+};
+
+// Returns a set of borrowed images to an arena (or the heap) when it goes
+// out of scope, so they are not lost if the borrowing function throws
+class ArenaImageGuard
+{
+public:
+
+  explicit ArenaImageGuard( ImageArena *arena ) : arena( arena ) {}
+  ~ArenaImageGuard();
+
+  // Release *image on destruction, unless it has been set to NULL
+  void add( IplImage **image ) { images.push_back( image ); }
+
+private:
+
+  ImageArena *arena;
+  std::vector< IplImage** > images;
+
+  ArenaImageGuard( const ArenaImageGuard& );
+  ArenaImageGuard& operator=( const ArenaImageGuard& );
+};
+
+//------------------------------------------------------------------------------
+//                             Function Prototypes
+//------------------------------------------------------------------------------
+
+// Equivalents of cvCreateImage, cvCloneImage and cvReleaseImage which use the
+// given arena, or the heap if the arena is NULL
+IplImage *arenaCreateImage( ImageArena *arena, CvSize size, int depth, int channels );
+IplImage *arenaCloneImage( ImageArena *arena, IplImage *image );
+void arenaReleaseImage( ImageArena *arena, IplImage **image );
+
+}
+
+#endif
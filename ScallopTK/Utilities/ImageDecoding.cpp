@@ -0,0 +1,364 @@
+//------------------------------------------------------------------------------
+// Title: ImageDecoding.cpp
+//------------------------------------------------------------------------------
+
+#include "ImageDecoding.h"
+
+#include <stdio.h>
+
+#ifdef USE_LIBJPEG
+  #include <setjmp.h>
+
+  extern "C" {
+    #include <jpeglib.h>
+  }
+#endif
+
+namespace ScallopTK
+{
+
+bool readFileContents( const std::string& filename,
+  std::vector< unsigned char >& contents, size_t maxBytes )
+{
+  contents.clear();
+
+  FILE *file = fopen( filename.c_str(), "rb" );
+
+  if( !file )
+  {
+    return false;
+  }
+
+  bool success = false;
+
+  if( fseek( file, 0, SEEK_END ) == 0 )
+  {
+    long size = ftell( file );
+
+    if( maxBytes > 0 && (size_t)size > maxBytes )
+    {
+      size = (long)maxBytes;
+    }
+
+    if( size > 0 && fseek( file, 0, SEEK_SET ) == 0 )
+    {
+      contents.resize( size );
+      success = ( fread( &contents[0], 1, size, file ) == (size_t)size );
+    }
+  }
+
+  fclose( file );
+
+  if( !success )
+  {
+    contents.clear();
+  }
+
+  return success;
+}
+
+// Is the given marker a start of frame segment (which holds the image size)?
+static bool isFrameMarker( int marker )
+{
+  return marker >= 0xC0 && marker <= 0xCF &&
+         marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+bool readJpegSegments( const unsigned char *contents, size_t size,
+  std::vector< JpegSegment >& segments )
+{
+  segments.clear();
+
+  // Check for the start of image marker
+  if( size < 2 || contents[0] != 0xFF || contents[1] != 0xD8 )
+  {
+    return false;
+  }
+
+  size_t position = 2;
+
+  while( position < size && contents[position] == 0xFF )
+  {
+    // Skip fill bytes
+    while( position < size && contents[position] == 0xFF )
+    {
+      position++;
+    }
+
+    if( position >= size )
+    {
+      break;
+    }
+
+    int marker = contents[position++];
+
+    // Markers without a segment
+    if( marker == 0x01 || ( marker >= 0xD0 && marker <= 0xD7 ) )
+    {
+      continue;
+    }
+
+    // End of image, or start of the image data
+    if( marker == 0xD9 || marker == 0xDA || position + 2 > size )
+    {
+      break;
+    }
+
+    size_t length = ( contents[position] << 8 ) | contents[position+1];
+
+    if( length < 2 || position + length > size )
+    {
+      break;
+    }
+
+    JpegSegment segment;
+    segment.marker = marker;
+    segment.data = contents + position + 2;
+    segment.length = length - 2;
+    segments.push_back( segment );
+
+    position += length;
+  }
+
+  return true;
+}
+
+bool readImageSize( const std::vector< unsigned char >& contents, cv::Size& size )
+{
+  std::vector< JpegSegment > segments;
+
+  if( contents.empty() ||
+      !readJpegSegments( &contents[0], contents.size(), segments ) )
+  {
+    return false;
+  }
+
+  for( unsigned i = 0; i < segments.size(); i++ )
+  {
+    const JpegSegment& segment = segments[i];
+
+    // Sample precision, followed by height and width
+    if( isFrameMarker( segment.marker ) && segment.length >= 5 )
+    {
+      int rows = ( segment.data[1] << 8 ) | segment.data[2];
+      int cols = ( segment.data[3] << 8 ) | segment.data[4];
+
+      if( rows > 0 && cols > 0 )
+      {
+        size = cv::Size( cols, rows );
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+#ifdef USE_LIBJPEG
+
+// Error handler which returns control to the decoder instead of exiting
+struct DecodeErrorManager
+{
+  jpeg_error_mgr base;
+  jmp_buf jump;
+};
+
+static void onDecodeError( j_common_ptr info )
+{
+  DecodeErrorManager *manager = (DecodeErrorManager*) info->err;
+  longjmp( manager->jump, 1 );
+}
+
+// Source manager callbacks for reading from memory, as jpeg_mem_src is not
+// available in all libjpeg versions
+static const JOCTET endOfImage[2] = { 0xFF, JPEG_EOI };
+
+static void initSource( j_decompress_ptr )
+{
+}
+
+static boolean fillInputBuffer( j_decompress_ptr info )
+{
+  // The whole file is already buffered, so pad truncated files with an end
+  // of image marker like libjpeg's own sources do
+  info->src->next_input_byte = endOfImage;
+  info->src->bytes_in_buffer = 2;
+  return TRUE;
+}
+
+static void skipInputData( j_decompress_ptr info, long count )
+{
+  if( count <= 0 )
+  {
+    return;
+  }
+
+  if( (size_t)count > info->src->bytes_in_buffer )
+  {
+    fillInputBuffer( info );
+    return;
+  }
+
+  info->src->next_input_byte += count;
+  info->src->bytes_in_buffer -= count;
+}
+
+static void termSource( j_decompress_ptr )
+{
+}
+
+// State of a single decode. libjpeg reports errors by longjmp, which skips
+// C++ destructors and leaves locals changed after setjmp indeterminate, so
+// the steps below which call into libjpeg only touch this plain C state and
+// any C++ objects are created outside of them.
+struct JpegDecode
+{
+  jpeg_decompress_struct info;
+  jpeg_source_mgr source;
+  DecodeErrorManager error;
+};
+
+// Read the header and start decompressing at 1/denominator scale, as BGR or
+// greyscale. Returns false, with the decoder destroyed, on failure or if the
+// image has another layout.
+static bool startJpegDecode( JpegDecode *decode, const unsigned char *data,
+  size_t size, int denominator )
+{
+  jpeg_decompress_struct *info = &decode->info;
+
+  info->err = jpeg_std_error( &decode->error.base );
+  decode->error.base.error_exit = onDecodeError;
+
+  if( setjmp( decode->error.jump ) )
+  {
+    jpeg_destroy_decompress( &decode->info );
+    return false;
+  }
+
+  jpeg_create_decompress( info );
+
+  decode->source.next_input_byte = data;
+  decode->source.bytes_in_buffer = size;
+  decode->source.init_source = initSource;
+  decode->source.fill_input_buffer = fillInputBuffer;
+  decode->source.skip_input_data = skipInputData;
+  decode->source.resync_to_restart = jpeg_resync_to_restart;
+  decode->source.term_source = termSource;
+  info->src = &decode->source;
+
+  jpeg_read_header( info, TRUE );
+
+  if( info->jpeg_color_space == JCS_GRAYSCALE )
+  {
+    info->out_color_space = JCS_GRAYSCALE;
+  }
+  else if( info->num_components == 3 )
+  {
+    info->out_color_space = JCS_RGB;
+  }
+  else
+  {
+    // CMYK and other layouts are left to OpenCV
+    jpeg_destroy_decompress( info );
+    return false;
+  }
+
+  info->scale_num = 1;
+  info->scale_denom = denominator;
+  info->dct_method = JDCT_ISLOW;
+
+  jpeg_start_decompress( info );
+  return true;
+}
+
+// Read every output row of a started decode into a buffer of output_height
+// rows of the given stride, then destroy the decoder. Returns false on failure.
+static bool finishJpegDecode( JpegDecode *decode, unsigned char *data,
+  size_t step )
+{
+  jpeg_decompress_struct *info = &decode->info;
+
+  if( setjmp( decode->error.jump ) )
+  {
+    jpeg_destroy_decompress( &decode->info );
+    return false;
+  }
+
+  while( info->output_scanline < info->output_height )
+  {
+    JSAMPROW row = data + info->output_scanline * step;
+    jpeg_read_scanlines( info, &row, 1 );
+  }
+
+  jpeg_finish_decompress( info );
+  jpeg_destroy_decompress( info );
+  return true;
+}
+
+// Decode a JPEG at 1/denominator scale, returns an empty image on failure or
+// if the image can't be output as BGR or greyscale
+static cv::Mat decodeScaledJpeg( const std::vector< unsigned char >& contents,
+  int denominator )
+{
+  JpegDecode decode;
+
+  if( !startJpegDecode( &decode, &contents[0], contents.size(), denominator ) )
+  {
+    return cv::Mat();
+  }
+
+  cv::Mat output( decode.info.output_height, decode.info.output_width,
+    decode.info.output_components == 1 ? CV_8UC1 : CV_8UC3 );
+
+  if( !finishJpegDecode( &decode, output.data, output.step ) )
+  {
+    return cv::Mat();
+  }
+
+  if( output.channels() == 1 )
+  {
+    cv::cvtColor( output, output, CV_GRAY2BGR );
+  }
+  else
+  {
+    cv::cvtColor( output, output, CV_RGB2BGR );
+  }
+
+  return output;
+}
+
+#endif
+
+cv::Mat decodeImage( const std::vector< unsigned char >& contents, float minScale )
+{
+  if( contents.empty() )
+  {
+    return cv::Mat();
+  }
+
+#ifdef USE_LIBJPEG
+  // Largest supported denominator which doesn't go below the minimum scale
+  int denominator = 1;
+
+  while( denominator < 8 && 1.0f / ( 2 * denominator ) >= minScale )
+  {
+    denominator *= 2;
+  }
+
+  // Files which aren't JPEGs are rejected by libjpeg, then left to OpenCV
+  if( denominator > 1 )
+  {
+    cv::Mat output = decodeScaledJpeg( contents, denominator );
+
+    if( !output.empty() )
+    {
+      return output;
+    }
+  }
+#endif
+
+  // Wraps the buffer without copying it
+  return cv::imdecode( cv::Mat( contents ), CV_LOAD_IMAGE_COLOR );
+}
+
+}
@@ -0,0 +1,62 @@
+//------------------------------------------------------------------------------
+// Title: ImageDecoding.h
+// Description: Reads image files into memory once, then reads dimensions from
+//  their headers and decodes JPEGs directly at a reduced resolution using
+//  libjpeg DCT scaling
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_IMAGE_DECODING_H_
+#define SCALLOP_TK_IMAGE_DECODING_H_
+
+// C/C++ Includes
+#include <string>
+#include <vector>
+
+// OpenCV Includes
+#include <cv.h>
+#include <highgui.h>
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                              Class Definitions
+//------------------------------------------------------------------------------
+
+// A marker segment of a JPEG file, pointing into the file contents
+struct JpegSegment
+{
+  int marker;
+  const unsigned char *data;
+  size_t length;
+};
+
+//------------------------------------------------------------------------------
+//                             Function Prototypes
+//------------------------------------------------------------------------------
+
+// Read the contents of a file into memory, or only its first maxBytes if
+// non-zero, returns false on failure
+bool readFileContents( const std::string& filename,
+  std::vector< unsigned char >& contents, size_t maxBytes = 0 );
+
+// List the marker segments of a JPEG held in memory which precede the image
+// data (stopping at the first scan, or a segment extending past the end of
+// the contents). Returns false if the contents aren't a JPEG.
+bool readJpegSegments( const unsigned char *contents, size_t size,
+  std::vector< JpegSegment >& segments );
+
+// Read the full resolution of a JPEG from its frame header, without
+// decoding it. Returns false for other formats or truncated files.
+bool readImageSize( const std::vector< unsigned char >& contents, cv::Size& size );
+
+// Decode an image held in memory as 8-bit BGR, at the smallest DCT scale
+// (1, 1/2, 1/4 or 1/8) which is at least minScale of its full resolution.
+// The output is only reduced for JPEGs in builds with libjpeg, otherwise (or
+// if minScale is above 1/2) the image is decoded at full resolution.
+cv::Mat decodeImage( const std::vector< unsigned char >& contents,
+  float minScale = 1.0f );
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+//------------------------------------------------------------------------------
+// Title: ImagePrefetcher.cpp
+//------------------------------------------------------------------------------
+
+#include "ImagePrefetcher.h"
+
+#include "ScallopTK/Utilities/ImageDecoding.h"
+
+namespace ScallopTK
+{
+
+ImagePrefetcher::ImagePrefetcher( const std::vector< std::string >& files,
+  unsigned queueDepth, unsigned threads, DecodeScaleSelector *selector,
+  bool readMetadata )
+ : filenames( files ),
+   depth( queueDepth ),
+   scaleSelector( selector ),
+   parseMetadata( readMetadata ),
+   prefetching( false ),
+   nextDecode( 0 ),
+   inProgress( 0 ),
+   stopping( false ),
+   requests( 0 ),
+   starved( 0 ),
+   bufferedTotal( 0 ),
+   waitSeconds( 0.0 )
+{
+  if( !THREADING_ENABLED || depth == 0 || threads == 0 )
+  {
+    return;
+  }
+
+  // No point in having more decoders than queue slots
+  threads = std::min( threads, depth );
+
+  for( unsigned i = 0; i < threads; i++ )
+  {
+    ThreadHandle handle;
+
+    if( !launchThread( handle, decodeLoop, this ) )
+    {
+      std::cerr << "WARNING: Unable to launch image decode thread" << std::endl;
+      break;
+    }
+
+    handles.push_back( handle );
+  }
+
+  prefetching = !handles.empty();
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+  stop();
+}
+
+void ImagePrefetcher::stop()
+{
+  lock.lock();
+  stopping = true;
+  spaceReady.broadcast();
+  imageReady.broadcast();
+  lock.unlock();
+
+  for( unsigned i = 0; i < handles.size(); i++ )
+  {
+    joinThread( handles[i] );
+  }
+
+  handles.clear();
+}
+
+DecodedFrame ImagePrefetcher::decode( unsigned index )
+{
+  DecodedFrame output;
+  float scale = 1.0f;
+
+  // Read the file once, metadata and the image are both parsed from memory
+  std::vector< unsigned char > contents;
+
+  if( !readFileContents( filenames[index], contents ) )
+  {
+    return output;
+  }
+
+  if( parseMetadata )
+  {
+    parseImageMetadata( filenames[index], contents, output.metadata );
+  }
+
+  if( scaleSelector && readImageSize( contents, output.fullSize ) )
+  {
+    scale = scaleSelector->getDecodeScale( index, output.fullSize, output.metadata );
+  }
+
+  output.image = decodeImage( contents, scale );
+
+  if( output.fullSize.width == 0 || output.fullSize.height == 0 )
+  {
+    output.fullSize = output.image.size();
+  }
+
+  return output;
+}
+
+DecodedFrame ImagePrefetcher::getImage( unsigned index )
+{
+  // Decode on the calling thread if not prefetching
+  if( !isPrefetching() )
+  {
+    int64 start = cv::getTickCount();
+    DecodedFrame frame = decode( index );
+
+    lock.lock();
+    requests++;
+    starved++;
+    waitSeconds += ( cv::getTickCount() - start ) / cv::getTickFrequency();
+    lock.unlock();
+    return frame;
+  }
+
+  lock.lock();
+
+  requests++;
+  bufferedTotal += decoded.size();
+
+  std::map< unsigned, DecodedFrame >::iterator itr = decoded.find( index );
+
+  // Wait for the frame if it is not yet ready
+  if( itr == decoded.end() )
+  {
+    int64 start = cv::getTickCount();
+    starved++;
+
+    while( itr == decoded.end() && !stopping )
+    {
+      imageReady.wait( lock );
+      itr = decoded.find( index );
+    }
+
+    waitSeconds += ( cv::getTickCount() - start ) / cv::getTickFrequency();
+  }
+
+  DecodedFrame frame;
+
+  if( itr != decoded.end() )
+  {
+    frame = itr->second;
+    decoded.erase( itr );
+    spaceReady.signal();
+  }
+
+  lock.unlock();
+  return frame;
+}
+
+void ImagePrefetcher::printStats( std::ostream& out )
+{
+  lock.lock();
+
+  out << "Image Prefetch Queue: " << starved << " of " << requests;
+  out << " frames waited on decode, " << waitSeconds << "s total wait";
+
+  if( isPrefetching() && requests > 0 )
+  {
+    out << ", " << double( bufferedTotal ) / requests;
+    out << " of " << depth << " frames buffered on average";
+  }
+
+  out << std::endl;
+
+  lock.unlock();
+}
+
+void *ImagePrefetcher::decodeLoop( void *arg )
+{
+  ImagePrefetcher *queue = (ImagePrefetcher*) arg;
+
+  queue->lock.lock();
+
+  while( true )
+  {
+    // Wait for a free slot in the queue
+    while( !queue->stopping &&
+           queue->nextDecode < queue->filenames.size() &&
+           queue->decoded.size() + queue->inProgress >= queue->depth )
+    {
+      queue->spaceReady.wait( queue->lock );
+    }
+
+    if( queue->stopping || queue->nextDecode >= queue->filenames.size() )
+    {
+      break;
+    }
+
+    unsigned index = queue->nextDecode++;
+    queue->inProgress++;
+
+    // Read and decode without holding the lock
+    queue->lock.unlock();
+    DecodedFrame frame = queue->decode( index );
+    queue->lock.lock();
+
+    queue->inProgress--;
+    queue->decoded[index] = frame;
+    queue->imageReady.broadcast();
+  }
+
+  queue->lock.unlock();
+  return NULL;
+}
+
+}
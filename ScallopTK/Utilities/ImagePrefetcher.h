@@ -0,0 +1,129 @@
+//------------------------------------------------------------------------------
+// Title: ImagePrefetcher.h
+// Description: Bounded queue which reads and decodes upcoming input images
+//  on background threads, so that file IO overlaps with detection. Each file
+//  is read once, with metadata parsed from and images decoded in memory.
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_IMAGE_PREFETCHER_H_
+#define SCALLOP_TK_IMAGE_PREFETCHER_H_
+
+// C/C++ Includes
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+// OpenCV Includes
+#include <cv.h>
+#include <highgui.h>
+
+// Scallop Includes
+#include "ScallopTK/Utilities/Threads.h"
+#include "ScallopTK/ScaleDetection/ImageProperties.h"
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                              Class Definitions
+//------------------------------------------------------------------------------
+
+// A decoded frame, the full resolution of its file (before any reduced
+// scale decode) and metadata read from the file, if requested
+struct DecodedFrame
+{
+  cv::Mat image;
+  cv::Size fullSize;
+  ImageMetadata metadata;
+};
+
+// Chooses the lowest resolution each frame is needed at, so that it can be
+// decoded at a reduced scale
+class DecodeScaleSelector
+{
+public:
+
+  virtual ~DecodeScaleSelector() {}
+
+  // Fraction of the given full resolution required for the given frame index,
+  // may be called from multiple decode threads at once
+  virtual float getDecodeScale( unsigned index, const cv::Size& fullSize,
+    const ImageMetadata& metadata ) = 0;
+};
+
+class ImagePrefetcher
+{
+public:
+
+  // Begin decoding the given files in order on the given number of threads,
+  // keeping at most depth images decoded (or being decoded) ahead of the
+  // consumers. If depth or threads is 0, or threading is disabled in this
+  // build, images are instead decoded on request by getImage. If a selector
+  // is given, JPEGs are decoded at no less than the scale it chooses. If
+  // readMetadata is set, metadata is also parsed from each file.
+  ImagePrefetcher( const std::vector< std::string >& filenames,
+    unsigned depth, unsigned threads, DecodeScaleSelector *selector = NULL,
+    bool readMetadata = false );
+  ~ImagePrefetcher();
+
+  // Retrieve the decoded frame for the given frame index, blocking until it
+  // is available. Each index should be retrieved once, roughly in order.
+  DecodedFrame getImage( unsigned index );
+
+  // Stop decoding new frames and wait for all decode threads to exit
+  void stop();
+
+  // Is background decoding enabled?
+  bool isPrefetching() const { return prefetching; }
+
+  // Print queue starvation statistics collected so far
+  void printStats( std::ostream& out );
+
+private:
+
+  // Decode thread main loop
+  static void *decodeLoop( void *arg );
+
+  // Read and decode a single frame, at a reduced scale if possible
+  DecodedFrame decode( unsigned index );
+
+  // Inputs
+  std::vector< std::string > filenames;
+  unsigned depth;
+  DecodeScaleSelector *scaleSelector;
+  bool parseMetadata;
+
+  // Decode threads
+  std::vector< ThreadHandle > handles;
+  bool prefetching;
+
+  // Guards all members below
+  ThreadMutex lock;
+  ThreadCondition imageReady;
+  ThreadCondition spaceReady;
+
+  // Decoded frames not yet retrieved, keyed by frame index
+  std::map< unsigned, DecodedFrame > decoded;
+
+  // Next frame index to decode, and number of decodes in progress
+  unsigned nextDecode;
+  unsigned inProgress;
+
+  // Set when decode threads should exit
+  bool stopping;
+
+  // Starvation statistics
+  unsigned requests;
+  unsigned starved;
+  unsigned bufferedTotal;
+  double waitSeconds;
+
+  ImagePrefetcher( const ImagePrefetcher& );
+  ImagePrefetcher& operator=( const ImagePrefetcher& );
+};
+
+}
+
+#endif
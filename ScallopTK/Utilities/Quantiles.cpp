@@ -0,0 +1,172 @@
+//------------------------------------------------------------------------------
+// Title: Quantiles.cpp
+//------------------------------------------------------------------------------
+
+#include "Quantiles.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "ScallopTK/Utilities/SIMD.h"
+
+namespace ScallopTK
+{
+
+// True unless value is infinite or NaN
+static inline bool isFinite( float value )
+{
+  return value - value == 0.0f;
+}
+
+#ifdef SCALLOP_TK_USE_SSE
+// Number of bits set in each 4-bit movemask result
+static const int maskBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+#endif
+
+QuantileHistogram::QuantileHistogram( IplImage *img, float pivot )
+ : counts( QUANTILE_BINS, 0 ),
+   cumulative( QUANTILE_BINS, 0 ),
+   minValue( 0.0f ),
+   maxValue( 0.0f ),
+   binWidth( 0.0f ),
+   total( 0 ),
+   pivotCount( 0 )
+{
+  assert( img->nChannels == 1 );
+  assert( img->depth == IPL_DEPTH_32F );
+
+  // Find the range of finite values, count them, and count those at or
+  // below the pivot. Infinite and NaN values are left out of the histogram.
+  float rangeMin = std::numeric_limits< float >::max();
+  float rangeMax = -rangeMin;
+
+#ifdef SCALLOP_TK_USE_SSE
+  const __m128 pivots = _mm_set1_ps( pivot );
+  __m128 mins = _mm_set1_ps( rangeMin );
+  __m128 maxs = _mm_set1_ps( rangeMax );
+#endif
+
+  for( int r = 0; r < img->height; r++ )
+  {
+    const float *row = (const float*)( img->imageData + r * img->widthStep );
+    int c = 0;
+
+#ifdef SCALLOP_TK_USE_SSE
+    for( ; c + 4 <= img->width; c += 4 )
+    {
+      __m128 v = _mm_loadu_ps( row + c );
+
+      // v - v is 0 for finite values and NaN otherwise
+      __m128 diff = _mm_sub_ps( v, v );
+      __m128 finite = _mm_cmpeq_ps( diff, diff );
+
+      // Non-finite lanes take the other operand of min and max
+      mins = _mm_min_ps( mins, _mm_or_ps( _mm_and_ps( finite, v ),
+        _mm_andnot_ps( finite, mins ) ) );
+      maxs = _mm_max_ps( maxs, _mm_or_ps( _mm_and_ps( finite, v ),
+        _mm_andnot_ps( finite, maxs ) ) );
+
+      total += maskBits[ _mm_movemask_ps( finite ) ];
+      pivotCount += maskBits[ _mm_movemask_ps(
+        _mm_and_ps( finite, _mm_cmple_ps( v, pivots ) ) ) ];
+    }
+#endif
+
+    for( ; c < img->width; c++ )
+    {
+      if( !isFinite( row[c] ) )
+      {
+        continue;
+      }
+
+      rangeMin = std::min( rangeMin, row[c] );
+      rangeMax = std::max( rangeMax, row[c] );
+      total++;
+      pivotCount += ( row[c] <= pivot );
+    }
+  }
+
+#ifdef SCALLOP_TK_USE_SSE
+  float lanes[4];
+  _mm_storeu_ps( lanes, mins );
+  rangeMin = std::min( rangeMin, *std::min_element( lanes, lanes + 4 ) );
+  _mm_storeu_ps( lanes, maxs );
+  rangeMax = std::max( rangeMax, *std::max_element( lanes, lanes + 4 ) );
+#endif
+
+  if( total == 0 )
+  {
+    return;
+  }
+
+  minValue = rangeMin;
+  maxValue = rangeMax;
+
+  // Histogram all finite values, the maximum goes in the last bin. Bins
+  // depend on the range found above, so this needs a second pass.
+  if( maxValue > minValue )
+  {
+    binWidth = ( maxValue - minValue ) / QUANTILE_BINS;
+    float binScale = QUANTILE_BINS / ( maxValue - minValue );
+
+    for( int r = 0; r < img->height; r++ )
+    {
+      const float *row = (const float*)( img->imageData + r * img->widthStep );
+
+      for( int c = 0; c < img->width; c++ )
+      {
+        if( !isFinite( row[c] ) )
+        {
+          continue;
+        }
+
+        int bin = (int)( ( row[c] - minValue ) * binScale );
+        counts[ std::max( 0, std::min( bin, QUANTILE_BINS - 1 ) ) ]++;
+      }
+    }
+  }
+  else
+  {
+    counts[0] = total;
+  }
+
+  for( int i = 1; i < QUANTILE_BINS; i++ )
+  {
+    cumulative[i] = cumulative[i-1] + counts[i-1];
+  }
+}
+
+float QuantileHistogram::valueAtRank( int rank ) const
+{
+  if( total == 0 || binWidth == 0.0f )
+  {
+    return minValue;
+  }
+
+  rank = std::max( 0, std::min( rank, total - 1 ) );
+
+  // Last bin starting at or before the rank, which holds it
+  int bin = (int)( std::upper_bound( cumulative.begin(), cumulative.end(), rank )
+    - cumulative.begin() ) - 1;
+
+  // Assume values are spread evenly within the bin
+  float offset = ( rank - cumulative[bin] + 0.5f ) / counts[bin];
+  float value = minValue + binWidth * ( bin + offset );
+
+  return std::min( value, maxValue );
+}
+
+float QuantileHistogram::quantile( float p ) const
+{
+  return valueAtRank( (int)( p * total ) );
+}
+
+void QuantileHistogram::quantiles( const float *p, int count, float *values ) const
+{
+  for( int i = 0; i < count; i++ )
+  {
+    values[i] = quantile( p[i] );
+  }
+}
+
+}
@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+// Title: Quantiles.h
+// Description: Histogram-based estimation of several quantiles of an image
+//  at once, in linear time and with a fixed error bound, instead of sorting
+//  a sample of its values for each statistic
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_QUANTILES_H_
+#define SCALLOP_TK_QUANTILES_H_
+
+// C/C++ Includes
+#include <vector>
+
+// OpenCV Includes
+#include <cv.h>
+#include <cxcore.h>
+
+namespace ScallopTK
+{
+
+//------------------------------------------------------------------------------
+//                                 Constants
+//------------------------------------------------------------------------------
+
+// Number of histogram bins spanning the range of an image's values
+const int QUANTILE_BINS = 4096;
+
+//------------------------------------------------------------------------------
+//                              Class Definitions
+//------------------------------------------------------------------------------
+
+// Histogram of every finite value in a single channel 32f image, built in two
+// passes over the image (the first finds its range). Any number of order
+// statistics can then be read from it, each within errorBound() of the exact
+// value, which is one bin width: (max - min) / QUANTILE_BINS. Infinite and
+// NaN values are ignored, and not counted in size().
+class QuantileHistogram
+{
+public:
+
+  // Build the histogram, also counting values at or below pivot exactly
+  explicit QuantileHistogram( IplImage *img, float pivot = 0.0f );
+
+  // Number of finite values in the histogram
+  int size() const { return total; }
+
+  // Number of finite values at or below the pivot
+  int pivotRank() const { return pivotCount; }
+
+  // Approximate rank'th smallest value (0 based, clamped to the valid range)
+  float valueAtRank( int rank ) const;
+
+  // Approximate p quantile, the floor(p*size)'th smallest value
+  float quantile( float p ) const;
+
+  // Approximate quantiles for count values of p
+  void quantiles( const float *p, int count, float *values ) const;
+
+  // Largest difference between any returned value and the exact one
+  float errorBound() const { return binWidth; }
+
+private:
+
+  // Number of values in each bin, and in all earlier bins
+  std::vector< int > counts;
+  std::vector< int > cumulative;
+
+  // Range of the histogram
+  float minValue;
+  float maxValue;
+  float binWidth;
+
+  // Total values, and values at or below the pivot
+  int total;
+  int pivotCount;
+};
+
+}
+
+#endif
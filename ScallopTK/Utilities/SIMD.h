@@ -0,0 +1,15 @@
+//------------------------------------------------------------------------------
+// Title: SIMD.h
+// Description: Compile-time detection of SSE support, defines
+//              SCALLOP_TK_USE_SSE and includes the intrinsics when present
+//------------------------------------------------------------------------------
+
+#ifndef SCALLOP_TK_SIMD_H_
+#define SCALLOP_TK_SIMD_H_
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+  #include <emmintrin.h>
+  #define SCALLOP_TK_USE_SSE
+#endif
+
+#endif
@@ -0,0 +1,180 @@
+//------------------------------------------------------------------------------
+// Title: Threads.cpp
+//------------------------------------------------------------------------------
+
+#include "Threads.h"
+
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
+namespace ScallopTK
+{
+
+// Shared state for a single parallelFor call
+struct ParallelForState {
+  const ParallelLoopBody *Body;
+  int Count;
+  int ChunkSize;
+  int Next;
+  ThreadMutex Lock;
+
+  // First error thrown by the body on any thread, guarded by Lock
+  bool Failed;
+  std::string Error;
+
+  // Helpers currently running chunks of this loop, guarded by the pool lock
+  int Active;
+  ThreadCondition Finished;
+};
+
+// Record an error thrown by the body and stop handing out chunks
+static void failParallelChunks( ParallelForState *state, const std::string& error ) {
+
+  state->Lock.lock();
+  if( !state->Failed ) {
+    state->Failed = true;
+    state->Error = error;
+  }
+  state->Next = state->Count;
+  state->Lock.unlock();
+}
+
+// Repeatedly claim and run chunks until the loop range is exhausted. Never
+// throws, errors are recorded in the state for the caller to rethrow.
+static void *runParallelChunks( void *arg ) {
+
+  ParallelForState *state = (ParallelForState*) arg;
+
+  while( true ) {
+
+    state->Lock.lock();
+    int begin = state->Next;
+    state->Next = std::min( state->Next + state->ChunkSize, state->Count );
+    state->Lock.unlock();
+
+    if( begin >= state->Count )
+      break;
+
+    try {
+      (*state->Body)( begin, std::min( begin + state->ChunkSize, state->Count ) );
+    }
+    catch( const std::exception& e ) {
+      failParallelChunks( state, e.what() );
+    }
+    catch( ... ) {
+      failParallelChunks( state, "Unknown error in parallel loop" );
+    }
+  }
+
+  return NULL;
+}
+
+// Helper threads shared by all parallelFor calls, launched on first use and
+// kept for the life of the process. Each call queues one request per helper
+// it would like; idle helpers take requests and run chunks of that loop,
+// while requests nobody took in time are withdrawn once the caller has run
+// out of chunks. Callers never wait for a helper to become free, so nested
+// and concurrent calls cannot deadlock, they just get fewer helpers.
+struct HelperPool {
+  ThreadMutex Lock;
+  ThreadCondition Work;
+  std::deque< ParallelForState* > Requests;
+  int Helpers;
+
+  HelperPool() : Helpers( 0 ) {}
+};
+
+// Never destroyed, as helpers may still be waiting on it at exit
+static HelperPool *helperPool = new HelperPool;
+
+static void *runHelper( void *arg ) {
+
+  HelperPool *pool = (HelperPool*) arg;
+
+  pool->Lock.lock();
+
+  while( true ) {
+
+    while( pool->Requests.empty() )
+      pool->Work.wait( pool->Lock );
+
+    ParallelForState *state = pool->Requests.front();
+    pool->Requests.pop_front();
+    state->Active++;
+    pool->Lock.unlock();
+
+    runParallelChunks( state );
+
+    pool->Lock.lock();
+    if( --state->Active == 0 )
+      state->Finished.signal();
+  }
+
+  return NULL;
+}
+
+void parallelFor( int count, const ParallelLoopBody& body,
+  int threads, int chunkSize ) {
+
+  if( count <= 0 )
+    return;
+
+  chunkSize = std::max( chunkSize, 1 );
+  threads = std::min( threads, ( count + chunkSize - 1 ) / chunkSize );
+  threads = std::min( threads, MAX_THREADS );
+
+  // Run serially if there's nothing to gain
+  if( !THREADING_ENABLED || threads <= 1 ) {
+    body( 0, count );
+    return;
+  }
+
+  ParallelForState state;
+  state.Body = &body;
+  state.Count = count;
+  state.ChunkSize = chunkSize;
+  state.Next = 0;
+  state.Failed = false;
+  state.Active = 0;
+
+  HelperPool *pool = helperPool;
+
+  // Grow the pool to the largest helper count requested so far, then post
+  // requests for helpers, the calling thread also processes chunks
+  pool->Lock.lock();
+
+  while( pool->Helpers < threads - 1 ) {
+    ThreadHandle handle;
+    if( !launchThread( handle, runHelper, pool ) )
+      break;
+#ifdef USE_PTHREADS
+    pthread_detach( handle );
+#endif
+    pool->Helpers++;
+  }
+
+  for( int i = 0; i < threads - 1; i++ )
+    pool->Requests.push_back( &state );
+
+  pool->Work.broadcast();
+  pool->Lock.unlock();
+
+  runParallelChunks( &state );
+
+  // Withdraw untaken requests and wait for helpers still running chunks
+  pool->Lock.lock();
+
+  pool->Requests.erase( std::remove( pool->Requests.begin(),
+    pool->Requests.end(), &state ), pool->Requests.end() );
+
+  while( state.Active > 0 )
+    state.Finished.wait( pool->Lock );
+
+  pool->Lock.unlock();
+
+  if( state.Failed )
+    throw std::runtime_error( state.Error );
+}
+
+}
@@ -19,15 +19,20 @@
 // Scallop Includes
 #include "Definitions.h"
 
+// PThreads
+#ifdef USE_PTHREADS
+  #include <pthread.h>
+  #include <sys/time.h>
+#endif
+
 namespace ScallopTK
 {
 
 //------------------------------------------------------------------------------
-//                             Globals and Consts
+//                                   Consts
 //------------------------------------------------------------------------------
 
 const int MAX_THREADS = 64;
-extern int THREADS;
 
 //------------------------------------------------------------------------------
 //                                  PThreads
@@ -35,96 +40,152 @@ extern int THREADS;
 
 #ifdef USE_PTHREADS
 
-#include <pthread.h>
+// Simple mutex wrapper for state shared between worker threads
+class ThreadMutex
+{
+public:
+  ThreadMutex() { pthread_mutex_init( &mutex, NULL ); }
+  ~ThreadMutex() { pthread_mutex_destroy( &mutex ); }
 
-// Thread Status
-const int ERROR     = 0x00;
-const int AVAILABLE = 0x01;
-const int RUNNING   = 0x02;
+  void lock() { pthread_mutex_lock( &mutex ); }
+  void unlock() { pthread_mutex_unlock( &mutex ); }
 
-// Local Globals
-static int ThreadInfo[ MAX_THREADS ];
+private:
+  friend class ThreadCondition;
 
-// Global Mutex Locks
-static pthread_mutex_t ListLock;
-static pthread_mutex_t CCLock;
-static pthread_mutex_t OutputLock;
-static pthread_mutex_t LockInfo[ MAX_THREADS ];
+  pthread_mutex_t mutex;
 
-// Helper Functions
-inline void threadExit() { 
-  pthread_exit()( 0 ); 
-}
+  ThreadMutex( const ThreadMutex& );
+  ThreadMutex& operator=( const ThreadMutex& );
+};
 
-inline void markThreadAsFinished( const int& idx ) { 
-  pthread_mutex_lock(&LockInfo[idx]);
-  ThreadInfo[idx] = AVAILABLE; 
-  pthread_mutex_unlock(&LockInfo[idx]);
+// Condition variable wrapper, used alongside a ThreadMutex
+class ThreadCondition
+{
+public:
+  ThreadCondition() { pthread_cond_init( &cond, NULL ); }
+  ~ThreadCondition() { pthread_cond_destroy( &cond ); }
+
+  // Must be called with the given mutex held
+  void wait( ThreadMutex& m ) { pthread_cond_wait( &cond, &m.mutex ); }
+
+  // Wait as above for at most the given number of seconds, returns false
+  // if timed out
+  bool timedWait( ThreadMutex& m, double seconds ) {
+    timeval now;
+    gettimeofday( &now, NULL );
+    double end = now.tv_sec + now.tv_usec / 1e6 + seconds;
+    timespec abstime;
+    abstime.tv_sec = (time_t) end;
+    abstime.tv_nsec = (long) ( ( end - abstime.tv_sec ) * 1e9 );
+    return pthread_cond_timedwait( &cond, &m.mutex, &abstime ) == 0;
+  }
+
+  void signal() { pthread_cond_signal( &cond ); }
+  void broadcast() { pthread_cond_broadcast( &cond ); }
+
+private:
+  pthread_cond_t cond;
+
+  ThreadCondition( const ThreadCondition& );
+  ThreadCondition& operator=( const ThreadCondition& );
+};
+
+// True if worker threads can run concurrently in this build
+const bool THREADING_ENABLED = true;
+
+// Handle to a launched worker thread
+typedef pthread_t ThreadHandle;
+
+// Launch a new worker thread running func( arg )
+inline bool launchThread( ThreadHandle& handle, void *(*func)( void* ), void *arg ) {
+  return pthread_create( &handle, NULL, func, arg ) == 0;
 }
 
-inline void markThreadAsRunning( const int& idx ) { 
-  pthread_mutex_lock(&LockInfo[idx]);
-  ThreadInfo[idx] = RUNNING; 
-  pthread_mutex_unlock(&LockInfo[idx]);
+// Wait for a worker thread launched above to finish
+inline void joinThread( ThreadHandle& handle ) {
+  pthread_join( handle, NULL );
 }
 
-inline void setThreadsAsAvailable() {
-  for( int i=0; i < THREADS; i++ )
-    ThreadInfo[i] = AVAILABLE;
-}
+#else
 
-inline bool isThreadRunning( const int& idx ) {
-  pthread_mutex_lock(&LockInfo[idx]);
-  bool response = (ThreadInfo[idx] == RUNNING);
-  pthread_mutex_unlock(&LockInfo[idx]);
-  return response;
-}
+//------------------------------------------------------------------------------
+//                   No Threading Enabled Empty Prototypes
+//------------------------------------------------------------------------------
 
-inline void getDisplayLock() {
-  pthread_mutex_lock(&OutputLock);
-}
+// Without threading, mutexes do nothing and "launching" a thread simply
+// runs the function to completion on the calling thread
+class ThreadMutex
+{
+public:
+  void lock() {}
+  void unlock() {}
+};
 
-inline void unlockDisplay() {
-  pthread_mutex_unlock(&OutputLock);
-}
+class ThreadCondition
+{
+public:
+  void wait( ThreadMutex& m ) {}
+  bool timedWait( ThreadMutex& m, double seconds ) { return false; }
+  void signal() {}
+  void broadcast() {}
+};
 
-inline void initializeThreads() {
-  pthread_mutex_init(&OutputLock, NULL);
-  for( int i=0; i<THREADS; i++ )
-    pthread_mutex_init(&LockInfo[i], NULL);
-}
+const bool THREADING_ENABLED = false;
 
-inline void killThreads() {
-  pthread_mutex_destroy(&OutputLock);
-  for (int i=0; i<THREADS; i++ )
-    pthread_mutex_destroy(&LockInfo[i]);
-}
+typedef int ThreadHandle;
 
-inline void getListLock() {
-  pthread_mutex_lock(&ListLock);
+inline bool launchThread( ThreadHandle& handle, void *(*func)( void* ), void *arg ) {
+  handle = 0;
+  func( arg );
+  return true;
 }
 
-inline void unlockList() {
-  pthread_mutex_unlock(&ListLock);
-}
+inline void joinThread( ThreadHandle& handle ) {}
 
-#else
+#endif
+
+// Holds a mutex for the lifetime of the object, so it is released even if
+// the code holding it throws. A NULL mutex is ignored.
+class ScopedLock
+{
+public:
+  explicit ScopedLock( ThreadMutex *m ) : mutex( m ) { if( mutex ) mutex->lock(); }
+  ~ScopedLock() { if( mutex ) mutex->unlock(); }
+
+private:
+  ThreadMutex *mutex;
+
+  ScopedLock( const ScopedLock& );
+  ScopedLock& operator=( const ScopedLock& );
+};
 
 //------------------------------------------------------------------------------
-//                   No Threading Enabled Empty Prototypes
+//                              Parallel Loops
 //------------------------------------------------------------------------------
 
-inline void initializeThreads() {}
-inline void threadExit() {}
-inline void markThreadAsFinished( const int& idx ) {}
-inline void markThreadAsRunning( const int& idx ) {}
-inline void halt_until_finished() {}
-inline void getDisplayLock() {}
-inline void unlockDisplay() {}
-inline void getListLock() {}
-inline void unlockList() {}
+// Number of candidates handed to a thread at once in per-candidate loops
+const int CANDIDATE_CHUNK_SIZE = 4;
 
-#endif
+// Body of a loop run by parallelFor, operator() is called on disjoint
+// [begin,end) sub-ranges which together cover the full loop range
+class ParallelLoopBody
+{
+public:
+  virtual ~ParallelLoopBody() {}
+  virtual void operator()( int begin, int end ) const = 0;
+};
+
+// Run body over [0,count) in chunks of chunkSize, using up to threads threads
+// including the calling thread. Chunks are handed out dynamically, so each
+// index is visited exactly once; if iterations are independent the results
+// are identical to a serial loop for any thread count. Helper threads come
+// from a process-wide pool launched on first use, so calls are cheap and may
+// be nested or made from several threads at once. If the body throws on any
+// thread, no further chunks are started and, once every running chunk has
+// finished, the first error is rethrown to the caller as a runtime_error.
+void parallelFor( int count, const ParallelLoopBody& body,
+  int threads, int chunkSize = 1 );
 
 }
 
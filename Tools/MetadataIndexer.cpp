@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------------
+// Title: Metadata Indexer
+// Description: Scan a survey directory once and write a sidecar index of
+//  image metadata and dimensions, used by the detector instead of parsing
+//  metadata from every image when the survey is reprocessed
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//                               Include Files
+//------------------------------------------------------------------------------
+
+// Standard C/C++
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Scallop Includes
+#include "ScallopTK/ScaleDetection/MetadataIndex.h"
+#include "ScallopTK/Utilities/HelperFunctions.h"
+#include "ScallopTK/Utilities/Filesystem.h"
+
+//------------------------------------------------------------------------------
+//                               Configurations
+//------------------------------------------------------------------------------
+
+// Namespaces
+using namespace std;
+using namespace ScallopTK;
+
+//------------------------------------------------------------------------------
+//                                Main Function
+//------------------------------------------------------------------------------
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 && argc != 3 )
+  {
+    cout << endl;
+    cout << "Metadata Indexer Usage: " << endl;
+    cout << "./MetadataIndexer [INPUT_DIR] [OUTPUT_INDEX]" << endl;
+    cout << endl;
+    cout << "If no output is given, the index is written to ";
+    cout << "INPUT_DIR/" << DEFAULT_METADATA_INDEX << endl;
+    cout << endl;
+    return 0;
+  }
+
+  string inputDir = argv[1];
+
+  if( inputDir.size() > 0 && inputDir[ inputDir.size()-1 ] != '\\' &&
+      inputDir[ inputDir.size()-1 ] != '/' )
+  {
+    inputDir = inputDir + "/";
+  }
+
+  string output = ( argc == 3 ? string( argv[2] ) : inputDir + DEFAULT_METADATA_INDEX );
+
+  // Get a list of all images in the input dir
+  vector< string > filenames, subdirs;
+
+  if( !listAllFile( inputDir, filenames, subdirs ) )
+  {
+    cerr << "ERROR: Unable to read directory " << inputDir << endl;
+    return 1;
+  }
+
+  cullNonImages( filenames );
+
+  // Read each image header
+  MetadataIndex index;
+  unsigned withMetadata = 0;
+
+  for( unsigned i = 0; i < filenames.size(); i++ )
+  {
+    MetadataIndexEntry entry;
+
+    if( !readIndexEntry( filenames[i], entry ) )
+    {
+      cerr << "WARNING: Unable to read " << filenames[i] << ", skipping" << endl;
+      continue;
+    }
+
+    if( index.find( filenames[i] ) )
+    {
+      cerr << "WARNING: Duplicate filename " << filenames[i] << ", ";
+      cerr << "only the last is indexed" << endl;
+    }
+
+    if( entry.metadata.valid )
+    {
+      withMetadata++;
+    }
+
+    index.insert( filenames[i], entry );
+  }
+
+  if( !index.save( output ) )
+  {
+    cerr << "ERROR: Unable to write index " << output << endl;
+    return 1;
+  }
+
+  cout << "Indexed " << index.size() << " images (" << withMetadata;
+  cout << " with metadata) to " << output << endl;
+  return 0;
+}
@@ -321,11 +321,11 @@ int main( int argc, char** argv )
     settings.NumThreads = 1;
   }
 
-#ifdef WIN32
-  // If on windows, default to 1 thread
+#ifndef USE_PTHREADS
+  // If built without threading support, default to 1 thread
   if( settings.NumThreads != 1 ) {
     cerr << endl;
-    cerr << "WARNING: Windows version does not support threading at this time. ";
+    cerr << "WARNING: This build does not support threading (ENABLE_THREADING). ";
     cerr << "WARNING: Defaulting to 1 thread." << endl;
     settings.NumThreads = 1;
   }